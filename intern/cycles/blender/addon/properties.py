@@ -57,6 +57,7 @@ enum_displacement_methods = (
 
 enum_bvh_layouts = (
     ('BVH2', "BVH2", "", 1),
+    ('BVH4', "BVH4", "", 2),
     ('EMBREE', "Embree", "", 4),
 )
 
@@ -395,6 +396,12 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         min=0.0, max=1.0,
         default=0.01,
     )
+    use_light_tree: BoolProperty(
+        name="Light Tree",
+        description="Sample lights based on their distance, orientation and strength, "
+        "which reduces noise in scenes with many lights (only used for path tracing)",
+        default=False,
+    )
 
     use_adaptive_sampling: BoolProperty(
         name="Use Adaptive Sampling",
@@ -697,6 +704,19 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         default=0,
         min=0, max=16,
     )
+    use_texture_cache: BoolProperty(
+        name="Texture Cache",
+        description="Load tiles of image textures while rendering on the CPU, instead of loading "
+        "all images before rendering. Tiled and mipmapped files (.tx) load fastest",
+        default=False,
+    )
+    texture_cache_size: IntProperty(
+        name="Cache Size",
+        description="Maximum memory used by image tiles in the texture cache, in megabytes",
+        default=4096,
+        min=64, max=1048576,
+        subtype='UNSIGNED',
+    )
     tile_order: EnumProperty(
         name="Tile Order",
         description="Tile order for rendering",
@@ -836,6 +856,15 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         default='EMBREE',
     )
     debug_use_cpu_split_kernel: BoolProperty(name="Split Kernel", default=False)
+    debug_cpu_split_kernel_paths: IntProperty(
+        name="Split Kernel Paths",
+        default=1024,
+        min=1,
+        max=65536,
+        description="Number of paths each thread traces at once with the split kernel, every "
+        "kernel stage processes all of them before the next stage starts (reduced when their "
+        "states would use more than 1 GB of memory)"
+    )
 
     debug_use_cuda_adaptive_compile: BoolProperty(name="Adaptive Compile", default=False)
     debug_use_cuda_split_kernel: BoolProperty(name="Split Kernel", default=False)
@@ -27,6 +27,7 @@
 
 #include "util/util_foreach.h"
 #include "util/util_progress.h"
+#include "util/util_time.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -42,7 +43,10 @@ int BVHStackEntry::encodeIdx() const
 BVH2::BVH2(const BVHParams &params_,
            const vector<Geometry *> &geometry_,
            const vector<Object *> &objects_)
-    : BVH(params_, geometry_, objects_)
+    : BVH(params_, geometry_, objects_),
+      top_level_prims_size(0),
+      top_level_nodes_size(0),
+      top_level_leaf_nodes_size(0)
 {
 }
 
@@ -59,6 +63,7 @@ void BVH2::build(Progress &progress, Stats *)
                      params,
                      progress);
   BVHNode *bvh2_root = bvh_build.run();
+  build_stats = bvh_build.stats;
 
   if (progress.get_cancel()) {
     if (bvh2_root != NULL) {
@@ -81,6 +86,8 @@ void BVH2::build(Progress &progress, Stats *)
     return;
   }
 
+  const double pack_start_time = time_dt();
+
   /* pack triangles */
   progress.set_substatus("Packing BVH triangles and strands");
   pack_primitives();
@@ -94,18 +101,46 @@ void BVH2::build(Progress &progress, Stats *)
   progress.set_substatus("Packing BVH nodes");
   pack_nodes(root);
 
+  build_stats.pack_time = time_dt() - pack_start_time;
+
   /* free build nodes */
   root->deleteSubtree();
 }
 
 void BVH2::refit(Progress &progress)
 {
+  if (params.top_level) {
+    /* Strip the merged instance BVHs and restore geometry local primitive indices, so the top
+     * level part of the arrays is the same as it was right after building. */
+    pack.prim_index.resize(top_level_prims_size);
+    pack.prim_type.resize(top_level_prims_size);
+    pack.prim_object.resize(top_level_prims_size);
+    if (pack.prim_time.size()) {
+      pack.prim_time.resize(top_level_prims_size);
+    }
+    pack.nodes.resize(top_level_nodes_size);
+    pack.leaf_nodes.resize(top_level_leaf_nodes_size);
+
+    for (size_t i = 0; i < pack.prim_index.size(); i++) {
+      if (pack.prim_index[i] != -1) {
+        pack.prim_index[i] -= objects[pack.prim_object[i]]->get_geometry()->prim_offset;
+      }
+    }
+  }
+
   progress.set_substatus("Packing BVH primitives");
   pack_primitives();
 
   if (progress.get_cancel())
     return;
 
+  if (params.top_level) {
+    /* Merge the (possibly refitted) instance BVHs again, refitting uses the bounds of the
+     * instancing objects for them. */
+    progress.set_substatus("Packing BVH instances");
+    pack_instances(top_level_nodes_size, top_level_leaf_nodes_size);
+  }
+
   progress.set_substatus("Refitting BVH nodes");
   refit_nodes();
 }
@@ -260,7 +295,10 @@ void BVH2::pack_nodes(const BVHNode *root)
   pack.leaf_nodes.clear();
   /* For top level BVH, first merge existing BVH's so we know the offsets. */
   if (params.top_level) {
-    pack_instances(node_size, num_leaf_nodes * BVH_NODE_LEAF_SIZE);
+    top_level_prims_size = pack.prim_index.size();
+    top_level_nodes_size = node_size;
+    top_level_leaf_nodes_size = num_leaf_nodes * BVH_NODE_LEAF_SIZE;
+    pack_instances(top_level_nodes_size, top_level_leaf_nodes_size);
   }
   else {
     pack.nodes.resize(node_size);
@@ -315,8 +353,6 @@ void BVH2::pack_nodes(const BVHNode *root)
 
 void BVH2::refit_nodes()
 {
-  assert(!params.top_level);
-
   BoundBox bbox = BoundBox::empty;
   uint visibility = 0;
   refit_node(0, (pack.root_index == -1) ? true : false, bbox, visibility);
@@ -659,38 +695,8 @@ void BVH2::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
     }
 
     if (bvh->pack.nodes.size()) {
-      int4 *bvh_nodes = &bvh->pack.nodes[0];
-      size_t bvh_nodes_size = bvh->pack.nodes.size();
-
-      for (size_t i = 0, j = 0; i < bvh_nodes_size; j++) {
-        size_t nsize, nsize_bbox;
-        if (bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
-          nsize = BVH_UNALIGNED_NODE_SIZE;
-          nsize_bbox = 0;
-        }
-        else {
-          nsize = BVH_NODE_SIZE;
-          nsize_bbox = 0;
-        }
-
-        memcpy(pack_nodes + pack_nodes_offset, bvh_nodes + i, nsize_bbox * sizeof(int4));
-
-        /* Modify offsets into arrays */
-        int4 data = bvh_nodes[i + nsize_bbox];
-        data.z += (data.z < 0) ? -noffset_leaf : noffset;
-        data.w += (data.w < 0) ? -noffset_leaf : noffset;
-        pack_nodes[pack_nodes_offset + nsize_bbox] = data;
-
-        /* Usually this copies nothing, but we better
-         * be prepared for possible node size extension.
-         */
-        memcpy(&pack_nodes[pack_nodes_offset + nsize_bbox + 1],
-               &bvh_nodes[i + nsize_bbox + 1],
-               sizeof(int4) * (nsize - (nsize_bbox + 1)));
-
-        pack_nodes_offset += nsize;
-        i += nsize;
-      }
+      pack_instance_nodes(bvh->pack, pack_nodes + pack_nodes_offset, noffset, noffset_leaf);
+      pack_nodes_offset += bvh->pack.nodes.size();
     }
 
     nodes_offset += bvh->pack.nodes.size();
@@ -699,4 +705,29 @@ void BVH2::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
   }
 }
 
+void BVH2::pack_instance_nodes(const PackedBVH &instance_pack,
+                               int4 *pack_nodes,
+                               int nodes_offset,
+                               int leaf_nodes_offset)
+{
+  const int4 *bvh_nodes = &instance_pack.nodes[0];
+  const size_t bvh_nodes_size = instance_pack.nodes.size();
+
+  for (size_t i = 0; i < bvh_nodes_size;) {
+    const size_t nsize = (bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) ? BVH_UNALIGNED_NODE_SIZE :
+                                                                      BVH_NODE_SIZE;
+
+    /* Modify offsets into arrays */
+    int4 data = bvh_nodes[i];
+    data.z += (data.z < 0) ? -leaf_nodes_offset : nodes_offset;
+    data.w += (data.w < 0) ? -leaf_nodes_offset : nodes_offset;
+    pack_nodes[i] = data;
+
+    /* Copy the bounds or aligned spaces of the children as is. */
+    memcpy(&pack_nodes[i + 1], &bvh_nodes[i + 1], sizeof(int4) * (nsize - 1));
+
+    i += nsize;
+  }
+}
+
 CCL_NAMESPACE_END
@@ -50,7 +50,15 @@ class BVH2 : public BVH {
 
   PackedBVH pack;
 
+  /* Statistics of the last build. */
+  BVHBuildStats build_stats;
+
  protected:
+  /* Size of the top level part of the packed arrays, instanced BVHs are merged in after it. */
+  size_t top_level_prims_size;
+  size_t top_level_nodes_size;
+  size_t top_level_leaf_nodes_size;
+
   /* constructor */
   friend class BVH;
   BVH2(const BVHParams &params,
@@ -61,7 +69,7 @@ class BVH2 : public BVH {
   virtual BVHNode *widen_children_nodes(const BVHNode *root);
 
   /* pack */
-  void pack_nodes(const BVHNode *root);
+  virtual void pack_nodes(const BVHNode *root);
 
   void pack_leaf(const BVHStackEntry &e, const LeafNode *leaf);
   void pack_inner(const BVHStackEntry &e, const BVHStackEntry &e0, const BVHStackEntry &e1);
@@ -92,7 +100,7 @@ class BVH2 : public BVH {
 
   /* refit */
   void refit_nodes();
-  void refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility);
+  virtual void refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility);
 
   /* Refit range of primitives. */
   void refit_primitives(int start, int end, BoundBox &bbox, uint &visibility);
@@ -103,6 +111,10 @@ class BVH2 : public BVH {
 
   /* merge instance BVH's */
   void pack_instances(size_t nodes_size, size_t leaf_nodes_size);
+  virtual void pack_instance_nodes(const PackedBVH &instance_pack,
+                                   int4 *pack_nodes,
+                                   int nodes_offset,
+                                   int leaf_nodes_offset);
 };
 
 CCL_NAMESPACE_END
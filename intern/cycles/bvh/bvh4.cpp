@@ -0,0 +1,238 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bvh/bvh4.h"
+
+#include "bvh/bvh_node.h"
+
+CCL_NAMESPACE_BEGIN
+
+BVH4::BVH4(const BVHParams &params_,
+           const vector<Geometry *> &geometry_,
+           const vector<Object *> &objects_)
+    : BVH2(params_, geometry_, objects_)
+{
+  /* The SIMD node intersection only supports axis aligned bounds. */
+  params.use_unaligned_nodes = false;
+}
+
+/* Collapse the binary tree below the given node, by repeatedly replacing the inner child with
+ * the largest surface area with its own children until there are four children. */
+static BVHNode *bvh4_widen_node(const BVHNode *node)
+{
+  if (node->is_leaf()) {
+    return new LeafNode(*reinterpret_cast<const LeafNode *>(node));
+  }
+
+  const BVHNode *children[4] = {node->get_child(0), node->get_child(1)};
+  int num_children = 2;
+
+  while (num_children < 4) {
+    int best_child = -1;
+    float best_area = -FLT_MAX;
+    for (int i = 0; i < num_children; i++) {
+      if (!children[i]->is_leaf() && children[i]->bounds.safe_area() > best_area) {
+        best_child = i;
+        best_area = children[i]->bounds.safe_area();
+      }
+    }
+    if (best_child == -1) {
+      break;
+    }
+
+    const BVHNode *expand = children[best_child];
+    children[best_child] = expand->get_child(0);
+    children[num_children++] = expand->get_child(1);
+  }
+
+  BVHNode *wide_children[4];
+  for (int i = 0; i < num_children; i++) {
+    wide_children[i] = bvh4_widen_node(children[i]);
+  }
+
+  return new InnerNode(node->bounds, wide_children, num_children);
+}
+
+BVHNode *BVH4::widen_children_nodes(const BVHNode *root)
+{
+  if (root == NULL) {
+    return NULL;
+  }
+  return bvh4_widen_node(root);
+}
+
+void BVH4::pack_node(int idx,
+                     const BoundBox *bounds,
+                     const int *child,
+                     const uint *visibility,
+                     const int num_children)
+{
+  assert(idx + BVH4_NODE_SIZE <= pack.nodes.size());
+  assert(num_children <= 4);
+
+  int4 data[BVH4_NODE_SIZE];
+  for (int i = 0; i < 4; i++) {
+    /* Unused children get empty bounds, which are never intersected. */
+    const BoundBox &b = (i < num_children) ? bounds[i] : BoundBox::empty;
+
+    data[0][i] = (i < num_children) ? visibility[i] : 0;
+    data[1][i] = __float_as_int(b.min.x);
+    data[2][i] = __float_as_int(b.max.x);
+    data[3][i] = __float_as_int(b.min.y);
+    data[4][i] = __float_as_int(b.max.y);
+    data[5][i] = __float_as_int(b.min.z);
+    data[6][i] = __float_as_int(b.max.z);
+    data[7][i] = (i < num_children) ? child[i] : 0;
+  }
+
+  memcpy(&pack.nodes[idx], data, sizeof(int4) * BVH4_NODE_SIZE);
+}
+
+void BVH4::pack_nodes(const BVHNode *root)
+{
+  const size_t num_nodes = root->getSubtreeSize(BVH_STAT_NODE_COUNT);
+  const size_t num_leaf_nodes = root->getSubtreeSize(BVH_STAT_LEAF_COUNT);
+  assert(num_leaf_nodes <= num_nodes);
+  const size_t node_size = (num_nodes - num_leaf_nodes) * BVH4_NODE_SIZE;
+
+  /* Resize arrays */
+  pack.nodes.clear();
+  pack.leaf_nodes.clear();
+  /* For top level BVH, first merge existing BVH's so we know the offsets. */
+  if (params.top_level) {
+    top_level_prims_size = pack.prim_index.size();
+    top_level_nodes_size = node_size;
+    top_level_leaf_nodes_size = num_leaf_nodes * BVH_NODE_LEAF_SIZE;
+    pack_instances(top_level_nodes_size, top_level_leaf_nodes_size);
+  }
+  else {
+    pack.nodes.resize(node_size);
+    pack.leaf_nodes.resize(num_leaf_nodes * BVH_NODE_LEAF_SIZE);
+  }
+
+  int next_node_idx = 0, next_leaf_node_idx = 0;
+
+  vector<BVHStackEntry> stack;
+  stack.reserve(BVHParams::MAX_DEPTH * 4);
+  if (root->is_leaf()) {
+    stack.push_back(BVHStackEntry(root, next_leaf_node_idx++));
+  }
+  else {
+    stack.push_back(BVHStackEntry(root, next_node_idx));
+    next_node_idx += BVH4_NODE_SIZE;
+  }
+
+  while (stack.size()) {
+    BVHStackEntry e = stack.back();
+    stack.pop_back();
+
+    if (e.node->is_leaf()) {
+      /* leaf node */
+      const LeafNode *leaf = reinterpret_cast<const LeafNode *>(e.node);
+      pack_leaf(e, leaf);
+    }
+    else {
+      /* inner node */
+      const int num_children = e.node->num_children();
+      BoundBox bounds[4];
+      int child[4];
+      uint visibility[4];
+
+      for (int i = 0; i < num_children; ++i) {
+        const BVHNode *child_node = e.node->get_child(i);
+        int idx;
+        if (child_node->is_leaf()) {
+          idx = next_leaf_node_idx++;
+        }
+        else {
+          idx = next_node_idx;
+          next_node_idx += BVH4_NODE_SIZE;
+        }
+
+        const BVHStackEntry child_entry(child_node, idx);
+        stack.push_back(child_entry);
+
+        bounds[i] = child_node->bounds;
+        child[i] = child_entry.encodeIdx();
+        visibility[i] = child_node->visibility;
+      }
+
+      pack_node(e.idx, bounds, child, visibility, num_children);
+    }
+  }
+  assert(node_size == next_node_idx);
+  /* root index to start traversal at, to handle case of single leaf node */
+  pack.root_index = (root->is_leaf()) ? -1 : 0;
+}
+
+void BVH4::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
+{
+  if (leaf) {
+    BVH2::refit_node(idx, leaf, bbox, visibility);
+    return;
+  }
+
+  assert(idx + BVH4_NODE_SIZE <= pack.nodes.size());
+
+  const int4 cnodes = pack.nodes[idx + BVH4_NODE_SIZE - 1];
+  BoundBox child_bounds[4];
+  int child[4];
+  uint child_visibility[4];
+  int num_children = 0;
+
+  /* refit inner node, set bbox from children */
+  for (int i = 0; i < 4; i++) {
+    const int c = cnodes[i];
+    if (c == 0) {
+      continue;
+    }
+
+    child_bounds[num_children] = BoundBox::empty;
+    child_visibility[num_children] = 0;
+    refit_node((c < 0) ? -c - 1 : c,
+               (c < 0),
+               child_bounds[num_children],
+               child_visibility[num_children]);
+    child[num_children] = c;
+
+    bbox.grow(child_bounds[num_children]);
+    visibility |= child_visibility[num_children];
+    num_children++;
+  }
+
+  pack_node(idx, child_bounds, child, child_visibility, num_children);
+}
+
+void BVH4::pack_instance_nodes(const PackedBVH &instance_pack,
+                               int4 *pack_nodes,
+                               int nodes_offset,
+                               int leaf_nodes_offset)
+{
+  const size_t bvh_nodes_size = instance_pack.nodes.size();
+  memcpy(pack_nodes, &instance_pack.nodes[0], sizeof(int4) * bvh_nodes_size);
+
+  /* Modify offsets into arrays, unused children stay zero. */
+  for (size_t i = 0; i < bvh_nodes_size; i += BVH4_NODE_SIZE) {
+    int4 &cnodes = pack_nodes[i + BVH4_NODE_SIZE - 1];
+    for (int j = 0; j < 4; j++) {
+      if (cnodes[j] != 0) {
+        cnodes[j] += (cnodes[j] < 0) ? -leaf_nodes_offset : nodes_offset;
+      }
+    }
+  }
+}
+
+CCL_NAMESPACE_END
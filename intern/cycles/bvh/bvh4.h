@@ -0,0 +1,63 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BVH4_H__
+#define __BVH4_H__
+
+#include "bvh/bvh2.h"
+
+CCL_NAMESPACE_BEGIN
+
+#define BVH4_NODE_SIZE 8
+
+/* BVH4
+ *
+ * BVH with up to four children per inner node, obtained by collapsing the binary tree. The
+ * children bounds are stored per axis so the CPU kernel intersects them with SIMD. Leaf nodes,
+ * primitives and instances are packed the same way as for BVH2.
+ */
+class BVH4 : public BVH2 {
+ protected:
+  /* constructor */
+  friend class BVH;
+  BVH4(const BVHParams &params,
+       const vector<Geometry *> &geometry,
+       const vector<Object *> &objects);
+
+  /* Building process. */
+  BVHNode *widen_children_nodes(const BVHNode *root) override;
+
+  /* pack */
+  void pack_nodes(const BVHNode *root) override;
+  void pack_node(int idx,
+                 const BoundBox *bounds,
+                 const int *child,
+                 const uint *visibility,
+                 const int num_children);
+
+  /* refit */
+  void refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility) override;
+
+  /* merge instance BVH's */
+  void pack_instance_nodes(const PackedBVH &instance_pack,
+                           int4 *pack_nodes,
+                           int nodes_offset,
+                           int leaf_nodes_offset) override;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __BVH4_H__ */
@@ -372,7 +372,10 @@ BVHNode *BVHBuild::run()
   BVHRange root;
 
   /* add references */
+  const double references_start_time = time_dt();
   add_references(root);
+  stats.references_time = time_dt() - references_start_time;
+  stats.num_references = references.size();
 
   if (progress.get_cancel())
     return NULL;
@@ -425,6 +428,8 @@ BVHNode *BVHBuild::run()
     task_pool.wait_work();
   }
 
+  stats.nodes_time = time_dt() - build_start_time;
+
   /* clean up temporary memory usage by threads */
   spatial_storage.clear();
 
@@ -436,13 +441,23 @@ BVHNode *BVHBuild::run()
       VLOG(1) << "BVH build cancelled.";
     }
     else {
+      const double finalize_start_time = time_dt();
       /*rotate(rootnode, 4, 5);*/
       rootnode->update_visibility();
       rootnode->update_time();
+      stats.finalize_time = time_dt() - finalize_start_time;
+
+      stats.sah_cost = rootnode->computeSubtreeSAHCost(params);
+      if (params.use_spatial_split) {
+        stats.num_duplicated_references = spatial_free_index - stats.num_references;
+      }
     }
     if (rootnode != NULL) {
       VLOG(1) << "BVH build statistics:\n"
               << "  Build time: " << time_dt() - build_start_time << "\n"
+              << "  SAH cost: " << stats.sah_cost << "\n"
+              << "  Number of duplicated references: "
+              << string_human_readable_number(stats.num_duplicated_references) << "\n"
               << "  Total number of nodes: "
               << string_human_readable_number(rootnode->getSubtreeSize(BVH_STAT_NODE_COUNT))
               << "\n"
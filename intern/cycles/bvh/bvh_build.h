@@ -57,6 +57,9 @@ class BVHBuild {
 
   BVHNode *run();
 
+  /* Statistics of the last run. */
+  BVHBuildStats stats;
+
  protected:
   friend class BVHMixedSplit;
   friend class BVHObjectSplit;
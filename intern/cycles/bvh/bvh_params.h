@@ -309,6 +309,37 @@ struct BVHSpatialStorage {
   vector<BVHReference> new_references;
 };
 
+/* BVH Build Statistics
+ *
+ * Timing of the build phases and quality of the resulting tree, reported as part of the render
+ * statistics. */
+
+struct BVHBuildStats {
+  /* Time spent in the build phases, in seconds. */
+  double references_time;
+  double nodes_time;
+  double finalize_time;
+  double pack_time;
+
+  /* Number of primitive references, and how many of them were added by spatial splits. */
+  size_t num_references;
+  size_t num_duplicated_references;
+
+  /* Surface area heuristic cost of the built tree. */
+  float sah_cost;
+
+  BVHBuildStats()
+      : references_time(0.0),
+        nodes_time(0.0),
+        finalize_time(0.0),
+        pack_time(0.0),
+        num_references(0),
+        num_duplicated_references(0),
+        sah_cost(0.0f)
+  {
+  }
+};
+
 CCL_NAMESPACE_END
 
 #endif /* __BVH_PARAMS_H__ */
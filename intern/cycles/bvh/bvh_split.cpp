@@ -25,9 +25,17 @@
 #include "render/object.h"
 
 #include "util/util_algorithm.h"
+#include "util/util_tbb.h"
 
 CCL_NAMESPACE_BEGIN
 
+/* Number of references handled by a single task when the spatial split of a range is evaluated
+ * or performed in parallel.
+ *
+ * NOTE: The per-thread spatial storage is not used by the parallel loops. A thread waiting for
+ * the loop to finish may pick up another node build task, which uses the same storage. */
+static const int SPATIAL_SPLIT_REFERENCES_PER_TASK = 1024;
+
 /* Object Split */
 
 BVHObjectSplit::BVHObjectSplit(BVHBuild *builder,
@@ -130,6 +138,19 @@ void BVHObjectSplit::split(BVHRange &left, BVHRange &right, const BVHRange &rang
 
 /* Spatial Split */
 
+static void spatial_bins_clear(BVHSpatialBin bins[3][BVHParams::NUM_SPATIAL_BINS])
+{
+  for (int dim = 0; dim < 3; dim++) {
+    for (int i = 0; i < BVHParams::NUM_SPATIAL_BINS; i++) {
+      BVHSpatialBin &bin = bins[dim][i];
+
+      bin.bounds = BoundBox::empty;
+      bin.enter = 0;
+      bin.exit = 0;
+    }
+  }
+}
+
 BVHSpatialSplit::BVHSpatialSplit(const BVHBuild &builder,
                                  BVHSpatialStorage *storage,
                                  const BVHRange &range,
@@ -159,44 +180,37 @@ BVHSpatialSplit::BVHSpatialSplit(const BVHBuild &builder,
   float3 binSize = (range_bounds.max - origin) * (1.0f / (float)BVHParams::NUM_SPATIAL_BINS);
   float3 invBinSize = 1.0f / binSize;
 
-  for (int dim = 0; dim < 3; dim++) {
-    for (int i = 0; i < BVHParams::NUM_SPATIAL_BINS; i++) {
-      BVHSpatialBin &bin = storage_->bins[dim][i];
-
-      bin.bounds = BoundBox::empty;
-      bin.enter = 0;
-      bin.exit = 0;
-    }
-  }
-
   /* chop references into bins. */
-  for (unsigned int refIdx = range.start(); refIdx < range.end(); refIdx++) {
-    const BVHReference &ref = references_->at(refIdx);
-    BoundBox prim_bounds = get_prim_bounds(ref);
-    float3 firstBinf = (prim_bounds.min - origin) * invBinSize;
-    float3 lastBinf = (prim_bounds.max - origin) * invBinSize;
-    int3 firstBin = make_int3((int)firstBinf.x, (int)firstBinf.y, (int)firstBinf.z);
-    int3 lastBin = make_int3((int)lastBinf.x, (int)lastBinf.y, (int)lastBinf.z);
-
-    firstBin = clamp(firstBin, 0, BVHParams::NUM_SPATIAL_BINS - 1);
-    lastBin = clamp(lastBin, firstBin, BVHParams::NUM_SPATIAL_BINS - 1);
-
-    for (int dim = 0; dim < 3; dim++) {
-      BVHReference currRef(
-          get_prim_bounds(ref), ref.prim_index(), ref.prim_object(), ref.prim_type());
-
-      for (int i = firstBin[dim]; i < lastBin[dim]; i++) {
-        BVHReference leftRef, rightRef;
-
-        split_reference(
-            builder, leftRef, rightRef, currRef, dim, origin[dim] + binSize[dim] * (float)(i + 1));
-        storage_->bins[dim][i].bounds.grow(leftRef.bounds());
-        currRef = rightRef;
+  if (range.size() < BVHBuild::THREAD_TASK_SIZE) {
+    spatial_bins_clear(storage_->bins);
+    bin_references(
+        builder, range.start(), range.end(), origin, binSize, invBinSize, storage_->bins);
+  }
+  else {
+    /* Bin blocks of references in parallel and merge the histograms after. */
+    struct BlockBins {
+      BVHSpatialBin bins[3][BVHParams::NUM_SPATIAL_BINS];
+    };
+    const int num_blocks = divide_up(range.size(), SPATIAL_SPLIT_REFERENCES_PER_TASK);
+    vector<BlockBins> block_bins(num_blocks);
+
+    parallel_for(0, num_blocks, [&](int block) {
+      const int start = range.start() + block * SPATIAL_SPLIT_REFERENCES_PER_TASK;
+      const int end = min(start + SPATIAL_SPLIT_REFERENCES_PER_TASK, range.end());
+      spatial_bins_clear(block_bins[block].bins);
+      bin_references(builder, start, end, origin, binSize, invBinSize, block_bins[block].bins);
+    });
+
+    spatial_bins_clear(storage_->bins);
+    for (const BlockBins &block : block_bins) {
+      for (int dim = 0; dim < 3; dim++) {
+        for (int i = 0; i < BVHParams::NUM_SPATIAL_BINS; i++) {
+          BVHSpatialBin &bin = storage_->bins[dim][i];
+          bin.bounds.grow(block.bins[dim][i].bounds);
+          bin.enter += block.bins[dim][i].enter;
+          bin.exit += block.bins[dim][i].exit;
+        }
       }
-
-      storage_->bins[dim][lastBin[dim]].bounds.grow(currRef.bounds());
-      storage_->bins[dim][firstBin[dim]].enter++;
-      storage_->bins[dim][lastBin[dim]].exit++;
     }
   }
 
@@ -233,6 +247,49 @@ BVHSpatialSplit::BVHSpatialSplit(const BVHBuild &builder,
   }
 }
 
+void BVHSpatialSplit::bin_references(const BVHBuild &builder,
+                                     int start,
+                                     int end,
+                                     const float3 &origin,
+                                     const float3 &bin_size,
+                                     const float3 &inv_bin_size,
+                                     BVHSpatialBin bins[3][BVHParams::NUM_SPATIAL_BINS])
+{
+  for (int refIdx = start; refIdx < end; refIdx++) {
+    const BVHReference &ref = references_->at(refIdx);
+    BoundBox prim_bounds = get_prim_bounds(ref);
+    float3 firstBinf = (prim_bounds.min - origin) * inv_bin_size;
+    float3 lastBinf = (prim_bounds.max - origin) * inv_bin_size;
+    int3 firstBin = make_int3((int)firstBinf.x, (int)firstBinf.y, (int)firstBinf.z);
+    int3 lastBin = make_int3((int)lastBinf.x, (int)lastBinf.y, (int)lastBinf.z);
+
+    firstBin = clamp(firstBin, 0, BVHParams::NUM_SPATIAL_BINS - 1);
+    lastBin = clamp(lastBin, firstBin, BVHParams::NUM_SPATIAL_BINS - 1);
+
+    for (int dim = 0; dim < 3; dim++) {
+      BVHReference currRef(
+          get_prim_bounds(ref), ref.prim_index(), ref.prim_object(), ref.prim_type());
+
+      for (int i = firstBin[dim]; i < lastBin[dim]; i++) {
+        BVHReference leftRef, rightRef;
+
+        split_reference(builder,
+                        leftRef,
+                        rightRef,
+                        currRef,
+                        dim,
+                        origin[dim] + bin_size[dim] * (float)(i + 1));
+        bins[dim][i].bounds.grow(leftRef.bounds());
+        currRef = rightRef;
+      }
+
+      bins[dim][lastBin[dim]].bounds.grow(currRef.bounds());
+      bins[dim][firstBin[dim]].enter++;
+      bins[dim][lastBin[dim]].exit++;
+    }
+  }
+}
+
 void BVHSpatialSplit::split(BVHBuild *builder,
                             BVHRange &left,
                             BVHRange &right,
@@ -266,6 +323,32 @@ void BVHSpatialSplit::split(BVHBuild *builder,
     }
   }
 
+  /* Clipping references against the split plane is the expensive part of the split. For many
+   * references intersecting both sides do it in parallel up front, the order dependent choice
+   * between duplicating and unsplitting is made after. Clipped references are stored as left and
+   * right pairs, and are swapped along with the references they belong to. */
+  const int split_start = left_end;
+  const bool parallel_split = (right_start - left_end) >= BVHBuild::THREAD_TASK_SIZE;
+  vector<BVHReference> split_refs;
+  if (parallel_split) {
+    split_refs.resize(2 * (right_start - left_end));
+    parallel_for(blocked_range<int>(left_end, right_start, SPATIAL_SPLIT_REFERENCES_PER_TASK),
+                 [&](const blocked_range<int> &r) {
+                   for (int i = r.begin(); i != r.end(); i++) {
+                     const BVHReference curr_ref(get_prim_bounds(refs[i]),
+                                                 refs[i].prim_index(),
+                                                 refs[i].prim_object(),
+                                                 refs[i].prim_type());
+                     split_reference(*builder,
+                                     split_refs[2 * (i - split_start)],
+                                     split_refs[2 * (i - split_start) + 1],
+                                     curr_ref,
+                                     this->dim,
+                                     this->pos);
+                   }
+                 });
+  }
+
   /* Duplicate or unsplit references intersecting both sides.
    *
    * Duplication happens into a temporary pre-allocated vector in order to
@@ -281,7 +364,13 @@ void BVHSpatialSplit::split(BVHBuild *builder,
                           refs[left_end].prim_object(),
                           refs[left_end].prim_type());
     BVHReference lref, rref;
-    split_reference(*builder, lref, rref, curr_ref, this->dim, this->pos);
+    if (parallel_split) {
+      lref = split_refs[2 * (left_end - split_start)];
+      rref = split_refs[2 * (left_end - split_start) + 1];
+    }
+    else {
+      split_reference(*builder, lref, rref, curr_ref, this->dim, this->pos);
+    }
 
     /* compute SAH for duplicate/unsplit candidates. */
     BoundBox lub = left_bounds;   // Unsplit to left:     new left-hand bounds.
@@ -312,7 +401,14 @@ void BVHSpatialSplit::split(BVHBuild *builder,
     else if (minSAH == unsplitRightSAH) {
       /* unsplit to right */
       right_bounds = rub;
-      swap(refs[left_end], refs[--right_start]);
+      --right_start;
+      swap(refs[left_end], refs[right_start]);
+      if (parallel_split) {
+        swap(split_refs[2 * (left_end - split_start)],
+             split_refs[2 * (right_start - split_start)]);
+        swap(split_refs[2 * (left_end - split_start) + 1],
+             split_refs[2 * (right_start - split_start) + 1]);
+      }
     }
     else {
       /* duplicate */
@@ -102,6 +102,15 @@ class BVHSpatialSplit {
   const BVHUnaligned *unaligned_heuristic_;
   const Transform *aligned_space_;
 
+  /* Add references in the given range to the bins of all three axes. */
+  void bin_references(const BVHBuild &builder,
+                      int start,
+                      int end,
+                      const float3 &origin,
+                      const float3 &bin_size,
+                      const float3 &inv_bin_size,
+                      BVHSpatialBin bins[3][BVHParams::NUM_SPATIAL_BINS]);
+
   /* Lower-level functions which calculates boundaries of left and right nodes
    * needed for spatial split.
    *
@@ -1026,6 +1026,25 @@ void CUDADevice::mem_copy_to(device_memory &mem)
   }
 }
 
+void CUDADevice::mem_copy_to_range(device_memory &mem, size_t offset, size_t size)
+{
+  if (mem.type == MEM_PIXELS || mem.type == MEM_TEXTURE || !mem.device_pointer ||
+      !mem.host_pointer || !mem.is_resident(this) || mem.device_size != mem.memory_size()) {
+    Device::mem_copy_to_range(mem, offset, size);
+    return;
+  }
+
+  thread_scoped_lock lock(cuda_mem_map_mutex);
+  if (!cuda_mem_map[&mem].use_mapped_host || mem.host_pointer != mem.shared_pointer) {
+    const CUDAContextScope scope(this);
+    const size_t element_size = mem.memory_elements_size(1);
+    const size_t offset_bytes = offset * element_size;
+    cuda_assert(cuMemcpyHtoD((CUdeviceptr)mem.device_pointer + offset_bytes,
+                             (const char *)mem.host_pointer + offset_bytes,
+                             size * element_size));
+  }
+}
+
 void CUDADevice::mem_copy_from(device_memory &mem, int y, int w, int h, int elem)
 {
   if (mem.type == MEM_PIXELS && !background) {
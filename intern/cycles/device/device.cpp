@@ -366,9 +366,14 @@ void Device::draw_pixels(device_memory &rgba,
   }
 }
 
+void Device::mem_copy_to_range(device_memory &mem, size_t /*offset*/, size_t /*size*/)
+{
+  mem_copy_to(mem);
+}
+
 void Device::build_bvh(BVH *bvh, Progress &progress, bool refit)
 {
-  assert(bvh->params.bvh_layout == BVH_LAYOUT_BVH2);
+  assert(bvh->params.bvh_layout == BVH_LAYOUT_BVH2 || bvh->params.bvh_layout == BVH_LAYOUT_BVH4);
 
   BVH2 *const bvh2 = static_cast<BVH2 *>(bvh);
   if (refit) {
@@ -619,6 +624,8 @@ DeviceInfo Device::get_multi_device(const vector<DeviceInfo> &subdevices,
   info.num = 0;
 
   info.has_half_images = true;
+  info.has_sparse_images = true;
+  info.has_texture_cache = true;
   info.has_volume_decoupled = true;
   info.has_branched_path = true;
   info.has_adaptive_stop_per_sample = true;
@@ -665,6 +672,8 @@ DeviceInfo Device::get_multi_device(const vector<DeviceInfo> &subdevices,
 
     /* Accumulate device info. */
     info.has_half_images &= device.has_half_images;
+    info.has_sparse_images &= device.has_sparse_images;
+    info.has_texture_cache &= device.has_texture_cache;
     info.has_volume_decoupled &= device.has_volume_decoupled;
     info.has_branched_path &= device.has_branched_path;
     info.has_adaptive_stop_per_sample &= device.has_adaptive_stop_per_sample;
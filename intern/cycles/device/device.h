@@ -78,6 +78,8 @@ class DeviceInfo {
   int num;
   bool display_device;               /* GPU is used as a display device. */
   bool has_half_images;              /* Support half-float textures. */
+  bool has_sparse_images;            /* Support sparse 3D textures. */
+  bool has_texture_cache;            /* Support loading image tiles while rendering. */
   bool has_volume_decoupled;         /* Decoupled volume shading. */
   bool has_branched_path;            /* Supports branched path tracing. */
   bool has_adaptive_stop_per_sample; /* Per-sample adaptive sampling stopping. */
@@ -99,6 +101,8 @@ class DeviceInfo {
     cpu_threads = 0;
     display_device = false;
     has_half_images = false;
+    has_sparse_images = false;
+    has_texture_cache = false;
     has_volume_decoupled = false;
     has_branched_path = true;
     has_adaptive_stop_per_sample = false;
@@ -375,6 +379,11 @@ class Device {
     return NULL;
   }
 
+  /* texture cache, only for CPU device */
+  virtual void set_texture_cache_lookup(TextureCacheLookupFunction /*lookup*/)
+  {
+  }
+
   /* load/compile kernels, must be called before adding tasks */
   virtual bool load_kernels(const DeviceRequestedFeatures & /*requested_features*/)
   {
@@ -485,6 +494,9 @@ class Device {
 
   virtual void mem_alloc(device_memory &mem) = 0;
   virtual void mem_copy_to(device_memory &mem) = 0;
+  /* Copy a range of elements of memory that was copied to the device before. Devices that can't
+   * update part of an allocation copy the whole memory instead. */
+  virtual void mem_copy_to_range(device_memory &mem, size_t offset, size_t size);
   virtual void mem_copy_from(device_memory &mem, int y, int w, int h, int elem) = 0;
   virtual void mem_zero(device_memory &mem) = 0;
   virtual void mem_free(device_memory &mem) = 0;
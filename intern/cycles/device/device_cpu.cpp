@@ -312,12 +312,14 @@ class CPUDevice : public Device {
 #ifdef WITH_OSL
     kernel_globals.osl = &osl_globals;
 #endif
+    kernel_globals.texture_cache_lookup = NULL;
 #ifdef WITH_EMBREE
     embree_device = rtcNewDevice("verbose=0");
 #endif
     use_split_kernel = DebugFlags().cpu.split_kernel;
     if (use_split_kernel) {
-      VLOG(1) << "Will be using split kernel.";
+      VLOG(1) << "Will be using split kernel with up to " << DebugFlags().cpu.split_kernel_paths
+              << " paths per thread.";
     }
     need_texture_info = false;
 
@@ -367,6 +369,9 @@ class CPUDevice : public Device {
   virtual BVHLayoutMask get_bvh_layout_mask() const override
   {
     BVHLayoutMask bvh_layout_mask = BVH_LAYOUT_BVH2;
+#ifdef __KERNEL_SSE2__
+    bvh_layout_mask |= BVH_LAYOUT_BVH4;
+#endif /* __KERNEL_SSE2__ */
 #ifdef WITH_EMBREE
     bvh_layout_mask |= BVH_LAYOUT_EMBREE;
 #endif /* WITH_EMBREE */
@@ -432,6 +437,14 @@ class CPUDevice : public Device {
     }
   }
 
+  virtual void mem_copy_to_range(device_memory &mem, size_t offset, size_t size) override
+  {
+    /* Device memory is the host memory, so there is nothing to copy once allocated. */
+    if (!mem.device_pointer || mem.type == MEM_TEXTURE) {
+      Device::mem_copy_to_range(mem, offset, size);
+    }
+  }
+
   virtual void mem_copy_from(
       device_memory & /*mem*/, int /*y*/, int /*w*/, int /*h*/, int /*elem*/) override
   {
@@ -548,6 +561,11 @@ class CPUDevice : public Device {
 #endif
   }
 
+  virtual void set_texture_cache_lookup(TextureCacheLookupFunction lookup) override
+  {
+    kernel_globals.texture_cache_lookup = lookup;
+  }
+
   void build_bvh(BVH *bvh, Progress &progress, bool refit) override
   {
 #ifdef WITH_EMBREE
@@ -1543,18 +1561,16 @@ class CPUSplitKernelFunction : public SplitKernelFunction {
     KernelGlobals *kg = (KernelGlobals *)kernel_globals.device_pointer;
     kg->global_size = make_int2(dim.global_size[0], dim.global_size[1]);
 
-    for (int y = 0; y < dim.global_size[1]; y++) {
-      for (int x = 0; x < dim.global_size[0]; x++) {
-        kg->global_id = make_int2(x, y);
-
-        func(kg, (KernelData *)data.device_pointer);
-      }
-    }
+    /* The kernel loops over the work items. */
+    func(kg, (KernelData *)data.device_pointer);
 
     return true;
   }
 };
 
+/* Memory for the path states of all threads with the split kernel. */
+static const uint64_t CPU_SPLIT_KERNEL_MAX_STATE_MEMORY = 1024ull * 1024 * 1024;
+
 CPUSplitKernel::CPUSplitKernel(CPUDevice *device) : DeviceSplitKernel(device), device(device)
 {
 }
@@ -1621,11 +1637,25 @@ int2 CPUSplitKernel::split_kernel_local_size()
   return make_int2(1, 1);
 }
 
-int2 CPUSplitKernel::split_kernel_global_size(device_memory & /*kg*/,
-                                              device_memory & /*data*/,
+int2 CPUSplitKernel::split_kernel_global_size(device_memory &kg,
+                                              device_memory &data,
                                               DeviceTask & /*task*/)
 {
-  return make_int2(1, 1);
+  /* Keep many paths in flight, so each kernel stage runs over a batch of rays and its code and
+   * data stay in cache, instead of alternating between stages for every path. */
+  const int requested_paths = DebugFlags().cpu.split_kernel_paths;
+  if (requested_paths <= 1) {
+    return make_int2(1, 1);
+  }
+
+  const uint64_t state_size_per_path = state_buffer_size(kg, data, 1024) / 1024;
+  const int num_paths = split_kernel_cpu_num_paths(requested_paths,
+                                                   device->info.cpu_threads,
+                                                   state_size_per_path,
+                                                   CPU_SPLIT_KERNEL_MAX_STATE_MEMORY);
+  VLOG(1) << "Split kernel traces " << num_paths << " paths per thread, using "
+          << string_human_readable_size(state_size_per_path * num_paths) << " for the states.";
+  return make_int2(num_paths, 1);
 }
 
 uint64_t CPUSplitKernel::state_buffer_size(device_memory &kernel_globals,
@@ -1654,6 +1684,8 @@ void device_cpu_info(vector<DeviceInfo> &devices)
   info.has_adaptive_stop_per_sample = true;
   info.has_osl = true;
   info.has_half_images = true;
+  info.has_sparse_images = true;
+  info.has_texture_cache = true;
   info.has_profiling = true;
   info.denoisers = DENOISER_NLM;
   if (openimagedenoise_supported()) {
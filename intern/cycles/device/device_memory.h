@@ -253,6 +253,7 @@ class device_memory {
   void device_alloc();
   void device_free();
   void device_copy_to();
+  void device_copy_to(size_t offset, size_t size);
   void device_copy_from(int y, int w, int h, int elem);
   void device_zero();
 
@@ -333,6 +334,8 @@ template<typename T> class device_vector : public device_memory {
     data_elements = device_type_traits<T>::num_elements;
     modified = true;
     need_realloc_ = true;
+    modified_begin_ = 0;
+    modified_end_ = 0;
 
     assert(data_elements > 0);
   }
@@ -456,6 +459,24 @@ template<typename T> class device_vector : public device_memory {
     modified = true;
   }
 
+  /* Tag a range of elements as modified, so that only that part is copied to the device if the
+   * memory is not fully modified otherwise. Ranges are merged into a single one. */
+  void tag_modified(size_t offset, size_t size)
+  {
+    if (size == 0) {
+      return;
+    }
+
+    if (modified_begin_ == modified_end_) {
+      modified_begin_ = offset;
+      modified_end_ = offset + size;
+    }
+    else {
+      modified_begin_ = (offset < modified_begin_) ? offset : modified_begin_;
+      modified_end_ = (offset + size > modified_end_) ? offset + size : modified_end_;
+    }
+  }
+
   void tag_realloc()
   {
     need_realloc_ = true;
@@ -483,21 +504,30 @@ template<typename T> class device_vector : public device_memory {
     if (data_size != 0) {
       device_copy_to();
     }
+
+    modified_begin_ = modified_end_ = 0;
   }
 
   void copy_to_device_if_modified()
   {
-    if (!modified) {
+    if (modified) {
+      copy_to_device();
       return;
     }
 
-    copy_to_device();
+    if (modified_begin_ < modified_end_ && modified_begin_ < data_size) {
+      const size_t end = (modified_end_ < data_size) ? modified_end_ : data_size;
+      device_copy_to(modified_begin_, end - modified_begin_);
+    }
+
+    modified_begin_ = modified_end_ = 0;
   }
 
   void clear_modified()
   {
     modified = false;
     need_realloc_ = false;
+    modified_begin_ = modified_end_ = 0;
   }
 
   void copy_from_device()
@@ -528,6 +558,10 @@ template<typename T> class device_vector : public device_memory {
   {
     return width * ((height == 0) ? 1 : height) * ((depth == 0) ? 1 : depth);
   }
+
+  /* Range of elements modified since the last copy to the device. */
+  size_t modified_begin_;
+  size_t modified_end_;
 };
 
 /* Pixel Memory
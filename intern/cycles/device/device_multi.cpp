@@ -248,7 +248,8 @@ class MultiDevice : public Device {
   void build_bvh(BVH *bvh, Progress &progress, bool refit) override
   {
     /* Try to build and share a single acceleration structure, if possible */
-    if (bvh->params.bvh_layout == BVH_LAYOUT_BVH2 || bvh->params.bvh_layout == BVH_LAYOUT_EMBREE) {
+    if (bvh->params.bvh_layout == BVH_LAYOUT_BVH2 || bvh->params.bvh_layout == BVH_LAYOUT_BVH4 ||
+        bvh->params.bvh_layout == BVH_LAYOUT_EMBREE) {
       devices.back().device->build_bvh(bvh, progress, refit);
       return;
     }
@@ -310,6 +311,13 @@ class MultiDevice : public Device {
     return devices.front().device->osl_memory();
   }
 
+  virtual void set_texture_cache_lookup(TextureCacheLookupFunction lookup) override
+  {
+    foreach (SubDevice &sub, devices) {
+      sub.device->set_texture_cache_lookup(lookup);
+    }
+  }
+
   bool is_resident(device_ptr key, Device *sub_device) override
   {
     foreach (SubDevice &sub, devices) {
@@ -436,6 +444,41 @@ class MultiDevice : public Device {
     stats.mem_alloc(mem.device_size - existing_size);
   }
 
+  void mem_copy_to_range(device_memory &mem, size_t offset, size_t size) override
+  {
+    device_ptr existing_key = mem.device_pointer;
+    if (!existing_key || mem.type == MEM_TEXTURE || strcmp(mem.name, "RenderBuffers") == 0) {
+      mem_copy_to(mem);
+      return;
+    }
+
+    size_t existing_size = mem.device_size;
+
+    foreach (const vector<SubDevice *> &island, peer_islands) {
+      SubDevice *owner_sub = find_suitable_mem_device(existing_key, island);
+      const device_ptr owner_ptr = owner_sub->ptr_map[existing_key];
+      mem.device = owner_sub->device;
+      mem.device_pointer = owner_ptr;
+      mem.device_size = existing_size;
+
+      owner_sub->device->mem_copy_to_range(mem, offset, size);
+      owner_sub->ptr_map[existing_key] = mem.device_pointer;
+
+      if (mem.type == MEM_GLOBAL && mem.device_pointer != owner_ptr) {
+        /* Sub-device reallocated the memory, update pointer in kernel globals on all devices. */
+        foreach (SubDevice *island_sub, island) {
+          if (island_sub != owner_sub) {
+            island_sub->device->mem_copy_to(mem);
+          }
+        }
+      }
+    }
+
+    mem.device = this;
+    mem.device_pointer = existing_key;
+    stats.mem_alloc(mem.device_size - existing_size);
+  }
+
   void mem_copy_from(device_memory &mem, int y, int w, int h, int elem) override
   {
     device_ptr key = mem.device_pointer;
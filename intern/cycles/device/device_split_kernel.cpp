@@ -26,6 +26,21 @@ CCL_NAMESPACE_BEGIN
 
 static const double alpha = 0.1; /* alpha for rolling average */
 
+int split_kernel_cpu_num_paths(const int requested_paths,
+                               const int num_threads,
+                               const uint64_t state_size_per_path,
+                               const uint64_t max_memory)
+{
+  const uint64_t max_memory_per_thread = max_memory / max(num_threads, 1);
+  const uint64_t max_paths = (state_size_per_path > 0) ?
+                                 max_memory_per_thread / state_size_per_path :
+                                 requested_paths;
+  if (max_paths < (uint64_t)requested_paths) {
+    return max((int)max_paths, 1);
+  }
+  return max(requested_paths, 1);
+}
+
 DeviceSplitKernel::DeviceSplitKernel(Device *device)
     : device(device),
       split_data(device, "split_data"),
@@ -105,7 +120,9 @@ bool DeviceSplitKernel::load_kernels(const DeviceRequestedFeatures &requested_fe
   LOAD_KERNEL(path_init);
   LOAD_KERNEL(scene_intersect);
   LOAD_KERNEL(lamp_emission);
-  if (requested_features.use_volume) {
+  /* CPU kernels are always compiled with volume support, which leaves emptying the queue of
+   * active rays to the volume kernel instead of the lamp emission kernel. */
+  if (requested_features.use_volume || device->info.type == DEVICE_CPU) {
     LOAD_KERNEL(do_volume);
   }
   LOAD_KERNEL(queue_enqueue);
@@ -53,6 +53,13 @@ class SplitKernelFunction {
   virtual bool enqueue(const KernelDimensions &dim, device_memory &kg, device_memory &data) = 0;
 };
 
+/* Number of paths every CPU thread traces at once with the split kernel. This is limited so that
+ * the path states of all threads use at most max_memory. */
+int split_kernel_cpu_num_paths(int requested_paths,
+                               int num_threads,
+                               uint64_t state_size_per_path,
+                               uint64_t max_memory);
+
 class DeviceSplitKernel {
  private:
   Device *device;
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* BVH4 nodes store the bounds of four children as rows of the node, so a ray is tested against
+ * all of them at once with SSE (or Neon through sse2neon). Node layout:
+ *
+ *   0: visibility flags of the children
+ *   1: lower x bounds     2: upper x bounds
+ *   3: lower y bounds     4: upper y bounds
+ *   5: lower z bounds     6: upper z bounds
+ *   7: child node addresses, negative for leaf nodes and zero for unused children
+ *
+ * Unused children have empty bounds and no visibility, so they are never traversed. */
+
+#define BVH4_NODE_SIZE 8
+
+/* Ray data splatted for intersection with four child bounds. */
+typedef struct BVH4Ray {
+  ssef idir_x, idir_y, idir_z;
+  ssef org_idir_x, org_idir_y, org_idir_z;
+  /* Rows of the node holding the bounds the ray enters and exits the children through. */
+  int near_x, near_y, near_z;
+  int far_x, far_y, far_z;
+} BVH4Ray;
+
+ccl_device_inline void bvh4_ray_init(BVH4Ray *ray4, const float3 P, const float3 idir)
+{
+  ray4->idir_x = ssef(idir.x);
+  ray4->idir_y = ssef(idir.y);
+  ray4->idir_z = ssef(idir.z);
+  ray4->org_idir_x = ssef(P.x * idir.x);
+  ray4->org_idir_y = ssef(P.y * idir.y);
+  ray4->org_idir_z = ssef(P.z * idir.z);
+
+  ray4->near_x = (idir.x >= 0.0f) ? 1 : 2;
+  ray4->far_x = (idir.x >= 0.0f) ? 2 : 1;
+  ray4->near_y = (idir.y >= 0.0f) ? 3 : 4;
+  ray4->far_y = (idir.y >= 0.0f) ? 4 : 3;
+  ray4->near_z = (idir.z >= 0.0f) ? 5 : 6;
+  ray4->far_z = (idir.z >= 0.0f) ? 6 : 5;
+}
+
+ccl_device_forceinline int bvh4_node_intersect(KernelGlobals *kg,
+                                               const BVH4Ray *ray4,
+                                               const float t,
+                                               const int node_addr,
+                                               const uint visibility,
+                                               ssef *dist)
+{
+  const ssef tnear_x = msub(kernel_tex_fetch_ssef(__bvh_nodes, node_addr + ray4->near_x),
+                            ray4->idir_x,
+                            ray4->org_idir_x);
+  const ssef tnear_y = msub(kernel_tex_fetch_ssef(__bvh_nodes, node_addr + ray4->near_y),
+                            ray4->idir_y,
+                            ray4->org_idir_y);
+  const ssef tnear_z = msub(kernel_tex_fetch_ssef(__bvh_nodes, node_addr + ray4->near_z),
+                            ray4->idir_z,
+                            ray4->org_idir_z);
+  const ssef tfar_x = msub(kernel_tex_fetch_ssef(__bvh_nodes, node_addr + ray4->far_x),
+                           ray4->idir_x,
+                           ray4->org_idir_x);
+  const ssef tfar_y = msub(kernel_tex_fetch_ssef(__bvh_nodes, node_addr + ray4->far_y),
+                           ray4->idir_y,
+                           ray4->org_idir_y);
+  const ssef tfar_z = msub(kernel_tex_fetch_ssef(__bvh_nodes, node_addr + ray4->far_z),
+                           ray4->idir_z,
+                           ray4->org_idir_z);
+
+  const ssef tnear = max(max(tnear_x, tnear_y), max(tnear_z, ssef(0.0f)));
+  const ssef tfar = min(min(tfar_x, tfar_y), min(tfar_z, ssef(t)));
+  int mask = movemask(tnear <= tfar);
+
+#ifdef __VISIBILITY_FLAG__
+  const ssei cvisibility = kernel_tex_fetch_ssei(__bvh_nodes, node_addr);
+  mask &= movemask((cvisibility & ssei((int)visibility)) != ssei(0));
+#else
+  (void)visibility;
+#endif
+
+  *dist = tnear;
+  return mask;
+}
+
+/* Intersect the ray with the children of an inner node and return the address of the closest
+ * intersected child. Other intersected children are pushed on the traversal stack, farthest
+ * first. When no child is intersected the next node is popped from the stack. */
+ccl_device_forceinline int bvh4_node_traverse(KernelGlobals *kg,
+                                              const BVH4Ray *ray4,
+                                              const float t,
+                                              const int node_addr,
+                                              const uint visibility,
+                                              int *traversal_stack,
+                                              int *stack_ptr)
+{
+  ssef dist;
+  uint mask = (uint)bvh4_node_intersect(kg, ray4, t, node_addr, visibility, &dist);
+
+  if (mask == 0) {
+    const int next_node_addr = traversal_stack[*stack_ptr];
+    --(*stack_ptr);
+    return next_node_addr;
+  }
+
+  const float4 cnodes = kernel_tex_fetch(__bvh_nodes, node_addr + BVH4_NODE_SIZE - 1);
+
+  int child = __bsf(mask);
+  mask &= mask - 1;
+  if (mask == 0) {
+    /* Only one child was intersected. */
+    return __float_as_int(cnodes[child]);
+  }
+
+  /* Sort intersected children by descending distance. */
+  int child_addr[4];
+  float child_dist[4];
+  int num_children = 0;
+
+  for (;;) {
+    const int addr = __float_as_int(cnodes[child]);
+    const float d = dist[child];
+    int i = num_children++;
+    for (; i > 0 && child_dist[i - 1] < d; i--) {
+      child_addr[i] = child_addr[i - 1];
+      child_dist[i] = child_dist[i - 1];
+    }
+    child_addr[i] = addr;
+    child_dist[i] = d;
+
+    if (mask == 0) {
+      break;
+    }
+    child = __bsf(mask);
+    mask &= mask - 1;
+  }
+
+  for (int i = 0; i < num_children - 1; i++) {
+    ++(*stack_ptr);
+    kernel_assert(*stack_ptr < BVH_STACK_SIZE);
+    traversal_stack[*stack_ptr] = child_addr[i];
+  }
+
+  return child_addr[num_children - 1];
+}
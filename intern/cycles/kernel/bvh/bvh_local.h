@@ -81,11 +81,30 @@ ccl_device_inline
     object = local_object;
   }
 
+#ifdef __BVH4__
+  const bool use_bvh4 = (kernel_data.bvh.bvh_layout == BVH_LAYOUT_BVH4);
+  BVH4Ray ray4;
+  bvh4_ray_init(&ray4, P, idir);
+#endif
+
   /* traversal loop */
   do {
     do {
       /* traverse internal nodes */
       while (node_addr >= 0 && node_addr != ENTRYPOINT_SENTINEL) {
+#ifdef __BVH4__
+        if (use_bvh4) {
+          node_addr = bvh4_node_traverse(kg,
+                                         &ray4,
+                                         isect_t,
+                                         node_addr,
+                                         PATH_RAY_ALL_VISIBILITY,
+                                         traversal_stack,
+                                         &stack_ptr);
+          continue;
+        }
+#endif
+
         int node_addr_child1, traverse_mask;
         float dist[2];
         float4 cnodes = kernel_tex_fetch(__bvh_nodes, node_addr + 0);
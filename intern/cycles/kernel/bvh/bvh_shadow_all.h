@@ -73,11 +73,25 @@ ccl_device_inline
   *num_hits = 0;
   isect_array->t = tmax;
 
+#ifdef __BVH4__
+  const bool use_bvh4 = (kernel_data.bvh.bvh_layout == BVH_LAYOUT_BVH4);
+  BVH4Ray ray4;
+  bvh4_ray_init(&ray4, P, idir);
+#endif
+
   /* traversal loop */
   do {
     do {
       /* traverse internal nodes */
       while (node_addr >= 0 && node_addr != ENTRYPOINT_SENTINEL) {
+#ifdef __BVH4__
+        if (use_bvh4) {
+          node_addr = bvh4_node_traverse(
+              kg, &ray4, isect_t, node_addr, visibility, traversal_stack, &stack_ptr);
+          continue;
+        }
+#endif
+
         int node_addr_child1, traverse_mask;
         float dist[2];
         float4 cnodes = kernel_tex_fetch(__bvh_nodes, node_addr + 0);
@@ -226,6 +240,9 @@ ccl_device_inline
 #else
           isect_t = bvh_instance_push(kg, object, ray, &P, &dir, &idir, isect_t);
 #endif
+#ifdef __BVH4__
+          bvh4_ray_init(&ray4, P, idir);
+#endif
 
           num_hits_in_instance = 0;
           isect_array->t = isect_t;
@@ -251,6 +268,9 @@ ccl_device_inline
 #else
         bvh_instance_pop_factor(kg, object, ray, &P, &dir, &idir, &t_fac);
 #endif
+#ifdef __BVH4__
+        bvh4_ray_init(&ray4, P, idir);
+#endif
 
         /* scale isect->t to adjust for instancing */
         for (int i = 0; i < num_hits_in_instance; i++) {
@@ -262,6 +282,9 @@ ccl_device_inline
         bvh_instance_motion_pop(kg, object, ray, &P, &dir, &idir, FLT_MAX, &ob_itfm);
 #else
         bvh_instance_pop(kg, object, ray, &P, &dir, &idir, FLT_MAX);
+#endif
+#ifdef __BVH4__
+        bvh4_ray_init(&ray4, P, idir);
 #endif
       }
 
@@ -30,7 +30,17 @@ CCL_NAMESPACE_BEGIN
 #define ENTRYPOINT_SENTINEL 0x76543210
 
 /* 64 object BVH + 64 mesh BVH + 64 object node splitting */
-#define BVH_STACK_SIZE 192
+#ifdef __BVH4__
+/* BVH4 nodes are collapsed from up to three levels of the binary tree. Traversal may descend
+ * into a child that was only one binary level down and push the other three, so in the worst
+ * case three entries are pushed per binary level. The traversal functions choose the layout at
+ * run time, so the stack is sized for BVH4 whenever it is compiled in. This only applies to CPU
+ * kernels, where it adds 1.5 KB to the stack frame of each traversal function. Only one of them
+ * is active at a time, and the throughput of BVH2 traversal is not measurably affected. */
+#  define BVH_STACK_SIZE (192 * 3)
+#else
+#  define BVH_STACK_SIZE 192
+#endif
 /* BVH intersection function variations */
 
 #define BVH_MOTION 1
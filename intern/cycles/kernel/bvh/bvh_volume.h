@@ -71,11 +71,25 @@ ccl_device_inline
   isect->prim = PRIM_NONE;
   isect->object = OBJECT_NONE;
 
+#ifdef __BVH4__
+  const bool use_bvh4 = (kernel_data.bvh.bvh_layout == BVH_LAYOUT_BVH4);
+  BVH4Ray ray4;
+  bvh4_ray_init(&ray4, P, idir);
+#endif
+
   /* traversal loop */
   do {
     do {
       /* traverse internal nodes */
       while (node_addr >= 0 && node_addr != ENTRYPOINT_SENTINEL) {
+#ifdef __BVH4__
+        if (use_bvh4) {
+          node_addr = bvh4_node_traverse(
+              kg, &ray4, isect->t, node_addr, visibility, traversal_stack, &stack_ptr);
+          continue;
+        }
+#endif
+
         int node_addr_child1, traverse_mask;
         float dist[2];
         float4 cnodes = kernel_tex_fetch(__bvh_nodes, node_addr + 0);
@@ -186,6 +200,9 @@ ccl_device_inline
 #else
             isect->t = bvh_instance_push(kg, object, ray, &P, &dir, &idir, isect->t);
 #endif
+#ifdef __BVH4__
+            bvh4_ray_init(&ray4, P, idir);
+#endif
 
             ++stack_ptr;
             kernel_assert(stack_ptr < BVH_STACK_SIZE);
@@ -212,6 +229,9 @@ ccl_device_inline
 #else
       isect->t = bvh_instance_pop(kg, object, ray, &P, &dir, &idir, isect->t);
 #endif
+#ifdef __BVH4__
+      bvh4_ray_init(&ray4, P, idir);
+#endif
 
       object = OBJECT_NONE;
       node_addr = traversal_stack[stack_ptr];
@@ -78,6 +78,9 @@ typedef struct KernelGlobals {
   CoverageMap *coverage_material;
   CoverageMap *coverage_asset;
 
+  /* Set by the image manager when images are stored in the texture cache. */
+  TextureCacheLookupFunction texture_cache_lookup;
+
   /* split kernel */
   SplitData split_data;
   SplitParams split_param_data;
@@ -15,6 +15,7 @@
  */
 
 #include "kernel_light_background.h"
+#include "kernel_light_tree.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -292,6 +293,9 @@ ccl_device bool lamp_light_eval(
   }
 
   ls->pdf *= kernel_data.integrator.pdf_lights;
+  if (kernel_data.integrator.use_light_tree) {
+    ls->pdf *= light_tree_pdf_factor(kg, P, light_tree_lamp_emitter(kg, lamp));
+  }
 
   return true;
 }
@@ -342,7 +346,9 @@ ccl_device_inline float triangle_light_pdf_area(KernelGlobals *kg,
   return t * t * pdf / cos_pi;
 }
 
-ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *sd, float t)
+ccl_device_forceinline float triangle_light_pdf_distribution(KernelGlobals *kg,
+                                                             ShaderData *sd,
+                                                             float t)
 {
   /* A naive heuristic to decide between costly solid angle sampling
    * and simple area sampling, comparing the distance to the triangle plane
@@ -411,6 +417,17 @@ ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *s
   }
 }
 
+ccl_device_forceinline float triangle_light_pdf(KernelGlobals *kg, ShaderData *sd, float t)
+{
+  float pdf = triangle_light_pdf_distribution(kg, sd, t);
+  if (kernel_data.integrator.use_light_tree) {
+    /* The point that the ray was traced from. */
+    const float3 Px = sd->P + sd->I * t;
+    pdf *= light_tree_pdf_factor(kg, Px, light_tree_triangle_emitter(kg, sd->object, sd->prim));
+  }
+  return pdf;
+}
+
 ccl_device_forceinline void triangle_light_sample(KernelGlobals *kg,
                                                   int prim,
                                                   int object,
@@ -634,7 +651,17 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
 {
   if (lamp < 0) {
     /* sample index */
-    int index = light_distribution_sample(kg, &randu);
+    int index;
+    float pdf_factor = 1.0f;
+    if (kernel_data.integrator.use_light_tree) {
+      index = light_tree_sample_distribution(kg, P, &randu, &pdf_factor);
+      if (index < 0) {
+        return false;
+      }
+    }
+    else {
+      index = light_distribution_sample(kg, &randu);
+    }
 
     /* fetch light data */
     const ccl_global KernelLightDistribution *kdistribution = &kernel_tex_fetch(
@@ -647,10 +674,22 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
 
       triangle_light_sample(kg, prim, object, randu, randv, time, ls, P);
       ls->shader |= shader_flag;
+      /* The probability of the light tree is not known by the triangle sampling. */
+      ls->pdf *= pdf_factor;
       return (ls->pdf > 0.0f);
     }
 
     lamp = -prim - 1;
+
+    if (UNLIKELY(light_select_reached_max_bounces(kg, lamp, bounce))) {
+      return false;
+    }
+
+    if (!lamp_light_sample(kg, lamp, randu, randv, P, ls)) {
+      return false;
+    }
+    ls->pdf *= pdf_factor;
+    return (ls->pdf > 0.0f);
   }
 
   if (UNLIKELY(light_select_reached_max_bounces(kg, lamp, bounce))) {
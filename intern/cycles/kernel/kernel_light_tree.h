@@ -0,0 +1,308 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+CCL_NAMESPACE_BEGIN
+
+/* Light Tree
+ *
+ * Selects lights and emissive triangles based on their importance for the shading point, using
+ * a bounding volume hierarchy over all lights that bounds their positions, the directions they
+ * emit into and their energy. Based on:
+ *
+ * Alejandro Conty Estevez and Christopher Kulla.
+ * Importance Sampling of Many Lights with Adaptive Tree Splitting.
+ *
+ * The importance only depends on the position of the shading point and not on its normal, so
+ * that the probability of selecting an emitter can be computed again when the emitter is hit by
+ * a ray, for multiple importance sampling.
+ *
+ * Distant and background lights are not part of the tree. They are selected with the same
+ * probability as with the flat light distribution. */
+
+ccl_device float light_tree_importance(const float3 P,
+                                       const float3 bbox_min,
+                                       const float3 bbox_max,
+                                       const float3 axis,
+                                       const float theta_o,
+                                       const float theta_e,
+                                       const float energy)
+{
+  if (energy == 0.0f) {
+    return 0.0f;
+  }
+
+  /* Use the geometric mean of the distances to the closest and the farthest point of the bounds,
+   * the distance to the centroid can't tell apart nodes that are close to the shading point.
+   * Inside the bounds the closest distance is clamped, so that no node gets all the importance. */
+  const float closest_squared = len_squared(clamp(P, bbox_min, bbox_max) - P);
+  const float farthest_squared = len_squared(max(fabs(P - bbox_min), fabs(bbox_max - P)));
+  const float distance_squared = sqrtf(fmaxf(closest_squared, 1e-4f * farthest_squared) *
+                                       farthest_squared);
+  if (distance_squared == 0.0f) {
+    return energy;
+  }
+
+  const float3 centroid = 0.5f * (bbox_min + bbox_max);
+  const float radius_squared = 0.25f * len_squared(bbox_max - bbox_min);
+  const float3 centroid_to_P = P - centroid;
+  const float centroid_distance_squared = len_squared(centroid_to_P);
+  if (centroid_distance_squared <= radius_squared) {
+    /* The shading point can be in any direction of the emitters. */
+    return energy / distance_squared;
+  }
+
+  /* Angle between the axis and the direction towards the shading point, reduced by the angles of
+   * the cone of normals and of the bounds as seen from the shading point. */
+  const float centroid_distance = sqrtf(centroid_distance_squared);
+  const float theta = safe_acosf(dot(axis, centroid_to_P) / centroid_distance);
+  const float theta_u = safe_asinf(sqrtf(radius_squared) / centroid_distance);
+  const float theta_prime = fmaxf(theta - theta_o - theta_u, 0.0f);
+  if (theta_prime >= theta_e) {
+    return 0.0f;
+  }
+
+  return energy * cosf(theta_prime) / distance_squared;
+}
+
+ccl_device float light_tree_node_importance(KernelGlobals *kg, const float3 P, int node_index)
+{
+  const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes, node_index);
+  return light_tree_importance(P,
+                               make_float3(knode->bounding_box_min[0],
+                                           knode->bounding_box_min[1],
+                                           knode->bounding_box_min[2]),
+                               make_float3(knode->bounding_box_max[0],
+                                           knode->bounding_box_max[1],
+                                           knode->bounding_box_max[2]),
+                               make_float3(knode->axis[0], knode->axis[1], knode->axis[2]),
+                               knode->theta_o,
+                               knode->theta_e,
+                               knode->energy);
+}
+
+ccl_device float light_tree_emitter_importance(KernelGlobals *kg,
+                                               const float3 P,
+                                               int emitter_index)
+{
+  const ccl_global KernelLightTreeEmitter *kemitter = &kernel_tex_fetch(__light_tree_emitters,
+                                                                        emitter_index);
+  return light_tree_importance(P,
+                               make_float3(kemitter->bounding_box_min[0],
+                                           kemitter->bounding_box_min[1],
+                                           kemitter->bounding_box_min[2]),
+                               make_float3(kemitter->bounding_box_max[0],
+                                           kemitter->bounding_box_max[1],
+                                           kemitter->bounding_box_max[2]),
+                               make_float3(
+                                   kemitter->axis[0], kemitter->axis[1], kemitter->axis[2]),
+                               kemitter->theta_o,
+                               kemitter->theta_e,
+                               kemitter->energy);
+}
+
+/* Select an emitter of the tree, proportional to the importance of the nodes on the way down.
+ * The random number is rescaled so that it can be used again. Returns -1 when no emitter is
+ * important for the shading point. */
+ccl_device int light_tree_sample_emitter(KernelGlobals *kg,
+                                         const float3 P,
+                                         float *randu,
+                                         float *pdf)
+{
+  int node_index = 0;
+  float r = *randu;
+  *pdf = 1.0f;
+
+  while (true) {
+    const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes,
+                                                                    node_index);
+    if (knode->num_emitters > 0) {
+      break;
+    }
+
+    const int left_index = node_index + 1;
+    const int right_index = knode->child_index;
+    const float left_importance = light_tree_node_importance(kg, P, left_index);
+    const float right_importance = light_tree_node_importance(kg, P, right_index);
+    const float total_importance = left_importance + right_importance;
+    if (total_importance == 0.0f) {
+      return -1;
+    }
+
+    const float left_probability = left_importance / total_importance;
+    if (r < left_probability) {
+      node_index = left_index;
+      r = r / left_probability;
+      *pdf *= left_probability;
+    }
+    else {
+      node_index = right_index;
+      r = (r - left_probability) / (1.0f - left_probability);
+      *pdf *= 1.0f - left_probability;
+    }
+  }
+
+  /* Select an emitter of the leaf. */
+  const ccl_global KernelLightTreeNode *kleaf = &kernel_tex_fetch(__light_tree_nodes, node_index);
+  const int first_emitter = kleaf->child_index;
+  const int num_emitters = kleaf->num_emitters;
+
+  float total_importance = 0.0f;
+  for (int i = 0; i < num_emitters; i++) {
+    total_importance += light_tree_emitter_importance(kg, P, first_emitter + i);
+  }
+  if (total_importance == 0.0f) {
+    return -1;
+  }
+
+  r *= total_importance;
+  float cdf = 0.0f;
+  int selected_emitter = -1;
+  float selected_importance = 0.0f;
+  float selected_cdf = 0.0f;
+  for (int i = 0; i < num_emitters; i++) {
+    const float importance = light_tree_emitter_importance(kg, P, first_emitter + i);
+    if (importance == 0.0f) {
+      continue;
+    }
+    selected_emitter = first_emitter + i;
+    selected_importance = importance;
+    selected_cdf = cdf;
+    cdf += importance;
+    if (r < cdf) {
+      break;
+    }
+  }
+
+  *randu = clamp((r - selected_cdf) / selected_importance, 0.0f, 1.0f - 1e-6f);
+  *pdf *= selected_importance / total_importance;
+  return selected_emitter;
+}
+
+/* Probability of selecting the emitter with #light_tree_sample_emitter. */
+ccl_device float light_tree_emitter_pdf(KernelGlobals *kg, const float3 P, int emitter_index)
+{
+  const ccl_global KernelLightTreeEmitter *kemitter = &kernel_tex_fetch(__light_tree_emitters,
+                                                                        emitter_index);
+  int node_index = kemitter->parent_index;
+  const ccl_global KernelLightTreeNode *kleaf = &kernel_tex_fetch(__light_tree_nodes, node_index);
+
+  float total_importance = 0.0f;
+  for (int i = 0; i < kleaf->num_emitters; i++) {
+    total_importance += light_tree_emitter_importance(kg, P, kleaf->child_index + i);
+  }
+  if (total_importance == 0.0f) {
+    return 0.0f;
+  }
+  float pdf = light_tree_emitter_importance(kg, P, emitter_index) / total_importance;
+
+  /* Walk up to the root, multiplying with the probability of going down the same way. */
+  int parent_index = kleaf->parent_index;
+  while (parent_index >= 0 && pdf > 0.0f) {
+    const ccl_global KernelLightTreeNode *kparent = &kernel_tex_fetch(__light_tree_nodes,
+                                                                      parent_index);
+    const int left_index = parent_index + 1;
+    const int right_index = kparent->child_index;
+    const float left_importance = light_tree_node_importance(kg, P, left_index);
+    const float right_importance = light_tree_node_importance(kg, P, right_index);
+    const float total_importance = left_importance + right_importance;
+    if (total_importance == 0.0f) {
+      return 0.0f;
+    }
+
+    if (node_index == left_index) {
+      pdf *= left_importance / total_importance;
+    }
+    else {
+      pdf *= right_importance / total_importance;
+    }
+
+    node_index = parent_index;
+    parent_index = kparent->parent_index;
+  }
+
+  return pdf;
+}
+
+/* Select an emitter from the tree or one of the distant and background lights, and return its
+ * index in the light distribution. The random number is rescaled so that it can be used again. */
+ccl_device int light_tree_sample_distribution(KernelGlobals *kg,
+                                              const float3 P,
+                                              float *randu,
+                                              float *pdf_factor)
+{
+  const float pdf_light_tree = kernel_data.integrator.pdf_light_tree;
+  const int num_emitters = kernel_data.integrator.num_light_tree_emitters;
+
+  int emitter_index;
+  if (*randu < pdf_light_tree) {
+    *randu = *randu / pdf_light_tree;
+    float pdf;
+    emitter_index = light_tree_sample_emitter(kg, P, randu, &pdf);
+    if (emitter_index < 0) {
+      return -1;
+    }
+    const float pdf_flat = kernel_tex_fetch(__light_tree_emitters, emitter_index).pdf_flat;
+    *pdf_factor = (pdf_flat > 0.0f) ? pdf_light_tree * pdf / pdf_flat : 0.0f;
+  }
+  else {
+    /* The distant and background lights follow the emitters of the tree. Their probability is
+     * the same as with the flat distribution. */
+    const int num_infinite = kernel_data.integrator.num_light_tree_infinite;
+    const float r = (*randu - pdf_light_tree) / (1.0f - pdf_light_tree) * num_infinite;
+    const int index = min(float_to_int(r), num_infinite - 1);
+    *randu = clamp(r - index, 0.0f, 1.0f - 1e-6f);
+    emitter_index = num_emitters + index;
+    *pdf_factor = 1.0f;
+  }
+
+  return kernel_tex_fetch(__light_tree_emitters, emitter_index).distribution_id;
+}
+
+/* Factor to convert the probability of selecting an emitter with the flat light distribution
+ * into the probability of selecting it with the light tree. */
+ccl_device float light_tree_pdf_factor(KernelGlobals *kg, const float3 P, int emitter_index)
+{
+  if (emitter_index < 0) {
+    /* Not in the light distribution, can't be selected. */
+    return 0.0f;
+  }
+  if (emitter_index >= kernel_data.integrator.num_light_tree_emitters) {
+    /* Distant and background lights. */
+    return 1.0f;
+  }
+  const float pdf_flat = kernel_tex_fetch(__light_tree_emitters, emitter_index).pdf_flat;
+  if (pdf_flat == 0.0f) {
+    return 0.0f;
+  }
+  return kernel_data.integrator.pdf_light_tree * light_tree_emitter_pdf(kg, P, emitter_index) /
+         pdf_flat;
+}
+
+ccl_device_inline int light_tree_lamp_emitter(KernelGlobals *kg, int lamp)
+{
+  return kernel_tex_fetch(__light_tree_emitter_index, lamp);
+}
+
+ccl_device_inline int light_tree_triangle_emitter(KernelGlobals *kg, int object, int prim)
+{
+  const int offset = kernel_tex_fetch(__light_tree_object_offset, object);
+  if (offset == LIGHT_TREE_OBJECT_NONE) {
+    return -1;
+  }
+  return kernel_tex_fetch(__light_tree_emitter_index, offset + prim);
+}
+
+CCL_NAMESPACE_END
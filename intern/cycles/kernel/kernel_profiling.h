@@ -34,11 +34,16 @@ CCL_NAMESPACE_BEGIN
     if ((object) != PRIM_NONE) { \
       profiling_helper.set_object(object); \
     }
+#  define PROFILING_SHADER_SWITCH(shader) \
+    if ((shader) != SHADER_NONE) { \
+      profiling_helper.count_shader_switch((shader)&SHADER_MASK); \
+    }
 #else
 #  define PROFILING_INIT(kg, event)
 #  define PROFILING_EVENT(event)
 #  define PROFILING_SHADER(shader)
 #  define PROFILING_OBJECT(object)
+#  define PROFILING_SHADER_SWITCH(shader)
 #endif /* __KERNEL_CPU__ */
 
 CCL_NAMESPACE_END
@@ -1060,6 +1060,11 @@ ccl_device void shader_eval_surface(KernelGlobals *kg,
                                     int path_flag)
 {
   PROFILING_INIT(kg, PROFILING_SHADER_EVAL);
+  /* Only count surface hits of paths, which are the evaluations sorted by shader in the split
+   * kernel. Emission and transparent shadows are evaluated in between them. */
+  if (!(path_flag & (PATH_RAY_SHADOW | PATH_RAY_EMISSION))) {
+    PROFILING_SHADER_SWITCH(sd->shader);
+  }
 
   /* If path is being terminated, we are tracing a shadow ray or evaluating
    * emission, then we don't need to store closures. The emission and shadow
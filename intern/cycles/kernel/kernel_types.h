@@ -128,6 +128,9 @@ CCL_NAMESPACE_BEGIN
 #  endif
 #  define __VOLUME_DECOUPLED__
 #  define __VOLUME_RECORD_ALL__
+#  ifdef __KERNEL_SSE2__
+#    define __BVH4__
+#  endif
 #endif /* __KERNEL_CPU__ */
 
 #ifdef __KERNEL_CUDA__
@@ -1387,6 +1390,12 @@ typedef struct KernelIntegrator {
 
   int max_closures;
 
+  /* light tree */
+  int use_light_tree;
+  int num_light_tree_emitters;
+  int num_light_tree_infinite;
+  float pdf_light_tree;
+
   int pad1, pad2;
 } KernelIntegrator;
 static_assert_align(KernelIntegrator, 16);
@@ -1395,14 +1404,15 @@ typedef enum KernelBVHLayout {
   BVH_LAYOUT_NONE = 0,
 
   BVH_LAYOUT_BVH2 = (1 << 0),
-  BVH_LAYOUT_EMBREE = (1 << 1),
-  BVH_LAYOUT_OPTIX = (1 << 2),
-  BVH_LAYOUT_MULTI_OPTIX = (1 << 3),
-  BVH_LAYOUT_MULTI_OPTIX_EMBREE = (1 << 4),
+  BVH_LAYOUT_BVH4 = (1 << 1),
+  BVH_LAYOUT_EMBREE = (1 << 2),
+  BVH_LAYOUT_OPTIX = (1 << 3),
+  BVH_LAYOUT_MULTI_OPTIX = (1 << 4),
+  BVH_LAYOUT_MULTI_OPTIX_EMBREE = (1 << 5),
 
   /* Default BVH layout to use for CPU. */
   BVH_LAYOUT_AUTO = BVH_LAYOUT_EMBREE,
-  BVH_LAYOUT_ALL = BVH_LAYOUT_BVH2 | BVH_LAYOUT_EMBREE | BVH_LAYOUT_OPTIX,
+  BVH_LAYOUT_ALL = BVH_LAYOUT_BVH2 | BVH_LAYOUT_BVH4 | BVH_LAYOUT_EMBREE | BVH_LAYOUT_OPTIX,
 } KernelBVHLayout;
 
 typedef struct KernelBVH {
@@ -1548,6 +1558,47 @@ typedef struct KernelLightDistribution {
 } KernelLightDistribution;
 static_assert_align(KernelLightDistribution, 16);
 
+/* Bounds of a group of lights in the light tree: their positions, the cone of normals with the
+ * angle theta_o around the axis, the angle theta_e by which the emission spreads beyond the
+ * normals, and their total energy. */
+typedef struct KernelLightTreeNode {
+  float bounding_box_min[3];
+  float energy;
+  float bounding_box_max[3];
+  float theta_o;
+  float axis[3];
+  float theta_e;
+  /* The first child of an inner node directly follows it, this is the index of the second child.
+   * For leaf nodes it is the index of the first emitter. */
+  int child_index;
+  /* Zero for inner nodes. */
+  int num_emitters;
+  /* -1 for the root. */
+  int parent_index;
+  int pad;
+} KernelLightTreeNode;
+static_assert_align(KernelLightTreeNode, 16);
+
+typedef struct KernelLightTreeEmitter {
+  float bounding_box_min[3];
+  float energy;
+  float bounding_box_max[3];
+  float theta_o;
+  float axis[3];
+  float theta_e;
+  /* Index in the light distribution. */
+  int distribution_id;
+  /* Leaf node that contains the emitter. */
+  int parent_index;
+  /* Probability of selecting the emitter with the flat light distribution. */
+  float pdf_flat;
+  int pad;
+} KernelLightTreeEmitter;
+static_assert_align(KernelLightTreeEmitter, 16);
+
+/* Offset of objects without emissive triangles in the light tree. */
+#define LIGHT_TREE_OBJECT_NONE (-0x7fffffff - 1)
+
 typedef struct KernelParticle {
   int index;
   float age;
@@ -476,6 +476,155 @@ template<typename T> struct TextureInterpolator {
   }
 };
 
+/* Sparse textures with the voxels in tiles, see SparseTextureHeader. The wrapping is the same
+ * as for dense textures, only the lookup of the voxels is different. */
+template<int channels> struct SparseInterpolator {
+
+  static ccl_always_inline float4 read(const TextureInfo &info, int x, int y, int z)
+  {
+    const SparseTextureHeader *header = (const SparseTextureHeader *)info.data;
+    const int *table = (const int *)(header + 1);
+    const float *voxels = (const float *)(table + header->table_size);
+
+    x += header->offset_x;
+    y += header->offset_y;
+    z += header->offset_z;
+    const int tile = (x >> SPARSE_TILE_SHIFT) +
+                     header->tiles_x * ((y >> SPARSE_TILE_SHIFT) +
+                                        header->tiles_y * (z >> SPARSE_TILE_SHIFT));
+    const size_t voxel = (size_t)table[tile] * SPARSE_TILE_VOXELS + (x & SPARSE_TILE_MASK) +
+                         ((y & SPARSE_TILE_MASK) << SPARSE_TILE_SHIFT) +
+                         ((z & SPARSE_TILE_MASK) << (2 * SPARSE_TILE_SHIFT));
+    const float *value = voxels + voxel * channels;
+
+    if (channels == 1) {
+      return make_float4(value[0], value[0], value[0], 1.0f);
+    }
+    return make_float4(value[0], value[1], value[2], 1.0f);
+  }
+
+  static ccl_always_inline int wrap(const TextureInfo &info, int x, int size)
+  {
+    if (info.extension == EXTENSION_REPEAT) {
+      x %= size;
+      return (x < 0) ? x + size : x;
+    }
+    return clamp(x, 0, size - 1);
+  }
+
+  static ccl_always_inline float4 interp_3d_closest(const TextureInfo &info,
+                                                    const int size[3],
+                                                    float x,
+                                                    float y,
+                                                    float z)
+  {
+    int ix, iy, iz;
+    frac(x * (float)size[0], &ix);
+    frac(y * (float)size[1], &iy);
+    frac(z * (float)size[2], &iz);
+    return read(info, wrap(info, ix, size[0]), wrap(info, iy, size[1]), wrap(info, iz, size[2]));
+  }
+
+  static ccl_always_inline float4 interp_3d_linear(const TextureInfo &info,
+                                                   const int size[3],
+                                                   float x,
+                                                   float y,
+                                                   float z)
+  {
+    int ix, iy, iz;
+    const float tx = frac(x * (float)size[0] - 0.5f, &ix);
+    const float ty = frac(y * (float)size[1] - 0.5f, &iy);
+    const float tz = frac(z * (float)size[2] - 0.5f, &iz);
+
+    const int xc[2] = {wrap(info, ix, size[0]), wrap(info, ix + 1, size[0])};
+    const int yc[2] = {wrap(info, iy, size[1]), wrap(info, iy + 1, size[1])};
+    const int zc[2] = {wrap(info, iz, size[2]), wrap(info, iz + 1, size[2])};
+
+    float4 r;
+    r = (1.0f - tz) * (1.0f - ty) * (1.0f - tx) * read(info, xc[0], yc[0], zc[0]);
+    r += (1.0f - tz) * (1.0f - ty) * tx * read(info, xc[1], yc[0], zc[0]);
+    r += (1.0f - tz) * ty * (1.0f - tx) * read(info, xc[0], yc[1], zc[0]);
+    r += (1.0f - tz) * ty * tx * read(info, xc[1], yc[1], zc[0]);
+
+    r += tz * (1.0f - ty) * (1.0f - tx) * read(info, xc[0], yc[0], zc[1]);
+    r += tz * (1.0f - ty) * tx * read(info, xc[1], yc[0], zc[1]);
+    r += tz * ty * (1.0f - tx) * read(info, xc[0], yc[1], zc[1]);
+    r += tz * ty * tx * read(info, xc[1], yc[1], zc[1]);
+
+    return r;
+  }
+
+#if defined(__GNUC__) || defined(__clang__)
+  static ccl_always_inline
+#else
+  static ccl_never_inline
+#endif
+      float4
+      interp_3d_cubic(const TextureInfo &info, const int size[3], float x, float y, float z)
+  {
+    int ix, iy, iz;
+    /* Tricubic b-spline interpolation. */
+    const float tx = frac(x * (float)size[0] - 0.5f, &ix);
+    const float ty = frac(y * (float)size[1] - 0.5f, &iy);
+    const float tz = frac(z * (float)size[2] - 0.5f, &iz);
+
+    int xc[4], yc[4], zc[4];
+    for (int i = 0; i < 4; i++) {
+      xc[i] = wrap(info, ix + i - 1, size[0]);
+      yc[i] = wrap(info, iy + i - 1, size[1]);
+      zc[i] = wrap(info, iz + i - 1, size[2]);
+    }
+    float u[4], v[4], w[4];
+
+    /* Some helper macro to keep code reasonable size,
+     * let compiler to inline all the matrix multiplications.
+     */
+#define DATA(x, y, z) (read(info, xc[x], yc[y], zc[z]))
+#define COL_TERM(col, row) \
+  (v[col] * (u[0] * DATA(0, col, row) + u[1] * DATA(1, col, row) + u[2] * DATA(2, col, row) + \
+             u[3] * DATA(3, col, row)))
+#define ROW_TERM(row) \
+  (w[row] * (COL_TERM(0, row) + COL_TERM(1, row) + COL_TERM(2, row) + COL_TERM(3, row)))
+
+    SET_CUBIC_SPLINE_WEIGHTS(u, tx);
+    SET_CUBIC_SPLINE_WEIGHTS(v, ty);
+    SET_CUBIC_SPLINE_WEIGHTS(w, tz);
+
+    /* Actual interpolation. */
+    return ROW_TERM(0) + ROW_TERM(1) + ROW_TERM(2) + ROW_TERM(3);
+
+#undef COL_TERM
+#undef ROW_TERM
+#undef DATA
+  }
+
+  static ccl_always_inline float4
+  interp_3d(const TextureInfo &info, float x, float y, float z, InterpolationType interp)
+  {
+    if (UNLIKELY(!info.data))
+      return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+    if (info.extension == EXTENSION_CLIP) {
+      if (x < 0.0f || y < 0.0f || z < 0.0f || x > 1.0f || y > 1.0f || z > 1.0f) {
+        return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+      }
+    }
+
+    /* The width of the texture info is the size in bytes. */
+    const SparseTextureHeader *header = (const SparseTextureHeader *)info.data;
+    const int size[3] = {header->width, header->height, header->depth};
+
+    switch ((interp == INTERPOLATION_NONE) ? info.interpolation : interp) {
+      case INTERPOLATION_CLOSEST:
+        return interp_3d_closest(info, size, x, y, z);
+      case INTERPOLATION_LINEAR:
+        return interp_3d_linear(info, size, x, y, z);
+      default:
+        return interp_3d_cubic(info, size, x, y, z);
+    }
+  }
+};
+
 #ifdef WITH_NANOVDB
 template<typename T> struct NanoVDBInterpolator {
 
@@ -584,6 +733,19 @@ template<typename T> struct NanoVDBInterpolator {
 
 #undef SET_CUBIC_SPLINE_WEIGHTS
 
+ccl_device float4 kernel_tex_image_interp_texture_cache(KernelGlobals *kg,
+                                                      const TextureInfo &info,
+                                                      float x,
+                                                      float y,
+                                                      const float2 dx,
+                                                      const float2 dy)
+{
+  const void *image = *(const void *const *)info.data;
+  float r[4];
+  kg->texture_cache_lookup(image, x, y, dx.x, dx.y, dy.x, dy.y, r);
+  return make_float4(r[0], r[1], r[2], r[3]);
+}
+
 ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, float y)
 {
   const TextureInfo &info = kernel_tex_fetch(__texture_info, id);
@@ -605,6 +767,9 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
       return TextureInterpolator<ushort4>::interp(info, x, y);
     case IMAGE_DATA_TYPE_FLOAT4:
       return TextureInterpolator<float4>::interp(info, x, y);
+    case IMAGE_DATA_TYPE_TEXTURE_CACHE:
+      return kernel_tex_image_interp_texture_cache(
+          kg, info, x, y, make_float2(0.0f, 0.0f), make_float2(0.0f, 0.0f));
     default:
       assert(0);
       return make_float4(
@@ -612,6 +777,20 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
   }
 }
 
+/* Lookup with the derivatives of the texture coordinates, for images in the texture cache to
+ * select the mipmap level. Other images are interpolated as usual. */
+ccl_device float4 kernel_tex_image_interp_derivatives(
+    KernelGlobals *kg, int id, float x, float y, const float2 dx, const float2 dy)
+{
+  const TextureInfo &info = kernel_tex_fetch(__texture_info, id);
+
+  if (info.data_type == IMAGE_DATA_TYPE_TEXTURE_CACHE) {
+    return kernel_tex_image_interp_texture_cache(kg, info, x, y, dx, dy);
+  }
+
+  return kernel_tex_image_interp(kg, id, x, y);
+}
+
 ccl_device float4 kernel_tex_image_interp_3d(KernelGlobals *kg,
                                              int id,
                                              float3 P,
@@ -640,6 +819,10 @@ ccl_device float4 kernel_tex_image_interp_3d(KernelGlobals *kg,
       return TextureInterpolator<ushort4>::interp_3d(info, P.x, P.y, P.z, interp);
     case IMAGE_DATA_TYPE_FLOAT4:
       return TextureInterpolator<float4>::interp_3d(info, P.x, P.y, P.z, interp);
+    case IMAGE_DATA_TYPE_SPARSE_FLOAT:
+      return SparseInterpolator<1>::interp_3d(info, P.x, P.y, P.z, interp);
+    case IMAGE_DATA_TYPE_SPARSE_FLOAT3:
+      return SparseInterpolator<3>::interp_3d(info, P.x, P.y, P.z, interp);
 #ifdef WITH_NANOVDB
     case IMAGE_DATA_TYPE_NANOVDB_FLOAT:
       return NanoVDBInterpolator<float>::interp_3d(info, P.x, P.y, P.z, interp);
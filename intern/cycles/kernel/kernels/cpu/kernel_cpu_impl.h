@@ -186,17 +186,31 @@ void KERNEL_FUNCTION_FULL_NAME(shader)(KernelGlobals *kg,
         STUB_ASSERT(KERNEL_ARCH, name); \
       }
 #  else
+/* Every call runs the stage for all paths of the thread. The loop is compiled with the
+ * instruction set of the kernel and the stage is inlined into it, instead of the device calling
+ * the kernel through a function pointer for every path. Work groups have a single work item on
+ * the CPU, so the locals are initialized for every path. */
 #    define DEFINE_SPLIT_KERNEL_FUNCTION(name) \
       void KERNEL_FUNCTION_FULL_NAME(name)(KernelGlobals * kg, KernelData * /*data*/) \
       { \
-        kernel_##name(kg); \
+        for (int y = 0; y < kg->global_size.y; y++) { \
+          for (int x = 0; x < kg->global_size.x; x++) { \
+            kg->global_id = make_int2(x, y); \
+            kernel_##name(kg); \
+          } \
+        } \
       }
 
 #    define DEFINE_SPLIT_KERNEL_FUNCTION_LOCALS(name, type) \
       void KERNEL_FUNCTION_FULL_NAME(name)(KernelGlobals * kg, KernelData * /*data*/) \
       { \
-        ccl_local type locals; \
-        kernel_##name(kg, &locals); \
+        for (int y = 0; y < kg->global_size.y; y++) { \
+          for (int x = 0; x < kg->global_size.x; x++) { \
+            kg->global_id = make_int2(x, y); \
+            ccl_local type locals; \
+            kernel_##name(kg, &locals); \
+          } \
+        } \
       }
 #  endif /* KERNEL_STUB */
 
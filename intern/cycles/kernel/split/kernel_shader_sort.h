@@ -16,6 +16,47 @@
 
 CCL_NAMESPACE_BEGIN
 
+#ifdef __KERNEL_CPU__
+/* Stable merge sort of the first num indices by shader. The CPU split kernel sorts each block
+ * from a single thread, so a sorting network is not needed. */
+ccl_device_inline void shader_sort_block_cpu(const uint *value,
+                                             ushort *index,
+                                             ushort *index_tmp,
+                                             const int num)
+{
+  ushort *src = index;
+  ushort *dst = index_tmp;
+
+  for (int width = 1; width < num; width <<= 1) {
+    for (int start = 0; start < num; start += 2 * width) {
+      const int mid = min(start + width, num);
+      const int end = min(start + 2 * width, num);
+      int i = start, j = mid, k = start;
+
+      while (i < mid && j < end) {
+        dst[k++] = (value[src[j]] < value[src[i]]) ? src[j++] : src[i++];
+      }
+      while (i < mid) {
+        dst[k++] = src[i++];
+      }
+      while (j < end) {
+        dst[k++] = src[j++];
+      }
+    }
+
+    ushort *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  if (src != index) {
+    for (int i = 0; i < num; i++) {
+      index[i] = src[i];
+    }
+  }
+}
+#endif /* __KERNEL_CPU__ */
+
 ccl_device void kernel_shader_sort(KernelGlobals *kg, ccl_local_param ShaderSortLocals *locals)
 {
 #ifndef __KERNEL_CUDA__
@@ -54,8 +95,14 @@ ccl_device void kernel_shader_sort(KernelGlobals *kg, ccl_local_param ShaderSort
   }
   ccl_barrier(CCL_LOCAL_MEM_FENCE);
 
-  /* skip sorting for cpu split kernel */
-#  ifdef __KERNEL_OPENCL__
+#  ifdef __KERNEL_CPU__
+  /* Sort the block so shaders are evaluated in batches of hits with the same shader, which keeps
+   * the SVM program and its data in cache. */
+  shader_sort_block_cpu(local_value,
+                        local_index,
+                        &locals->local_index_tmp[0],
+                        min(SHADER_SORT_BLOCK_SIZE, (int)(qsize - offset)));
+#  elif defined(__KERNEL_OPENCL__)
 
   /* bitonic sort */
   for (uint length = 1; length < SHADER_SORT_BLOCK_SIZE; length <<= 1) {
@@ -77,7 +124,7 @@ ccl_device void kernel_shader_sort(KernelGlobals *kg, ccl_local_param ShaderSort
       }
     }
   }
-#  endif /* __KERNEL_OPENCL__ */
+#  endif /* __KERNEL_CPU__ */
 
   /* copy to destination */
   for (uint i = 0; i < SHADER_SORT_BLOCK_SIZE; i += SHADER_SORT_LOCAL_SIZE) {
@@ -16,14 +16,25 @@
 
 CCL_NAMESPACE_BEGIN
 
-ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint flags)
+ccl_device float4 svm_image_texture_derivatives(KernelGlobals *kg,
+                                                int id,
+                                                float x,
+                                                float y,
+                                                const float2 dx,
+                                                const float2 dy,
+                                                uint flags)
 {
   if (id == -1) {
     return make_float4(
         TEX_IMAGE_MISSING_R, TEX_IMAGE_MISSING_G, TEX_IMAGE_MISSING_B, TEX_IMAGE_MISSING_A);
   }
 
+#ifdef __KERNEL_CPU__
+  /* The derivatives select the mipmap level of images in the texture cache. */
+  float4 r = kernel_tex_image_interp_derivatives(kg, id, x, y, dx, dy);
+#else
   float4 r = kernel_tex_image_interp(kg, id, x, y);
+#endif
   const float alpha = r.w;
 
   if ((flags & NODE_IMAGE_ALPHA_UNASSOCIATE) && alpha != 1.0f && alpha != 0.0f) {
@@ -38,6 +49,31 @@ ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y,
   return r;
 }
 
+ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint flags)
+{
+  return svm_image_texture_derivatives(
+      kg, id, x, y, make_float2(0.0f, 0.0f), make_float2(0.0f, 0.0f), flags);
+}
+
+/* Derivatives of the UV map that the texture coordinates come from. */
+ccl_device void svm_image_uv_derivatives(
+    KernelGlobals *kg, ShaderData *sd, uint id, float2 *dx, float2 *dy)
+{
+  *dx = make_float2(0.0f, 0.0f);
+  *dy = make_float2(0.0f, 0.0f);
+
+#ifdef __RAY_DIFFERENTIALS__
+  if (sd->object == OBJECT_NONE) {
+    return;
+  }
+
+  const AttributeDescriptor desc = find_attribute(kg, sd, id);
+  if (desc.offset != ATTR_STD_NOT_FOUND && desc.type == NODE_ATTR_FLOAT2) {
+    primitive_surface_attribute_float2(kg, sd, desc, dx, dy);
+  }
+#endif
+}
+
 /* Remap coordinate from 0..1 box to -1..-1 */
 ccl_device_inline float3 texco_remap_square(float3 co)
 {
@@ -65,6 +101,16 @@ ccl_device void svm_node_tex_image(
     tex_co = make_float2(co.x, co.y);
   }
 
+  float2 dx, dy;
+  if (flags & NODE_IMAGE_DERIVATIVES) {
+    uint4 derivatives_node = read_node(kg, offset);
+    svm_image_uv_derivatives(kg, sd, derivatives_node.x, &dx, &dy);
+  }
+  else {
+    dx = make_float2(0.0f, 0.0f);
+    dy = make_float2(0.0f, 0.0f);
+  }
+
   /* TODO(lukas): Consider moving tile information out of the SVM node.
    * TextureInfo seems a reasonable candidate. */
   int id = -1;
@@ -108,7 +154,7 @@ ccl_device void svm_node_tex_image(
     id = -num_nodes;
   }
 
-  float4 f = svm_image_texture(kg, id, tex_co.x, tex_co.y, flags);
+  float4 f = svm_image_texture_derivatives(kg, id, tex_co.x, tex_co.y, dx, dy, flags);
 
   if (stack_valid(out_offset))
     stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
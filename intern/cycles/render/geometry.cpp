@@ -538,6 +538,14 @@ void GeometryManager::update_svm_attributes(Device *,
   dscene->attributes_map.copy_to_device();
 }
 
+/* Offsets into the attribute arrays of the device scene. */
+struct AttributeArrayOffsets {
+  size_t attr_float;
+  size_t attr_float2;
+  size_t attr_float3;
+  size_t attr_uchar4;
+};
+
 static void update_attribute_element_size(Geometry *geom,
                                           Attribute *mattr,
                                           AttributePrimitive prim,
@@ -705,6 +713,27 @@ void GeometryManager::update_attribute_element_offset(Geometry *geom,
   }
 }
 
+static bool geometry_attributes_modified(Geometry *geom)
+{
+  foreach (const Attribute &attr, geom->attributes.attributes) {
+    if (attr.modified) {
+      return true;
+    }
+  }
+
+  if (geom->is_mesh()) {
+    Mesh *mesh = static_cast<Mesh *>(geom);
+
+    foreach (const Attribute &attr, mesh->subd_attributes.attributes) {
+      if (attr.modified) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
 void GeometryManager::device_update_attributes(Device *device,
                                                DeviceScene *dscene,
                                                Scene *scene,
@@ -712,6 +741,8 @@ void GeometryManager::device_update_attributes(Device *device,
 {
   progress.set_status("Updating Mesh", "Computing attributes");
 
+  scoped_timer requests_timer;
+
   /* gather per mesh requested attributes. as meshes may have multiple
    * shaders assigned, this merges the requested attributes that have
    * been set per shader by the shader manager */
@@ -774,9 +805,14 @@ void GeometryManager::device_update_attributes(Device *device,
   size_t attr_float3_size = 0;
   size_t attr_uchar4_size = 0;
 
+  /* Geometry attributes are filled in parallel, starting at these offsets. */
+  vector<AttributeArrayOffsets> geom_offsets(scene->geometry.size());
+
   for (size_t i = 0; i < scene->geometry.size(); i++) {
     Geometry *geom = scene->geometry[i];
     AttributeRequestSet &attributes = geom_attributes[i];
+    geom_offsets[i] = {attr_float_size, attr_float2_size, attr_float3_size, attr_uchar4_size};
+
     foreach (AttributeRequest &req, attributes.requests) {
       Attribute *attr = geom->attributes.find(req);
 
@@ -803,6 +839,9 @@ void GeometryManager::device_update_attributes(Device *device,
     }
   }
 
+  const AttributeArrayOffsets object_offsets = {
+      attr_float_size, attr_float2_size, attr_float3_size, attr_uchar4_size};
+
   for (size_t i = 0; i < scene->objects.size(); i++) {
     Object *object = scene->objects[i];
 
@@ -817,6 +856,11 @@ void GeometryManager::device_update_attributes(Device *device,
     }
   }
 
+  if (scene->update_stats) {
+    scene->update_stats->geometry.times.add_entry(
+        {"device_update (attributes: requests)", requests_timer.get_time()});
+  }
+
   dscene->attributes_float.alloc(attr_float_size);
   dscene->attributes_float2.alloc(attr_float2_size);
   dscene->attributes_float3.alloc(attr_float3_size);
@@ -827,50 +871,37 @@ void GeometryManager::device_update_attributes(Device *device,
                              dscene->attributes_float3.need_realloc() ||
                              dscene->attributes_uchar4.need_realloc();
 
-  size_t attr_float_offset = 0;
-  size_t attr_float2_offset = 0;
-  size_t attr_float3_offset = 0;
-  size_t attr_uchar4_offset = 0;
+  {
+    scoped_callback_timer timer([scene](double time) {
+      if (scene->update_stats) {
+        scene->update_stats->geometry.times.add_entry({"device_update (attributes: pack)", time});
+      }
+    });
 
-  /* Fill in attributes. */
-  for (size_t i = 0; i < scene->geometry.size(); i++) {
-    Geometry *geom = scene->geometry[i];
-    AttributeRequestSet &attributes = geom_attributes[i];
+    /* Fill in attributes. */
+    parallel_for((size_t)0, scene->geometry.size(), [&](size_t i) {
+      Geometry *geom = scene->geometry[i];
+      AttributeRequestSet &attributes = geom_attributes[i];
 
-    /* todo: we now store std and name attributes from requests even if
-     * they actually refer to the same mesh attributes, optimize */
-    foreach (AttributeRequest &req, attributes.requests) {
-      Attribute *attr = geom->attributes.find(req);
+      if (progress.get_cancel())
+        return;
 
-      if (attr) {
-        /* force a copy if we need to reallocate all the data */
-        attr->modified |= copy_all_data;
-      }
-
-      update_attribute_element_offset(geom,
-                                      dscene->attributes_float,
-                                      attr_float_offset,
-                                      dscene->attributes_float2,
-                                      attr_float2_offset,
-                                      dscene->attributes_float3,
-                                      attr_float3_offset,
-                                      dscene->attributes_uchar4,
-                                      attr_uchar4_offset,
-                                      attr,
-                                      ATTR_PRIM_GEOMETRY,
-                                      req.type,
-                                      req.desc);
+      size_t attr_float_offset = geom_offsets[i].attr_float;
+      size_t attr_float2_offset = geom_offsets[i].attr_float2;
+      size_t attr_float3_offset = geom_offsets[i].attr_float3;
+      size_t attr_uchar4_offset = geom_offsets[i].attr_uchar4;
 
-      if (geom->is_mesh()) {
-        Mesh *mesh = static_cast<Mesh *>(geom);
-        Attribute *subd_attr = mesh->subd_attributes.find(req);
+      /* todo: we now store std and name attributes from requests even if
+       * they actually refer to the same mesh attributes, optimize */
+      foreach (AttributeRequest &req, attributes.requests) {
+        Attribute *attr = geom->attributes.find(req);
 
-        if (subd_attr) {
+        if (attr) {
           /* force a copy if we need to reallocate all the data */
-          subd_attr->modified |= copy_all_data;
+          attr->modified |= copy_all_data;
         }
 
-        update_attribute_element_offset(mesh,
+        update_attribute_element_offset(geom,
                                         dscene->attributes_float,
                                         attr_float_offset,
                                         dscene->attributes_float2,
@@ -879,67 +910,142 @@ void GeometryManager::device_update_attributes(Device *device,
                                         attr_float3_offset,
                                         dscene->attributes_uchar4,
                                         attr_uchar4_offset,
-                                        subd_attr,
-                                        ATTR_PRIM_SUBD,
-                                        req.subd_type,
-                                        req.subd_desc);
+                                        attr,
+                                        ATTR_PRIM_GEOMETRY,
+                                        req.type,
+                                        req.desc);
+
+        if (geom->is_mesh()) {
+          Mesh *mesh = static_cast<Mesh *>(geom);
+          Attribute *subd_attr = mesh->subd_attributes.find(req);
+
+          if (subd_attr) {
+            /* force a copy if we need to reallocate all the data */
+            subd_attr->modified |= copy_all_data;
+          }
+
+          update_attribute_element_offset(mesh,
+                                          dscene->attributes_float,
+                                          attr_float_offset,
+                                          dscene->attributes_float2,
+                                          attr_float2_offset,
+                                          dscene->attributes_float3,
+                                          attr_float3_offset,
+                                          dscene->attributes_uchar4,
+                                          attr_uchar4_offset,
+                                          subd_attr,
+                                          ATTR_PRIM_SUBD,
+                                          req.subd_type,
+                                          req.subd_desc);
+        }
       }
+    });
 
-      if (progress.get_cancel())
-        return;
+    if (progress.get_cancel())
+      return;
+
+    size_t attr_float_offset = object_offsets.attr_float;
+    size_t attr_float2_offset = object_offsets.attr_float2;
+    size_t attr_float3_offset = object_offsets.attr_float3;
+    size_t attr_uchar4_offset = object_offsets.attr_uchar4;
+
+    for (size_t i = 0; i < scene->objects.size(); i++) {
+      Object *object = scene->objects[i];
+      AttributeRequestSet &attributes = object_attributes[i];
+      AttributeSet &values = object_attribute_values[i];
+
+      foreach (AttributeRequest &req, attributes.requests) {
+        Attribute *attr = values.find(req);
+
+        update_attribute_element_offset(object->geometry,
+                                        dscene->attributes_float,
+                                        attr_float_offset,
+                                        dscene->attributes_float2,
+                                        attr_float2_offset,
+                                        dscene->attributes_float3,
+                                        attr_float3_offset,
+                                        dscene->attributes_uchar4,
+                                        attr_uchar4_offset,
+                                        attr,
+                                        ATTR_PRIM_GEOMETRY,
+                                        req.type,
+                                        req.desc);
+
+        /* object attributes don't care about subdivision */
+        req.subd_type = req.type;
+        req.subd_desc = req.desc;
+
+        if (progress.get_cancel())
+          return;
+      }
     }
-  }
 
-  for (size_t i = 0; i < scene->objects.size(); i++) {
-    Object *object = scene->objects[i];
-    AttributeRequestSet &attributes = object_attributes[i];
-    AttributeSet &values = object_attribute_values[i];
+    /* Only copy the ranges of geometry with modified attributes, object attributes are always
+     * filled in again. */
+    for (size_t i = 0; i < scene->geometry.size(); i++) {
+      if (!geometry_attributes_modified(scene->geometry[i])) {
+        continue;
+      }
 
-    foreach (AttributeRequest &req, attributes.requests) {
-      Attribute *attr = values.find(req);
-
-      update_attribute_element_offset(object->geometry,
-                                      dscene->attributes_float,
-                                      attr_float_offset,
-                                      dscene->attributes_float2,
-                                      attr_float2_offset,
-                                      dscene->attributes_float3,
-                                      attr_float3_offset,
-                                      dscene->attributes_uchar4,
-                                      attr_uchar4_offset,
-                                      attr,
-                                      ATTR_PRIM_GEOMETRY,
-                                      req.type,
-                                      req.desc);
-
-      /* object attributes don't care about subdivision */
-      req.subd_type = req.type;
-      req.subd_desc = req.desc;
+      const AttributeArrayOffsets &begin = geom_offsets[i];
+      const AttributeArrayOffsets &end = (i + 1 < scene->geometry.size()) ? geom_offsets[i + 1] :
+                                                                            object_offsets;
 
-      if (progress.get_cancel())
-        return;
+      dscene->attributes_float.tag_modified(begin.attr_float, end.attr_float - begin.attr_float);
+      dscene->attributes_float2.tag_modified(begin.attr_float2,
+                                             end.attr_float2 - begin.attr_float2);
+      dscene->attributes_float3.tag_modified(begin.attr_float3,
+                                             end.attr_float3 - begin.attr_float3);
+      dscene->attributes_uchar4.tag_modified(begin.attr_uchar4,
+                                             end.attr_uchar4 - begin.attr_uchar4);
     }
+
+    dscene->attributes_float.tag_modified(object_offsets.attr_float,
+                                          attr_float_size - object_offsets.attr_float);
+    dscene->attributes_float2.tag_modified(object_offsets.attr_float2,
+                                           attr_float2_size - object_offsets.attr_float2);
+    dscene->attributes_float3.tag_modified(object_offsets.attr_float3,
+                                           attr_float3_size - object_offsets.attr_float3);
+    dscene->attributes_uchar4.tag_modified(object_offsets.attr_uchar4,
+                                           attr_uchar4_size - object_offsets.attr_uchar4);
   }
 
-  /* create attribute lookup maps */
-  if (scene->shader_manager->use_osl())
-    update_osl_attributes(device, scene, geom_attributes);
+  {
+    scoped_callback_timer timer([scene](double time) {
+      if (scene->update_stats) {
+        scene->update_stats->geometry.times.add_entry({"device_update (attributes: maps)", time});
+      }
+    });
 
-  update_svm_attributes(device, dscene, scene, geom_attributes, object_attributes);
+    /* create attribute lookup maps */
+    if (scene->shader_manager->use_osl())
+      update_osl_attributes(device, scene, geom_attributes);
 
-  if (progress.get_cancel())
-    return;
+    update_svm_attributes(device, dscene, scene, geom_attributes, object_attributes);
 
-  /* copy to device */
-  progress.set_status("Updating Mesh", "Copying Attributes to device");
+    if (progress.get_cancel())
+      return;
+  }
 
-  dscene->attributes_float.copy_to_device();
-  dscene->attributes_float2.copy_to_device();
-  dscene->attributes_float3.copy_to_device();
-  dscene->attributes_uchar4.copy_to_device();
+  {
+    scoped_callback_timer timer([scene](double time) {
+      if (scene->update_stats) {
+        scene->update_stats->geometry.times.add_entry(
+            {"device_update (attributes: copy to device)", time});
+      }
+    });
 
-  if (progress.get_cancel())
-    return;
+    /* copy to device */
+    progress.set_status("Updating Mesh", "Copying Attributes to device");
+
+    dscene->attributes_float.copy_to_device_if_modified();
+    dscene->attributes_float2.copy_to_device_if_modified();
+    dscene->attributes_float3.copy_to_device_if_modified();
+    dscene->attributes_uchar4.copy_to_device_if_modified();
+
+    if (progress.get_cancel())
+      return;
+  }
 
   /* After mesh attributes and patch tables have been copied to device memory,
    * we need to update offsets in the objects. */
@@ -1018,6 +1124,9 @@ void GeometryManager::mesh_calc_offset(Scene *scene, BVHLayout bvh_layout)
 void GeometryManager::device_update_mesh(
     Device *, DeviceScene *dscene, Scene *scene, bool for_displacement, Progress &progress)
 {
+  const string stats_prefix = for_displacement ? "device_update (displacement: " :
+                                                 "device_update (";
+
   /* Count. */
   size_t vert_size = 0;
   size_t tri_size = 0;
@@ -1053,6 +1162,10 @@ void GeometryManager::device_update_mesh(
     }
   }
 
+  /* Geometry is packed in parallel, each geometry writes to its own range of the arrays as
+   * computed by mesh_calc_offset(). */
+  const size_t num_geometry = scene->geometry.size();
+
   /* Create mapping from triangle to primitive triangle array. */
   vector<uint> tri_prim_index(tri_size);
   if (for_displacement) {
@@ -1061,14 +1174,15 @@ void GeometryManager::device_update_mesh(
      * from final render kernels since we don't have BVH yet, so can't
      * really use same semantic of arrays.
      */
-    foreach (Geometry *geom, scene->geometry) {
+    parallel_for((size_t)0, num_geometry, [&](size_t geom_index) {
+      Geometry *geom = scene->geometry[geom_index];
       if (geom->geometry_type == Geometry::MESH || geom->geometry_type == Geometry::VOLUME) {
         Mesh *mesh = static_cast<Mesh *>(geom);
         for (size_t i = 0; i < mesh->num_triangles(); ++i) {
           tri_prim_index[i + mesh->prim_offset] = 3 * (i + mesh->prim_offset);
         }
       }
-    }
+    });
   }
   else {
     for (size_t i = 0; i < dscene->prim_index.size(); ++i) {
@@ -1080,6 +1194,12 @@ void GeometryManager::device_update_mesh(
 
   /* Fill in all the arrays. */
   if (tri_size != 0) {
+    scoped_callback_timer timer([scene, &stats_prefix](double time) {
+      if (scene->update_stats) {
+        scene->update_stats->geometry.times.add_entry({stats_prefix + "pack triangles)", time});
+      }
+    });
+
     /* normals */
     progress.set_status("Updating Mesh", "Computing normals");
 
@@ -1095,20 +1215,34 @@ void GeometryManager::device_update_mesh(
                                dscene->tri_patch.need_realloc() ||
                                dscene->tri_patch_uv.need_realloc();
 
-    foreach (Geometry *geom, scene->geometry) {
+    auto need_pack_shaders = [&](const Mesh *mesh) {
+      return mesh->shader_is_modified() || mesh->smooth_is_modified() ||
+             mesh->triangles_is_modified() || copy_all_data;
+    };
+    auto need_pack_normals = [&](const Mesh *mesh) {
+      return mesh->verts_is_modified() || copy_all_data;
+    };
+    auto need_pack_verts = [&](const Mesh *mesh) {
+      return mesh->triangles_is_modified() || mesh->vert_patch_uv_is_modified() || copy_all_data;
+    };
+
+    parallel_for((size_t)0, num_geometry, [&](size_t geom_index) {
+      Geometry *geom = scene->geometry[geom_index];
       if (geom->geometry_type == Geometry::MESH || geom->geometry_type == Geometry::VOLUME) {
         Mesh *mesh = static_cast<Mesh *>(geom);
 
-        if (mesh->shader_is_modified() || mesh->smooth_is_modified() ||
-            mesh->triangles_is_modified() || copy_all_data) {
+        if (progress.get_cancel())
+          return;
+
+        if (need_pack_shaders(mesh)) {
           mesh->pack_shaders(scene, &tri_shader[mesh->prim_offset]);
         }
 
-        if (mesh->verts_is_modified() || copy_all_data) {
+        if (need_pack_normals(mesh)) {
           mesh->pack_normals(&vnormal[mesh->vert_offset]);
         }
 
-        if (mesh->triangles_is_modified() || mesh->vert_patch_uv_is_modified() || copy_all_data) {
+        if (need_pack_verts(mesh)) {
           mesh->pack_verts(tri_prim_index,
                            &tri_vindex[mesh->prim_offset],
                            &tri_patch[mesh->prim_offset],
@@ -1116,11 +1250,41 @@ void GeometryManager::device_update_mesh(
                            mesh->vert_offset,
                            mesh->prim_offset);
         }
+      }
+    });
 
-        if (progress.get_cancel())
-          return;
+    if (progress.get_cancel())
+      return;
+
+    /* Only copy the ranges of the meshes that were packed again. */
+    foreach (Geometry *geom, scene->geometry) {
+      if (geom->geometry_type == Geometry::MESH || geom->geometry_type == Geometry::VOLUME) {
+        Mesh *mesh = static_cast<Mesh *>(geom);
+
+        if (need_pack_shaders(mesh)) {
+          dscene->tri_shader.tag_modified(mesh->prim_offset, mesh->num_triangles());
+        }
+
+        if (need_pack_normals(mesh)) {
+          dscene->tri_vnormal.tag_modified(mesh->vert_offset, mesh->verts.size());
+        }
+
+        if (need_pack_verts(mesh)) {
+          dscene->tri_vindex.tag_modified(mesh->prim_offset, mesh->num_triangles());
+          dscene->tri_patch.tag_modified(mesh->prim_offset, mesh->num_triangles());
+          dscene->tri_patch_uv.tag_modified(mesh->vert_offset, mesh->verts.size());
+        }
       }
     }
+  }
+
+  if (tri_size != 0) {
+    scoped_callback_timer timer([scene, &stats_prefix](double time) {
+      if (scene->update_stats) {
+        scene->update_stats->geometry.times.add_entry(
+            {stats_prefix + "copy triangles to device)", time});
+      }
+    });
 
     /* vertex coordinates */
     progress.set_status("Updating Mesh", "Copying Mesh to device");
@@ -1133,6 +1297,12 @@ void GeometryManager::device_update_mesh(
   }
 
   if (curve_size != 0) {
+    scoped_callback_timer timer([scene, &stats_prefix](double time) {
+      if (scene->update_stats) {
+        scene->update_stats->geometry.times.add_entry({stats_prefix + "curves)", time});
+      }
+    });
+
     progress.set_status("Updating Mesh", "Copying Strands to device");
 
     float4 *curve_keys = dscene->curve_keys.alloc(curve_key_size);
@@ -1140,25 +1310,42 @@ void GeometryManager::device_update_mesh(
 
     const bool copy_all_data = dscene->curve_keys.need_realloc() || dscene->curves.need_realloc();
 
-    foreach (Geometry *geom, scene->geometry) {
+    auto need_pack_curves = [&](const Hair *hair) {
+      return hair->curve_radius_is_modified() || hair->curve_keys_is_modified() ||
+             hair->curve_shader_is_modified() || hair->curve_first_key_is_modified() ||
+             copy_all_data;
+    };
+
+    parallel_for((size_t)0, num_geometry, [&](size_t geom_index) {
+      Geometry *geom = scene->geometry[geom_index];
       if (geom->is_hair()) {
         Hair *hair = static_cast<Hair *>(geom);
 
-        bool curve_keys_co_modified = hair->curve_radius_is_modified() ||
-                                      hair->curve_keys_is_modified();
-        bool curve_data_modified = hair->curve_shader_is_modified() ||
-                                   hair->curve_first_key_is_modified();
-
-        if (!curve_keys_co_modified && !curve_data_modified && !copy_all_data) {
-          continue;
+        if (!need_pack_curves(hair)) {
+          return;
         }
 
+        if (progress.get_cancel())
+          return;
+
         hair->pack_curves(scene,
                           &curve_keys[hair->curvekey_offset],
                           &curves[hair->prim_offset],
                           hair->curvekey_offset);
-        if (progress.get_cancel())
-          return;
+      }
+    });
+
+    if (progress.get_cancel())
+      return;
+
+    foreach (Geometry *geom, scene->geometry) {
+      if (geom->is_hair()) {
+        Hair *hair = static_cast<Hair *>(geom);
+
+        if (need_pack_curves(hair)) {
+          dscene->curve_keys.tag_modified(hair->curvekey_offset, hair->get_curve_keys().size());
+          dscene->curves.tag_modified(hair->prim_offset, hair->num_curves());
+        }
       }
     }
 
@@ -1167,13 +1354,24 @@ void GeometryManager::device_update_mesh(
   }
 
   if (patch_size != 0 && dscene->patches.need_realloc()) {
+    scoped_callback_timer timer([scene, &stats_prefix](double time) {
+      if (scene->update_stats) {
+        scene->update_stats->geometry.times.add_entry({stats_prefix + "patches)", time});
+      }
+    });
+
     progress.set_status("Updating Mesh", "Copying Patches to device");
 
     uint *patch_data = dscene->patches.alloc(patch_size);
 
-    foreach (Geometry *geom, scene->geometry) {
+    parallel_for((size_t)0, num_geometry, [&](size_t geom_index) {
+      Geometry *geom = scene->geometry[geom_index];
       if (geom->is_mesh()) {
         Mesh *mesh = static_cast<Mesh *>(geom);
+
+        if (progress.get_cancel())
+          return;
+
         mesh->pack_patches(&patch_data[mesh->patch_offset],
                            mesh->vert_offset,
                            mesh->face_offset,
@@ -1183,18 +1381,26 @@ void GeometryManager::device_update_mesh(
           mesh->patch_table->copy_adjusting_offsets(&patch_data[mesh->patch_table_offset],
                                                     mesh->patch_table_offset);
         }
-
-        if (progress.get_cancel())
-          return;
       }
-    }
+    });
+
+    if (progress.get_cancel())
+      return;
 
     dscene->patches.copy_to_device();
   }
 
   if (for_displacement) {
+    scoped_callback_timer timer([scene, &stats_prefix](double time) {
+      if (scene->update_stats) {
+        scene->update_stats->geometry.times.add_entry(
+            {stats_prefix + "pack triangle vertices)", time});
+      }
+    });
+
     float4 *prim_tri_verts = dscene->prim_tri_verts.alloc(tri_size * 3);
-    foreach (Geometry *geom, scene->geometry) {
+    parallel_for((size_t)0, num_geometry, [&](size_t geom_index) {
+      Geometry *geom = scene->geometry[geom_index];
       if (geom->geometry_type == Geometry::MESH || geom->geometry_type == Geometry::VOLUME) {
         Mesh *mesh = static_cast<Mesh *>(geom);
         for (size_t i = 0; i < mesh->num_triangles(); ++i) {
@@ -1205,7 +1411,7 @@ void GeometryManager::device_update_mesh(
           prim_tri_verts[offset + 2] = float3_to_float4(mesh->verts[t.v[2]]);
         }
       }
-    }
+    });
     dscene->prim_tri_verts.copy_to_device();
   }
 }
@@ -1232,8 +1438,18 @@ void GeometryManager::device_update_bvh(Device *device,
 
   VLOG(1) << "Using " << bvh_layout_name(bparams.bvh_layout) << " layout.";
 
+  /* BVH4 is packed by the BVH2 code, only the node layout differs. */
+  const bool has_bvh2_layout = (bparams.bvh_layout == BVH_LAYOUT_BVH2 ||
+                                bparams.bvh_layout == BVH_LAYOUT_BVH4);
+
+  /* The scene BVH is only kept when no geometry was added or removed and no geometry needed to be
+   * rebuilt, so the top level can be refitted to the new object and geometry bounds. When objects
+   * moved the top level is built again instead, refitting would keep the old object grouping. The
+   * object BVHs are merged in as they are, so this only costs a build over the objects. */
   const bool can_refit = scene->bvh != nullptr &&
-                         (bparams.bvh_layout == BVHLayout::BVH_LAYOUT_OPTIX);
+                         (bparams.bvh_layout == BVHLayout::BVH_LAYOUT_OPTIX ||
+                          (has_bvh2_layout && dscene->bvh_leaf_nodes.size() != 0 &&
+                           (update_flags & TRANSFORM_MODIFIED) == 0));
   const bool pack_all = scene->bvh == nullptr;
 
   BVH *bvh = scene->bvh;
@@ -1241,14 +1457,34 @@ void GeometryManager::device_update_bvh(Device *device,
     bvh = scene->bvh = BVH::create(bparams, scene->geometry, scene->objects, device);
   }
 
+  if (can_refit && has_bvh2_layout) {
+    /* The packed BVH was moved to the device arrays after the last build, hand it back so the
+     * top level nodes can be refitted in place. */
+    PackedBVH &bvh2_pack = static_cast<BVH2 *>(bvh)->pack;
+    dscene->bvh_nodes.give_data(bvh2_pack.nodes);
+    dscene->bvh_leaf_nodes.give_data(bvh2_pack.leaf_nodes);
+    dscene->object_node.give_data(bvh2_pack.object_node);
+    dscene->prim_tri_verts.give_data(bvh2_pack.prim_tri_verts);
+    dscene->prim_tri_index.give_data(bvh2_pack.prim_tri_index);
+    dscene->prim_type.give_data(bvh2_pack.prim_type);
+    dscene->prim_visibility.give_data(bvh2_pack.prim_visibility);
+    dscene->prim_index.give_data(bvh2_pack.prim_index);
+    dscene->prim_object.give_data(bvh2_pack.prim_object);
+    dscene->prim_time.give_data(bvh2_pack.prim_time);
+    bvh2_pack.root_index = dscene->data.bvh.root;
+  }
+
   device->build_bvh(bvh, progress, can_refit);
 
   if (progress.get_cancel()) {
+    if (has_bvh2_layout) {
+      /* The packed BVH is incomplete, build it again on the next update. */
+      delete scene->bvh;
+      scene->bvh = nullptr;
+    }
     return;
   }
 
-  const bool has_bvh2_layout = (bparams.bvh_layout == BVH_LAYOUT_BVH2);
-
   PackedBVH pack;
   if (has_bvh2_layout) {
     pack = std::move(static_cast<BVH2 *>(bvh)->pack);
@@ -1370,24 +1606,16 @@ void GeometryManager::device_update_bvh(Device *device,
   dscene->data.bvh.scene = 0;
 }
 
-/* Set of flags used to help determining what data has been modified or needs reallocation, so we
- * can decide which device data to free or update. */
+/* Set of flags used to help determining what data needs reallocation, so we can decide which
+ * device data to free. */
 enum {
-  DEVICE_CURVE_DATA_MODIFIED = (1 << 0),
-  DEVICE_MESH_DATA_MODIFIED = (1 << 1),
-
-  ATTR_FLOAT_MODIFIED = (1 << 2),
-  ATTR_FLOAT2_MODIFIED = (1 << 3),
-  ATTR_FLOAT3_MODIFIED = (1 << 4),
-  ATTR_UCHAR4_MODIFIED = (1 << 5),
-
-  CURVE_DATA_NEED_REALLOC = (1 << 6),
-  MESH_DATA_NEED_REALLOC = (1 << 7),
+  CURVE_DATA_NEED_REALLOC = (1 << 0),
+  MESH_DATA_NEED_REALLOC = (1 << 1),
 
-  ATTR_FLOAT_NEEDS_REALLOC = (1 << 8),
-  ATTR_FLOAT2_NEEDS_REALLOC = (1 << 9),
-  ATTR_FLOAT3_NEEDS_REALLOC = (1 << 10),
-  ATTR_UCHAR4_NEEDS_REALLOC = (1 << 11),
+  ATTR_FLOAT_NEEDS_REALLOC = (1 << 2),
+  ATTR_FLOAT2_NEEDS_REALLOC = (1 << 3),
+  ATTR_FLOAT3_NEEDS_REALLOC = (1 << 4),
+  ATTR_UCHAR4_NEEDS_REALLOC = (1 << 5),
 
   ATTRS_NEED_REALLOC = (ATTR_FLOAT_NEEDS_REALLOC | ATTR_FLOAT2_NEEDS_REALLOC |
                         ATTR_FLOAT3_NEEDS_REALLOC | ATTR_UCHAR4_NEEDS_REALLOC),
@@ -1395,32 +1623,6 @@ enum {
   DEVICE_CURVE_DATA_NEEDS_REALLOC = (CURVE_DATA_NEED_REALLOC | ATTRS_NEED_REALLOC),
 };
 
-static void update_device_flags_attribute(uint32_t &device_update_flags,
-                                          const AttributeSet &attributes)
-{
-  foreach (const Attribute &attr, attributes.attributes) {
-    if (!attr.modified) {
-      continue;
-    }
-
-    if (attr.element == ATTR_ELEMENT_CORNER) {
-      device_update_flags |= ATTR_UCHAR4_MODIFIED;
-    }
-    else if (attr.type == TypeDesc::TypeFloat) {
-      device_update_flags |= ATTR_FLOAT_MODIFIED;
-    }
-    else if (attr.type == TypeFloat2) {
-      device_update_flags |= ATTR_FLOAT2_MODIFIED;
-    }
-    else if (attr.type == TypeDesc::TypeMatrix) {
-      device_update_flags |= ATTR_FLOAT3_MODIFIED;
-    }
-    else if (attr.element != ATTR_ELEMENT_VOXEL) {
-      device_update_flags |= ATTR_FLOAT3_MODIFIED;
-    }
-  }
-}
-
 void GeometryManager::device_update_preprocess(Device *device, Scene *scene, Progress &progress)
 {
   if (!need_update() && !need_flags_update) {
@@ -1503,13 +1705,6 @@ void GeometryManager::device_update_preprocess(Device *device, Scene *scene, Pro
       }
     }
 
-    /* only check for modified attributes if we do not need to reallocate them already */
-    if ((device_update_flags & ATTRS_NEED_REALLOC) == 0) {
-      update_device_flags_attribute(device_update_flags, geom->attributes);
-      /* don't check for subd_attributes, as if they were modified, we would need to reallocate
-       * anyway */
-    }
-
     /* Re-create volume mesh if we will rebuild or refit the BVH. Note we
      * should only do it in that case, otherwise the BVH and mesh can go
      * out of sync. */
@@ -1536,9 +1731,6 @@ void GeometryManager::device_update_preprocess(Device *device, Scene *scene, Pro
       if (hair->need_update_rebuild) {
         device_update_flags |= DEVICE_CURVE_DATA_NEEDS_REALLOC;
       }
-      else if (hair->is_modified()) {
-        device_update_flags |= DEVICE_CURVE_DATA_MODIFIED;
-      }
     }
 
     if (geom->is_mesh()) {
@@ -1547,9 +1739,6 @@ void GeometryManager::device_update_preprocess(Device *device, Scene *scene, Pro
       if (mesh->need_update_rebuild) {
         device_update_flags |= DEVICE_MESH_DATA_NEEDS_REALLOC;
       }
-      else if (mesh->is_modified()) {
-        device_update_flags |= DEVICE_MESH_DATA_MODIFIED;
-      }
     }
   }
 
@@ -1599,45 +1788,24 @@ void GeometryManager::device_update_preprocess(Device *device, Scene *scene, Pro
     dscene->attributes_map.tag_realloc();
     dscene->attributes_float.tag_realloc();
   }
-  else if (device_update_flags & ATTR_FLOAT_MODIFIED) {
-    dscene->attributes_float.tag_modified();
-  }
 
   if (device_update_flags & ATTR_FLOAT2_NEEDS_REALLOC) {
     dscene->attributes_map.tag_realloc();
     dscene->attributes_float2.tag_realloc();
   }
-  else if (device_update_flags & ATTR_FLOAT2_MODIFIED) {
-    dscene->attributes_float2.tag_modified();
-  }
 
   if (device_update_flags & ATTR_FLOAT3_NEEDS_REALLOC) {
     dscene->attributes_map.tag_realloc();
     dscene->attributes_float3.tag_realloc();
   }
-  else if (device_update_flags & ATTR_FLOAT3_MODIFIED) {
-    dscene->attributes_float3.tag_modified();
-  }
 
   if (device_update_flags & ATTR_UCHAR4_NEEDS_REALLOC) {
     dscene->attributes_map.tag_realloc();
     dscene->attributes_uchar4.tag_realloc();
   }
-  else if (device_update_flags & ATTR_UCHAR4_MODIFIED) {
-    dscene->attributes_uchar4.tag_modified();
-  }
-
-  if (device_update_flags & DEVICE_MESH_DATA_MODIFIED) {
-    /* if anything else than vertices or shaders are modified, we would need to reallocate, so
-     * these are the only arrays that can be updated */
-    dscene->tri_vnormal.tag_modified();
-    dscene->tri_shader.tag_modified();
-  }
 
-  if (device_update_flags & DEVICE_CURVE_DATA_MODIFIED) {
-    dscene->curve_keys.tag_modified();
-    dscene->curves.tag_modified();
-  }
+  /* Modified geometry that does not need reallocation only tags the ranges of the device arrays
+   * it packs into, see device_update_mesh() and device_update_attributes(). */
 
   need_flags_update = false;
 }
@@ -1839,28 +2007,15 @@ void GeometryManager::device_update(Device *device,
                                                           device->get_bvh_layout_mask());
   mesh_calc_offset(scene, bvh_layout);
   if (true_displacement_used) {
-    scoped_callback_timer timer([scene](double time) {
-      if (scene->update_stats) {
-        scene->update_stats->geometry.times.add_entry(
-            {"device_update (displacement: copy meshes to device)", time});
-      }
-    });
     device_update_mesh(device, dscene, scene, true, progress);
   }
   if (progress.get_cancel()) {
     return;
   }
 
-  {
-    scoped_callback_timer timer([scene](double time) {
-      if (scene->update_stats) {
-        scene->update_stats->geometry.times.add_entry({"device_update (attributes)", time});
-      }
-    });
-    device_update_attributes(device, dscene, scene, progress);
-    if (progress.get_cancel()) {
-      return;
-    }
+  device_update_attributes(device, dscene, scene, progress);
+  if (progress.get_cancel()) {
+    return;
   }
 
   /* Update displacement. */
@@ -1902,12 +2057,6 @@ void GeometryManager::device_update(Device *device,
 
   /* Device re-update after displacement. */
   if (displacement_done) {
-    scoped_callback_timer timer([scene](double time) {
-      if (scene->update_stats) {
-        scene->update_stats->geometry.times.add_entry(
-            {"device_update (displacement: attributes)", time});
-      }
-    });
     device_free(device, dscene, false);
 
     device_update_attributes(device, dscene, scene, progress);
@@ -1918,7 +2067,7 @@ void GeometryManager::device_update(Device *device,
 
   /* update the bvh even when there is no geometry so the kernel bvh data is still valid,
    * especially when removing all of the objects during interactive renders */
-  bool need_update_scene_bvh = (scene->bvh == nullptr);
+  bool need_update_scene_bvh = (scene->bvh == nullptr) || (update_flags & TRANSFORM_MODIFIED);
   {
     scoped_callback_timer timer([scene](double time) {
       if (scene->update_stats) {
@@ -1982,17 +2131,9 @@ void GeometryManager::device_update(Device *device,
     }
   }
 
-  {
-    scoped_callback_timer timer([scene](double time) {
-      if (scene->update_stats) {
-        scene->update_stats->geometry.times.add_entry(
-            {"device_update (copy meshes to device)", time});
-      }
-    });
-    device_update_mesh(device, dscene, scene, false, progress);
-    if (progress.get_cancel()) {
-      return;
-    }
+  device_update_mesh(device, dscene, scene, false, progress);
+  if (progress.get_cancel()) {
+    return;
   }
 
   if (true_displacement_used) {
@@ -2101,12 +2242,34 @@ bool GeometryManager::need_update() const
   return update_flags != UPDATE_NONE;
 }
 
+static void collect_bvh_statistics(const string &name, const BVH *bvh, RenderStats *stats)
+{
+  /* Only BVHs built by Cycles itself have build statistics. */
+  if (bvh == NULL ||
+      (bvh->params.bvh_layout != BVH_LAYOUT_BVH2 && bvh->params.bvh_layout != BVH_LAYOUT_BVH4)) {
+    return;
+  }
+
+  const BVHBuildStats &build_stats = static_cast<const BVH2 *>(bvh)->build_stats;
+  stats->bvh.times.add_entry(NamedTimeEntry("Adding references", build_stats.references_time));
+  stats->bvh.times.add_entry(NamedTimeEntry("Building nodes", build_stats.nodes_time));
+  stats->bvh.times.add_entry(NamedTimeEntry("Finalizing nodes", build_stats.finalize_time));
+  stats->bvh.times.add_entry(NamedTimeEntry("Packing", build_stats.pack_time));
+  stats->bvh.entries.push_back(NamedBVHEntry(name,
+                                             build_stats.sah_cost,
+                                             build_stats.num_references,
+                                             build_stats.num_duplicated_references));
+}
+
 void GeometryManager::collect_statistics(const Scene *scene, RenderStats *stats)
 {
   foreach (Geometry *geometry, scene->geometry) {
     stats->mesh.geometry.add_entry(
         NamedSizeEntry(string(geometry->name.c_str()), geometry->get_total_size_in_bytes()));
+    collect_bvh_statistics(string(geometry->name.c_str()), geometry->bvh, stats);
   }
+
+  collect_bvh_statistics("Scene", scene->bvh, stats);
 }
 
 CCL_NAMESPACE_END
@@ -186,6 +186,10 @@ class GeometryManager {
     SHADER_ATTRIBUTE_MODIFIED = (1 << 8),
     SHADER_DISPLACEMENT_MODIFIED = (1 << 9),
 
+    /* Only transforms of objects with instanced geometry changed, the top level BVH needs to be
+     * rebuilt but the geometry BVHs can be kept. */
+    TRANSFORM_MODIFIED = (1 << 10),
+
     GEOMETRY_ADDED = MESH_ADDED | HAIR_ADDED,
     GEOMETRY_REMOVED = MESH_REMOVED | HAIR_REMOVED,
 
@@ -742,6 +742,23 @@ void ShaderGraph::break_cycles(ShaderNode *node, vector<bool> &visited, vector<b
   on_stack[node->id] = false;
 }
 
+static void hash_node_and_links(ShaderNode *node, MD5Hash &md5)
+{
+  node->hash(md5);
+  foreach (ShaderInput *input, node->inputs) {
+    int link_id = (input->link) ? input->link->parent->id : 0;
+    md5.append((uint8_t *)&link_id, sizeof(link_id));
+    md5.append((input->link) ? input->link->name().c_str() : "");
+  }
+
+  if (node->special_type == SHADER_SPECIAL_TYPE_OSL) {
+    /* Hash takes into account socket values, to detect changes
+     * in the code of the node we need an exception. */
+    OSLNode *oslnode = static_cast<OSLNode *>(node);
+    md5.append(oslnode->bytecode_hash);
+  }
+}
+
 void ShaderGraph::compute_displacement_hash()
 {
   /* Compute hash of all nodes linked to displacement, to detect if we need
@@ -758,24 +775,21 @@ void ShaderGraph::compute_displacement_hash()
 
   MD5Hash md5;
   foreach (ShaderNode *node, nodes_displace) {
-    node->hash(md5);
-    foreach (ShaderInput *input, node->inputs) {
-      int link_id = (input->link) ? input->link->parent->id : 0;
-      md5.append((uint8_t *)&link_id, sizeof(link_id));
-      md5.append((input->link) ? input->link->name().c_str() : "");
-    }
-
-    if (node->special_type == SHADER_SPECIAL_TYPE_OSL) {
-      /* Hash takes into account socket values, to detect changes
-       * in the code of the node we need an exception. */
-      OSLNode *oslnode = static_cast<OSLNode *>(node);
-      md5.append(oslnode->bytecode_hash);
-    }
+    hash_node_and_links(node, md5);
   }
 
   displacement_hash = md5.get_hex();
 }
 
+void ShaderGraph::hash(MD5Hash &md5)
+{
+  /* Hash of all nodes and links, to detect if the graph changed since it was compiled. */
+  md5.append((uint8_t *)&finalized, sizeof(finalized));
+  foreach (ShaderNode *node, nodes) {
+    hash_node_and_links(node, md5);
+  }
+}
+
 void ShaderGraph::clean(Scene *scene)
 {
   /* Graph simplification */
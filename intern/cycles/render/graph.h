@@ -335,6 +335,7 @@ class ShaderGraph : public NodeOwner {
 
   void remove_proxy_nodes();
   void compute_displacement_hash();
+  void hash(MD5Hash &md5);
   void simplify(Scene *scene);
   void finalize(Scene *scene,
                 bool do_bump = false,
@@ -21,6 +21,7 @@
 #include "render/image_vdb.h"
 #include "render/scene.h"
 #include "render/stats.h"
+#include "render/texture_cache.h"
 
 #include "util/util_foreach.h"
 #include "util/util_image.h"
@@ -77,6 +78,12 @@ const char *name_from_type(ImageDataType type)
       return "nanovdb_float";
     case IMAGE_DATA_TYPE_NANOVDB_FLOAT3:
       return "nanovdb_float3";
+    case IMAGE_DATA_TYPE_SPARSE_FLOAT:
+      return "sparse_float";
+    case IMAGE_DATA_TYPE_SPARSE_FLOAT3:
+      return "sparse_float3";
+    case IMAGE_DATA_TYPE_TEXTURE_CACHE:
+      return "texture_cache";
     case IMAGE_DATA_NUM_TYPES:
       assert(!"System enumerator type, should never be used");
       return "";
@@ -304,6 +311,8 @@ ImageManager::ImageManager(const DeviceInfo &info)
 
   /* Set image limits */
   has_half_images = info.has_half_images;
+  has_sparse_images = info.has_sparse_images;
+  has_texture_cache = info.has_texture_cache;
 }
 
 ImageManager::~ImageManager()
@@ -317,6 +326,21 @@ void ImageManager::set_osl_texture_system(void *texture_system)
   osl_texture_system = texture_system;
 }
 
+void ImageManager::set_texture_cache(const bool use_texture_cache, const size_t max_memory)
+{
+  if (use_texture_cache && has_texture_cache) {
+    texture_cache.reset(new TextureCache(max_memory));
+  }
+  else {
+    texture_cache.reset();
+  }
+}
+
+bool ImageManager::use_texture_cache() const
+{
+  return (bool)texture_cache;
+}
+
 bool ImageManager::set_animation_frame_update(int frame)
 {
   if (frame != animation_frame) {
@@ -366,6 +390,18 @@ void ImageManager::load_image_metadata(Image *img)
     }
   }
 
+  /* Sparse textures are only supported on the CPU, loaders fill in dense voxels instead. */
+  if (!has_sparse_images) {
+    if (metadata.type == IMAGE_DATA_TYPE_SPARSE_FLOAT) {
+      metadata.type = IMAGE_DATA_TYPE_FLOAT;
+      metadata.byte_size = 0;
+    }
+    else if (metadata.type == IMAGE_DATA_TYPE_SPARSE_FLOAT3) {
+      metadata.type = IMAGE_DATA_TYPE_FLOAT4;
+      metadata.byte_size = 0;
+    }
+  }
+
   img->need_metadata = false;
 }
 
@@ -448,6 +484,7 @@ int ImageManager::add_image_slot(ImageLoader *loader,
   img->builtin = builtin;
   img->users = 1;
   img->mem = NULL;
+  img->cache_image = NULL;
 
   images[slot] = img;
 
@@ -661,6 +698,22 @@ void ImageManager::device_load_image(Device *device, Scene *scene, int slot, Pro
   load_image_metadata(img);
   ImageDataType type = img->metadata.type;
 
+  if (img->cache_image) {
+    texture_cache->remove_image(img->cache_image);
+    img->cache_image = NULL;
+  }
+
+  /* Load tiles of 2D images while rendering. Builtin images are loaded now, because their data
+   * is only available while syncing. */
+  if (texture_cache && !img->builtin && !img->loader->is_vdb_loader() &&
+      img->metadata.depth <= 1) {
+    img->cache_image = texture_cache->add_image(
+        img->loader, img->metadata, img->params, image_associate_alpha(img), texture_limit);
+    if (img->cache_image) {
+      type = IMAGE_DATA_TYPE_TEXTURE_CACHE;
+    }
+  }
+
   /* Name for debugging. */
   img->mem_name = string_printf("__tex_image_%s_%03d", name_from_type(type), slot);
 
@@ -771,6 +824,25 @@ void ImageManager::device_load_image(Device *device, Scene *scene, int slot, Pro
     }
   }
 #endif
+  else if (type == IMAGE_DATA_TYPE_SPARSE_FLOAT || type == IMAGE_DATA_TYPE_SPARSE_FLOAT3) {
+    thread_scoped_lock device_lock(device_mutex);
+    void *pixels = img->mem->alloc(img->metadata.byte_size, 0);
+
+    if (pixels != NULL) {
+      img->loader->load_pixels(img->metadata, pixels, img->metadata.byte_size, false);
+    }
+  }
+  else if (type == IMAGE_DATA_TYPE_TEXTURE_CACHE) {
+    /* The kernel looks up pixels through the image in the texture cache. */
+    thread_scoped_lock device_lock(device_mutex);
+    TextureCacheImage **pixels = (TextureCacheImage **)img->mem->alloc(
+        sizeof(TextureCacheImage *), 0);
+
+    if (pixels != NULL) {
+      *pixels = img->cache_image;
+    }
+    device->set_texture_cache_lookup(TextureCache::kernel_lookup);
+  }
 
   {
     thread_scoped_lock device_lock(device_mutex);
@@ -803,6 +875,10 @@ void ImageManager::device_free_image(Device *, int slot)
     delete img->mem;
   }
 
+  if (img->cache_image) {
+    texture_cache->remove_image(img->cache_image);
+  }
+
   delete img->loader;
   delete img;
   images[slot] = NULL;
@@ -891,8 +967,10 @@ void ImageManager::device_free(Device *device)
 void ImageManager::collect_statistics(RenderStats *stats)
 {
   foreach (const Image *image, images) {
-    stats->image.textures.add_entry(
-        NamedSizeEntry(image->loader->name(), image->mem->memory_size()));
+    const size_t memory_size = (image->cache_image) ?
+                                   texture_cache->memory_size(image->cache_image) :
+                                   image->mem->memory_size();
+    stats->image.textures.add_entry(NamedSizeEntry(image->loader->name(), memory_size));
   }
 }
 
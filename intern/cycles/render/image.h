@@ -39,6 +39,8 @@ class Progress;
 class RenderStats;
 class Scene;
 class ColorSpaceProcessor;
+class TextureCache;
+class TextureCacheImage;
 class VDBImageLoader;
 
 /* Image Parameters */
@@ -185,6 +187,11 @@ class ImageManager {
   void device_free_builtin(Device *device);
 
   void set_osl_texture_system(void *texture_system);
+
+  /* Load tiles of images on demand while rendering, instead of loading full images before
+   * rendering. Only used when supported by the device. */
+  void set_texture_cache(const bool use_texture_cache, const size_t max_memory);
+  bool use_texture_cache() const;
   bool set_animation_frame_update(int frame);
 
   void collect_statistics(RenderStats *stats);
@@ -205,6 +212,7 @@ class ImageManager {
 
     string mem_name;
     device_texture *mem;
+    TextureCacheImage *cache_image;
 
     int users;
     thread_mutex mutex;
@@ -213,6 +221,8 @@ class ImageManager {
  private:
   bool need_update_;
   bool has_half_images;
+  bool has_sparse_images;
+  bool has_texture_cache;
 
   thread_mutex device_mutex;
   thread_mutex images_mutex;
@@ -220,6 +230,7 @@ class ImageManager {
 
   vector<Image *> images;
   void *osl_texture_system;
+  unique_ptr<TextureCache> texture_cache;
 
   int add_image_slot(ImageLoader *loader, const ImageParams &params, const bool builtin);
   void add_image_user(int slot);
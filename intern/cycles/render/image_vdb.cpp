@@ -24,8 +24,167 @@
 #  include <nanovdb/util/OpenToNanoVDB.h>
 #endif
 
+#include "util/util_tbb.h"
+
 CCL_NAMESPACE_BEGIN
 
+#if defined(WITH_OPENVDB) && !defined(WITH_NANOVDB)
+/* Sparse textures without NanoVDB. */
+
+static_assert(SPARSE_TILE_SIZE == openvdb::FloatTree::LeafNodeType::DIM,
+              "Sparse texture tiles must match OpenVDB leaf nodes");
+
+/* Call the function with the typed grid, for all grid types that can be stored in a sparse
+ * texture. */
+template<typename Func> static bool sparse_grid_dispatch(const openvdb::GridBase &grid, Func func)
+{
+  if (grid.isType<openvdb::FloatGrid>()) {
+    func(static_cast<const openvdb::FloatGrid &>(grid));
+  }
+  else if (grid.isType<openvdb::Vec3fGrid>()) {
+    func(static_cast<const openvdb::Vec3fGrid &>(grid));
+  }
+  else if (grid.isType<openvdb::BoolGrid>()) {
+    func(static_cast<const openvdb::BoolGrid &>(grid));
+  }
+  else if (grid.isType<openvdb::DoubleGrid>()) {
+    func(static_cast<const openvdb::DoubleGrid &>(grid));
+  }
+  else if (grid.isType<openvdb::Int32Grid>()) {
+    func(static_cast<const openvdb::Int32Grid &>(grid));
+  }
+  else if (grid.isType<openvdb::Int64Grid>()) {
+    func(static_cast<const openvdb::Int64Grid &>(grid));
+  }
+  else if (grid.isType<openvdb::Vec3IGrid>()) {
+    func(static_cast<const openvdb::Vec3IGrid &>(grid));
+  }
+  else if (grid.isType<openvdb::Vec3dGrid>()) {
+    func(static_cast<const openvdb::Vec3dGrid &>(grid));
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+template<typename T> static void sparse_write_value(float *voxel, const T value)
+{
+  voxel[0] = (float)value;
+}
+
+template<typename T>
+static void sparse_write_value(float *voxel, const openvdb::math::Vec3<T> &value)
+{
+  voxel[0] = (float)value.x();
+  voxel[1] = (float)value.y();
+  voxel[2] = (float)value.z();
+}
+
+/* Assign a voxel block to every tile that contains values different from the background, so that
+ * the texture has the same values as a dense copy of the grid. This includes inactive values, for
+ * example the inside of a level set. Block zero is the background. */
+template<typename GridType>
+static int sparse_assign_blocks(const GridType &grid,
+                                const openvdb::Coord &tile_origin,
+                                const int tiles[3],
+                                vector<int> &tile_blocks)
+{
+  tile_blocks.clear();
+  tile_blocks.resize((size_t)tiles[0] * tiles[1] * tiles[2], 0);
+  int num_blocks = 1;
+
+  auto mark_tiles = [&](const openvdb::CoordBBox &bbox) {
+    int tile_min[3], tile_max[3];
+    for (int i = 0; i < 3; i++) {
+      tile_min[i] = max((bbox.min()[i] - tile_origin[i]) >> SPARSE_TILE_SHIFT, 0);
+      tile_max[i] = min((bbox.max()[i] - tile_origin[i]) >> SPARSE_TILE_SHIFT, tiles[i] - 1);
+    }
+    for (int z = tile_min[2]; z <= tile_max[2]; z++) {
+      for (int y = tile_min[1]; y <= tile_max[1]; y++) {
+        for (int x = tile_min[0]; x <= tile_max[0]; x++) {
+          int &block = tile_blocks[x + (size_t)tiles[0] * (y + (size_t)tiles[1] * z)];
+          if (block == 0) {
+            block = num_blocks++;
+          }
+        }
+      }
+    }
+  };
+
+  const typename GridType::ValueType background = grid.background();
+
+  /* Leaf nodes have the size of a tile. */
+  for (typename GridType::TreeType::LeafCIter leaf = grid.tree().cbeginLeaf(); leaf; ++leaf) {
+    for (auto value = leaf->cbeginValueAll(); value; ++value) {
+      if (!openvdb::math::isExactlyEqual(*value, background)) {
+        mark_tiles(openvdb::CoordBBox::createCube(leaf->origin(), SPARSE_TILE_SIZE));
+        break;
+      }
+    }
+  }
+
+  /* Tiles of internal nodes span one or more tiles, skip the voxels of leaf nodes here. */
+  typename GridType::ValueAllCIter iter = grid.cbeginValueAll();
+  iter.setMaxDepth(GridType::ValueAllCIter::LEAF_DEPTH - 1);
+  for (; iter; ++iter) {
+    if (openvdb::math::isExactlyEqual(*iter, background)) {
+      continue;
+    }
+    openvdb::CoordBBox bbox;
+    iter.getBoundingBox(bbox);
+    mark_tiles(bbox);
+  }
+
+  return num_blocks;
+}
+
+template<typename GridType>
+static void sparse_fill_blocks(const GridType &grid,
+                               const openvdb::Coord &tile_origin,
+                               const int tiles[3],
+                               const vector<int> &tile_blocks,
+                               const int channels,
+                               float *voxels)
+{
+  const size_t block_size = SPARSE_TILE_VOXELS * channels;
+  for (int i = 0; i < SPARSE_TILE_VOXELS; i++) {
+    sparse_write_value(voxels + i * channels, grid.background());
+  }
+
+  parallel_for((size_t)0, tile_blocks.size(), [&](size_t tile) {
+    const int block = tile_blocks[tile];
+    if (block == 0) {
+      return;
+    }
+
+    const int tile_x = tile % tiles[0];
+    const int tile_y = (tile / tiles[0]) % tiles[1];
+    const int tile_z = tile / ((size_t)tiles[0] * tiles[1]);
+    const openvdb::Coord origin = tile_origin + openvdb::Coord(tile_x << SPARSE_TILE_SHIFT,
+                                                               tile_y << SPARSE_TILE_SHIFT,
+                                                               tile_z << SPARSE_TILE_SHIFT);
+
+    typename GridType::ConstAccessor accessor = grid.getConstAccessor();
+    float *voxel = voxels + block * block_size;
+    for (int z = 0; z < SPARSE_TILE_SIZE; z++) {
+      for (int y = 0; y < SPARSE_TILE_SIZE; y++) {
+        for (int x = 0; x < SPARSE_TILE_SIZE; x++) {
+          sparse_write_value(voxel, accessor.getValue(origin.offsetBy(x, y, z)));
+          voxel += channels;
+        }
+      }
+    }
+  });
+}
+
+static size_t sparse_byte_size(const int table_size, const int num_blocks, const int channels)
+{
+  return sizeof(SparseTextureHeader) + sizeof(int) * table_size +
+         sizeof(float) * SPARSE_TILE_VOXELS * channels * num_blocks;
+}
+#endif
+
 VDBImageLoader::VDBImageLoader(const string &grid_name) : grid_name(grid_name)
 {
 }
@@ -132,6 +291,24 @@ bool VDBImageLoader::load_metadata(ImageMetaData &metadata)
   else {
     metadata.type = IMAGE_DATA_TYPE_FLOAT4;
   }
+
+  /* Only store the tiles with values other than the background. The texture is read in the same
+   * way as a dense texture, so the transform is the same. The tiles are aligned with the OpenVDB
+   * leaf nodes. */
+  for (int i = 0; i < 3; i++) {
+    sparse_tile_origin[i] = bbox.min()[i] & ~SPARSE_TILE_MASK;
+    sparse_tiles[i] = ((bbox.max()[i] - sparse_tile_origin[i]) >> SPARSE_TILE_SHIFT) + 1;
+  }
+  const bool is_sparse = sparse_grid_dispatch(*grid, [&](const auto &typed_grid) {
+    sparse_num_blocks = sparse_assign_blocks(
+        typed_grid, sparse_tile_origin, sparse_tiles, sparse_tile_blocks);
+  });
+  if (is_sparse) {
+    metadata.type = (metadata.channels == 1) ? IMAGE_DATA_TYPE_SPARSE_FLOAT :
+                                               IMAGE_DATA_TYPE_SPARSE_FLOAT3;
+    metadata.byte_size = sparse_byte_size(
+        align_up(sparse_tile_blocks.size(), 4), sparse_num_blocks, metadata.channels);
+  }
 #  endif
 
   /* Set transform from object space to voxel index. */
@@ -161,13 +338,51 @@ bool VDBImageLoader::load_metadata(ImageMetaData &metadata)
 #endif
 }
 
-bool VDBImageLoader::load_pixels(const ImageMetaData &, void *pixels, const size_t, const bool)
+bool VDBImageLoader::load_pixels(const ImageMetaData &metadata,
+                                 void *pixels,
+                                 const size_t,
+                                 const bool)
 {
 #ifdef WITH_OPENVDB
 #  ifdef WITH_NANOVDB
+  (void)metadata;
   memcpy(pixels, nanogrid.data(), nanogrid.size());
 #  else
-  if (grid->isType<openvdb::FloatGrid>()) {
+  if (metadata.type == IMAGE_DATA_TYPE_SPARSE_FLOAT ||
+      metadata.type == IMAGE_DATA_TYPE_SPARSE_FLOAT3) {
+    const int table_size = align_up(sparse_tile_blocks.size(), 4);
+
+    SparseTextureHeader *header = (SparseTextureHeader *)pixels;
+    header->width = metadata.width;
+    header->height = metadata.height;
+    header->depth = metadata.depth;
+    header->offset_x = bbox.min().x() - sparse_tile_origin.x();
+    header->offset_y = bbox.min().y() - sparse_tile_origin.y();
+    header->offset_z = bbox.min().z() - sparse_tile_origin.z();
+    header->tiles_x = sparse_tiles[0];
+    header->tiles_y = sparse_tiles[1];
+    header->tiles_z = sparse_tiles[2];
+    header->table_size = table_size;
+    header->num_blocks = sparse_num_blocks;
+    header->pad = 0;
+
+    int *table = (int *)(header + 1);
+    memcpy(table, sparse_tile_blocks.data(), sizeof(int) * sparse_tile_blocks.size());
+    for (int i = sparse_tile_blocks.size(); i < table_size; i++) {
+      table[i] = 0;
+    }
+
+    float *voxels = (float *)(table + table_size);
+    sparse_grid_dispatch(*grid, [&](const auto &typed_grid) {
+      sparse_fill_blocks(typed_grid,
+                         sparse_tile_origin,
+                         sparse_tiles,
+                         sparse_tile_blocks,
+                         metadata.channels,
+                         voxels);
+    });
+  }
+  else if (grid->isType<openvdb::FloatGrid>()) {
     openvdb::tools::Dense<float, openvdb::tools::LayoutXYZ> dense(bbox, (float *)pixels);
     openvdb::tools::copyToDense(*openvdb::gridConstPtrCast<openvdb::FloatGrid>(grid), dense);
   }
@@ -209,6 +424,7 @@ bool VDBImageLoader::load_pixels(const ImageMetaData &, void *pixels, const size
 #  endif
   return true;
 #else
+  (void)metadata;
   (void)pixels;
   return false;
 #endif
@@ -238,6 +454,8 @@ void VDBImageLoader::cleanup()
 #endif
 #ifdef WITH_NANOVDB
   nanogrid.reset();
+#elif defined(WITH_OPENVDB)
+  sparse_tile_blocks.free_memory();
 #endif
 }
 
@@ -60,6 +60,12 @@ class VDBImageLoader : public ImageLoader {
 #endif
 #ifdef WITH_NANOVDB
   nanovdb::GridHandle<> nanogrid;
+#elif defined(WITH_OPENVDB)
+  /* Layout of the sparse texture, see #SparseTextureHeader. */
+  openvdb::Coord sparse_tile_origin;
+  int sparse_tiles[3];
+  vector<int> sparse_tile_blocks;
+  int sparse_num_blocks;
 #endif
 };
 
@@ -20,6 +20,7 @@
 #include "render/film.h"
 #include "render/graph.h"
 #include "render/integrator.h"
+#include "render/light_tree.h"
 #include "render/mesh.h"
 #include "render/nodes.h"
 #include "render/object.h"
@@ -535,6 +536,279 @@ void LightManager::device_update_distribution(Device *,
   }
 }
 
+static LightTreeEmitter light_tree_triangle_emitter(const float3 &p1,
+                                                    const float3 &p2,
+                                                    const float3 &p3,
+                                                    int distribution_id)
+{
+  LightTreeEmitter emitter;
+  emitter.bbox = BoundBox::empty;
+  emitter.bbox.grow(p1);
+  emitter.bbox.grow(p2);
+  emitter.bbox.grow(p3);
+  /* Triangles emit on both sides. */
+  emitter.bcone = OrientationBounds(
+      safe_normalize(cross(p2 - p1, p3 - p1)), M_PI_F, M_PI_2_F);
+  emitter.energy = triangle_area(p1, p2, p3);
+  emitter.distribution_id = distribution_id;
+  return emitter;
+}
+
+static LightTreeEmitter light_tree_lamp_emitter(const Light *light, int distribution_id)
+{
+  const float3 co = light->get_co();
+  const float size = light->get_size();
+
+  LightTreeEmitter emitter;
+  emitter.bbox = BoundBox::empty;
+  if (light->get_light_type() == LIGHT_AREA) {
+    const float3 axisu = light->get_axisu() * (light->get_sizeu() * size);
+    const float3 axisv = light->get_axisv() * (light->get_sizev() * size);
+    emitter.bbox.grow(co - 0.5f * axisu - 0.5f * axisv);
+    emitter.bbox.grow(co + 0.5f * axisu - 0.5f * axisv);
+    emitter.bbox.grow(co - 0.5f * axisu + 0.5f * axisv);
+    emitter.bbox.grow(co + 0.5f * axisu + 0.5f * axisv);
+    emitter.bcone = OrientationBounds(safe_normalize(light->get_dir()), 0.0f, M_PI_2_F);
+  }
+  else {
+    emitter.bbox.grow(co, size);
+    if (light->get_light_type() == LIGHT_SPOT) {
+      emitter.bcone = OrientationBounds(
+          safe_normalize(light->get_dir()), light->get_spot_angle() * 0.5f, M_PI_2_F);
+    }
+    else {
+      emitter.bcone = OrientationBounds(make_float3(0.0f, 0.0f, 1.0f), M_PI_F, M_PI_2_F);
+    }
+  }
+  emitter.energy = average(fabs(light->get_strength()));
+  emitter.distribution_id = distribution_id;
+  return emitter;
+}
+
+static void light_tree_pack_bounds(const BoundBox &bbox,
+                                   const OrientationBounds &bcone,
+                                   float energy,
+                                   float bounding_box_min[3],
+                                   float bounding_box_max[3],
+                                   float axis[3],
+                                   float *theta_o,
+                                   float *theta_e,
+                                   float *packed_energy)
+{
+  bounding_box_min[0] = bbox.min.x;
+  bounding_box_min[1] = bbox.min.y;
+  bounding_box_min[2] = bbox.min.z;
+  bounding_box_max[0] = bbox.max.x;
+  bounding_box_max[1] = bbox.max.y;
+  bounding_box_max[2] = bbox.max.z;
+  axis[0] = bcone.axis.x;
+  axis[1] = bcone.axis.y;
+  axis[2] = bcone.axis.z;
+  *theta_o = bcone.theta_o;
+  *theta_e = bcone.theta_e;
+  *packed_energy = energy;
+}
+
+void LightManager::device_update_light_tree(Device *device,
+                                            DeviceScene *dscene,
+                                            Scene *scene,
+                                            Progress &progress)
+{
+  KernelIntegrator *kintegrator = &dscene->data.integrator;
+  kintegrator->use_light_tree = false;
+  kintegrator->num_light_tree_emitters = 0;
+  kintegrator->num_light_tree_infinite = 0;
+  kintegrator->pdf_light_tree = 0.0f;
+
+  /* Branched path tracing samples all lights, which the tree can't be used for. */
+  const Integrator *integrator = scene->integrator;
+  const bool use_branched = integrator->get_method() == Integrator::BRANCHED_PATH &&
+                            device->info.has_branched_path;
+  if (!integrator->get_use_light_tree() || use_branched || !kintegrator->use_direct_light) {
+    return;
+  }
+
+  progress.set_status("Updating Lights", "Building light tree");
+
+  /* Emitters are created in the same order as the light distribution. Distant and background
+   * lights are not part of the tree, they are added after the emitters of the tree. */
+  const KernelLightDistribution *distribution = dscene->light_distribution.data();
+  vector<LightTreeEmitter> emitters;
+  vector<LightTreeEmitter> infinite_emitters;
+  emitters.reserve(kintegrator->num_distribution);
+
+  /* Lamps first, then the triangles of every emissive object. */
+  int num_lamps = 0;
+  foreach (Light *light, scene->lights) {
+    if (light->is_enabled) {
+      num_lamps++;
+    }
+  }
+  int *object_offset = dscene->light_tree_object_offset.alloc(max(scene->objects.size(), 1));
+  int num_emitter_indices = num_lamps;
+
+  int distribution_id = 0;
+  float triangle_energy = 0.0f;
+  for (size_t object_index = 0; object_index < scene->objects.size(); object_index++) {
+    Object *object = scene->objects[object_index];
+    object_offset[object_index] = LIGHT_TREE_OBJECT_NONE;
+
+    if (progress.get_cancel()) {
+      return;
+    }
+    if (!object_usable_as_light(object)) {
+      continue;
+    }
+
+    Mesh *mesh = static_cast<Mesh *>(object->get_geometry());
+    const Transform tfm = object->get_tfm();
+    const size_t mesh_num_triangles = mesh->num_triangles();
+    object_offset[object_index] = num_emitter_indices - mesh->prim_offset;
+    num_emitter_indices += mesh_num_triangles;
+
+    /* Only the triangles that are in the light distribution are emitters. */
+    while (distribution_id < kintegrator->num_distribution &&
+           distribution[distribution_id].prim >= 0 &&
+           distribution[distribution_id].mesh_light.object_id == (int)object_index) {
+      const int prim = distribution[distribution_id].prim - mesh->prim_offset;
+      const Mesh::Triangle t = mesh->get_triangle(prim);
+      float3 p1 = mesh->get_verts()[t.v[0]];
+      float3 p2 = mesh->get_verts()[t.v[1]];
+      float3 p3 = mesh->get_verts()[t.v[2]];
+      if (!mesh->transform_applied) {
+        p1 = transform_point(&tfm, p1);
+        p2 = transform_point(&tfm, p2);
+        p3 = transform_point(&tfm, p3);
+      }
+      LightTreeEmitter emitter = light_tree_triangle_emitter(p1, p2, p3, distribution_id);
+      if (!t.valid(&mesh->get_verts()[0])) {
+        emitter.energy = 0.0f;
+      }
+      triangle_energy += emitter.energy;
+      emitters.push_back(emitter);
+      distribution_id++;
+    }
+  }
+
+  const int num_triangles = emitters.size();
+  float lamp_energy = 0.0f;
+  foreach (Light *light, scene->lights) {
+    if (!light->is_enabled) {
+      continue;
+    }
+    if (light->light_type == LIGHT_DISTANT || light->light_type == LIGHT_BACKGROUND) {
+      LightTreeEmitter emitter;
+      emitter.distribution_id = distribution_id;
+      infinite_emitters.push_back(emitter);
+    }
+    else {
+      emitters.push_back(light_tree_lamp_emitter(light, distribution_id));
+      lamp_energy += emitters.back().energy;
+    }
+    distribution_id++;
+  }
+  assert(distribution_id == kintegrator->num_distribution);
+
+  if (emitters.empty()) {
+    /* Only distant and background lights, the tree wouldn't change anything. */
+    dscene->light_tree_object_offset.free();
+    return;
+  }
+
+  /* Give lamps and triangles the same total energy, like the light distribution gives them the
+   * same probability. */
+  if (num_triangles > 0 && lamp_energy > 0.0f && triangle_energy > 0.0f) {
+    const float triangle_energy_scale = lamp_energy / triangle_energy;
+    for (int i = 0; i < num_triangles; i++) {
+      emitters[i].energy *= triangle_energy_scale;
+    }
+  }
+
+  LightTree light_tree(emitters);
+  const vector<LightTreeNode> &nodes = light_tree.get_nodes();
+  const int num_emitters = emitters.size();
+  vector<int> emitter_leaf(num_emitters);
+
+  KernelLightTreeNode *knodes = dscene->light_tree_nodes.alloc(nodes.size());
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const LightTreeNode &node = nodes[i];
+    KernelLightTreeNode &knode = knodes[i];
+    light_tree_pack_bounds(node.bbox,
+                           node.bcone,
+                           node.energy,
+                           knode.bounding_box_min,
+                           knode.bounding_box_max,
+                           knode.axis,
+                           &knode.theta_o,
+                           &knode.theta_e,
+                           &knode.energy);
+    knode.child_index = node.child_index;
+    knode.num_emitters = node.num_emitters;
+    knode.parent_index = node.parent_index;
+    knode.pad = 0;
+
+    for (int j = 0; j < node.num_emitters; j++) {
+      emitter_leaf[node.child_index + j] = i;
+    }
+  }
+
+  /* Map the lamps and triangles to their emitter, -1 if they are not in the tree. */
+  int *emitter_index = dscene->light_tree_emitter_index.alloc(max(num_emitter_indices, 1));
+  for (int i = 0; i < num_emitter_indices; i++) {
+    emitter_index[i] = -1;
+  }
+  KernelLightTreeEmitter *kemitters = dscene->light_tree_emitters.alloc(
+      num_emitters + infinite_emitters.size());
+  for (int i = 0; i < num_emitters + (int)infinite_emitters.size(); i++) {
+    const bool is_infinite = i >= num_emitters;
+    const LightTreeEmitter &emitter = is_infinite ? infinite_emitters[i - num_emitters] :
+                                                    emitters[i];
+    KernelLightTreeEmitter &kemitter = kemitters[i];
+    const KernelLightDistribution &kdistribution = distribution[emitter.distribution_id];
+    if (is_infinite) {
+      memset(&kemitter, 0, sizeof(kemitter));
+      kemitter.parent_index = -1;
+    }
+    else {
+      light_tree_pack_bounds(emitter.bbox,
+                             emitter.bcone,
+                             emitter.energy,
+                             kemitter.bounding_box_min,
+                             kemitter.bounding_box_max,
+                             kemitter.axis,
+                             &kemitter.theta_o,
+                             &kemitter.theta_e,
+                             &kemitter.energy);
+      kemitter.parent_index = emitter_leaf[i];
+    }
+    kemitter.distribution_id = emitter.distribution_id;
+    /* Probability of selecting the emitter from the light distribution. */
+    kemitter.pdf_flat = distribution[emitter.distribution_id + 1].totarea -
+                        kdistribution.totarea;
+    kemitter.pad = 0;
+
+    if (kdistribution.prim < 0) {
+      emitter_index[~kdistribution.prim] = i;
+    }
+    else {
+      const int object_id = kdistribution.mesh_light.object_id;
+      emitter_index[object_offset[object_id] + kdistribution.prim] = i;
+    }
+  }
+
+  kintegrator->use_light_tree = true;
+  kintegrator->num_light_tree_emitters = num_emitters;
+  kintegrator->num_light_tree_infinite = infinite_emitters.size();
+  kintegrator->pdf_light_tree = 1.0f - infinite_emitters.size() * kintegrator->pdf_lights;
+
+  VLOG(1) << "Light tree with " << nodes.size() << " nodes for " << num_emitters << " emitters.";
+
+  dscene->light_tree_nodes.copy_to_device();
+  dscene->light_tree_emitters.copy_to_device();
+  dscene->light_tree_emitter_index.copy_to_device();
+  dscene->light_tree_object_offset.copy_to_device();
+}
+
 static void background_cdf(
     int start, int end, int res_x, int res_y, const vector<float3> *pixels, float2 *cond_cdf)
 {
@@ -994,6 +1268,10 @@ void LightManager::device_update(Device *device,
   if (progress.get_cancel())
     return;
 
+  device_update_light_tree(device, dscene, scene, progress);
+  if (progress.get_cancel())
+    return;
+
   if (need_update_background) {
     device_update_background(device, dscene, scene, progress);
     if (progress.get_cancel())
@@ -1013,6 +1291,10 @@ void LightManager::device_update(Device *device,
 void LightManager::device_free(Device *, DeviceScene *dscene, const bool free_background)
 {
   dscene->light_distribution.free();
+  dscene->light_tree_nodes.free();
+  dscene->light_tree_emitters.free();
+  dscene->light_tree_emitter_index.free();
+  dscene->light_tree_object_offset.free();
   dscene->lights.free();
   if (free_background) {
     dscene->light_background_marginal_cdf.free();
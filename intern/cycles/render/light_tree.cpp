@@ -0,0 +1,236 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/light_tree.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+float OrientationBounds::calculate_measure() const
+{
+  const float theta_w = fminf(theta_o + theta_e, M_PI_F);
+  const float cos_theta_o = cosf(theta_o);
+  const float sin_theta_o = sinf(theta_o);
+
+  return M_2PI_F * (1.0f - cos_theta_o) +
+         M_PI_2_F * (2.0f * theta_w * sin_theta_o - cosf(theta_o - 2.0f * theta_w) -
+                     2.0f * theta_o * sin_theta_o + cos_theta_o);
+}
+
+OrientationBounds merge(const OrientationBounds &cone_a, const OrientationBounds &cone_b)
+{
+  if (cone_a.is_empty()) {
+    return cone_b;
+  }
+  if (cone_b.is_empty()) {
+    return cone_a;
+  }
+
+  /* Set cone a to the one with the larger angle. */
+  const OrientationBounds &a = (cone_a.theta_o >= cone_b.theta_o) ? cone_a : cone_b;
+  const OrientationBounds &b = (cone_a.theta_o >= cone_b.theta_o) ? cone_b : cone_a;
+
+  const float theta_d = safe_acosf(dot(a.axis, b.axis));
+  const float theta_e = fmaxf(a.theta_e, b.theta_e);
+
+  /* Cone a contains cone b. */
+  if (fminf(theta_d + b.theta_o, M_PI_F) <= a.theta_o) {
+    return OrientationBounds(a.axis, a.theta_o, theta_e);
+  }
+
+  /* The new cone touches both cones on opposite sides. */
+  const float theta_o = (a.theta_o + theta_d + b.theta_o) * 0.5f;
+  if (theta_o >= M_PI_F) {
+    return OrientationBounds(a.axis, M_PI_F, theta_e);
+  }
+
+  /* Rotate the axis of cone a towards the axis of cone b. */
+  const float3 ortho = b.axis - a.axis * dot(a.axis, b.axis);
+  const float ortho_length = len(ortho);
+  if (ortho_length < 1e-6f) {
+    /* The axes point in opposite directions. */
+    return OrientationBounds(a.axis, M_PI_F, theta_e);
+  }
+  const float theta_r = theta_o - a.theta_o;
+  const float3 axis = a.axis * cosf(theta_r) + (ortho / ortho_length) * sinf(theta_r);
+  return OrientationBounds(normalize(axis), theta_o, theta_e);
+}
+
+LightTree::LightTree(vector<LightTreeEmitter> &emitters, int max_emitters_in_leaf)
+    : max_emitters_in_leaf(max(max_emitters_in_leaf, 1))
+{
+  if (emitters.empty()) {
+    return;
+  }
+
+  nodes.reserve(2 * emitters.size() / this->max_emitters_in_leaf + 1);
+  build_recursive(emitters, 0, emitters.size(), -1);
+}
+
+int LightTree::build_recursive(vector<LightTreeEmitter> &emitters,
+                               int start,
+                               int end,
+                               int parent_index)
+{
+  const int node_index = nodes.size();
+  nodes.push_back(LightTreeNode());
+
+  BoundBox bbox = BoundBox::empty;
+  OrientationBounds bcone = OrientationBounds::empty;
+  float energy = 0.0f;
+  for (int i = start; i < end; i++) {
+    bbox.grow(emitters[i].bbox);
+    bcone = merge(bcone, emitters[i].bcone);
+    energy += emitters[i].energy;
+  }
+
+  const bool is_leaf = end - start <= max_emitters_in_leaf;
+  const int split_index = is_leaf ? start : split(emitters, start, end);
+
+  LightTreeNode &node = nodes[node_index];
+  node.bbox = bbox;
+  node.bcone = bcone;
+  node.energy = energy;
+  node.parent_index = parent_index;
+
+  if (is_leaf) {
+    node.child_index = start;
+    node.num_emitters = end - start;
+    return node_index;
+  }
+
+  /* The node vector can be reallocated while building the children. */
+  build_recursive(emitters, start, split_index, node_index);
+  const int right_index = build_recursive(emitters, split_index, end, node_index);
+  nodes[node_index].child_index = right_index;
+  nodes[node_index].num_emitters = 0;
+  return node_index;
+}
+
+int LightTree::split(vector<LightTreeEmitter> &emitters, int start, int end)
+{
+  const int num_buckets = 12;
+
+  BoundBox centroid_bbox = BoundBox::empty;
+  BoundBox bbox = BoundBox::empty;
+  for (int i = start; i < end; i++) {
+    centroid_bbox.grow(emitters[i].bbox.center());
+    bbox.grow(emitters[i].bbox);
+  }
+
+  const float3 centroid_extent = centroid_bbox.size();
+  const float3 extent = bbox.size();
+  const float max_extent = max3(extent);
+
+  /* Find the cheapest split with the surface area orientation heuristic. Splits along a short
+   * axis are penalized, so that the nodes don't get too thin. */
+  float min_cost = FLT_MAX;
+  int min_axis = -1;
+  int min_bucket = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    if (centroid_extent[axis] == 0.0f) {
+      continue;
+    }
+
+    struct Bucket {
+      BoundBox bbox = BoundBox::empty;
+      OrientationBounds bcone = OrientationBounds::empty;
+      float energy = 0.0f;
+      int count = 0;
+    } buckets[num_buckets];
+
+    const float inv_extent = num_buckets / centroid_extent[axis];
+    for (int i = start; i < end; i++) {
+      const float centroid = emitters[i].bbox.center()[axis];
+      const int bucket_index = clamp(
+          (int)((centroid - centroid_bbox.min[axis]) * inv_extent), 0, num_buckets - 1);
+      Bucket &bucket = buckets[bucket_index];
+      bucket.bbox.grow(emitters[i].bbox);
+      bucket.bcone = merge(bucket.bcone, emitters[i].bcone);
+      bucket.energy += emitters[i].energy;
+      bucket.count++;
+    }
+
+    /* Accumulate the buckets on the right side of every split from right to left. */
+    float right_costs[num_buckets];
+    Bucket right;
+    for (int b = num_buckets - 1; b > 0; b--) {
+      right.bbox.grow(buckets[b].bbox);
+      right.bcone = merge(right.bcone, buckets[b].bcone);
+      right.energy += buckets[b].energy;
+      right.count += buckets[b].count;
+      right_costs[b] = (right.count > 0) ? right.energy * right.bcone.calculate_measure() *
+                                               right.bbox.area() :
+                                           0.0f;
+    }
+
+    const float regularization = max_extent / extent[axis];
+    Bucket left;
+    for (int b = 0; b < num_buckets - 1; b++) {
+      left.bbox.grow(buckets[b].bbox);
+      left.bcone = merge(left.bcone, buckets[b].bcone);
+      left.energy += buckets[b].energy;
+      left.count += buckets[b].count;
+      if (left.count == 0 || left.count == end - start) {
+        continue;
+      }
+
+      const float left_cost = left.energy * left.bcone.calculate_measure() * left.bbox.area();
+      const float cost = regularization * (left_cost + right_costs[b + 1]);
+      if (cost < min_cost) {
+        min_cost = cost;
+        min_axis = axis;
+        min_bucket = b;
+      }
+    }
+  }
+
+  const int middle = (start + end) / 2;
+  if (min_axis < 0) {
+    /* All emitters are at the same place, split them in the middle so that the leaves don't get
+     * too large. */
+    return middle;
+  }
+
+  const float split_position = centroid_bbox.min[min_axis] +
+                               centroid_extent[min_axis] * (min_bucket + 1) / num_buckets;
+  auto begin = emitters.begin();
+  const int split_index = std::partition(begin + start,
+                                         begin + end,
+                                         [&](const LightTreeEmitter &emitter) {
+                                           const float centroid =
+                                               emitter.bbox.center()[min_axis];
+                                           return centroid < split_position;
+                                         }) -
+                          begin;
+
+  if (split_index == start || split_index == end) {
+    /* Can happen due to floating point precision, split at the median instead. */
+    std::nth_element(begin + start,
+                     begin + middle,
+                     begin + end,
+                     [&](const LightTreeEmitter &a, const LightTreeEmitter &b) {
+                       return a.bbox.center()[min_axis] < b.bbox.center()[min_axis];
+                     });
+    return middle;
+  }
+
+  return split_index;
+}
+
+CCL_NAMESPACE_END
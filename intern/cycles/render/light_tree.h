@@ -0,0 +1,106 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include "util/util_boundbox.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Bounds of the directions that light is emitted into. The normals of the emitters are in the
+ * cone with the angle theta_o around the axis, and the emission spreads theta_e beyond the
+ * normals. */
+struct OrientationBounds {
+  float3 axis;
+  float theta_o;
+  float theta_e;
+
+  enum empty_t { empty = 0 };
+
+  OrientationBounds() = default;
+  OrientationBounds(empty_t) : axis(make_float3(0.0f, 0.0f, 1.0f)), theta_o(-1.0f), theta_e(0.0f)
+  {
+  }
+  OrientationBounds(const float3 &axis, float theta_o, float theta_e)
+      : axis(axis), theta_o(theta_o), theta_e(theta_e)
+  {
+  }
+
+  bool is_empty() const
+  {
+    return theta_o < 0.0f;
+  }
+
+  /* Measure of the directions, used to compare how well groups of emitters are bounded. */
+  float calculate_measure() const;
+};
+
+OrientationBounds merge(const OrientationBounds &a, const OrientationBounds &b);
+
+/* A lamp or an emissive triangle. */
+struct LightTreeEmitter {
+  BoundBox bbox;
+  OrientationBounds bcone;
+  float energy;
+  /* Index in the light distribution. */
+  int distribution_id;
+};
+
+struct LightTreeNode {
+  BoundBox bbox;
+  OrientationBounds bcone;
+  float energy;
+  /* The first child of an inner node directly follows it, this is the index of the second child.
+   * For leaf nodes it is the index of the first emitter. */
+  int child_index;
+  /* Zero for inner nodes. */
+  int num_emitters;
+  int parent_index;
+
+  bool is_leaf() const
+  {
+    return num_emitters > 0;
+  }
+};
+
+/* Bounding volume hierarchy over emitters, for importance sampling of many lights. The tree is
+ * built top-down with the surface area orientation heuristic, which takes the energy and the
+ * orientation of the emitters into account in addition to their bounds. */
+class LightTree {
+ public:
+  /* The emitters are reordered so that the emitters of every leaf are next to each other. */
+  LightTree(vector<LightTreeEmitter> &emitters, int max_emitters_in_leaf = 8);
+
+  const vector<LightTreeNode> &get_nodes() const
+  {
+    return nodes;
+  }
+
+ protected:
+  int build_recursive(vector<LightTreeEmitter> &emitters, int start, int end, int parent_index);
+  /* Reorders the emitters and returns the index of the first emitter of the second child. */
+  int split(vector<LightTreeEmitter> &emitters, int start, int end);
+
+  vector<LightTreeNode> nodes;
+  int max_emitters_in_leaf;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __LIGHT_TREE_H__ */
@@ -393,6 +393,30 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
     }
   }
 
+  /* Images in the texture cache select the mipmap level with the derivatives of the UV map. */
+  int uv_attribute = ATTR_STD_NOT_FOUND;
+  if (compiler.scene->image_manager->use_texture_cache() && projection == NODE_IMAGE_PROJ_FLAT &&
+      tex_mapping.skip() && vector_in->link) {
+    ShaderNode *node = vector_in->link->parent;
+    if (node->type == UVMapNode::node_type) {
+      UVMapNode *uvmap = (UVMapNode *)node;
+      if (!uvmap->get_from_dupli()) {
+        uv_attribute = (uvmap->get_attribute() != "") ?
+                           compiler.attribute(uvmap->get_attribute()) :
+                           compiler.attribute(ATTR_STD_UV);
+      }
+    }
+    else if (node->type == TextureCoordinateNode::node_type) {
+      TextureCoordinateNode *texco = (TextureCoordinateNode *)node;
+      if (vector_in->link == node->output("UV") && !texco->get_from_dupli()) {
+        uv_attribute = compiler.attribute(ATTR_STD_UV);
+      }
+    }
+  }
+  if (uv_attribute != ATTR_STD_NOT_FOUND) {
+    flags |= NODE_IMAGE_DERIVATIVES;
+  }
+
   if (projection != NODE_IMAGE_PROJ_BOX) {
     /* If there only is one image (a very common case), we encode it as a negative value. */
     int num_nodes;
@@ -411,6 +435,10 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
                                              flags),
                       projection);
 
+    if (flags & NODE_IMAGE_DERIVATIVES) {
+      compiler.add_node(uv_attribute, 0, 0, 0);
+    }
+
     if (num_nodes > 0) {
       for (int i = 0; i < num_nodes; i++) {
         int4 node;
@@ -58,6 +58,9 @@ struct UpdateObjectTransformState {
   /* Motion offsets for each object. */
   array<uint> motion_offset;
 
+  /* Motion offsets differ from the previous update, decompose motion of all objects. */
+  bool motion_offset_modified;
+
   /* Packed object arrays. Those will be filled in. */
   uint *object_flag;
   KernelObject *objects;
@@ -207,6 +210,20 @@ void Object::apply_transform(bool apply_to_motion)
    * transform_applied boolean */
 }
 
+/* Tag the positions of the geometry as modified, so that they are packed again and the BVH is
+ * updated, without tagging everything as modified. */
+static void tag_geometry_positions_modified(Geometry *geometry)
+{
+  if (geometry->is_mesh() || geometry->is_volume()) {
+    Mesh *mesh = static_cast<Mesh *>(geometry);
+    mesh->tag_verts_modified();
+  }
+  else if (geometry->is_hair()) {
+    Hair *hair = static_cast<Hair *>(geometry);
+    hair->tag_curve_keys_modified();
+  }
+}
+
 void Object::tag_update(Scene *scene)
 {
   uint32_t flag = ObjectManager::UPDATE_NONE;
@@ -220,18 +237,16 @@ void Object::tag_update(Scene *scene)
   }
 
   if (geometry) {
-    if (tfm_is_modified()) {
-      /* tag the geometry as modified so the BVH is updated, but do not tag everything as modified
-       */
-      if (geometry->is_mesh() || geometry->is_volume()) {
-        Mesh *mesh = static_cast<Mesh *>(geometry);
-        mesh->tag_verts_modified();
-      }
-      else if (geometry->is_hair()) {
-        Hair *hair = static_cast<Hair *>(geometry);
-        hair->tag_curve_keys_modified();
+    if (!geometry->transform_applied) {
+      /* The geometry and its BVH are in object space, only the top level BVH needs to be rebuilt
+       * for the new transform. */
+      if (tfm_is_modified() || motion_is_modified()) {
+        flag |= ObjectManager::TRANSFORM_MODIFIED;
       }
     }
+    else if (tfm_is_modified()) {
+      tag_geometry_positions_modified(geometry);
+    }
 
     foreach (Node *node, geometry->get_used_shaders()) {
       Shader *shader = static_cast<Shader *>(node);
@@ -481,7 +496,8 @@ void ObjectManager::device_update_object_transform(UpdateObjectTransformState *s
       kobject.motion_offset = state->motion_offset[ob->index];
 
       /* Decompose transforms for interpolation. */
-      if (ob->tfm_is_modified() || update_all) {
+      if (ob->tfm_is_modified() || ob->motion_is_modified() || state->motion_offset_modified ||
+          update_all) {
         DecomposedTransform *decomp = state->object_motion + kobject.motion_offset;
         transform_motion_decompose(decomp, ob->motion.data(), ob->motion.size());
       }
@@ -539,6 +555,7 @@ void ObjectManager::device_update_transforms(DeviceScene *dscene, Scene *scene,
   state.have_curves = false;
   state.scene = scene;
   state.queue_start_object = 0;
+  state.motion_offset_modified = false;
 
   state.objects = dscene->objects.alloc(scene->objects.size());
   state.object_flag = dscene->object_flag.alloc(scene->objects.size());
@@ -564,9 +581,19 @@ void ObjectManager::device_update_transforms(DeviceScene *dscene, Scene *scene,
       motion_offset += ob->motion.size();
     }
 
+    /* Decomposed motion of unmodified objects is kept, unless it moved or the array is allocated
+     * again, which loses its contents. */
+    state.motion_offset_modified = (state.motion_offset != last_motion_offset) ||
+                                   (dscene->object_motion.size() != motion_offset);
+    last_motion_offset = state.motion_offset;
+
     state.object_motion = dscene->object_motion.alloc(motion_offset);
   }
 
+  if (state.need_motion != Scene::MOTION_BLUR) {
+    last_motion_offset.clear();
+  }
+
   /* Particle system device offsets
    * 0 is dummy particle, index starts at 1.
    */
@@ -895,6 +922,10 @@ void ObjectManager::apply_static_transforms(DeviceScene *dscene, Scene *scene, P
           object->apply_transform(apply_to_motion);
           geom->transform_applied = true;
 
+          /* The positions were changed in place, possibly in an update where only the object
+           * was tagged, e.g. when it stopped using motion blur or its geometry lost users. */
+          tag_geometry_positions_modified(geom);
+
           if (progress.get_cancel())
             return;
         }
@@ -923,6 +954,10 @@ void ObjectManager::tag_update(Scene *scene, uint32_t flag)
       geometry_flag |= (GeometryManager::GEOMETRY_ADDED | GeometryManager::GEOMETRY_REMOVED);
     }
 
+    if ((flag & TRANSFORM_MODIFIED) != 0) {
+      geometry_flag |= GeometryManager::TRANSFORM_MODIFIED;
+    }
+
     scene->geometry_manager->tag_update(scene, geometry_flag);
   }
 
@@ -133,6 +133,7 @@ class ObjectManager {
     OBJECT_REMOVED = (1 << 4),
     OBJECT_MODIFIED = (1 << 5),
     HOLDOUT_MODIFIED = (1 << 6),
+    TRANSFORM_MODIFIED = (1 << 7),
 
     /* tag everything in the manager for an update */
     UPDATE_ALL = ~0u,
@@ -174,6 +175,10 @@ class ObjectManager {
   bool device_update_object_transform_pop_work(UpdateObjectTransformState *state,
                                                int *start_index,
                                                int *num_objects);
+
+  /* Offsets into the object motion array of the last update, decomposed transforms only need
+   * to be computed again for all objects when these change. */
+  array<uint> last_motion_offset;
 };
 
 CCL_NAMESPACE_END
@@ -79,6 +79,10 @@ DeviceScene::DeviceScene(Device *device)
       lights(device, "__lights", MEM_GLOBAL),
       light_background_marginal_cdf(device, "__light_background_marginal_cdf", MEM_GLOBAL),
       light_background_conditional_cdf(device, "__light_background_conditional_cdf", MEM_GLOBAL),
+      light_tree_nodes(device, "__light_tree_nodes", MEM_GLOBAL),
+      light_tree_emitters(device, "__light_tree_emitters", MEM_GLOBAL),
+      light_tree_emitter_index(device, "__light_tree_emitter_index", MEM_GLOBAL),
+      light_tree_object_offset(device, "__light_tree_object_offset", MEM_GLOBAL),
       particles(device, "__particles", MEM_GLOBAL),
       svm_nodes(device, "__svm_nodes", MEM_GLOBAL),
       shaders(device, "__shaders", MEM_GLOBAL),
@@ -114,6 +118,8 @@ Scene::Scene(const SceneParams &params_, Device *device)
   object_manager = new ObjectManager();
   integrator = create_node<Integrator>();
   image_manager = new ImageManager(device->info);
+  image_manager->set_texture_cache(params.use_texture_cache,
+                                   (size_t)params.texture_cache_size * 1024 * 1024);
   particle_system_manager = new ParticleSystemManager();
   bake_manager = new BakeManager();
   procedural_manager = new ProceduralManager();
@@ -303,6 +303,10 @@ void Shader::set_graph(ShaderGraph *graph_)
   delete graph;
   graph = graph_;
 
+  /* The compiled nodes reference images and other data owned by nodes of the old graph. */
+  svm_nodes.clear();
+  svm_nodes_hash = "";
+
   /* Store info here before graph optimization to make sure that
    * nodes that get optimized away still count. */
   has_volume_connected = (graph->output()->input("Volume")->link != NULL);
@@ -28,6 +28,7 @@
 
 #include "graph/node.h"
 
+#include "util/util_array.h"
 #include "util/util_map.h"
 #include "util/util_param.h"
 #include "util/util_string.h"
@@ -130,6 +131,11 @@ class Shader : public Node {
   /* requested mesh attributes */
   AttributeRequestSet attributes;
 
+  /* SVM nodes of the last compilation, and a hash of the graph and settings they were compiled
+   * from. The nodes are used again as long as the hash does not change. */
+  array<int4> svm_nodes;
+  string svm_nodes_hash;
+
   /* determined before compiling */
   uint id;
   bool used;
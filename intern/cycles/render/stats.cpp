@@ -252,11 +252,53 @@ string ImageStats::full_report(int indent_level)
   return result;
 }
 
+/* BVH statistics. */
+
+NamedBVHEntry::NamedBVHEntry()
+    : name(""), sah_cost(0.0f), num_references(0), num_duplicated_references(0)
+{
+}
+
+NamedBVHEntry::NamedBVHEntry(const string &name,
+                             float sah_cost,
+                             size_t num_references,
+                             size_t num_duplicated_references)
+    : name(name),
+      sah_cost(sah_cost),
+      num_references(num_references),
+      num_duplicated_references(num_duplicated_references)
+{
+}
+
+BVHStats::BVHStats()
+{
+}
+
+string BVHStats::full_report(int indent_level)
+{
+  const string indent(indent_level * kIndentNumSpaces, ' ');
+  const string double_indent = indent + indent;
+  string result = "";
+  result += indent + "Build phases:\n" + times.full_report(indent_level + 1);
+  result += indent + "Trees:\n";
+  foreach (const NamedBVHEntry &entry, entries) {
+    result += string_printf("%s%-32s SAH cost %.2f, references %s (%s duplicated)\n",
+                            double_indent.c_str(),
+                            entry.name.c_str(),
+                            (double)entry.sah_cost,
+                            string_human_readable_number(entry.num_references).c_str(),
+                            string_human_readable_number(entry.num_duplicated_references).c_str());
+  }
+  return result;
+}
+
 /* Overall statistics. */
 
 RenderStats::RenderStats()
 {
   has_profiling = false;
+  shader_evals = 0;
+  shader_switches = 0;
 }
 
 void RenderStats::collect_profiling(Scene *scene, Profiler &prof)
@@ -312,6 +354,8 @@ void RenderStats::collect_profiling(Scene *scene, Profiler &prof)
   prefilter.add_entry("Detect Outliers", prof.get_event(PROFILING_DENOISING_DETECT_OUTLIERS));
   prefilter.add_entry("Combine Halves", prof.get_event(PROFILING_DENOISING_COMBINE_HALVES));
 
+  prof.get_shader_switches(shader_evals, shader_switches);
+
   shaders.entries.clear();
   foreach (Shader *shader, scene->shaders) {
     uint64_t samples, hits;
@@ -334,9 +378,17 @@ string RenderStats::full_report()
   string result = "";
   result += "Mesh statistics:\n" + mesh.full_report(1);
   result += "Image statistics:\n" + image.full_report(1);
+  result += "BVH statistics:\n" + bvh.full_report(1);
   if (has_profiling) {
     result += "Kernel statistics:\n" + kernel.full_report(1);
     result += "Shader statistics:\n" + shaders.full_report(1);
+    if (shader_evals != 0) {
+      result += string_printf("  %-32s: %s (%.1f%% of %s surface hits)\n",
+                              "Shader switches",
+                              string_human_readable_number(shader_switches).c_str(),
+                              100.0 * shader_switches / shader_evals,
+                              string_human_readable_number(shader_evals).c_str());
+    }
     result += "Object statistics:\n" + objects.full_report(1);
   }
   else {
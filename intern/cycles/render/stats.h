@@ -77,10 +77,17 @@ class NamedTimeStats {
  public:
   NamedTimeStats();
 
-  /* Add entry to the statistics. */
+  /* Add entry to the statistics. Time of entries with the same name is accumulated, for stages
+   * that run more than once during an update. */
   void add_entry(const NamedTimeEntry &entry)
   {
     total_time += entry.time;
+    for (NamedTimeEntry &existing_entry : entries) {
+      if (existing_entry.name == entry.name) {
+        existing_entry.time += entry.time;
+        return;
+      }
+    }
     entries.push_back(entry);
   }
 
@@ -173,6 +180,33 @@ class ImageStats {
   NamedSizeStats textures;
 };
 
+/* Statistics of a single built BVH. */
+class NamedBVHEntry {
+ public:
+  NamedBVHEntry();
+  NamedBVHEntry(const string &name,
+                float sah_cost,
+                size_t num_references,
+                size_t num_duplicated_references);
+
+  string name;
+  float sah_cost;
+  size_t num_references;
+  size_t num_duplicated_references;
+};
+
+/* Statistics about BVH builds, with time spent in each build phase summed over all BVHs. */
+class BVHStats {
+ public:
+  BVHStats();
+
+  /* Generate full human-readable report. */
+  string full_report(int indent_level = 0);
+
+  NamedTimeStats times;
+  vector<NamedBVHEntry> entries;
+};
+
 /* Render process statistics. */
 class RenderStats {
  public:
@@ -186,8 +220,14 @@ class RenderStats {
 
   bool has_profiling;
 
+  /* Shader evaluations for surface hits, and how many of them switched to a different shader
+   * than the previous one on the same thread. */
+  uint64_t shader_evals;
+  uint64_t shader_switches;
+
   MeshStats mesh;
   ImageStats image;
+  BVHStats bvh;
   NamedNestedSampleStats kernel;
   NamedSampleCountStats shaders;
   NamedSampleCountStats objects;
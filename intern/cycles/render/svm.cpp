@@ -18,6 +18,8 @@
 
 #include "render/background.h"
 #include "render/graph.h"
+#include "render/image.h"
+#include "render/integrator.h"
 #include "render/light.h"
 #include "render/mesh.h"
 #include "render/nodes.h"
@@ -28,6 +30,7 @@
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_md5.h"
 #include "util/util_progress.h"
 #include "util/util_task.h"
 
@@ -47,22 +50,67 @@ void SVMShaderManager::reset(Scene * /*scene*/)
 {
 }
 
+/* Hash of everything that the compiled nodes of the shader depend on, or an empty string when
+ * the nodes can't be reused. */
+static string svm_nodes_hash(Scene *scene, Shader *shader, bool background)
+{
+  foreach (ShaderNode *node, shader->graph->nodes) {
+    if (node->special_type == SHADER_SPECIAL_TYPE_OUTPUT_AOV) {
+      /* The offsets of AOVs depend on the passes of the film. */
+      return "";
+    }
+  }
+
+  MD5Hash md5;
+  shader->hash(md5);
+  shader->graph->hash(md5);
+  md5.append((uint8_t *)&shader->used, sizeof(shader->used));
+  md5.append((uint8_t *)&background, sizeof(background));
+
+  /* Scene settings that nodes read while compiling. */
+  const bool use_texture_cache = scene->image_manager->use_texture_cache();
+  md5.append((uint8_t *)&use_texture_cache, sizeof(use_texture_cache));
+  md5.append((uint8_t *)&scene->params.background, sizeof(scene->params.background));
+
+  if (shader->has_integrator_dependency) {
+    scene->integrator->hash(md5);
+  }
+  return md5.get_hex();
+}
+
 void SVMShaderManager::device_update_shader(Scene *scene,
                                             Shader *shader,
                                             Progress *progress,
-                                            array<int4> *svm_nodes)
+                                            array<int4> *svm_nodes,
+                                            int *r_compiled)
 {
+  *r_compiled = false;
   if (progress->get_cancel()) {
     return;
   }
   assert(shader->graph);
 
+  const bool background = (shader == scene->background->get_shader(scene));
+
+  /* Reuse the nodes of the last compilation when nothing changed. The graph has been finalized
+   * then, so the simplification passes don't have to run again either. */
+  if (!shader->svm_nodes_hash.empty() &&
+      shader->svm_nodes_hash == svm_nodes_hash(scene, shader, background)) {
+    *svm_nodes = shader->svm_nodes;
+    return;
+  }
+
   svm_nodes->push_back_slow(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
 
   SVMCompiler::Summary summary;
   SVMCompiler compiler(scene);
-  compiler.background = (shader == scene->background->get_shader(scene));
+  compiler.background = background;
   compiler.compile(shader, *svm_nodes, 0, &summary);
+  *r_compiled = true;
+
+  /* The hash is computed after compiling, because compiling finalizes the graph. */
+  shader->svm_nodes = *svm_nodes;
+  shader->svm_nodes_hash = svm_nodes_hash(scene, shader, background);
 
   VLOG(2) << "Compilation summary:\n"
           << "Shader name: " << shader->name << "\n"
@@ -95,13 +143,16 @@ void SVMShaderManager::device_update(Device *device,
   /* Build all shaders. */
   TaskPool task_pool;
   vector<array<int4>> shader_svm_nodes(num_shaders);
+  /* Not a vector of bool, so that the values can be written from different threads. */
+  vector<int> shader_compiled(num_shaders, 0);
   for (int i = 0; i < num_shaders; i++) {
     task_pool.push(function_bind(&SVMShaderManager::device_update_shader,
                                  this,
                                  scene,
                                  scene->shaders[i],
                                  &progress,
-                                 &shader_svm_nodes[i]));
+                                 &shader_svm_nodes[i],
+                                 &shader_compiled[i]));
   }
   task_pool.wait_work();
 
@@ -109,6 +160,8 @@ void SVMShaderManager::device_update(Device *device,
     return;
   }
 
+  int num_compiled_shaders = 0;
+
   /* The global node list contains a jump table (one node per shader)
    * followed by the nodes of all shaders. */
   int svm_nodes_size = num_shaders;
@@ -124,8 +177,11 @@ void SVMShaderManager::device_update(Device *device,
     Shader *shader = scene->shaders[i];
 
     shader->clear_modified();
-    if (shader->get_use_mis() && shader->has_surface_emission) {
-      scene->light_manager->tag_update(scene, LightManager::SHADER_COMPILED);
+    if (shader_compiled[i]) {
+      num_compiled_shaders++;
+      if (shader->get_use_mis() && shader->has_surface_emission) {
+        scene->light_manager->tag_update(scene, LightManager::SHADER_COMPILED);
+      }
     }
 
     /* Update the global jump table.
@@ -161,8 +217,8 @@ void SVMShaderManager::device_update(Device *device,
 
   update_flags = UPDATE_NONE;
 
-  VLOG(1) << "Shader manager updated " << num_shaders << " shaders in " << time_dt() - start_time
-          << " seconds.";
+  VLOG(1) << "Shader manager updated " << num_shaders << " shaders (" << num_compiled_shaders
+          << " compiled) in " << time_dt() - start_time << " seconds.";
 }
 
 void SVMShaderManager::device_free(Device *device, DeviceScene *dscene, Scene *scene)
@@ -53,7 +53,8 @@ class SVMShaderManager : public ShaderManager {
   void device_update_shader(Scene *scene,
                             Shader *shader,
                             Progress *progress,
-                            array<int4> *svm_nodes);
+                            array<int4> *svm_nodes,
+                            int *r_compiled);
 };
 
 /* Graph Compiler */
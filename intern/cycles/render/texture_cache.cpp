@@ -0,0 +1,1054 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/texture_cache.h"
+#include "render/colorspace.h"
+#include "render/image.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_foreach.h"
+#include "util/util_image.h"
+#include "util/util_logging.h"
+#include "util/util_math.h"
+#include "util/util_path.h"
+
+#include <OpenImageIO/filesystem.h>
+
+CCL_NAMESPACE_BEGIN
+
+/* Tile size for images that are not tiled in the file. */
+static const int TEXTURE_CACHE_TILE_SIZE = 64;
+/* Maximum number of files that are kept open for reading tiles. */
+static const int TEXTURE_CACHE_MAX_OPEN_FILES = 256;
+/* Added to the users of a slot while its tile is being evicted. */
+static const int TEXTURE_CACHE_EVICTING = 1 << 30;
+
+/* Convert pixels to the layout of the cache and to scene linear color, in the same way as
+ * images that are fully loaded by the image manager. */
+template<typename T>
+static void texture_cache_convert_pixels(const T *in_pixels,
+                                         const int in_channels,
+                                         const int in_stride,
+                                         T *pixels,
+                                         const int channels,
+                                         const int width,
+                                         const int height,
+                                         const int stride,
+                                         const ImageAlphaType alpha_type,
+                                         const ustring colorspace,
+                                         const bool compress_as_srgb)
+{
+  const T one = util_image_cast_from_float<T>(1.0f);
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      const T *in = in_pixels + ((size_t)y * in_stride + x) * in_channels;
+      T *out = pixels + ((size_t)y * stride + x) * channels;
+
+      if (channels == 1) {
+        out[0] = in[0];
+      }
+      else if (in_channels == 1) {
+        out[0] = out[1] = out[2] = in[0];
+        out[3] = one;
+      }
+      else if (in_channels == 2) {
+        out[0] = out[1] = out[2] = in[0];
+        out[3] = in[1];
+      }
+      else {
+        out[0] = in[0];
+        out[1] = in[1];
+        out[2] = in[2];
+        out[3] = (in_channels == 3) ? one : in[3];
+      }
+
+      if (channels == 4 && alpha_type == IMAGE_ALPHA_IGNORE) {
+        out[3] = one;
+      }
+    }
+  }
+
+  if (channels == 4 && colorspace != u_colorspace_raw && colorspace != u_colorspace_srgb) {
+    for (int y = 0; y < height; y++) {
+      ColorSpaceManager::to_scene_linear(
+          colorspace, pixels + (size_t)y * stride * channels, width, compress_as_srgb);
+    }
+  }
+}
+
+/* Make sure we don't have buggy values, like the image manager does. */
+static void texture_cache_remove_nan(float *pixels, const int channels, const size_t num_pixels)
+{
+  for (size_t i = 0; i < num_pixels; i++) {
+    float *pixel = pixels + i * channels;
+    bool is_finite = true;
+    for (int c = 0; c < channels; c++) {
+      is_finite = is_finite && isfinite(pixel[c]);
+    }
+    if (!is_finite) {
+      for (int c = 0; c < channels; c++) {
+        pixel[c] = 0.0f;
+      }
+    }
+  }
+}
+
+/* Box filter the level to half the resolution. */
+template<typename T>
+static void texture_cache_downsample(const vector<T> &pixels,
+                                     const int width,
+                                     const int height,
+                                     const int channels,
+                                     vector<T> &half_pixels,
+                                     const int half_width,
+                                     const int half_height)
+{
+  half_pixels.resize((size_t)half_width * half_height * channels);
+
+  for (int y = 0; y < half_height; y++) {
+    const int y0 = min(2 * y, height - 1);
+    const int y1 = min(2 * y + 1, height - 1);
+    for (int x = 0; x < half_width; x++) {
+      const int x0 = min(2 * x, width - 1);
+      const int x1 = min(2 * x + 1, width - 1);
+      for (int c = 0; c < channels; c++) {
+        const T *row0 = pixels.data() + (size_t)y0 * width * channels;
+        const T *row1 = pixels.data() + (size_t)y1 * width * channels;
+        const float sum = util_image_cast_to_float(row0[x0 * channels + c]) +
+                          util_image_cast_to_float(row0[x1 * channels + c]) +
+                          util_image_cast_to_float(row1[x0 * channels + c]) +
+                          util_image_cast_to_float(row1[x1 * channels + c]);
+        half_pixels[((size_t)y * half_width + x) * channels + c] = util_image_cast_from_float<T>(
+            0.25f * sum);
+      }
+    }
+  }
+}
+
+static inline float texture_cache_frac(const float x, int *ix)
+{
+  const float f = floorf(x);
+  *ix = (int)f;
+  return x - f;
+}
+
+/* Texture Cache Image */
+
+TextureCacheImage::TextureCacheImage(TextureCache *cache) : cache(cache), file(NULL)
+{
+}
+
+TextureCacheImage::~TextureCacheImage()
+{
+  foreach (TextureCacheLevel &level, levels) {
+    for (int i = 0; i < level.tiles_x * level.tiles_y; i++) {
+      TextureCacheTile *tile = level.slots[i].tile.load();
+      if (tile) {
+        delete tile;
+      }
+    }
+  }
+  close_file();
+  if (is_converted) {
+    path_remove(tile_filepath);
+  }
+}
+
+void TextureCacheImage::close_file() const
+{
+  if (file) {
+    ImageInput *in = (ImageInput *)file;
+    in->close();
+    delete in;
+    file = NULL;
+  }
+}
+
+TextureCacheTile *TextureCacheImage::create_tile(const int level_index,
+                                                 const int tile_x,
+                                                 const int tile_y) const
+{
+  const TextureCacheLevel &level = levels[level_index];
+  TextureCacheTile *tile = new TextureCacheTile();
+  tile->width = min(tile_size, level.width - tile_x * tile_size);
+  tile->height = min(tile_size, level.height - tile_y * tile_size);
+  tile->memory_size = (size_t)tile->width * tile->height * channels *
+                      (is_float ? sizeof(float) : sizeof(uchar));
+  tile->pixels.resize(tile->memory_size);
+  tile->used = false;
+  tile->slot = NULL;
+  tile->clock_prev = NULL;
+  tile->clock_next = NULL;
+  return tile;
+}
+
+void TextureCacheImage::fill_missing_tile(TextureCacheTile *tile) const
+{
+  const float missing[4] = {
+      TEX_IMAGE_MISSING_R, TEX_IMAGE_MISSING_G, TEX_IMAGE_MISSING_B, TEX_IMAGE_MISSING_A};
+  const size_t num_pixels = (size_t)tile->width * tile->height;
+  for (size_t i = 0; i < num_pixels; i++) {
+    for (int c = 0; c < channels; c++) {
+      if (is_float) {
+        ((float *)tile->pixels.data())[i * channels + c] = missing[c];
+      }
+      else {
+        tile->pixels[i * channels + c] = util_image_cast_from_float<uchar>(missing[c]);
+      }
+    }
+  }
+}
+
+bool TextureCacheImage::insert_tile(const int level_index,
+                                    const int tile_x,
+                                    const int tile_y,
+                                    TextureCacheTile *tile) const
+{
+  const TextureCacheLevel &level = levels[level_index];
+  TextureCacheSlot &slot = level.slots[tile_x + tile_y * level.tiles_x];
+  if (slot.tile.load()) {
+    delete tile;
+    return false;
+  }
+
+  tile->used = true;
+  tile->slot = &slot;
+  slot.tile.store(tile);
+  if (use_file_tiles) {
+    cache->clock_insert(tile);
+    cache->memory_used += tile->memory_size;
+  }
+  else {
+    cache->memory_generated += tile->memory_size;
+  }
+  cache->tiles_loaded++;
+  return true;
+}
+
+template<typename T>
+static bool texture_cache_read_file_tile(ImageInput *in,
+                                         const TypeDesc::BASETYPE format,
+                                         const int level_index,
+                                         const int x,
+                                         const int y,
+                                         const int width,
+                                         const int height,
+                                         vector<T> &pixels,
+                                         int &channels)
+{
+  ImageSpec spec;
+  if (!in->seek_subimage(0, level_index, spec)) {
+    return false;
+  }
+
+  channels = spec.nchannels;
+  pixels.resize((size_t)width * height * channels);
+  return in->read_tiles(x, x + width, y, y + height, 0, 1, format, pixels.data());
+}
+
+bool TextureCacheImage::read_file_tile(const int level_index,
+                                       TextureCacheTile *tile,
+                                       const int tile_x,
+                                       const int tile_y) const
+{
+  ImageInput *in = (ImageInput *)file;
+  const int x = tile_x * tile_size;
+  const int y = tile_y * tile_size;
+
+  if (is_converted) {
+    /* The file was written by the cache, in its layout. */
+    ImageSpec spec;
+    return in->seek_subimage(0, level_index, spec) &&
+           in->read_tiles(x,
+                          x + tile->width,
+                          y,
+                          y + tile->height,
+                          0,
+                          1,
+                          is_float ? TypeDesc::FLOAT : TypeDesc::UINT8,
+                          tile->pixels.data());
+  }
+
+  /* Read all channels of the tile, and convert them to the layout of the cache. */
+  int file_channels;
+
+  if (is_float) {
+    vector<float> file_pixels;
+    if (!texture_cache_read_file_tile(in,
+                                      TypeDesc::FLOAT,
+                                      level_index,
+                                      x,
+                                      y,
+                                      tile->width,
+                                      tile->height,
+                                      file_pixels,
+                                      file_channels)) {
+      return false;
+    }
+    texture_cache_convert_pixels(file_pixels.data(),
+                                 file_channels,
+                                 tile->width,
+                                 (float *)tile->pixels.data(),
+                                 channels,
+                                 tile->width,
+                                 tile->height,
+                                 tile->width,
+                                 alpha_type,
+                                 metadata->colorspace,
+                                 metadata->compress_as_srgb);
+    texture_cache_remove_nan(
+        (float *)tile->pixels.data(), channels, (size_t)tile->width * tile->height);
+  }
+  else {
+    vector<uchar> file_pixels;
+    if (!texture_cache_read_file_tile(in,
+                                      TypeDesc::UINT8,
+                                      level_index,
+                                      x,
+                                      y,
+                                      tile->width,
+                                      tile->height,
+                                      file_pixels,
+                                      file_channels)) {
+      return false;
+    }
+    texture_cache_convert_pixels(file_pixels.data(),
+                                 file_channels,
+                                 tile->width,
+                                 tile->pixels.data(),
+                                 channels,
+                                 tile->width,
+                                 tile->height,
+                                 tile->width,
+                                 alpha_type,
+                                 metadata->colorspace,
+                                 metadata->compress_as_srgb);
+  }
+
+  return true;
+}
+
+void TextureCacheImage::load_file_tile(const int level_index,
+                                       const int tile_x,
+                                       const int tile_y) const
+{
+  if (!file) {
+    unique_ptr<ImageInput> in(ImageInput::create(tile_filepath));
+    if (in) {
+      ImageSpec spec;
+      ImageSpec config;
+      if (!associate_alpha || is_converted) {
+        config.attribute("oiio:UnassociatedAlpha", 1);
+      }
+      if (in->open(tile_filepath, spec, config)) {
+        file = in.release();
+        cache->file_opened(this);
+      }
+    }
+  }
+
+  TextureCacheTile *tile = create_tile(level_index, tile_x, tile_y);
+  if (!(file && read_file_tile(level_index, tile, tile_x, tile_y))) {
+    VLOG(1) << "Failed to read tile of texture " << filepath.string() << ".";
+    fill_missing_tile(tile);
+  }
+
+  insert_tile(level_index, tile_x, tile_y, tile);
+}
+
+/* Convert an image that is not tiled to a tiled and mipmapped file, so that its tiles can be read
+ * and evicted like those of tiled files. This is the only time the full image is loaded. */
+template<typename T> void TextureCacheImage::convert_image() const
+{
+  vector<T> pixels;
+  if (!load_full_image(pixels)) {
+    generate_missing_tiles();
+    return;
+  }
+
+  if (write_tiled_file(pixels)) {
+    use_file_tiles = true;
+    is_converted = true;
+    return;
+  }
+
+  VLOG(1) << "Failed to write tiled file for texture " << loader->name()
+          << ", keeping all of its tiles in memory.";
+  generate_tiles(pixels);
+}
+
+/* Load the full image in the layout of the cache, with the first row at the top. */
+template<typename T> bool TextureCacheImage::load_full_image(vector<T> &pixels) const
+{
+  const TextureCacheLevel &first = levels[0];
+  const int width = first.width;
+  const int height = first.height;
+  const size_t num_pixels = (size_t)width * height;
+
+  /* Load the full image, with 4 values per pixel as in the image manager. */
+  ImageMetaData load_metadata = *metadata;
+  if (is_float) {
+    load_metadata.type = (channels == 4) ? IMAGE_DATA_TYPE_FLOAT4 : IMAGE_DATA_TYPE_FLOAT;
+  }
+  vector<T> file_pixels(num_pixels * 4);
+  const int file_channels = min(metadata->channels, 4);
+  if (!loader->load_pixels(
+          load_metadata, file_pixels.data(), num_pixels * metadata->channels, associate_alpha)) {
+    return false;
+  }
+
+  /* Images are loaded with the first row at the bottom, the cache uses the order of the files,
+   * so that tiles can be read from the file directly. */
+  pixels.resize(num_pixels * channels);
+  for (int y = 0; y < height; y++) {
+    texture_cache_convert_pixels<T>(file_pixels.data() + (size_t)(height - 1 - y) * width *
+                                                             file_channels,
+                                    file_channels,
+                                    width,
+                                    pixels.data() + (size_t)y * width * channels,
+                                    channels,
+                                    width,
+                                    1,
+                                    width,
+                                    alpha_type,
+                                    metadata->colorspace,
+                                    metadata->compress_as_srgb);
+  }
+  file_pixels.clear();
+  file_pixels.shrink_to_fit();
+
+  if (is_float) {
+    texture_cache_remove_nan((float *)pixels.data(), channels, num_pixels);
+  }
+  return true;
+}
+
+/* Write the levels to a file in the temporary directory. Only the level that is written and the
+ * one it is downsampled from are in memory besides the full image. */
+template<typename T> bool TextureCacheImage::write_tiled_file(const vector<T> &pixels) const
+{
+  const string filepath = path_join(
+      OIIO::Filesystem::temp_directory_path(),
+      OIIO::Filesystem::unique_path("cycles-texture-%%%%-%%%%-%%%%-%%%%.tif"));
+  unique_ptr<ImageOutput> out(ImageOutput::create(filepath));
+  if (!out || !out->supports("tiles") || !out->supports("mipmap")) {
+    return false;
+  }
+
+  const TypeDesc format = is_float ? TypeDesc::FLOAT : TypeDesc::UINT8;
+  ImageSpec spec(levels[0].width, levels[0].height, channels, format);
+  spec.tile_width = tile_size;
+  spec.tile_height = tile_size;
+
+  vector<T> level_pixels, next_level_pixels;
+  ImageOutput::OpenMode mode = ImageOutput::Create;
+  bool success = true;
+  for (int level_index = 0; success && level_index < (int)levels.size(); level_index++) {
+    const TextureCacheLevel &level = levels[level_index];
+    if (level_index > 0) {
+      const TextureCacheLevel &previous = levels[level_index - 1];
+      texture_cache_downsample((level_index == 1) ? pixels : level_pixels,
+                               previous.width,
+                               previous.height,
+                               channels,
+                               next_level_pixels,
+                               level.width,
+                               level.height);
+      level_pixels.swap(next_level_pixels);
+    }
+
+    spec.width = spec.full_width = level.width;
+    spec.height = spec.full_height = level.height;
+    success = out->open(filepath, spec, mode) &&
+              out->write_image(format, (level_index == 0) ? pixels.data() : level_pixels.data());
+    mode = ImageOutput::AppendMIPLevel;
+  }
+  success = out->close() && success;
+
+  if (!success) {
+    path_remove(filepath);
+    return false;
+  }
+  tile_filepath = filepath;
+  return true;
+}
+
+/* Generate the tiles of all levels in memory. The tiles are not evicted, since all of them would
+ * have to be generated again for a missing tile. */
+template<typename T> void TextureCacheImage::generate_tiles(vector<T> &pixels) const
+{
+  for (int level_index = 0; level_index < (int)levels.size(); level_index++) {
+    const TextureCacheLevel &level = levels[level_index];
+
+    if (level_index > 0) {
+      const TextureCacheLevel &previous = levels[level_index - 1];
+      vector<T> level_pixels;
+      texture_cache_downsample(pixels,
+                               previous.width,
+                               previous.height,
+                               channels,
+                               level_pixels,
+                               level.width,
+                               level.height);
+      pixels.swap(level_pixels);
+    }
+
+    if (level_index < first_level) {
+      continue;
+    }
+
+    for (int tile_y = 0; tile_y < level.tiles_y; tile_y++) {
+      for (int tile_x = 0; tile_x < level.tiles_x; tile_x++) {
+        TextureCacheTile *tile = create_tile(level_index, tile_x, tile_y);
+        T *tile_pixels = (T *)tile->pixels.data();
+        for (int y = 0; y < tile->height; y++) {
+          const T *row = pixels.data() + ((size_t)(tile_y * tile_size + y) * level.width +
+                                          tile_x * tile_size) *
+                                             channels;
+          std::copy(row, row + tile->width * channels, tile_pixels + y * tile->width * channels);
+        }
+        insert_tile(level_index, tile_x, tile_y, tile);
+      }
+    }
+  }
+}
+
+void TextureCacheImage::generate_missing_tiles() const
+{
+  for (int level_index = first_level; level_index < (int)levels.size(); level_index++) {
+    const TextureCacheLevel &level = levels[level_index];
+    for (int tile_y = 0; tile_y < level.tiles_y; tile_y++) {
+      for (int tile_x = 0; tile_x < level.tiles_x; tile_x++) {
+        TextureCacheTile *tile = create_tile(level_index, tile_x, tile_y);
+        fill_missing_tile(tile);
+        insert_tile(level_index, tile_x, tile_y, tile);
+      }
+    }
+  }
+}
+
+void TextureCacheImage::load_tile(const int level_index, const int tile_x, const int tile_y) const
+{
+  {
+    thread_scoped_lock lock(mutex);
+
+    const TextureCacheLevel &level = levels[level_index];
+    if (level.slots[tile_x + tile_y * level.tiles_x].tile.load()) {
+      /* Loaded by another thread in the meantime. */
+      return;
+    }
+
+    if (!use_file_tiles) {
+      /* Only happens the first time, generated tiles are never evicted. */
+      if (is_float) {
+        convert_image<float>();
+      }
+      else {
+        convert_image<uchar>();
+      }
+    }
+
+    if (use_file_tiles) {
+      load_file_tile(level_index, tile_x, tile_y);
+    }
+  }
+
+  cache->evict();
+}
+
+/* Texture Cache Fetch */
+
+TextureCacheFetch::TextureCacheFetch(const TextureCacheImage &image)
+    : image(image), slot(NULL), tile(NULL), level_index(-1), tile_x(0), tile_y(0)
+{
+}
+
+TextureCacheFetch::~TextureCacheFetch()
+{
+  release();
+}
+
+float4 TextureCacheFetch::read(const int level_index, int x, int y)
+{
+  const TextureCacheLevel &level = image.levels[level_index];
+
+  if (image.extension == EXTENSION_REPEAT) {
+    x %= level.width;
+    x = (x < 0) ? x + level.width : x;
+    y %= level.height;
+    y = (y < 0) ? y + level.height : y;
+  }
+  else {
+    x = clamp(x, 0, level.width - 1);
+    y = clamp(y, 0, level.height - 1);
+  }
+
+  const int tile_size = image.tile_size;
+  const int x_tile = x / tile_size;
+  const int y_tile = y / tile_size;
+  if (level_index != this->level_index || x_tile != tile_x || y_tile != tile_y) {
+    acquire(level_index, x_tile, y_tile);
+  }
+
+  const size_t index = ((size_t)(y - y_tile * tile_size) * tile->width +
+                        (x - x_tile * tile_size)) *
+                       image.channels;
+  if (image.is_float) {
+    const float *pixel = (const float *)tile->pixels.data() + index;
+    return (image.channels == 1) ? make_float4(pixel[0], pixel[0], pixel[0], 1.0f) :
+                                   make_float4(pixel[0], pixel[1], pixel[2], pixel[3]);
+  }
+
+  const uchar *pixel = tile->pixels.data() + index;
+  const float f = 1.0f / 255.0f;
+  return (image.channels == 1) ?
+             make_float4(pixel[0] * f, pixel[0] * f, pixel[0] * f, 1.0f) :
+             make_float4(pixel[0] * f, pixel[1] * f, pixel[2] * f, pixel[3] * f);
+}
+
+void TextureCacheFetch::acquire(const int level_index, const int x_tile, const int y_tile)
+{
+  release();
+
+  const TextureCacheLevel &level = image.levels[level_index];
+  slot = &level.slots[x_tile + y_tile * level.tiles_x];
+
+  while (true) {
+    if (slot->users.fetch_add(1) < 0) {
+      /* The tile is being evicted, which only takes a moment. */
+      slot->users.fetch_sub(1);
+      std::this_thread::yield();
+      continue;
+    }
+
+    tile = slot->tile.load();
+    if (tile) {
+      break;
+    }
+
+    image.load_tile(level_index, x_tile, y_tile);
+    tile = slot->tile.load();
+    if (tile) {
+      break;
+    }
+    slot->users.fetch_sub(1);
+  }
+
+  if (!tile->used.load(std::memory_order_relaxed)) {
+    tile->used.store(true, std::memory_order_relaxed);
+  }
+
+  this->level_index = level_index;
+  tile_x = x_tile;
+  tile_y = y_tile;
+}
+
+void TextureCacheFetch::release()
+{
+  if (slot) {
+    slot->users.fetch_sub(1);
+    slot = NULL;
+    tile = NULL;
+    level_index = -1;
+  }
+}
+
+/* Texture Cache Image Lookup */
+
+void TextureCacheImage::lookup(
+    float x, float y, const float2 dx, const float2 dy, float result[4]) const
+{
+  const float4 r = lookup_mipmap(x, y, dx, dy);
+  result[0] = r.x;
+  result[1] = r.y;
+  result[2] = r.z;
+  result[3] = r.w;
+}
+
+float4 TextureCacheImage::lookup_mipmap(float x,
+                                        float y,
+                                        const float2 dx,
+                                        const float2 dy) const
+{
+  if (extension == EXTENSION_CLIP) {
+    if (x < 0.0f || y < 0.0f || x > 1.0f || y > 1.0f) {
+      return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+  }
+
+  /* The cache stores the first row at the top. */
+  y = 1.0f - y;
+
+  /* Select the level where the footprint of the lookup is about one pixel. */
+  const TextureCacheLevel &level0 = levels[0];
+  const float width_x = len(make_float2(dx.x * level0.width, dx.y * level0.height));
+  const float width_y = len(make_float2(dy.x * level0.width, dy.y * level0.height));
+  const float footprint = max(width_x, width_y);
+  const int num_levels = levels.size();
+  const float lod = clamp(
+      (footprint > 1.0f) ? log2f(footprint) : 0.0f, (float)first_level, (float)(num_levels - 1));
+
+  TextureCacheFetch fetch(*this);
+
+  if (interpolation == INTERPOLATION_CLOSEST) {
+    const int level_index = min(float_to_int(lod + 0.5f), num_levels - 1);
+    const TextureCacheLevel &level = levels[level_index];
+    int ix, iy;
+    texture_cache_frac(x * level.width, &ix);
+    texture_cache_frac(y * level.height, &iy);
+    return fetch.read(level_index, ix, iy);
+  }
+
+  /* Trilinear interpolation, cubic interpolation is not supported by the cache. */
+  const int level_index = float_to_int(lod);
+  const float t = lod - level_index;
+  float4 r = lookup_linear(fetch, level_index, x, y);
+  if (t > 0.0f && level_index + 1 < num_levels) {
+    r = (1.0f - t) * r + t * lookup_linear(fetch, level_index + 1, x, y);
+  }
+  return r;
+}
+
+float4 TextureCacheImage::lookup_linear(TextureCacheFetch &fetch,
+                                        const int level_index,
+                                        const float x,
+                                        const float y) const
+{
+  const TextureCacheLevel &level = levels[level_index];
+  int ix, iy;
+  const float tx = texture_cache_frac(x * level.width - 0.5f, &ix);
+  const float ty = texture_cache_frac(y * level.height - 0.5f, &iy);
+
+  return (1.0f - ty) * ((1.0f - tx) * fetch.read(level_index, ix, iy) +
+                        tx * fetch.read(level_index, ix + 1, iy)) +
+         ty * ((1.0f - tx) * fetch.read(level_index, ix, iy + 1) +
+               tx * fetch.read(level_index, ix + 1, iy + 1));
+}
+
+bool TextureCacheImage::is_tile_loaded(const int level_index,
+                                       const int tile_x,
+                                       const int tile_y) const
+{
+  const TextureCacheLevel &level = levels[level_index];
+  return level.slots[tile_x + tile_y * level.tiles_x].tile.load() != NULL;
+}
+
+size_t TextureCacheImage::memory_size() const
+{
+  size_t size = 0;
+  foreach (const TextureCacheLevel &level, levels) {
+    for (int i = 0; i < level.tiles_x * level.tiles_y; i++) {
+      const TextureCacheTile *tile = level.slots[i].tile.load();
+      if (tile) {
+        size += tile->memory_size;
+      }
+    }
+  }
+  return size;
+}
+
+/* Texture Cache */
+
+TextureCache::TextureCache(const size_t max_memory)
+    : max_memory(max_memory),
+      memory_used(0),
+      memory_generated(0),
+      tiles_loaded(0),
+      tiles_evicted(0),
+      clock_hand(NULL),
+      clock_size(0)
+{
+}
+
+TextureCache::~TextureCache()
+{
+  VLOG(1) << "Texture cache loaded " << tiles_loaded << " tiles and evicted " << tiles_evicted
+          << " tiles.";
+
+  foreach (TextureCacheImage *image, images) {
+    delete image;
+  }
+}
+
+TextureCacheImage *TextureCache::add_image(ImageLoader *loader,
+                                           const ImageMetaData &metadata,
+                                           const ImageParams &params,
+                                           const bool associate_alpha,
+                                           const int texture_limit)
+{
+  if (metadata.width == 0 || metadata.height == 0 || metadata.channels == 0) {
+    return NULL;
+  }
+
+  TextureCacheImage *image = new TextureCacheImage(this);
+  image->loader = loader;
+  image->metadata.reset(new ImageMetaData(metadata));
+  image->filepath = loader->osl_filepath();
+  image->interpolation = params.interpolation;
+  image->extension = params.extension;
+  image->alpha_type = params.alpha_type;
+  image->associate_alpha = associate_alpha;
+  image->channels = (metadata.channels > 1) ? 4 : 1;
+  image->is_float = !(metadata.type == IMAGE_DATA_TYPE_BYTE ||
+                      metadata.type == IMAGE_DATA_TYPE_BYTE4);
+  image->tile_size = TEXTURE_CACHE_TILE_SIZE;
+  image->use_file_tiles = false;
+  image->is_converted = false;
+  image->first_level = 0;
+
+  /* Use the tiles and mipmaps of the file when it has them. */
+  vector<int2> level_sizes;
+  if (!image->filepath.empty() && path_exists(image->filepath.string())) {
+    unique_ptr<ImageInput> in(ImageInput::open(image->filepath.string()));
+    if (in) {
+      ImageSpec spec = in->spec();
+      const bool is_tiled = spec.tile_width > 0 && spec.tile_width == spec.tile_height &&
+                            spec.tile_depth <= 1 && spec.depth <= 1 && spec.x == 0 &&
+                            spec.y == 0 && spec.width == (int)metadata.width &&
+                            spec.height == (int)metadata.height;
+      if (is_tiled) {
+        image->tile_size = spec.tile_width;
+        for (int level_index = 0; in->seek_subimage(0, level_index, spec); level_index++) {
+          level_sizes.push_back(make_int2(spec.width, spec.height));
+        }
+        image->use_file_tiles = (level_sizes.size() > 1 ||
+                                 max(metadata.width, metadata.height) <= (size_t)image->tile_size);
+        if (image->use_file_tiles) {
+          image->tile_filepath = image->filepath.string();
+        }
+      }
+      in->close();
+    }
+  }
+
+  if (!image->use_file_tiles) {
+    level_sizes.clear();
+    int2 size = make_int2(metadata.width, metadata.height);
+    level_sizes.push_back(size);
+    while (size.x > 1 || size.y > 1) {
+      size = make_int2(max(size.x / 2, 1), max(size.y / 2, 1));
+      level_sizes.push_back(size);
+    }
+  }
+
+  image->levels.resize(level_sizes.size());
+  const int num_levels = level_sizes.size();
+  for (int level_index = 0; level_index < num_levels; level_index++) {
+    TextureCacheLevel &level = image->levels[level_index];
+    level.width = level_sizes[level_index].x;
+    level.height = level_sizes[level_index].y;
+    level.tiles_x = divide_up(level.width, image->tile_size);
+    level.tiles_y = divide_up(level.height, image->tile_size);
+
+    const int num_tiles = level.tiles_x * level.tiles_y;
+    level.slots.reset(new TextureCacheSlot[num_tiles]);
+    for (int i = 0; i < num_tiles; i++) {
+      level.slots[i].users = 0;
+      level.slots[i].tile = NULL;
+    }
+
+    if (texture_limit > 0 && max(level.width, level.height) > texture_limit) {
+      image->first_level = min(level_index + 1, num_levels - 1);
+    }
+  }
+
+  VLOG(1) << "Added texture " << loader->name() << " to texture cache, "
+          << (image->use_file_tiles ? "reading tiles from file." :
+                                      "converting to tiled file when first used.");
+
+  thread_scoped_lock lock(images_mutex);
+  images.push_back(image);
+  return image;
+}
+
+void TextureCache::remove_image(TextureCacheImage *image)
+{
+  {
+    thread_scoped_lock lock(files_mutex);
+    open_files.erase(std::remove(open_files.begin(), open_files.end(), image), open_files.end());
+    files_to_close.erase(std::remove(files_to_close.begin(), files_to_close.end(), image),
+                         files_to_close.end());
+  }
+  {
+    thread_scoped_lock lock(images_mutex);
+    images.erase(std::remove(images.begin(), images.end(), image), images.end());
+  }
+
+  if (image->use_file_tiles) {
+    thread_scoped_lock lock(clock_mutex);
+    foreach (TextureCacheLevel &level, image->levels) {
+      for (int i = 0; i < level.tiles_x * level.tiles_y; i++) {
+        TextureCacheTile *tile = level.slots[i].tile.load();
+        if (tile) {
+          clock_remove(tile);
+        }
+      }
+    }
+    memory_used -= image->memory_size();
+  }
+  else {
+    memory_generated -= image->memory_size();
+  }
+  delete image;
+}
+
+size_t TextureCache::memory_size() const
+{
+  return memory_used + memory_generated;
+}
+
+size_t TextureCache::memory_size(const TextureCacheImage *image) const
+{
+  return image->memory_size();
+}
+
+void TextureCache::kernel_lookup(const void *image,
+                                 const float x,
+                                 const float y,
+                                 const float dx_x,
+                                 const float dx_y,
+                                 const float dy_x,
+                                 const float dy_y,
+                                 float result[4])
+{
+  ((const TextureCacheImage *)image)
+      ->lookup(x, y, make_float2(dx_x, dx_y), make_float2(dy_x, dy_y), result);
+}
+
+void TextureCache::file_opened(const TextureCacheImage *image)
+{
+  /* Called while the mutex of the image is locked, so the file to close is only taken from the
+   * list here, and closed by the thread that needs to lock its image. */
+  thread_scoped_lock lock(files_mutex);
+  open_files.push_back(image);
+  if (open_files.size() > TEXTURE_CACHE_MAX_OPEN_FILES) {
+    files_to_close.push_back(open_files.front());
+    open_files.erase(open_files.begin());
+  }
+}
+
+void TextureCache::close_files()
+{
+  vector<const TextureCacheImage *> close_images;
+  {
+    thread_scoped_lock lock(files_mutex);
+    close_images.swap(files_to_close);
+  }
+
+  foreach (const TextureCacheImage *image, close_images) {
+    thread_scoped_lock lock(image->mutex);
+    image->close_file();
+  }
+}
+
+void TextureCache::clock_insert(TextureCacheTile *tile)
+{
+  thread_scoped_lock lock(clock_mutex);
+  if (clock_hand == NULL) {
+    tile->clock_prev = tile;
+    tile->clock_next = tile;
+    clock_hand = tile;
+  }
+  else {
+    /* Insert behind the hand, so that the new tile is visited last. */
+    tile->clock_prev = clock_hand->clock_prev;
+    tile->clock_next = clock_hand;
+    clock_hand->clock_prev->clock_next = tile;
+    clock_hand->clock_prev = tile;
+  }
+  clock_size++;
+}
+
+/* The clock mutex must be locked. */
+void TextureCache::clock_remove(TextureCacheTile *tile)
+{
+  if (tile->clock_next == tile) {
+    clock_hand = NULL;
+  }
+  else {
+    tile->clock_prev->clock_next = tile->clock_next;
+    tile->clock_next->clock_prev = tile->clock_prev;
+    if (clock_hand == tile) {
+      clock_hand = tile->clock_next;
+    }
+  }
+  tile->clock_prev = NULL;
+  tile->clock_next = NULL;
+  clock_size--;
+}
+
+void TextureCache::evict()
+{
+  close_files();
+
+  if (memory_used <= max_memory) {
+    return;
+  }
+
+  /* Only one thread evicts tiles at a time, others continue rendering. */
+  thread_scoped_lock evict_lock(evict_mutex, std::try_to_lock);
+  if (!evict_lock.owns_lock()) {
+    return;
+  }
+
+  /* Evict more than needed, so that this doesn't happen for every loaded tile. */
+  const size_t target_memory = max_memory - max_memory / 4;
+
+  thread_scoped_lock lock(clock_mutex);
+
+  /* In two rounds every tile is visited at least once after its used flag was cleared, more are
+   * not needed when the remaining tiles are in use. */
+  for (size_t steps = 2 * clock_size; steps > 0 && clock_hand && memory_used > target_memory;
+       steps--) {
+    TextureCacheTile *tile = clock_hand;
+    clock_hand = tile->clock_next;
+
+    /* Give tiles that were used recently a second chance. */
+    if (tile->used.exchange(false, std::memory_order_relaxed)) {
+      continue;
+    }
+
+    /* Skip tiles that are in use. */
+    TextureCacheSlot *slot = tile->slot;
+    int users = 0;
+    if (!slot->users.compare_exchange_strong(users, -TEXTURE_CACHE_EVICTING)) {
+      continue;
+    }
+    slot->tile.store(NULL);
+    slot->users += TEXTURE_CACHE_EVICTING;
+
+    clock_remove(tile);
+    memory_used -= tile->memory_size;
+    tiles_evicted++;
+    delete tile;
+  }
+
+  VLOG(3) << "Texture cache evicted tiles, " << string_human_readable_size(memory_used)
+          << " of tiles read from files in use.";
+}
+
+size_t TextureCache::num_tiles_loaded() const
+{
+  return tiles_loaded;
+}
+
+size_t TextureCache::num_tiles_evicted() const
+{
+  return tiles_evicted;
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TEXTURE_CACHE_H__
+#define __TEXTURE_CACHE_H__
+
+#include "util/util_param.h"
+#include "util/util_string.h"
+#include "util/util_texture.h"
+#include "util/util_thread.h"
+#include "util/util_types.h"
+#include "util/util_unique_ptr.h"
+#include "util/util_vector.h"
+
+#include <atomic>
+
+CCL_NAMESPACE_BEGIN
+
+class ImageLoader;
+class ImageMetaData;
+class ImageParams;
+class TextureCache;
+class TextureCacheFetch;
+
+struct TextureCacheSlot;
+
+/* Tile of one mipmap level of an image in the texture cache. */
+struct TextureCacheTile {
+  int width, height;
+  /* 1 or 4 channels, as uchar or float depending on the image. */
+  vector<uchar> pixels;
+  size_t memory_size;
+  /* Set when the tile is used, and cleared when the clock hand of the cache passes it. */
+  std::atomic<bool> used;
+  /* Slot that stores the tile, and its neighbors in the clock of the cache. */
+  TextureCacheSlot *slot;
+  TextureCacheTile *clock_prev, *clock_next;
+};
+
+/* Entry in the tile table of a mipmap level. The users are counted for the slot instead of the
+ * tile, so that the tile can't be freed between reading the pointer and adding a user. */
+struct TextureCacheSlot {
+  std::atomic<int> users;
+  std::atomic<TextureCacheTile *> tile;
+};
+
+struct TextureCacheLevel {
+  int width, height;
+  int tiles_x, tiles_y;
+  unique_ptr<TextureCacheSlot[]> slots;
+};
+
+/* Image in the texture cache, the kernel looks up pixels through this. */
+class TextureCacheImage {
+ public:
+  ~TextureCacheImage();
+
+  /* Lookup with the derivatives of the texture coordinates, which select the mipmap level.
+   * Coordinates are the same as for images in device memory, with the first row at the bottom.
+   * The RGBA result is written to an array since the kernels compiled for different instruction
+   * sets don't pass float4 the same way as this code. */
+  void lookup(float x, float y, const float2 dx, const float2 dy, float result[4]) const;
+
+  bool is_tile_loaded(int level_index, int tile_x, int tile_y) const;
+
+ protected:
+  friend class TextureCache;
+  friend class TextureCacheFetch;
+
+  explicit TextureCacheImage(TextureCache *cache);
+
+  /* Load the tile if no other thread loaded it yet. */
+  void load_tile(int level_index, int tile_x, int tile_y) const;
+  void load_file_tile(int level_index, int tile_x, int tile_y) const;
+  bool read_file_tile(int level_index, TextureCacheTile *tile, int tile_x, int tile_y) const;
+  template<typename T> void convert_image() const;
+  template<typename T> bool load_full_image(vector<T> &pixels) const;
+  template<typename T> bool write_tiled_file(const vector<T> &pixels) const;
+  template<typename T> void generate_tiles(vector<T> &pixels) const;
+  void generate_missing_tiles() const;
+
+  TextureCacheTile *create_tile(int level_index, int tile_x, int tile_y) const;
+  void fill_missing_tile(TextureCacheTile *tile) const;
+  bool insert_tile(int level_index, int tile_x, int tile_y, TextureCacheTile *tile) const;
+  void close_file() const;
+
+  float4 lookup_mipmap(float x, float y, const float2 dx, const float2 dy) const;
+  float4 lookup_linear(TextureCacheFetch &fetch, int level_index, float x, float y) const;
+
+  size_t memory_size() const;
+
+  TextureCache *cache;
+
+  /* Image to load tiles from. */
+  ImageLoader *loader;
+  unique_ptr<ImageMetaData> metadata;
+  ustring filepath;
+  InterpolationType interpolation;
+  ExtensionType extension;
+  ImageAlphaType alpha_type;
+  bool associate_alpha;
+
+  /* Layout of the tiles, with 1 or 4 channels. */
+  int channels;
+  bool is_float;
+  int tile_size;
+
+  /* Tiled and mipmapped files are read one tile at a time. Other images are converted to such a
+   * file in the temporary directory when they are first used, and then read the same way. Only
+   * if that fails, all tiles of all levels are generated in memory and never evicted, since
+   * generating a single tile requires loading the full image. */
+  mutable bool use_file_tiles;
+  mutable bool is_converted;
+  /* File that tiles are read from, with pixels in the layout of the cache if it was converted. */
+  mutable string tile_filepath;
+  /* Most detailed level that is used, to respect the texture size limit. */
+  int first_level;
+  vector<TextureCacheLevel> levels;
+
+  mutable thread_mutex mutex;
+  /* Open OIIO ImageInput for reading tiles. */
+  mutable void *file;
+};
+
+/* Reads pixels of tiles while keeping a user of the last tile, so that pixels in the same tile
+ * can be read without atomic operations. The tile is not evicted while it has users. */
+class TextureCacheFetch {
+ public:
+  explicit TextureCacheFetch(const TextureCacheImage &image);
+  ~TextureCacheFetch();
+
+  float4 read(const int level_index, int x, int y);
+
+ protected:
+  void acquire(const int level_index, const int x_tile, const int y_tile);
+  void release();
+
+  const TextureCacheImage &image;
+  TextureCacheSlot *slot;
+  TextureCacheTile *tile;
+  int level_index;
+  int tile_x, tile_y;
+};
+
+/* Texture Cache
+ *
+ * Loads tiles of 2D images on demand while rendering on the CPU, instead of loading the full
+ * images before rendering starts. Tiled and mipmapped files, like .tx files created with maketx,
+ * are read one tile at a time. Other images are converted to a temporary tiled and mipmapped file
+ * when they are first used, so that their tiles can be read the same way. The mipmap level is
+ * selected based on the ray differentials. When the tiles use more memory than the limit, tiles
+ * that were not used recently are freed.
+ *
+ * The kernel does not depend on the cache, it calls the lookup function that the image manager
+ * passes to the device. */
+class TextureCache {
+ public:
+  explicit TextureCache(size_t max_memory);
+  ~TextureCache();
+
+  /* Add an image, the loader must stay valid until the image is removed. Returns NULL if the
+   * metadata can't be loaded. */
+  TextureCacheImage *add_image(ImageLoader *loader,
+                               const ImageMetaData &metadata,
+                               const ImageParams &params,
+                               const bool associate_alpha,
+                               const int texture_limit);
+  void remove_image(TextureCacheImage *image);
+
+  size_t memory_size() const;
+  size_t memory_size(const TextureCacheImage *image) const;
+
+  /* Matches TextureCacheLookupFunction, the image is a TextureCacheImage. */
+  static void kernel_lookup(const void *image,
+                            float x,
+                            float y,
+                            float dx_x,
+                            float dx_y,
+                            float dy_x,
+                            float dy_y,
+                            float result[4]);
+
+  /* Statistics for the log. */
+  size_t num_tiles_loaded() const;
+  size_t num_tiles_evicted() const;
+
+ protected:
+  friend class TextureCacheImage;
+  friend class TextureCacheFetch;
+
+  /* Evict tiles that were not used recently when over the memory limit. Must be called without
+   * the mutex of any image locked. */
+  void evict();
+  void file_opened(const TextureCacheImage *image);
+  void close_files();
+
+  /* Add a tile read from a file to the clock, or remove it. */
+  void clock_insert(TextureCacheTile *tile);
+  void clock_remove(TextureCacheTile *tile);
+
+  size_t max_memory;
+  /* Memory of the tiles read from files, which is kept below the limit. */
+  std::atomic<size_t> memory_used;
+  /* Memory of the generated tiles of images that could not be converted to a tiled file. */
+  std::atomic<size_t> memory_generated;
+  std::atomic<size_t> tiles_loaded;
+  std::atomic<size_t> tiles_evicted;
+
+  thread_mutex images_mutex;
+  vector<TextureCacheImage *> images;
+
+  /* Tiles read from files form a circular list in the order they were loaded. Eviction moves the
+   * clock hand along it, tiles that were used since the hand last passed them are kept and the
+   * others are freed. This approximates freeing the least recently used tiles, without sorting
+   * all tiles for every eviction. */
+  thread_mutex clock_mutex;
+  TextureCacheTile *clock_hand;
+  size_t clock_size;
+
+  /* Images with open files, the oldest one is closed when there are too many. */
+  thread_mutex files_mutex;
+  vector<const TextureCacheImage *> open_files;
+  vector<const TextureCacheImage *> files_to_close;
+
+  thread_mutex evict_mutex;
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __TEXTURE_CACHE_H__ */
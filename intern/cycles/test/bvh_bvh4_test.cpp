@@ -0,0 +1,340 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "device/device.h"
+
+#include "render/graph.h"
+#include "render/mesh.h"
+#include "render/nodes.h"
+#include "render/object.h"
+#include "render/scene.h"
+#include "render/shader.h"
+#include "render/stats.h"
+
+#include "util/util_hash.h"
+#include "util/util_progress.h"
+#include "util/util_task.h"
+#include "util/util_time.h"
+#include "util/util_transform.h"
+#include "util/util_vector.h"
+
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/kernel_math.h"
+#include "kernel/kernel_types.h"
+#include "kernel/split/kernel_split_data.h"
+
+#include "kernel/kernel_globals.h"
+#include "kernel/kernels/cpu/kernel_cpu_image.h"
+
+#include "kernel/kernel_differential.h"
+#include "kernel/kernel_montecarlo.h"
+#include "kernel/kernel_projection.h"
+#include "kernel/kernel_random.h"
+
+#include "kernel/geom/geom.h"
+#include "kernel/bvh/bvh.h"
+
+CCL_NAMESPACE_BEGIN
+
+#ifdef __BVH4__
+
+namespace {
+
+float3 hash_float3(const uint i, const uint j)
+{
+  return make_float3(
+      hash_uint3_to_float(i, j, 0), hash_uint3_to_float(i, j, 1), hash_uint3_to_float(i, j, 2));
+}
+
+template<typename T, typename U> void set_texture(texture<T> &tex, device_vector<U> &vector)
+{
+  tex.data = (T *)vector.data();
+  tex.width = vector.size();
+}
+
+/* Scene on the CPU device with kernel globals that point to its device arrays, so the traversal
+ * functions can be called directly. All surfaces are transparent, so shadow rays record all
+ * hits. */
+class BVHScene {
+ public:
+  BVHScene(const BVHLayout bvh_layout)
+  {
+    TaskScheduler::init();
+    device = Device::create(device_info, stats, profiler, true);
+    SceneParams scene_params;
+    scene_params.bvh_layout = bvh_layout;
+    scene = new Scene(scene_params, device);
+
+    ShaderGraph *graph = new ShaderGraph();
+    TransparentBsdfNode *transparent = graph->create_node<TransparentBsdfNode>();
+    graph->add(transparent);
+    graph->connect(transparent->output("BSDF"), graph->output()->input("Surface"));
+    shader = scene->create_node<Shader>();
+    shader->name = "transparent";
+    shader->set_graph(graph);
+    shader->tag_update(scene);
+  }
+
+  ~BVHScene()
+  {
+    delete scene;
+    delete device;
+    TaskScheduler::exit();
+  }
+
+  Mesh *add_mesh(const int num_verts, const int num_triangles)
+  {
+    Mesh *mesh = scene->create_node<Mesh>();
+    array<Node *> used_shaders;
+    used_shaders.push_back_slow(shader);
+    mesh->set_used_shaders(used_shaders);
+    mesh->reserve_mesh(num_verts, num_triangles);
+    return mesh;
+  }
+
+  Object *add_object(Mesh *mesh, const Transform &tfm)
+  {
+    Object *object = scene->create_node<Object>();
+    object->set_geometry(mesh);
+    object->set_tfm(tfm);
+    return object;
+  }
+
+  void update()
+  {
+    Progress progress;
+    bool kernel_switch_needed = false;
+    scene->update(progress, kernel_switch_needed);
+
+    DeviceScene &dscene = scene->dscene;
+    memset((void *)&kg, 0, sizeof(kg));
+    kg.__data = dscene.data;
+    set_texture(kg.__bvh_nodes, dscene.bvh_nodes);
+    set_texture(kg.__bvh_leaf_nodes, dscene.bvh_leaf_nodes);
+    set_texture(kg.__object_node, dscene.object_node);
+    set_texture(kg.__prim_tri_index, dscene.prim_tri_index);
+    set_texture(kg.__prim_tri_verts, dscene.prim_tri_verts);
+    set_texture(kg.__prim_type, dscene.prim_type);
+    set_texture(kg.__prim_visibility, dscene.prim_visibility);
+    set_texture(kg.__prim_index, dscene.prim_index);
+    set_texture(kg.__prim_object, dscene.prim_object);
+    set_texture(kg.__prim_time, dscene.prim_time);
+    set_texture(kg.__tri_shader, dscene.tri_shader);
+    set_texture(kg.__objects, dscene.objects);
+    set_texture(kg.__object_flag, dscene.object_flag);
+    set_texture(kg.__shaders, dscene.shaders);
+  }
+
+  KernelGlobals kg;
+  Scene *scene;
+
+ protected:
+  Stats stats;
+  Profiler profiler;
+  DeviceInfo device_info;
+  Device *device;
+  Shader *shader;
+};
+
+/* Randomly placed and oriented triangles inside of a unit cube around the origin. */
+Mesh *add_random_triangles(BVHScene &bvh, const int num_triangles, const uint seed)
+{
+  Mesh *mesh = bvh.add_mesh(num_triangles * 3, num_triangles);
+  for (int i = 0; i < num_triangles; i++) {
+    const float3 center = hash_float3(seed, i * 4) - make_float3(0.5f, 0.5f, 0.5f);
+    for (int j = 1; j <= 3; j++) {
+      mesh->add_vertex(center + (hash_float3(seed, i * 4 + j) - make_float3(0.5f, 0.5f, 0.5f)) *
+                                    0.1f);
+    }
+    mesh->add_triangle(i * 3, i * 3 + 1, i * 3 + 2, 0, false);
+  }
+  return mesh;
+}
+
+/* One mesh that has its transform applied and one mesh that is instanced by several objects, so
+ * the traversal enters and leaves instances. */
+void create_random_triangles_scene(BVHScene &bvh)
+{
+  Mesh *mesh = add_random_triangles(bvh, 2000, 0);
+  Object *object = bvh.add_object(mesh, transform_scale(4.0f, 4.0f, 4.0f));
+  /* Only visible to camera rays, which tests the visibility of the nodes. */
+  object->set_visibility(PATH_RAY_CAMERA);
+
+  Mesh *instanced_mesh = add_random_triangles(bvh, 500, 1);
+  for (int i = 0; i < 8; i++) {
+    const float3 offset = (hash_float3(2, i) - make_float3(0.5f, 0.5f, 0.5f)) * 4.0f;
+    bvh.add_object(instanced_mesh,
+                   transform_translate(offset) *
+                       transform_rotate(i * 0.7f, normalize(make_float3(1.0f, 2.0f, 3.0f))) *
+                       transform_scale(1.0f + i * 0.1f, 1.0f, 1.0f));
+  }
+  bvh.update();
+}
+
+/* Terrain with bumps of different sizes, like a tessellated surface of a production scene. */
+void create_terrain_scene(BVHScene &bvh, const int resolution)
+{
+  Mesh *mesh = bvh.add_mesh((resolution + 1) * (resolution + 1), resolution * resolution * 2);
+  for (int y = 0; y <= resolution; y++) {
+    for (int x = 0; x <= resolution; x++) {
+      const float u = (float)x / resolution - 0.5f;
+      const float v = (float)y / resolution - 0.5f;
+      const float height = 0.1f * sinf(u * 7.0f) * cosf(v * 5.0f) +
+                           0.02f * sinf(u * 53.0f + v * 31.0f) +
+                           0.005f * hash_uint2_to_float(x, y);
+      mesh->add_vertex(make_float3(u, v, height));
+    }
+  }
+  for (int y = 0; y < resolution; y++) {
+    for (int x = 0; x < resolution; x++) {
+      const int v00 = y * (resolution + 1) + x;
+      const int v10 = v00 + 1;
+      const int v01 = v00 + resolution + 1;
+      const int v11 = v01 + 1;
+      mesh->add_triangle(v00, v10, v11, 0, false);
+      mesh->add_triangle(v00, v11, v01, 0, false);
+    }
+  }
+  bvh.add_object(mesh, transform_scale(4.0f, 4.0f, 4.0f));
+  bvh.update();
+}
+
+/* Rays from random points around the scene towards random points inside of it. */
+Ray create_ray(const int i)
+{
+  Ray ray;
+  memset((void *)&ray, 0, sizeof(ray));
+  ray.P = (hash_float3(3, i) - make_float3(0.5f, 0.5f, 0.5f)) * 12.0f;
+  const float3 target = (hash_float3(4, i) - make_float3(0.5f, 0.5f, 0.5f)) * 4.0f;
+  ray.D = normalize_len(target - ray.P, &ray.t);
+  /* Half of the rays end inside of the scene. */
+  ray.t = (i % 2) ? FLT_MAX : ray.t;
+  return ray;
+}
+
+/* Each triangle is hit at most once, so hits of all layouts sort the same way. */
+bool isect_less(const Intersection &a, const Intersection &b)
+{
+  return (a.object != b.object) ? a.object < b.object : a.prim < b.prim;
+}
+
+void expect_same_isect(const Intersection &bvh2_isect, const Intersection &bvh4_isect, int i)
+{
+  EXPECT_EQ(bvh4_isect.prim, bvh2_isect.prim) << "ray " << i;
+  EXPECT_EQ(bvh4_isect.object, bvh2_isect.object) << "ray " << i;
+  EXPECT_EQ(bvh4_isect.type, bvh2_isect.type) << "ray " << i;
+  /* The distance is scaled when entering and leaving instances, which rounds differently
+   * depending on the order in which instances are visited. */
+  EXPECT_NEAR(bvh4_isect.t, bvh2_isect.t, 1e-5f * bvh2_isect.t) << "ray " << i;
+  EXPECT_EQ(bvh4_isect.u, bvh2_isect.u) << "ray " << i;
+  EXPECT_EQ(bvh4_isect.v, bvh2_isect.v) << "ray " << i;
+}
+
+}  // namespace
+
+TEST(bvh_bvh4, same_hits_as_bvh2)
+{
+  BVHScene bvh2(BVH_LAYOUT_BVH2);
+  BVHScene bvh4(BVH_LAYOUT_BVH4);
+  create_random_triangles_scene(bvh2);
+  create_random_triangles_scene(bvh4);
+  ASSERT_EQ(bvh2.kg.__data.bvh.bvh_layout, BVH_LAYOUT_BVH2);
+  ASSERT_EQ(bvh4.kg.__data.bvh.bvh_layout, BVH_LAYOUT_BVH4);
+
+  int num_closest_hits = 0;
+  int num_shadow_hits = 0;
+  for (int i = 0; i < 4096; i++) {
+    const Ray ray = create_ray(i);
+
+    /* Closest hit, the mesh with the applied transform is only visible for camera rays. */
+    for (const uint visibility : {PATH_RAY_CAMERA, PATH_RAY_DIFFUSE}) {
+      Intersection bvh2_isect, bvh4_isect;
+      const bool bvh2_hit = scene_intersect(&bvh2.kg, &ray, visibility, &bvh2_isect);
+      const bool bvh4_hit = scene_intersect(&bvh4.kg, &ray, visibility, &bvh4_isect);
+      ASSERT_EQ(bvh4_hit, bvh2_hit) << "ray " << i;
+      if (bvh2_hit) {
+        expect_same_isect(bvh2_isect, bvh4_isect, i);
+        num_closest_hits++;
+      }
+    }
+
+    /* All hits in any order, the mesh with the applied transform is invisible to shadow rays. */
+    const uint max_hits = 64;
+    Intersection bvh2_isects[max_hits], bvh4_isects[max_hits];
+    uint bvh2_num_hits, bvh4_num_hits;
+    const bool bvh2_blocked = scene_intersect_shadow_all(
+        &bvh2.kg, &ray, bvh2_isects, PATH_RAY_SHADOW, max_hits, &bvh2_num_hits);
+    const bool bvh4_blocked = scene_intersect_shadow_all(
+        &bvh4.kg, &ray, bvh4_isects, PATH_RAY_SHADOW, max_hits, &bvh4_num_hits);
+    ASSERT_FALSE(bvh2_blocked) << "ray " << i;
+    ASSERT_FALSE(bvh4_blocked) << "ray " << i;
+    ASSERT_EQ(bvh4_num_hits, bvh2_num_hits) << "ray " << i;
+    std::sort(bvh2_isects, bvh2_isects + bvh2_num_hits, isect_less);
+    std::sort(bvh4_isects, bvh4_isects + bvh4_num_hits, isect_less);
+    for (uint j = 0; j < bvh2_num_hits; j++) {
+      expect_same_isect(bvh2_isects[j], bvh4_isects[j], i);
+    }
+    num_shadow_hits += bvh2_num_hits;
+
+    /* Closest hit with a single object, as used for subsurface scattering. The first object has
+     * its transform applied, the others are instances. */
+    const int local_object = i % bvh2.scene->objects.size();
+    LocalIntersection bvh2_local, bvh4_local;
+    scene_intersect_local(&bvh2.kg, &ray, &bvh2_local, local_object, NULL, 1);
+    scene_intersect_local(&bvh4.kg, &ray, &bvh4_local, local_object, NULL, 1);
+    ASSERT_EQ(bvh4_local.num_hits, bvh2_local.num_hits) << "ray " << i;
+    if (bvh2_local.num_hits) {
+      expect_same_isect(bvh2_local.hits[0], bvh4_local.hits[0], i);
+    }
+  }
+
+  /* A good part of the rays hit something, and shadow rays pass through the instances. */
+  EXPECT_GT(num_closest_hits, 2048);
+  EXPECT_GT(num_shadow_hits, 256);
+}
+
+/* Closest hit ray throughput of both layouts. */
+TEST(bvh_bvh4_performance, closest_hit_rays_per_second)
+{
+  const int num_rays = 1 << 20;
+  for (const BVHLayout bvh_layout : {BVH_LAYOUT_BVH2, BVH_LAYOUT_BVH4}) {
+    double build_time = time_dt();
+    BVHScene bvh(bvh_layout);
+    create_terrain_scene(bvh, 512);
+    build_time = time_dt() - build_time;
+
+    int num_hits = 0;
+    const double start_time = time_dt();
+    for (int i = 0; i < num_rays; i++) {
+      const Ray ray = create_ray(i);
+      Intersection isect;
+      num_hits += scene_intersect(&bvh.kg, &ray, PATH_RAY_CAMERA, &isect);
+    }
+    const double trace_time = time_dt() - start_time;
+
+    printf("%s: scene updated in %fs, %f million rays per second, %d hits\n",
+           bvh_layout_name(bvh_layout),
+           build_time,
+           num_rays / trace_time * 1e-6,
+           num_hits);
+  }
+}
+
+#endif /* __BVH4__ */
+
+CCL_NAMESPACE_END
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "device/device.h"
+#include "device/device_split_kernel.h"
+
+#include "render/buffers.h"
+#include "render/camera.h"
+#include "render/film.h"
+#include "render/graph.h"
+#include "render/mesh.h"
+#include "render/nodes.h"
+#include "render/object.h"
+#include "render/scene.h"
+#include "render/session.h"
+#include "render/shader.h"
+
+#include "util/util_debug.h"
+#include "util/util_transform.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Add a box with the given bounds to the mesh, which has space reserved for it. */
+void add_box(Mesh *mesh, const float3 bmin, const float3 bmax)
+{
+  const int base = mesh->get_verts().size();
+  for (int i = 0; i < 8; i++) {
+    mesh->add_vertex(make_float3((i & 1) ? bmax.x : bmin.x,
+                                 (i & 2) ? bmax.y : bmin.y,
+                                 (i & 4) ? bmax.z : bmin.z));
+  }
+  const int quads[6][4] = {
+      {0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+  for (int i = 0; i < 6; i++) {
+    mesh->add_triangle(base + quads[i][0], base + quads[i][1], base + quads[i][2], 0, false);
+    mesh->add_triangle(base + quads[i][0], base + quads[i][2], base + quads[i][3], 0, false);
+  }
+}
+
+/* Boxes of different heights on a ground plane, lit by a uniform background, so paths bounce
+ * between them and end in different kernel stages. */
+void create_boxes_scene(Scene *scene, const int width, const int height)
+{
+  ShaderGraph *graph = new ShaderGraph();
+  BackgroundNode *background = graph->create_node<BackgroundNode>();
+  background->set_color(make_float3(0.6f, 0.7f, 0.8f));
+  background->set_strength(1.0f);
+  graph->add(background);
+  graph->connect(background->output("Background"), graph->output()->input("Surface"));
+  scene->default_background->set_graph(graph);
+  scene->default_background->tag_update(scene);
+
+  Mesh *mesh = scene->create_node<Mesh>();
+  array<Node *> used_shaders;
+  used_shaders.push_back_slow(scene->default_surface);
+  mesh->set_used_shaders(used_shaders);
+  const int num_boxes = 1 + 64;
+  mesh->reserve_mesh(num_boxes * 8, num_boxes * 12);
+  add_box(mesh, make_float3(-20.0f, -1.0f, -20.0f), make_float3(20.0f, 0.0f, 20.0f));
+  for (int i = 0; i < 64; i++) {
+    const float x = (i % 8) * 2.0f - 7.5f;
+    const float z = (i / 8) * 2.0f - 7.5f;
+    const float box_height = 0.5f + (i * 7 % 5) * 0.5f;
+    add_box(mesh, make_float3(x, 0.0f, z), make_float3(x + 1.0f, box_height, z + 1.0f));
+  }
+
+  Object *object = scene->create_node<Object>();
+  object->set_geometry(mesh);
+  object->set_tfm(transform_identity());
+
+  Camera *camera = scene->camera;
+  camera->set_full_width(width);
+  camera->set_full_height(height);
+  camera->set_matrix(transform_translate(0.0f, 6.0f, -14.0f) *
+                     transform_rotate(0.4f, make_float3(1.0f, 0.0f, 0.0f)));
+  camera->compute_auto_viewplane();
+
+  scene->passes.clear();
+  Pass::add(PASS_COMBINED, scene->passes, "Combined");
+}
+
+const int boxes_width = 128;
+const int boxes_height = 96;
+const int boxes_samples = 16;
+
+/* Render the scene on the CPU, and return the time spent on path tracing. */
+double render_boxes_scene(const bool use_split_kernel, vector<float> &r_pixels)
+{
+  DebugFlags().cpu.split_kernel = use_split_kernel;
+
+  SessionParams session_params;
+  session_params.device = Device::available_devices(DEVICE_MASK_CPU).front();
+  session_params.background = true;
+  session_params.samples = boxes_samples;
+  session_params.tile_size = make_int2(32, 32);
+  Session session(session_params);
+
+  SceneParams scene_params;
+  session.scene = new Scene(scene_params, session.device);
+  create_boxes_scene(session.scene, boxes_width, boxes_height);
+
+  r_pixels.resize(boxes_width * boxes_height * 4);
+  session.write_render_tile_cb = [&](RenderTile &rtile) {
+    vector<float> pixels(rtile.w * rtile.h * 4);
+    rtile.buffers->copy_from_device();
+    rtile.buffers->get_pass_rect("Combined", 1.0f, rtile.sample, 4, pixels.data());
+    for (int y = 0; y < rtile.h; y++) {
+      memcpy(&r_pixels[((rtile.y + y) * boxes_width + rtile.x) * 4],
+             &pixels[y * rtile.w * 4],
+             sizeof(float) * rtile.w * 4);
+    }
+  };
+
+  BufferParams buffer_params;
+  buffer_params.width = boxes_width;
+  buffer_params.height = boxes_height;
+  buffer_params.full_width = boxes_width;
+  buffer_params.full_height = boxes_height;
+  buffer_params.passes = session.scene->passes;
+
+  session.reset(buffer_params, boxes_samples);
+  session.start();
+  session.wait();
+
+  DebugFlags().cpu.reset();
+
+  double total_time, render_time;
+  session.progress.get_time(total_time, render_time);
+  return render_time;
+}
+
+}  // namespace
+
+TEST(split_kernel_cpu_num_paths, within_budget)
+{
+  EXPECT_EQ(split_kernel_cpu_num_paths(1024, 8, 1000, 1024 * 1024 * 1024), 1024);
+  EXPECT_EQ(split_kernel_cpu_num_paths(1, 8, 1000, 1000), 1);
+}
+
+TEST(split_kernel_cpu_num_paths, limited_by_budget)
+{
+  /* 4 threads share 1 MiB, so every thread has room for 256 states of 1 KiB. */
+  EXPECT_EQ(split_kernel_cpu_num_paths(1024, 4, 1024, 1024 * 1024), 256);
+  /* The budget is shared by more threads. */
+  EXPECT_EQ(split_kernel_cpu_num_paths(1024, 16, 1024, 1024 * 1024), 64);
+}
+
+TEST(split_kernel_cpu_num_paths, at_least_one_path)
+{
+  /* A single state larger than the budget still traces one path. */
+  EXPECT_EQ(split_kernel_cpu_num_paths(1024, 4, 1024 * 1024, 1024), 1);
+  EXPECT_EQ(split_kernel_cpu_num_paths(1024, 0, 1024, 0), 1);
+  EXPECT_EQ(split_kernel_cpu_num_paths(0, 4, 1024, 1024 * 1024), 1);
+}
+
+/* Compare samples per second of the megakernel and the split kernel on the CPU, with the
+ * default number of paths every thread traces at once. */
+TEST(device_split_kernel_performance, cpu_samples_per_second)
+{
+  vector<float> mega_pixels, split_pixels;
+  const double mega_time = render_boxes_scene(false, mega_pixels);
+  const double split_time = render_boxes_scene(true, split_pixels);
+
+  const double num_samples = (double)boxes_width * boxes_height * boxes_samples;
+  printf("Megakernel: %f samples/s\n", num_samples / mega_time);
+  printf("Split kernel: %f samples/s, %d paths per thread\n",
+         num_samples / split_time,
+         DebugFlags().cpu.split_kernel_paths);
+
+  /* Both kernels trace the same paths, only in a different order. */
+  ASSERT_EQ(split_pixels.size(), mega_pixels.size());
+  for (size_t i = 0; i < mega_pixels.size(); i++) {
+    ASSERT_NEAR(split_pixels[i], mega_pixels[i], 1e-5f) << "pixel " << i / 4;
+  }
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/kernel_math.h"
+#include "kernel/kernel_types.h"
+#include "kernel/split/kernel_split_data.h"
+
+#include "kernel/kernel_globals.h"
+#include "kernel/split/kernel_split_common.h"
+#include "kernel/split/kernel_shader_sort.h"
+
+#include "util/util_hash.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Sort the first num entries of a block the way the shader sort kernel does, and compare the
+ * result with a stable sort of the indices by value. */
+void check_shader_sort(const vector<uint> &value, const int num)
+{
+  ShaderSortLocals locals;
+  for (int i = 0; i < SHADER_SORT_BLOCK_SIZE; i++) {
+    locals.local_value[i] = value[i];
+    locals.local_index[i] = i;
+  }
+
+  shader_sort_block_cpu(locals.local_value, locals.local_index, locals.local_index_tmp, num);
+
+  vector<ushort> expected(SHADER_SORT_BLOCK_SIZE);
+  for (int i = 0; i < SHADER_SORT_BLOCK_SIZE; i++) {
+    expected[i] = i;
+  }
+  std::stable_sort(expected.begin(),
+                   expected.begin() + num,
+                   [&](const ushort a, const ushort b) { return value[a] < value[b]; });
+
+  /* Entries after the first num ones are left as they are. */
+  for (int i = 0; i < SHADER_SORT_BLOCK_SIZE; i++) {
+    ASSERT_EQ(locals.local_index[i], expected[i]) << "index " << i << " of " << num;
+  }
+}
+
+}  // namespace
+
+TEST(kernel_shader_sort, stable_by_value)
+{
+  /* A few shaders, and empty slots without a shader that are sorted to the end. */
+  vector<uint> value(SHADER_SORT_BLOCK_SIZE);
+  for (int i = 0; i < SHADER_SORT_BLOCK_SIZE; i++) {
+    const uint shader = hash_uint2(i, 0) % 6;
+    value[i] = (shader == 5) ? ~0 : shader;
+  }
+
+  for (const int num : {0, 1, 2, 3, 31, 64, 100, 1000, SHADER_SORT_BLOCK_SIZE - 1}) {
+    check_shader_sort(value, num);
+  }
+  check_shader_sort(value, SHADER_SORT_BLOCK_SIZE);
+
+  /* Already sorted, reversed and equal values. */
+  for (int i = 0; i < SHADER_SORT_BLOCK_SIZE; i++) {
+    value[i] = i / 100;
+  }
+  check_shader_sort(value, SHADER_SORT_BLOCK_SIZE);
+  check_shader_sort(value, 777);
+  for (int i = 0; i < SHADER_SORT_BLOCK_SIZE; i++) {
+    value[i] = (SHADER_SORT_BLOCK_SIZE - i) / 100;
+  }
+  check_shader_sort(value, SHADER_SORT_BLOCK_SIZE);
+  check_shader_sort(value, 777);
+  for (int i = 0; i < SHADER_SORT_BLOCK_SIZE; i++) {
+    value[i] = ~0;
+  }
+  check_shader_sort(value, SHADER_SORT_BLOCK_SIZE);
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include <openvdb/openvdb.h>
+#include <openvdb/tools/Dense.h>
+#include <openvdb/tools/LevelSetSphere.h>
+
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/kernel_math.h"
+#include "kernel/kernel_types.h"
+#include "kernel/split/kernel_split_data.h"
+
+#include "kernel/kernel_globals.h"
+#include "kernel/kernels/cpu/kernel_cpu_image.h"
+
+#include "render/image_vdb.h"
+
+#include "util/util_hash.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Loader for a grid that is created in the test instead of being read from a file. */
+class TestVDBImageLoader : public VDBImageLoader {
+ public:
+  TestVDBImageLoader(openvdb::GridBase::ConstPtr test_grid) : VDBImageLoader("test")
+  {
+    grid = test_grid;
+  }
+};
+
+TextureInfo create_texture_info(const void *data,
+                                const ImageMetaData &metadata,
+                                const InterpolationType interpolation,
+                                const ExtensionType extension)
+{
+  TextureInfo info = {0};
+  info.data = (uint64_t)data;
+  info.data_type = metadata.type;
+  info.interpolation = interpolation;
+  info.extension = extension;
+  info.width = metadata.width;
+  info.height = metadata.height;
+  info.depth = metadata.depth;
+  return info;
+}
+
+}  // namespace
+
+TEST(render_image_vdb, sparse_level_set_matches_dense)
+{
+  openvdb::initialize();
+
+  /* The inside of a level set has negative values, which are stored in inactive tiles. */
+  openvdb::FloatGrid::Ptr grid = openvdb::tools::createLevelSetSphere<openvdb::FloatGrid>(
+      24.0f, openvdb::Vec3f(3.5f, -1.0f, 0.25f), 1.0f, 3.0f);
+  ASSERT_LT(grid->tree().getValue(openvdb::Coord(3, -1, 0)), 0.0f);
+
+  TestVDBImageLoader loader(grid);
+  ImageMetaData metadata;
+  ASSERT_TRUE(loader.load_metadata(metadata));
+  ASSERT_EQ(metadata.type, IMAGE_DATA_TYPE_SPARSE_FLOAT);
+  vector<float> sparse_pixels(divide_up(metadata.byte_size, sizeof(float)));
+  ASSERT_TRUE(loader.load_pixels(metadata, sparse_pixels.data(), metadata.byte_size, false));
+
+  /* Tiles outside of the sphere share the background block. */
+  const SparseTextureHeader *header = (const SparseTextureHeader *)sparse_pixels.data();
+  EXPECT_LT(header->num_blocks, header->tiles_x * header->tiles_y * header->tiles_z);
+
+  /* Dense copy of the grid, as used by devices without support for sparse textures. */
+  vector<float> dense_pixels((size_t)metadata.width * metadata.height * metadata.depth);
+  openvdb::tools::Dense<float, openvdb::tools::LayoutXYZ> dense(
+      grid->evalActiveVoxelBoundingBox(), dense_pixels.data());
+  openvdb::tools::copyToDense(*grid, dense);
+
+  for (const InterpolationType interpolation :
+       {INTERPOLATION_CLOSEST, INTERPOLATION_LINEAR, INTERPOLATION_CUBIC}) {
+    for (const ExtensionType extension : {EXTENSION_REPEAT, EXTENSION_EXTEND, EXTENSION_CLIP}) {
+      const TextureInfo dense_info = create_texture_info(
+          dense_pixels.data(), metadata, interpolation, extension);
+      const TextureInfo sparse_info = create_texture_info(
+          sparse_pixels.data(), metadata, interpolation, extension);
+
+      for (int i = 0; i < 4096; i++) {
+        /* Positions slightly outside of the texture test the extension too. */
+        const float x = hash_uint2_to_float(i, 0) * 1.2f - 0.1f;
+        const float y = hash_uint2_to_float(i, 1) * 1.2f - 0.1f;
+        const float z = hash_uint2_to_float(i, 2) * 1.2f - 0.1f;
+        const float expected = TextureInterpolator<float>::interp_3d(
+                                   dense_info, x, y, z, INTERPOLATION_NONE)
+                                   .x;
+        const float result = SparseInterpolator<1>::interp_3d(
+                                 sparse_info, x, y, z, INTERPOLATION_NONE)
+                                 .x;
+        ASSERT_NEAR(result, expected, 1e-5f * max(1.0f, fabsf(expected)))
+            << "interpolation " << interpolation << " extension " << extension << " at " << x
+            << " " << y << " " << z;
+      }
+    }
+  }
+}
+
+CCL_NAMESPACE_END
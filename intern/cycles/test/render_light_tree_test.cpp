@@ -0,0 +1,310 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/kernel_math.h"
+#include "kernel/kernel_types.h"
+#include "kernel/split/kernel_split_data.h"
+
+#include "kernel/kernel_globals.h"
+#include "kernel/kernel_light_tree.h"
+
+#include "render/light_tree.h"
+
+#include "util/util_hash.h"
+#include "util/util_time.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Point lights on a grid of streets, like the street lights of a city. */
+vector<LightTreeEmitter> create_city_lights(int size)
+{
+  vector<LightTreeEmitter> emitters;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      const float3 co = make_float3(x * 10.0f, y * 10.0f, 5.0f);
+      LightTreeEmitter emitter;
+      emitter.bbox = BoundBox::empty;
+      emitter.bbox.grow(co, 0.1f);
+      emitter.bcone = OrientationBounds(make_float3(0.0f, 0.0f, 1.0f), M_PI_F, M_PI_2_F);
+      emitter.energy = 0.5f + hash_uint2_to_float(x, y);
+      emitter.distribution_id = emitters.size();
+      emitters.push_back(emitter);
+    }
+  }
+  return emitters;
+}
+
+void pack_bounds(const BoundBox &bbox,
+                 const OrientationBounds &bcone,
+                 float bounding_box_min[3],
+                 float bounding_box_max[3],
+                 float axis[3])
+{
+  for (int i = 0; i < 3; i++) {
+    bounding_box_min[i] = bbox.min[i];
+    bounding_box_max[i] = bbox.max[i];
+    axis[i] = bcone.axis[i];
+  }
+}
+
+/* Kernel data of a tree that only contains emitters of the tree, all of them in the flat
+ * distribution with the same probability. */
+class LightTreeKernelData {
+ public:
+  LightTreeKernelData(const vector<LightTreeEmitter> &emitters, const LightTree &light_tree)
+  {
+    const vector<LightTreeNode> &nodes = light_tree.get_nodes();
+    knodes.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+      KernelLightTreeNode &knode = knodes[i];
+      pack_bounds(nodes[i].bbox,
+                  nodes[i].bcone,
+                  knode.bounding_box_min,
+                  knode.bounding_box_max,
+                  knode.axis);
+      knode.theta_o = nodes[i].bcone.theta_o;
+      knode.theta_e = nodes[i].bcone.theta_e;
+      knode.energy = nodes[i].energy;
+      knode.child_index = nodes[i].child_index;
+      knode.num_emitters = nodes[i].num_emitters;
+      knode.parent_index = nodes[i].parent_index;
+    }
+
+    kemitters.resize(emitters.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+      for (int j = 0; j < nodes[i].num_emitters; j++) {
+        const LightTreeEmitter &emitter = emitters[nodes[i].child_index + j];
+        KernelLightTreeEmitter &kemitter = kemitters[nodes[i].child_index + j];
+        pack_bounds(emitter.bbox,
+                    emitter.bcone,
+                    kemitter.bounding_box_min,
+                    kemitter.bounding_box_max,
+                    kemitter.axis);
+        kemitter.theta_o = emitter.bcone.theta_o;
+        kemitter.theta_e = emitter.bcone.theta_e;
+        kemitter.energy = emitter.energy;
+        kemitter.distribution_id = emitter.distribution_id;
+        kemitter.parent_index = i;
+        kemitter.pdf_flat = 1.0f / emitters.size();
+      }
+    }
+
+    memset((void *)&kg, 0, sizeof(kg));
+    kg.__light_tree_nodes.data = knodes.data();
+    kg.__light_tree_nodes.width = knodes.size();
+    kg.__light_tree_emitters.data = kemitters.data();
+    kg.__light_tree_emitters.width = kemitters.size();
+    kg.__data.integrator.use_light_tree = true;
+    kg.__data.integrator.num_light_tree_emitters = kemitters.size();
+    kg.__data.integrator.num_light_tree_infinite = 0;
+    kg.__data.integrator.pdf_light_tree = 1.0f;
+  }
+
+  KernelGlobals kg;
+
+ protected:
+  vector<KernelLightTreeNode> knodes;
+  vector<KernelLightTreeEmitter> kemitters;
+};
+
+bool bbox_contains(const BoundBox &a, const BoundBox &b)
+{
+  return a.min.x <= b.min.x && a.min.y <= b.min.y && a.min.z <= b.min.z && a.max.x >= b.max.x &&
+         a.max.y >= b.max.y && a.max.z >= b.max.z;
+}
+
+/* Unshadowed irradiance at the point, from point lights facing in all directions. */
+float irradiance(const vector<LightTreeEmitter> &emitters, int emitter_index, const float3 P)
+{
+  const LightTreeEmitter &emitter = emitters[emitter_index];
+  const float3 D = emitter.bbox.center() - P;
+  const float cos_theta = fmaxf(D.z, 0.0f) / len(D);
+  return emitter.energy * cos_theta / len_squared(D);
+}
+
+}  // namespace
+
+TEST(render_light_tree, merge_orientation_bounds)
+{
+  const OrientationBounds up(make_float3(0.0f, 0.0f, 1.0f), 0.0f, M_PI_2_F);
+  const OrientationBounds side(make_float3(1.0f, 0.0f, 0.0f), 0.1f, 0.2f);
+  const OrientationBounds down(make_float3(0.0f, 0.0f, -1.0f), 0.0f, M_PI_2_F);
+
+  const OrientationBounds up_side = merge(up, side);
+  EXPECT_NEAR(up_side.theta_o, (M_PI_2_F + 0.1f) * 0.5f, 1e-5f);
+  EXPECT_NEAR(up_side.theta_e, M_PI_2_F, 1e-5f);
+  /* Both axes are inside of the merged cone. */
+  EXPECT_LE(acosf(dot(up_side.axis, up.axis)), up_side.theta_o + 1e-5f);
+  EXPECT_LE(acosf(dot(up_side.axis, side.axis)) + side.theta_o, up_side.theta_o + 1e-5f);
+
+  EXPECT_NEAR(merge(up, down).theta_o, M_PI_F, 1e-5f);
+  EXPECT_NEAR(merge(up_side, up).theta_o, up_side.theta_o, 1e-5f);
+  EXPECT_NEAR(merge(OrientationBounds::empty, side).theta_o, side.theta_o, 1e-5f);
+
+  /* A cone that contains more directions has a larger measure. */
+  EXPECT_LT(up.calculate_measure(), up_side.calculate_measure());
+  EXPECT_LT(up_side.calculate_measure(), merge(up, down).calculate_measure());
+}
+
+TEST(render_light_tree, build)
+{
+  vector<LightTreeEmitter> emitters = create_city_lights(40);
+  const int max_emitters_in_leaf = 8;
+  LightTree light_tree(emitters, max_emitters_in_leaf);
+  const vector<LightTreeNode> &nodes = light_tree.get_nodes();
+
+  ASSERT_FALSE(nodes.empty());
+  EXPECT_EQ(nodes[0].parent_index, -1);
+
+  /* Every emitter is in exactly one leaf. */
+  vector<int> emitter_users(emitters.size(), 0);
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const LightTreeNode &node = nodes[i];
+    if (node.is_leaf()) {
+      EXPECT_LE(node.num_emitters, max_emitters_in_leaf);
+      float energy = 0.0f;
+      for (int j = 0; j < node.num_emitters; j++) {
+        const LightTreeEmitter &emitter = emitters[node.child_index + j];
+        EXPECT_TRUE(bbox_contains(node.bbox, emitter.bbox));
+        emitter_users[node.child_index + j]++;
+        energy += emitter.energy;
+      }
+      EXPECT_NEAR(node.energy, energy, 1e-3f);
+      continue;
+    }
+
+    const LightTreeNode &left = nodes[i + 1];
+    const LightTreeNode &right = nodes[node.child_index];
+    EXPECT_EQ(left.parent_index, i);
+    EXPECT_EQ(right.parent_index, i);
+    EXPECT_TRUE(bbox_contains(node.bbox, left.bbox));
+    EXPECT_TRUE(bbox_contains(node.bbox, right.bbox));
+    EXPECT_NEAR(node.energy, left.energy + right.energy, 1e-2f);
+  }
+  for (const int users : emitter_users) {
+    EXPECT_EQ(users, 1);
+  }
+}
+
+TEST(render_light_tree, sample_pdf)
+{
+  vector<LightTreeEmitter> emitters = create_city_lights(20);
+  LightTree light_tree(emitters);
+  LightTreeKernelData data(emitters, light_tree);
+  KernelGlobals *kg = &data.kg;
+
+  for (int i = 0; i < 10; i++) {
+    const float3 P = make_float3(
+        hash_uint2_to_float(i, 0) * 200.0f, hash_uint2_to_float(i, 1) * 200.0f, 0.0f);
+
+    /* The probabilities of all emitters add up to one. */
+    float total_pdf = 0.0f;
+    for (size_t j = 0; j < emitters.size(); j++) {
+      total_pdf += light_tree_emitter_pdf(kg, P, j);
+    }
+    EXPECT_NEAR(total_pdf, 1.0f, 1e-4f);
+
+    /* The probability of sampling an emitter matches the probability that is computed for it. */
+    for (int j = 0; j < 100; j++) {
+      float randu = hash_uint3_to_float(i, j, 2);
+      float pdf;
+      const int emitter_index = light_tree_sample_emitter(kg, P, &randu, &pdf);
+      ASSERT_GE(emitter_index, 0);
+      EXPECT_NEAR(pdf, light_tree_emitter_pdf(kg, P, emitter_index), 1e-5f);
+      EXPECT_GE(randu, 0.0f);
+      EXPECT_LT(randu, 1.0f);
+      EXPECT_NEAR(light_tree_pdf_factor(kg, P, emitter_index),
+                  pdf * emitters.size(),
+                  1e-3f * pdf * emitters.size());
+    }
+  }
+}
+
+/* Estimate the irradiance from many lights with the same number of samples for both methods, and
+ * compare the relative error. In a render every sample also traces a shadow ray and evaluates the
+ * light, which is much more expensive than selecting the light. */
+TEST(render_light_tree_performance, city_lights)
+{
+  vector<LightTreeEmitter> emitters = create_city_lights(224);
+  const int num_emitters = emitters.size();
+
+  double build_time = time_dt();
+  LightTree light_tree(emitters);
+  build_time = time_dt() - build_time;
+  LightTreeKernelData data(emitters, light_tree);
+  KernelGlobals *kg = &data.kg;
+
+  const int num_points = 64;
+  const int num_samples = 1024;
+  double flat_error = 0.0;
+  double tree_error = 0.0;
+  double flat_time = 0.0;
+  double tree_time = 0.0;
+  for (int i = 0; i < num_points; i++) {
+    const float3 P = make_float3(hash_uint2_to_float(i, 0) * 2240.0f,
+                                 hash_uint2_to_float(i, 1) * 2240.0f,
+                                 0.0f);
+    double reference = 0.0;
+    for (int j = 0; j < num_emitters; j++) {
+      reference += irradiance(emitters, j, P);
+    }
+
+    /* Uniform light selection, like the flat light distribution for lights of the same size. */
+    double sum = 0.0;
+    double start_time = time_dt();
+    for (int j = 0; j < num_samples; j++) {
+      const float randu = hash_uint3_to_float(i, j, 0);
+      const int emitter_index = min((int)(randu * num_emitters), num_emitters - 1);
+      sum += irradiance(emitters, emitter_index, P) * num_emitters;
+    }
+    flat_time += time_dt() - start_time;
+    flat_error += std::abs(sum / num_samples - reference) / reference;
+
+    sum = 0.0;
+    start_time = time_dt();
+    for (int j = 0; j < num_samples; j++) {
+      float randu = hash_uint3_to_float(i, j, 1);
+      float pdf;
+      const int emitter_index = light_tree_sample_emitter(kg, P, &randu, &pdf);
+      if (emitter_index >= 0) {
+        sum += irradiance(emitters, emitter_index, P) / pdf;
+      }
+    }
+    tree_time += time_dt() - start_time;
+    tree_error += std::abs(sum / num_samples - reference) / reference;
+  }
+
+  const double num_total_samples = (double)num_points * num_samples;
+  printf("%d lights, tree with %d nodes built in %fs\n",
+         num_emitters,
+         (int)light_tree.get_nodes().size(),
+         build_time);
+  printf("Flat distribution: %fus per sample, mean relative error %f\n",
+         flat_time / num_total_samples * 1e6,
+         flat_error / num_points);
+  printf("Light tree: %fus per sample, mean relative error %f\n",
+         tree_time / num_total_samples * 1e6,
+         tree_error / num_points);
+  EXPECT_LT(tree_error, flat_error);
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "device/device.h"
+
+#include "render/integrator.h"
+#include "render/mesh.h"
+#include "render/object.h"
+#include "render/scene.h"
+#include "render/stats.h"
+
+#include "util/util_foreach.h"
+#include "util/util_progress.h"
+#include "util/util_transform.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+array<Transform> create_motion(float3 offset, int steps = 3)
+{
+  array<Transform> motion;
+  for (int step = 0; step < steps; step++) {
+    motion.push_back_slow(transform_translate(offset * (float)step) *
+                          transform_rotate(0.1f * step, make_float3(0.0f, 0.0f, 1.0f)));
+  }
+  return motion;
+}
+
+}  // namespace
+
+class RenderObjectMotion : public testing::Test {
+ protected:
+  Stats stats;
+  Profiler profiler;
+  DeviceInfo device_info;
+  Device *device_cpu;
+  SceneParams scene_params;
+  Scene *scene;
+  Mesh *mesh;
+  Progress progress;
+
+  virtual void SetUp()
+  {
+    device_cpu = Device::create(device_info, stats, profiler, true);
+    scene = new Scene(scene_params, device_cpu);
+    scene->integrator->set_motion_blur(true);
+    mesh = scene->create_node<Mesh>();
+  }
+
+  virtual void TearDown()
+  {
+    delete scene;
+    delete device_cpu;
+  }
+
+  Object *add_object(const array<Transform> &motion)
+  {
+    Object *object = scene->create_node<Object>();
+    object->set_geometry(mesh);
+    object->set_tfm(transform_identity());
+    set_motion(object, motion);
+    return object;
+  }
+
+  void set_motion(Object *object, const array<Transform> &motion)
+  {
+    array<Transform> motion_copy = motion;
+    object->set_motion(motion_copy);
+  }
+
+  void update()
+  {
+    foreach (Object *object, scene->objects) {
+      if (object->is_modified()) {
+        object->tag_update(scene);
+      }
+    }
+    ObjectManager *object_manager = scene->object_manager;
+    object_manager->device_update(device_cpu, &scene->dscene, scene, progress);
+    object_manager->device_update_flags(device_cpu, &scene->dscene, scene, progress, false);
+  }
+
+  uint motion_offset(const Object *object)
+  {
+    return scene->dscene.objects[object->get_device_index()].motion_offset;
+  }
+
+  /* Decomposed motion in the device array must match the motion of every object. */
+  void check_motion()
+  {
+    foreach (Object *object, scene->objects) {
+      if (!object->use_motion()) {
+        continue;
+      }
+      const array<Transform> &motion = object->get_motion();
+      vector<DecomposedTransform> expected(motion.size());
+      transform_motion_decompose(expected.data(), motion.data(), motion.size());
+
+      const uint offset = motion_offset(object);
+      ASSERT_LE(offset + motion.size(), scene->dscene.object_motion.size());
+      const DecomposedTransform *decomp = scene->dscene.object_motion.data() + offset;
+      for (size_t step = 0; step < motion.size(); step++) {
+        EXPECT_EQ(memcmp(&expected[step], &decomp[step], sizeof(DecomposedTransform)), 0)
+            << "object " << object->get_device_index() << " step " << step;
+      }
+    }
+  }
+};
+
+TEST_F(RenderObjectMotion, offsets_reused)
+{
+  Object *a = add_object(create_motion(make_float3(1.0f, 0.0f, 0.0f)));
+  Object *b = add_object(array<Transform>());
+  Object *c = add_object(create_motion(make_float3(0.0f, 1.0f, 0.0f), 5));
+  update();
+
+  /* Objects without motion take no space, the others are packed one after the other. */
+  EXPECT_EQ(motion_offset(a), 0);
+  EXPECT_EQ(motion_offset(b), 0);
+  EXPECT_EQ(motion_offset(c), 3);
+  EXPECT_EQ(scene->dscene.object_motion.size(), 8);
+  check_motion();
+
+  /* Without changes the offsets and the array stay the same. */
+  const DecomposedTransform *object_motion = scene->dscene.object_motion.data();
+  update();
+  EXPECT_EQ(motion_offset(a), 0);
+  EXPECT_EQ(motion_offset(c), 3);
+  EXPECT_EQ(scene->dscene.object_motion.data(), object_motion);
+  check_motion();
+}
+
+TEST_F(RenderObjectMotion, redecompose_changed_object)
+{
+  /* Objects moving the same way used to share their decomposed motion, changing one of them
+   * must not affect the others. */
+  const array<Transform> motion = create_motion(make_float3(1.0f, 0.0f, 0.0f));
+  Object *a = add_object(motion);
+  Object *b = add_object(motion);
+  Object *c = add_object(motion);
+  update();
+  check_motion();
+
+  set_motion(b, create_motion(make_float3(0.0f, 0.0f, 1.0f)));
+  update();
+  EXPECT_EQ(motion_offset(a), 0);
+  EXPECT_EQ(motion_offset(b), 3);
+  EXPECT_EQ(motion_offset(c), 6);
+  check_motion();
+}
+
+TEST_F(RenderObjectMotion, redecompose_moved_offsets)
+{
+  Object *a = add_object(create_motion(make_float3(1.0f, 0.0f, 0.0f)));
+  Object *b = add_object(create_motion(make_float3(0.0f, 1.0f, 0.0f)));
+  Object *c = add_object(create_motion(make_float3(0.0f, 0.0f, 1.0f)));
+  update();
+  check_motion();
+
+  /* The first object stops moving, so the motion of the unmodified objects moves too. */
+  set_motion(a, array<Transform>());
+  update();
+  EXPECT_EQ(motion_offset(b), 0);
+  EXPECT_EQ(motion_offset(c), 3);
+  check_motion();
+
+  /* The last object uses more steps, which reallocates the array without moving offsets. */
+  set_motion(c, create_motion(make_float3(0.0f, 0.0f, 1.0f), 5));
+  update();
+  EXPECT_EQ(motion_offset(b), 0);
+  EXPECT_EQ(motion_offset(c), 3);
+  check_motion();
+
+  /* Freeing the device array loses the decomposed motion of all objects. */
+  scene->dscene.object_motion.free();
+  scene->object_manager->tag_update(scene, ObjectManager::MOTION_BLUR_MODIFIED);
+  update();
+  check_motion();
+}
+
+CCL_NAMESPACE_END
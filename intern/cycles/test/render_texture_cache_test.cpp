@@ -0,0 +1,306 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "render/image.h"
+#include "render/texture_cache.h"
+
+#include "util/util_hash.h"
+#include "util/util_image.h"
+#include "util/util_path.h"
+#include "util/util_thread.h"
+#include "util/util_unique_ptr.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Size of the test images and of their tiles, in pixels. */
+const int IMAGE_SIZE = 256;
+const int TILE_SIZE = 64;
+const int TILES_PER_ROW = IMAGE_SIZE / TILE_SIZE;
+/* Memory of a tile with 4 byte channels. */
+const size_t TILE_MEMORY = TILE_SIZE * TILE_SIZE * 4;
+
+/* The red and green channel store the position of the pixel, the first row is at the top. */
+void fill_test_pixels(uchar *pixels, const int size)
+{
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      uchar *pixel = pixels + ((size_t)y * size + x) * 4;
+      pixel[0] = (uchar)x;
+      pixel[1] = (uchar)y;
+      pixel[2] = 0;
+      pixel[3] = 255;
+    }
+  }
+}
+
+/* Write a tiled and mipmapped file, so that the cache reads it one tile at a time. */
+bool write_tiled_image(const string &filepath)
+{
+  unique_ptr<ImageOutput> out(ImageOutput::create(filepath));
+  if (!out || !out->supports("tiles") || !out->supports("mipmap")) {
+    return false;
+  }
+
+  ImageSpec spec(IMAGE_SIZE, IMAGE_SIZE, 4, TypeDesc::UINT8);
+  spec.tile_width = TILE_SIZE;
+  spec.tile_height = TILE_SIZE;
+  ImageOutput::OpenMode mode = ImageOutput::Create;
+  for (int size = IMAGE_SIZE; size >= 1; size /= 2) {
+    spec.width = spec.full_width = size;
+    spec.height = spec.full_height = size;
+    vector<uchar> pixels((size_t)size * size * 4);
+    fill_test_pixels(pixels.data(), size);
+    if (!out->open(filepath, spec, mode) || !out->write_image(TypeDesc::UINT8, pixels.data())) {
+      return false;
+    }
+    mode = ImageOutput::AppendMIPLevel;
+  }
+  return out->close();
+}
+
+/* Loader of the test image. Tiles are read from the file when it has a file path, otherwise the
+ * cache converts the pixels of the loader to a tiled file. */
+class TestImageLoader : public ImageLoader {
+ public:
+  explicit TestImageLoader(const string &filepath) : filepath(filepath), num_loads(0)
+  {
+  }
+
+  bool load_metadata(ImageMetaData &metadata) override
+  {
+    metadata.width = IMAGE_SIZE;
+    metadata.height = IMAGE_SIZE;
+    metadata.depth = 1;
+    metadata.channels = 4;
+    metadata.type = IMAGE_DATA_TYPE_BYTE4;
+    return true;
+  }
+
+  bool load_pixels(const ImageMetaData & /*metadata*/,
+                   void *pixels,
+                   const size_t /*pixels_size*/,
+                   const bool /*associate_alpha*/) override
+  {
+    /* Images are loaded with the first row at the bottom. */
+    vector<uchar> file_pixels((size_t)IMAGE_SIZE * IMAGE_SIZE * 4);
+    fill_test_pixels(file_pixels.data(), IMAGE_SIZE);
+    const size_t row_size = (size_t)IMAGE_SIZE * 4;
+    for (int y = 0; y < IMAGE_SIZE; y++) {
+      memcpy((uchar *)pixels + y * row_size,
+             file_pixels.data() + (IMAGE_SIZE - 1 - y) * row_size,
+             row_size);
+    }
+    num_loads++;
+    return true;
+  }
+
+  string name() const override
+  {
+    return "texture_cache_test";
+  }
+
+  ustring osl_filepath() const override
+  {
+    return ustring(filepath);
+  }
+
+  bool equals(const ImageLoader & /*other*/) const override
+  {
+    return false;
+  }
+
+  string filepath;
+  std::atomic<int> num_loads;
+};
+
+class TextureCacheTest : public testing::Test {
+ protected:
+  void TearDown() override
+  {
+    if (image) {
+      cache->remove_image(image);
+    }
+    if (!filepath.empty()) {
+      path_remove(filepath);
+    }
+  }
+
+  /* Add the test image, read from a tiled file or converted by the cache. */
+  void add_image(const size_t max_memory, const bool use_file)
+  {
+    if (use_file) {
+      filepath = path_join(testing::TempDir(), "cycles_texture_cache_test.tif");
+      ASSERT_TRUE(write_tiled_image(filepath));
+    }
+    loader.reset(new TestImageLoader(filepath));
+    cache.reset(new TextureCache(max_memory));
+
+    ImageMetaData metadata;
+    loader->load_metadata(metadata);
+    ImageParams params;
+    params.interpolation = INTERPOLATION_CLOSEST;
+    image = cache->add_image(loader.get(), metadata, params, true, 0);
+    ASSERT_NE(image, nullptr);
+  }
+
+  /* Returns false when the lookup at the center of the pixel does not give its position. */
+  bool lookup_pixel(const int x, const int y) const
+  {
+    float result[4];
+    image->lookup((x + 0.5f) / IMAGE_SIZE,
+                  1.0f - (y + 0.5f) / IMAGE_SIZE,
+                  make_float2(0.0f, 0.0f),
+                  make_float2(0.0f, 0.0f),
+                  result);
+    return (int)(result[0] * 255.0f + 0.5f) == x && (int)(result[1] * 255.0f + 0.5f) == y;
+  }
+
+  bool lookup_tile(const int tile_x, const int tile_y) const
+  {
+    return lookup_pixel(tile_x * TILE_SIZE + TILE_SIZE / 2, tile_y * TILE_SIZE + TILE_SIZE / 2);
+  }
+
+  string filepath;
+  unique_ptr<TestImageLoader> loader;
+  unique_ptr<TextureCache> cache;
+  TextureCacheImage *image = nullptr;
+};
+
+}  // namespace
+
+TEST_F(TextureCacheTest, evict_least_recently_used)
+{
+  add_image(4 * TILE_MEMORY, true);
+
+  for (int tile_y = 0; tile_y < TILES_PER_ROW; tile_y++) {
+    for (int tile_x = 0; tile_x < TILES_PER_ROW; tile_x++) {
+      EXPECT_TRUE(lookup_tile(tile_x, tile_y));
+      EXPECT_LE(cache->memory_size(), 4 * TILE_MEMORY);
+    }
+  }
+
+  EXPECT_EQ(cache->num_tiles_loaded(), (size_t)(TILES_PER_ROW * TILES_PER_ROW));
+  EXPECT_GT(cache->num_tiles_evicted(), (size_t)0);
+  EXPECT_FALSE(image->is_tile_loaded(0, 0, 0));
+  EXPECT_TRUE(image->is_tile_loaded(0, TILES_PER_ROW - 1, TILES_PER_ROW - 1));
+  EXPECT_EQ(cache->memory_size(), cache->memory_size(image));
+}
+
+TEST_F(TextureCacheTest, tile_in_use_not_evicted)
+{
+  add_image(2 * TILE_MEMORY, true);
+
+  {
+    /* The fetch keeps a user of the first tile while the other tiles are loaded. */
+    TextureCacheFetch fetch(*image);
+    EXPECT_EQ((int)(fetch.read(0, 0, 0).x * 255.0f + 0.5f), 0);
+
+    for (int tile_y = 0; tile_y < TILES_PER_ROW; tile_y++) {
+      for (int tile_x = 0; tile_x < TILES_PER_ROW; tile_x++) {
+        EXPECT_TRUE(lookup_tile(tile_x, tile_y));
+      }
+    }
+
+    EXPECT_GT(cache->num_tiles_evicted(), (size_t)0);
+    EXPECT_TRUE(image->is_tile_loaded(0, 0, 0));
+    const float4 pixel = fetch.read(0, 1, 2);
+    EXPECT_EQ((int)(pixel.x * 255.0f + 0.5f), 1);
+    EXPECT_EQ((int)(pixel.y * 255.0f + 0.5f), 2);
+  }
+
+  /* Without users, the tile is the least recently used one. */
+  for (int tile_x = 1; tile_x < TILES_PER_ROW; tile_x++) {
+    EXPECT_TRUE(lookup_tile(tile_x, 0));
+  }
+  EXPECT_FALSE(image->is_tile_loaded(0, 0, 0));
+}
+
+TEST_F(TextureCacheTest, concurrent_lookup)
+{
+  add_image(4 * TILE_MEMORY, true);
+
+  const int num_threads = 8;
+  const int num_lookups = 4096;
+  std::atomic<int> num_errors(0);
+  vector<unique_ptr<thread>> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(new thread([&, i]() {
+      for (int j = 0; j < num_lookups; j++) {
+        const uint hash = hash_uint2(i, j);
+        if (!lookup_pixel(hash % IMAGE_SIZE, (hash >> 16) % IMAGE_SIZE)) {
+          num_errors++;
+        }
+      }
+    }));
+  }
+  for (unique_ptr<thread> &t : threads) {
+    t->join();
+  }
+
+  EXPECT_EQ(num_errors.load(), 0);
+  EXPECT_GT(cache->num_tiles_evicted(), (size_t)0);
+  EXPECT_EQ(cache->memory_size(), cache->memory_size(image));
+}
+
+TEST_F(TextureCacheTest, used_tile_kept)
+{
+  add_image(8 * TILE_MEMORY, true);
+
+  /* Loading the ninth tile evicts the first three. */
+  for (int i = 0; i < 9; i++) {
+    EXPECT_TRUE(lookup_tile(i % TILES_PER_ROW, i / TILES_PER_ROW));
+  }
+  EXPECT_FALSE(image->is_tile_loaded(0, 2, 0));
+  EXPECT_TRUE(image->is_tile_loaded(0, 3, 0));
+
+  /* The fourth tile is used again, so the tiles loaded after it are evicted first. */
+  EXPECT_TRUE(lookup_tile(3, 0));
+  for (int i = 9; i < 12; i++) {
+    EXPECT_TRUE(lookup_tile(i % TILES_PER_ROW, i / TILES_PER_ROW));
+  }
+  EXPECT_TRUE(image->is_tile_loaded(0, 3, 0));
+  EXPECT_FALSE(image->is_tile_loaded(0, 0, 1));
+  EXPECT_FALSE(image->is_tile_loaded(0, 2, 1));
+  EXPECT_TRUE(image->is_tile_loaded(0, 3, 1));
+  EXPECT_LE(cache->memory_size(), 8 * TILE_MEMORY);
+}
+
+TEST_F(TextureCacheTest, untiled_image_converted_once)
+{
+  /* The image is converted to a tiled file when it is first used. After that its tiles are read
+   * from that file and evicted like those of tiled files, so the budget is respected. */
+  add_image(4 * TILE_MEMORY, false);
+
+  for (int i = 0; i < 2; i++) {
+    for (int tile_y = 0; tile_y < TILES_PER_ROW; tile_y++) {
+      for (int tile_x = 0; tile_x < TILES_PER_ROW; tile_x++) {
+        EXPECT_TRUE(lookup_tile(tile_x, tile_y));
+        EXPECT_LE(cache->memory_size(), 4 * TILE_MEMORY);
+      }
+    }
+  }
+
+  EXPECT_EQ(loader->num_loads.load(), 1);
+  EXPECT_GT(cache->num_tiles_evicted(), (size_t)0);
+  EXPECT_EQ(cache->memory_size(), cache->memory_size(image));
+}
+
+CCL_NAMESPACE_END
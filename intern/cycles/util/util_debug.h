@@ -82,6 +82,10 @@ class DebugFlags {
 
     /* Whether split kernel is used */
     bool split_kernel;
+
+    /* Number of paths each thread keeps in flight with the split kernel. Every kernel stage
+     * runs over all of them before the next stage starts. */
+    int split_kernel_paths;
   };
 
   /* Descriptor of CUDA feature-set to be used. */
@@ -21,7 +21,7 @@
 
 CCL_NAMESPACE_BEGIN
 
-Profiler::Profiler() : do_stop_worker(true), worker(NULL)
+Profiler::Profiler() : shader_evals(0), shader_switches(0), do_stop_worker(true), worker(NULL)
 {
 }
 
@@ -82,6 +82,8 @@ void Profiler::reset(int num_shaders, int num_objects)
   /* Resize and clear the accumulation vectors. */
   shader_hits.assign(num_shaders, 0);
   object_hits.assign(num_objects, 0);
+  shader_evals = 0;
+  shader_switches = 0;
 
   event_samples.assign(PROFILING_NUM_EVENTS, 0);
   shader_samples.assign(num_shaders, 0);
@@ -121,6 +123,9 @@ void Profiler::add_state(ProfilingState *state)
   /* Resize thread-local hit counters. */
   state->shader_hits.assign(shader_hits.size(), 0);
   state->object_hits.assign(object_hits.size(), 0);
+  state->last_eval_shader = -1;
+  state->shader_evals = 0;
+  state->shader_switches = 0;
 
   /* Initialize the state. */
   state->event = PROFILING_UNKNOWN;
@@ -147,6 +152,9 @@ void Profiler::remove_state(ProfilingState *state)
   for (int i = 0; i < object_hits.size(); i++) {
     object_hits[i] += state->object_hits[i];
   }
+
+  shader_evals += state->shader_evals;
+  shader_switches += state->shader_switches;
 }
 
 uint64_t Profiler::get_event(ProfilingEvent event)
@@ -177,4 +185,11 @@ bool Profiler::get_object(int object, uint64_t &samples, uint64_t &hits)
   return true;
 }
 
+void Profiler::get_shader_switches(uint64_t &evals, uint64_t &switches)
+{
+  assert(worker == NULL);
+  evals = shader_evals;
+  switches = shader_switches;
+}
+
 CCL_NAMESPACE_END
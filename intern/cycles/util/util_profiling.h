@@ -85,6 +85,12 @@ struct ProfilingState {
 
   vector<uint64_t> shader_hits;
   vector<uint64_t> object_hits;
+
+  /* Number of shader evaluations for surface hits, and how many of them used a different shader
+   * than the previous one on this thread. Reset in Profiler::add_state(). */
+  int32_t last_eval_shader;
+  uint64_t shader_evals;
+  uint64_t shader_switches;
 };
 
 class Profiler {
@@ -103,6 +109,7 @@ class Profiler {
   uint64_t get_event(ProfilingEvent event);
   bool get_shader(int shader, uint64_t &samples, uint64_t &hits);
   bool get_object(int object, uint64_t &samples, uint64_t &hits);
+  void get_shader_switches(uint64_t &evals, uint64_t &switches);
 
  protected:
   void run();
@@ -121,6 +128,10 @@ class Profiler {
   vector<uint64_t> shader_hits;
   vector<uint64_t> object_hits;
 
+  /* Totals of the per thread shader evaluation and switch counters. */
+  uint64_t shader_evals;
+  uint64_t shader_switches;
+
   volatile bool do_stop_worker;
   thread *worker;
 
@@ -150,6 +161,17 @@ class ProfilingHelper {
     }
   }
 
+  inline void count_shader_switch(int shader)
+  {
+    if (state->active) {
+      state->shader_evals++;
+      if (shader != state->last_eval_shader) {
+        state->last_eval_shader = shader;
+        state->shader_switches++;
+      }
+    }
+  }
+
   inline void set_object(int object)
   {
     state->object = object;
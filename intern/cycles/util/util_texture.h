@@ -59,6 +59,9 @@ typedef enum ImageDataType {
   IMAGE_DATA_TYPE_USHORT = 7,
   IMAGE_DATA_TYPE_NANOVDB_FLOAT = 8,
   IMAGE_DATA_TYPE_NANOVDB_FLOAT3 = 9,
+  IMAGE_DATA_TYPE_SPARSE_FLOAT = 10,
+  IMAGE_DATA_TYPE_SPARSE_FLOAT3 = 11,
+  IMAGE_DATA_TYPE_TEXTURE_CACHE = 12,
 
   IMAGE_DATA_NUM_TYPES
 } ImageDataType;
@@ -108,6 +111,46 @@ typedef struct TextureInfo {
   Transform transform_3d;
 } TextureInfo;
 
+#ifndef __KERNEL_GPU__
+/* Lookup of an image in the texture cache of the CPU device, the data of the texture info points
+ * to the image. The derivatives of the texture coordinates select the mipmap level. The result is
+ * written to an array since the kernels compiled for different instruction sets don't pass float4
+ * the same way as the cache. */
+typedef void (*TextureCacheLookupFunction)(const void *image,
+                                           float x,
+                                           float y,
+                                           float dx_x,
+                                           float dx_y,
+                                           float dy_x,
+                                           float dy_y,
+                                           float result[4]);
+#endif
+
+/* Sparse 3D textures
+ *
+ * The voxels are stored in tiles of 8x8x8 voxels, which match the leaf nodes of OpenVDB. The
+ * data starts with the header, followed by a table with the block index of every tile and the
+ * blocks with the voxels of the tiles. The first block contains the background value, all tiles
+ * with only background values use it, so that empty space takes no memory. */
+#define SPARSE_TILE_SHIFT 3
+#define SPARSE_TILE_SIZE (1 << SPARSE_TILE_SHIFT)
+#define SPARSE_TILE_MASK (SPARSE_TILE_SIZE - 1)
+#define SPARSE_TILE_VOXELS (SPARSE_TILE_SIZE * SPARSE_TILE_SIZE * SPARSE_TILE_SIZE)
+
+typedef struct SparseTextureHeader {
+  /* Dimensions of the texture in voxels. */
+  int width, height, depth;
+  /* Position of the first voxel of the texture in the first tile. */
+  int offset_x, offset_y, offset_z;
+  /* Number of tiles in every dimension. */
+  int tiles_x, tiles_y, tiles_z;
+  /* Number of entries in the tile table, padded to keep the voxels aligned. */
+  int table_size;
+  /* Number of voxel blocks, including the background block. */
+  int num_blocks;
+  int pad;
+} SparseTextureHeader;
+
 CCL_NAMESPACE_END
 
 #endif /* __UTIL_TEXTURE_H__ */
@@ -108,11 +108,63 @@ class ReadAttribute {
     return this->get_span().typed<T>();
   }
 
+  /* True when all elements have the same value, which can be retrieved with #get_single. */
+  bool is_single() const
+  {
+    return this->is_single_internal();
+  }
+
+  /* r_value is expected to be uninitialized. */
+  void get_single(void *r_value) const
+  {
+    BLI_assert(this->is_single());
+    this->get_internal(0, r_value);
+  }
+
+  /* True when #get_span does not have to copy the attribute values. */
+  bool is_span() const
+  {
+    return this->is_span_internal();
+  }
+
+  /* Get the attribute values when they are stored in memory with a constant distance in bytes
+   * between them, e.g. the positions in an array of #MVert. */
+  bool try_get_strided(const void **r_data, int64_t *r_stride) const
+  {
+    return this->try_get_strided_internal(r_data, r_stride);
+  }
+
+  /* Copy the values in the range into the uninitialized buffer. This is much faster than calling
+   * #get for every index, because there is only one virtual call. */
+  void materialize_to_uninitialized(const IndexRange range, void *r_values) const
+  {
+    BLI_assert(range.one_after_last() <= size_);
+    this->materialize_internal(range, r_values);
+  }
+
  protected:
   /* r_value is expected to be uninitialized. */
   virtual void get_internal(const int64_t index, void *r_value) const = 0;
 
   virtual void initialize_span() const;
+
+  virtual bool is_single_internal() const
+  {
+    return false;
+  }
+
+  virtual bool is_span_internal() const
+  {
+    return false;
+  }
+
+  virtual bool try_get_strided_internal(const void **UNUSED(r_data),
+                                        int64_t *UNUSED(r_stride)) const
+  {
+    return false;
+  }
+
+  virtual void materialize_internal(const IndexRange range, void *r_values) const;
 };
 
 /**
@@ -205,6 +257,91 @@ class WriteAttribute {
 using ReadAttributePtr = std::unique_ptr<ReadAttribute>;
 using WriteAttributePtr = std::unique_ptr<WriteAttribute>;
 
+/* Gives access to an attribute whose elements all have the same value, like a span would. */
+template<typename T> class SingleValueAttributeSpan {
+ private:
+  T value_;
+  int64_t size_;
+
+ public:
+  SingleValueAttributeSpan(T value, const int64_t size) : value_(std::move(value)), size_(size)
+  {
+  }
+
+  int64_t size() const
+  {
+    return size_;
+  }
+
+  const T &operator[](const int64_t UNUSED(index)) const
+  {
+    return value_;
+  }
+};
+
+/* Gives access to attribute values that are stored with a constant distance in bytes between
+ * them, like a span would. */
+template<typename T> class StridedAttributeSpan {
+ private:
+  const void *data_;
+  int64_t stride_;
+  int64_t size_;
+
+ public:
+  StridedAttributeSpan(const void *data, const int64_t stride, const int64_t size)
+      : data_(data), stride_(stride), size_(size)
+  {
+  }
+
+  int64_t size() const
+  {
+    return size_;
+  }
+
+  const T &operator[](const int64_t index) const
+  {
+    BLI_assert(index >= 0);
+    BLI_assert(index < size_);
+    return *static_cast<const T *>(POINTER_OFFSET(data_, stride_ * index));
+  }
+};
+
+/**
+ * Call the function with an object that gives access to the attribute values with `operator[]`
+ * and `size()`. Depending on how the attribute is stored, that is a #SingleValueAttributeSpan, a
+ * #StridedAttributeSpan or a #Span. The function is instantiated for all of these, so that the
+ * element access can be inlined, instead of doing a virtual call for every element. Attributes
+ * that are stored differently are copied into a span first.
+ *
+ * Example:
+ *   attribute_devirtualize<float>(attribute, [&](const auto &values) {
+ *     for (const int i : IndexRange(values.size())) {
+ *       r_result[i] = values[i] * 2.0f;
+ *     }
+ *   });
+ */
+template<typename T, typename Func>
+void attribute_devirtualize(const ReadAttribute &attribute, const Func &func)
+{
+  BLI_assert(attribute.cpp_type().template is<T>());
+  if (attribute.is_single()) {
+    TypedBuffer<T> buffer;
+    T *value_ptr = buffer;
+    attribute.get_single(value_ptr);
+    T value = std::move(*value_ptr);
+    value_ptr->~T();
+    func(SingleValueAttributeSpan<T>(std::move(value), attribute.size()));
+    return;
+  }
+  const void *strided_data;
+  int64_t stride;
+  if (attribute.try_get_strided(&strided_data, &stride)) {
+    func(StridedAttributeSpan<T>(strided_data, stride, attribute.size()));
+    return;
+  }
+  func(attribute.get_span<T>());
+}
+
 /* This provides type safe access to an attribute.
  * The underlying ReadAttribute is owned optionally. */
 template<typename T> class TypedReadAttribute {
@@ -243,6 +380,12 @@ template<typename T> class TypedReadAttribute {
   {
     return attribute_->get_span().template typed<T>();
   }
+
+  /* See #attribute_devirtualize. */
+  template<typename Func> void devirtualize(const Func &func) const
+  {
+    attribute_devirtualize<T>(*attribute_, func);
+  }
 };
 
 /* This provides type safe access to an attribute.
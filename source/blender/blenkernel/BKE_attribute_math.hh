@@ -253,4 +253,121 @@ template<typename T> using DefaultMixer = typename DefaultMixerStruct<T>::type;
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Mix a dynamic amount of values with weights for a single element.
+ *
+ * Accumulators give the same result as the mixers above, but only compute a single element. They
+ * are used when all values of an element can be looked up at once, e.g. with an offset array.
+ * Then the elements can be computed independently of each other (e.g. in parallel), and no
+ * buffers for the accumulated weights are necessary.
+ * \{ */
+
+template<typename T> class SimpleAccumulator {
+ private:
+  T value_{};
+  float total_weight_ = 0.0f;
+
+ public:
+  void mix_in(const T &value, const float weight = 1.0f)
+  {
+    BLI_assert(weight >= 0.0f);
+    value_ += value * weight;
+    total_weight_ += weight;
+  }
+
+  /**
+   * \param default_value: Result when no value has been mixed in.
+   */
+  T finalize(const T &default_value = {}) const
+  {
+    if (total_weight_ > 0.0f) {
+      return value_ * (1.0f / total_weight_);
+    }
+    return default_value;
+  }
+};
+
+template<typename T, typename AccumulationT, T (*ConvertToT)(const AccumulationT &value)>
+class SimpleAccumulatorWithAccumulationType {
+ private:
+  AccumulationT value_ = {0};
+  float total_weight_ = 0.0f;
+
+ public:
+  void mix_in(const T &value, const float weight = 1.0f)
+  {
+    value_ += static_cast<AccumulationT>(value) * weight;
+    total_weight_ += weight;
+  }
+
+  T finalize(const T &default_value = {}) const
+  {
+    if (total_weight_ > 0.0f) {
+      return ConvertToT(value_ * (1.0f / total_weight_));
+    }
+    return default_value;
+  }
+};
+
+class Color4fAccumulator {
+ private:
+  Color4f color_{0.0f, 0.0f, 0.0f, 0.0f};
+  float total_weight_ = 0.0f;
+
+ public:
+  void mix_in(const Color4f &color, const float weight = 1.0f)
+  {
+    BLI_assert(weight >= 0.0f);
+    color_.r += color.r * weight;
+    color_.g += color.g * weight;
+    color_.b += color.b * weight;
+    color_.a += color.a * weight;
+    total_weight_ += weight;
+  }
+
+  Color4f finalize(const Color4f &default_color = {0, 0, 0, 1}) const
+  {
+    if (total_weight_ > 0.0f) {
+      const float weight_inv = 1.0f / total_weight_;
+      return {color_.r * weight_inv,
+              color_.g * weight_inv,
+              color_.b * weight_inv,
+              color_.a * weight_inv};
+    }
+    return default_color;
+  }
+};
+
+template<typename T> struct DefaultAccumulatorStruct {
+  /* Use void by default. This can be check for in `if constexpr` statements. */
+  using type = void;
+};
+template<> struct DefaultAccumulatorStruct<float> {
+  using type = SimpleAccumulator<float>;
+};
+template<> struct DefaultAccumulatorStruct<float2> {
+  using type = SimpleAccumulator<float2>;
+};
+template<> struct DefaultAccumulatorStruct<float3> {
+  using type = SimpleAccumulator<float3>;
+};
+template<> struct DefaultAccumulatorStruct<Color4f> {
+  using type = Color4fAccumulator;
+};
+template<> struct DefaultAccumulatorStruct<int> {
+  using type = SimpleAccumulatorWithAccumulationType<int,
+                                                     double,
+                                                     DefaultMixerStruct<int>::double_to_int>;
+};
+template<> struct DefaultAccumulatorStruct<bool> {
+  using type = SimpleAccumulatorWithAccumulationType<bool,
+                                                     float,
+                                                     DefaultMixerStruct<bool>::float_to_bool>;
+};
+
+/* Utility to get the accumulator that gives the same result as #DefaultMixer<T>. */
+template<typename T> using DefaultAccumulator = typename DefaultAccumulatorStruct<T>::type;
+
+/** \} */
+
 }  // namespace blender::attribute_math
@@ -151,6 +151,12 @@ class GeometryComponent {
   /* The returned component should be of the same type as the type this is called on. */
   virtual GeometryComponent *copy() const = 0;
 
+  /* True when the geometry is owned by the component and not only referenced, i.e. when it stays
+   * valid independent of where it came from. */
+  virtual bool owns_direct_data() const = 0;
+  /* Copy referenced geometry, so that the component owns all of its data. */
+  virtual void ensure_owns_direct_data() = 0;
+
   void user_add() const;
   void user_remove() const;
   bool is_mutable() const;
@@ -317,6 +323,8 @@ struct GeometrySet {
 
   blender::Vector<const GeometryComponent *> get_components_for_read() const;
 
+  void ensure_owns_direct_data();
+
   void compute_boundbox_without_instances(blender::float3 *r_min, blender::float3 *r_max) const;
 
   friend std::ostream &operator<<(std::ostream &stream, const GeometrySet &geometry_set);
@@ -382,6 +390,9 @@ class MeshComponent : public GeometryComponent {
 
   bool is_empty() const final;
 
+  bool owns_direct_data() const override;
+  void ensure_owns_direct_data() override;
+
   static constexpr inline GeometryComponentType static_type = GEO_COMPONENT_TYPE_MESH;
 
  private:
@@ -412,6 +423,9 @@ class PointCloudComponent : public GeometryComponent {
 
   bool is_empty() const final;
 
+  bool owns_direct_data() const override;
+  void ensure_owns_direct_data() override;
+
   static constexpr inline GeometryComponentType static_type = GEO_COMPONENT_TYPE_POINT_CLOUD;
 
  private:
@@ -452,6 +466,9 @@ class InstancesComponent : public GeometryComponent {
 
   bool is_empty() const final;
 
+  bool owns_direct_data() const override;
+  void ensure_owns_direct_data() override;
+
   static constexpr inline GeometryComponentType static_type = GEO_COMPONENT_TYPE_INSTANCES;
 };
 
@@ -474,5 +491,8 @@ class VolumeComponent : public GeometryComponent {
   const Volume *get_for_read() const;
   Volume *get_for_write();
 
+  bool owns_direct_data() const override;
+  void ensure_owns_direct_data() override;
+
   static constexpr inline GeometryComponentType static_type = GEO_COMPONENT_TYPE_VOLUME;
 };
@@ -0,0 +1,66 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bke
+ *
+ * Distribution of points on the surface of a mesh. The functions are multi-threaded, but their
+ * results do not depend on the number of threads.
+ */
+
+#include "BLI_float3.hh"
+#include "BLI_float4x4.hh"
+#include "BLI_span.hh"
+#include "BLI_vector.hh"
+
+struct Mesh;
+
+namespace blender::bke::mesh_surface_sample {
+
+/**
+ * Randomly distribute points on the triangles of the mesh and append them to the result vectors.
+ * The expected number of points on a triangle is its area (after the transform is applied)
+ * multiplied with the density.
+ *
+ * Every triangle has its own random number generator that is seeded with the triangle index and
+ * the seed, so the points on a triangle don't change when other triangles change.
+ *
+ * \param density_factors: Optional factors for the density, one for every face corner. The
+ * density of a triangle is multiplied with the average of its corners.
+ */
+void sample_surface_random(const Mesh &mesh,
+                           const float4x4 &transform,
+                           float base_density,
+                           Span<float> density_factors,
+                           int seed,
+                           Vector<float3> &r_positions,
+                           Vector<float3> &r_bary_coords,
+                           Vector<int> &r_looptri_indices);
+
+/**
+ * Mark points in the mask, so that no two of the remaining points are closer to each other than
+ * the minimum distance. Points that are marked already are ignored.
+ *
+ * Points are processed in index order, every point that is not marked yet removes the close
+ * points after it. The close points are found in a uniform grid.
+ */
+void eliminate_close_points(Span<float3> positions,
+                            float minimum_distance,
+                            MutableSpan<bool> elimination_mask);
+
+}  // namespace blender::bke::mesh_surface_sample
@@ -312,6 +312,9 @@ typedef struct bNodeType {
 
   /* Execute a geometry node. */
   NodeGeometryExecFunction geometry_node_execute;
+  /* The geometry node requests its inputs with #GeoNodeExecParams::lazy_require_input, so that
+   * unused inputs are not computed. */
+  bool geometry_node_execute_supports_laziness;
 
   /* RNA integration */
   ExtensionRNA rna_ext;
@@ -82,8 +82,18 @@ void ReadAttribute::initialize_span() const
   const int element_size = cpp_type_.size();
   array_buffer_ = MEM_mallocN_aligned(size_ * element_size, cpp_type_.alignment(), __func__);
   array_is_temporary_ = true;
-  for (const int i : IndexRange(size_)) {
-    this->get_internal(i, POINTER_OFFSET(array_buffer_, i * element_size));
+  this->materialize_internal(IndexRange(size_), array_buffer_);
+}
+
+/**
+ * Subclasses should override this when they can copy many values at once without calling
+ * #get_internal for every element.
+ */
+void ReadAttribute::materialize_internal(const IndexRange range, void *r_values) const
+{
+  const int element_size = cpp_type_.size();
+  for (const int i : range) {
+    this->get_internal(i, POINTER_OFFSET(r_values, (i - range.start()) * element_size));
   }
 }
 
@@ -229,6 +239,36 @@ class ConvertedReadAttribute final : public ReadAttribute {
     base_attribute_->get(index, buffer);
     conversions_.convert(from_type_, to_type_, buffer, r_value);
   }
+
+  bool is_single_internal() const override
+  {
+    return base_attribute_->is_single();
+  }
+
+  void materialize_internal(const IndexRange range, void *r_values) const override
+  {
+    if (range.size() == 0) {
+      return;
+    }
+    /* Copy and convert the base values in chunks, so that there are no virtual calls per element
+     * and the temporary buffer stays small. */
+    const int64_t chunk_size = 1024;
+    void *buffer = MEM_mallocN_aligned(std::min(range.size(), chunk_size) * from_type_.size(),
+                                       from_type_.alignment(),
+                                       __func__);
+    for (int64_t chunk_start = 0; chunk_start < range.size(); chunk_start += chunk_size) {
+      const IndexRange chunk = range.slice(chunk_start,
+                                           std::min(chunk_size, range.size() - chunk_start));
+      base_attribute_->materialize_to_uninitialized(chunk, buffer);
+      conversions_.convert_n(from_type_,
+                             to_type_,
+                             buffer,
+                             POINTER_OFFSET(r_values, chunk_start * to_type_.size()),
+                             chunk.size());
+      from_type_.destruct_n(buffer, chunk.size());
+    }
+    MEM_freeN(buffer);
+  }
 };
 
 /** \} */
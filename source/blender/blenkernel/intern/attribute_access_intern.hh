@@ -47,6 +47,16 @@ class ConstantReadAttribute final : public ReadAttribute {
     this->cpp_type_.copy_to_uninitialized(value_, r_value);
   }
 
+  bool is_single_internal() const override
+  {
+    return true;
+  }
+
+  void materialize_internal(const IndexRange range, void *r_values) const override
+  {
+    cpp_type_.fill_uninitialized(value_, r_values, range.size());
+  }
+
   void initialize_span() const override
   {
     const int element_size = cpp_type_.size();
@@ -77,6 +87,16 @@ template<typename T> class ArrayReadAttribute final : public ReadAttribute {
     array_buffer_ = const_cast<T *>(data_.data());
     array_is_temporary_ = false;
   }
+
+  bool is_span_internal() const override
+  {
+    return true;
+  }
+
+  void materialize_internal(const IndexRange range, void *r_values) const override
+  {
+    uninitialized_copy_n(data_.data() + range.start(), range.size(), static_cast<T *>(r_values));
+  }
 };
 
 template<typename T> class OwnedArrayReadAttribute final : public ReadAttribute {
@@ -100,6 +120,16 @@ template<typename T> class OwnedArrayReadAttribute final : public ReadAttribute
     array_buffer_ = const_cast<T *>(data_.data());
     array_is_temporary_ = false;
   }
+
+  bool is_span_internal() const override
+  {
+    return true;
+  }
+
+  void materialize_internal(const IndexRange range, void *r_values) const override
+  {
+    uninitialized_copy_n(data_.data() + range.start(), range.size(), static_cast<T *>(r_values));
+  }
 };
 
 template<typename StructT, typename ElemT, ElemT (*GetFunc)(const StructT &)>
@@ -119,6 +149,61 @@ class DerivedArrayReadAttribute final : public ReadAttribute {
     const ElemT value = GetFunc(struct_value);
     new (r_value) ElemT(value);
   }
+
+  void materialize_internal(const IndexRange range, void *r_values) const override
+  {
+    ElemT *values = static_cast<ElemT *>(r_values);
+    for (const int64_t i : IndexRange(range.size())) {
+      new (values + i) ElemT(GetFunc(data_[range.start() + i]));
+    }
+  }
+};
+
+/**
+ * Gives access to a member of the structs in an array, e.g. the position in an array of #MVert.
+ * The member has to have the same memory layout as the attribute type. Since the values can be
+ * accessed with a stride, they don't have to be copied to be processed efficiently.
+ */
+template<typename StructT, typename ElemT>
+class StridedArrayReadAttribute final : public ReadAttribute {
+ private:
+  Span<StructT> data_;
+  int64_t member_offset_;
+
+ public:
+  StridedArrayReadAttribute(AttributeDomain domain, Span<StructT> data, const int64_t member_offset)
+      : ReadAttribute(domain, CPPType::get<ElemT>(), data.size()),
+        data_(data),
+        member_offset_(member_offset)
+  {
+    BLI_assert(member_offset + (int64_t)sizeof(ElemT) <= (int64_t)sizeof(StructT));
+  }
+
+  void get_internal(const int64_t index, void *r_value) const override
+  {
+    new (r_value) ElemT(this->get_member(index));
+  }
+
+  bool try_get_strided_internal(const void **r_data, int64_t *r_stride) const override
+  {
+    *r_data = POINTER_OFFSET(data_.data(), member_offset_);
+    *r_stride = sizeof(StructT);
+    return true;
+  }
+
+  void materialize_internal(const IndexRange range, void *r_values) const override
+  {
+    ElemT *values = static_cast<ElemT *>(r_values);
+    for (const int64_t i : IndexRange(range.size())) {
+      new (values + i) ElemT(this->get_member(range.start() + i));
+    }
+  }
+
+ private:
+  const ElemT &get_member(const int64_t index) const
+  {
+    return *reinterpret_cast<const ElemT *>(POINTER_OFFSET(&data_[index], member_offset_));
+  }
 };
 
 template<typename T> class ArrayWriteAttribute final : public WriteAttribute {
@@ -180,6 +265,32 @@ class DerivedArrayWriteAttribute final : public WriteAttribute {
     const ElemT &typed_value = *reinterpret_cast<const ElemT *>(value);
     SetFunc(struct_value, typed_value);
   }
+
+  /* Copy the values with the get and set functions inlined, instead of a virtual call for every
+   * element like the default implementation. */
+  void initialize_span(const bool write_only) override
+  {
+    array_buffer_ = MEM_mallocN_aligned(sizeof(ElemT) * size_, alignof(ElemT), __func__);
+    array_is_temporary_ = true;
+    ElemT *values = static_cast<ElemT *>(array_buffer_);
+    if (write_only) {
+      default_construct_n(values, size_);
+    }
+    else {
+      for (const int64_t i : IndexRange(size_)) {
+        new (values + i) ElemT(GetFunc(data_[i]));
+      }
+    }
+  }
+
+  void apply_span_if_necessary() override
+  {
+    BLI_assert(array_buffer_ != nullptr);
+    const ElemT *values = static_cast<const ElemT *>(array_buffer_);
+    for (const int64_t i : IndexRange(size_)) {
+      SetFunc(data_[i], values[i]);
+    }
+  }
 };
 
 /**
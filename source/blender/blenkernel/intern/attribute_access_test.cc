@@ -0,0 +1,377 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include "BLI_rand.hh"
+
+#include "BKE_attribute_access.hh"
+#include "BKE_attribute_math.hh"
+#include "BKE_geometry_set.hh"
+#include "BKE_mesh.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "PIL_time.h"
+
+#include "attribute_access_intern.hh"
+#include "mesh_test_utils.hh"
+
+namespace blender::bke::tests {
+
+TEST(attribute_access, DevirtualizeSingle)
+{
+  MeshComponent component;
+  component.replace(test_grid_mesh_create(4, true));
+  const float value = 3.0f;
+  ReadAttributePtr attribute = component.attribute_get_constant_for_read(
+      ATTR_DOMAIN_POINT, CD_PROP_FLOAT, &value);
+  EXPECT_TRUE(attribute->is_single());
+  EXPECT_FALSE(attribute->is_span());
+
+  bool used_single = false;
+  attribute_devirtualize<float>(*attribute, [&](const auto &values) {
+    used_single = std::is_same_v<std::decay_t<decltype(values)>, SingleValueAttributeSpan<float>>;
+    EXPECT_EQ(values.size(), 16);
+    EXPECT_EQ(values[0], 3.0f);
+    EXPECT_EQ(values[15], 3.0f);
+  });
+  EXPECT_TRUE(used_single);
+}
+
+TEST(attribute_access, DevirtualizeStridedPosition)
+{
+  MeshComponent component;
+  component.replace(test_grid_mesh_create(4, true));
+  ReadAttributePtr attribute = component.attribute_try_get_for_read("position");
+  ASSERT_TRUE(attribute);
+  EXPECT_FALSE(attribute->is_single());
+
+  const void *data;
+  int64_t stride;
+  EXPECT_TRUE(attribute->try_get_strided(&data, &stride));
+  EXPECT_EQ(stride, (int64_t)sizeof(MVert));
+
+  const Mesh *mesh = component.get_for_read();
+  bool used_strided = false;
+  attribute_devirtualize<float3>(*attribute, [&](const auto &values) {
+    used_strided = std::is_same_v<std::decay_t<decltype(values)>, StridedAttributeSpan<float3>>;
+    EXPECT_EQ(values.size(), mesh->totvert);
+    for (const int i : IndexRange(mesh->totvert)) {
+      EXPECT_EQ(values[i], float3(mesh->mvert[i].co));
+    }
+  });
+  EXPECT_TRUE(used_strided);
+}
+
+TEST(attribute_access, MaterializeConvertedAttribute)
+{
+  MeshComponent component;
+  component.replace(test_grid_mesh_create(4, true));
+  /* Reading the position as float converts every value to the length of the vector. */
+  ReadAttributePtr attribute = component.attribute_try_get_for_read(
+      "position", ATTR_DOMAIN_POINT, CD_PROP_FLOAT);
+  ASSERT_TRUE(attribute);
+
+  const Mesh *mesh = component.get_for_read();
+  Array<float> materialized(mesh->totvert);
+  attribute->materialize_to_uninitialized(IndexRange(mesh->totvert), materialized.data());
+  Span<float> span = attribute->get_span<float>();
+  for (const int i : IndexRange(mesh->totvert)) {
+    float value;
+    attribute->get(i, &value);
+    EXPECT_EQ(materialized[i], value);
+    EXPECT_EQ(span[i], value);
+  }
+}
+
+TEST(attribute_access, DevirtualizeAdaptedDomain)
+{
+  MeshComponent component;
+  component.replace(test_grid_mesh_create(4, true));
+  ReadAttributePtr attribute = component.attribute_try_get_for_read("position",
+                                                                    ATTR_DOMAIN_CORNER);
+  ASSERT_TRUE(attribute);
+  EXPECT_TRUE(attribute->is_span());
+
+  const Mesh *mesh = component.get_for_read();
+  attribute_devirtualize<float3>(*attribute, [&](const auto &values) {
+    EXPECT_EQ(values.size(), mesh->totloop);
+    for (const int i : IndexRange(mesh->totloop)) {
+      EXPECT_EQ(values[i], float3(mesh->mvert[mesh->mloop[i].v].co));
+    }
+  });
+}
+
+static int domain_element_index(const AttributeDomain domain,
+                                 const int point_index,
+                                 const int corner_index,
+                                 const int poly_index)
+{
+  switch (domain) {
+    case ATTR_DOMAIN_POINT:
+      return point_index;
+    case ATTR_DOMAIN_CORNER:
+      return corner_index;
+    case ATTR_DOMAIN_POLYGON:
+      return poly_index;
+    default:
+      BLI_assert(false);
+      return 0;
+  }
+}
+
+/* Interpolate between domains with a mixer that every corner of the mesh is mixed into, like it
+ * was done before the interpolations were computed per element. */
+template<typename T>
+static Array<T> adapt_domain_with_mixer(const Mesh &mesh,
+                                        const Span<T> old_values,
+                                        const AttributeDomain old_domain,
+                                        const AttributeDomain new_domain)
+{
+  MeshComponent component;
+  component.replace(const_cast<Mesh *>(&mesh), GeometryOwnershipType::ReadOnly);
+  Array<T> new_values(component.attribute_domain_size(new_domain));
+  attribute_math::DefaultMixer<T> mixer(new_values);
+  for (const int poly_index : IndexRange(mesh.totpoly)) {
+    const MPoly &poly = mesh.mpoly[poly_index];
+    for (const int corner_index : IndexRange(poly.loopstart, poly.totloop)) {
+      const int point_index = mesh.mloop[corner_index].v;
+      mixer.mix_in(domain_element_index(new_domain, point_index, corner_index, poly_index),
+                   old_values[domain_element_index(
+                       old_domain, point_index, corner_index, poly_index)]);
+    }
+  }
+  mixer.finalize();
+  return new_values;
+}
+
+template<typename T>
+static ReadAttributePtr adapt_domain(const MeshComponent &component,
+                                     const Span<T> old_values,
+                                     const AttributeDomain old_domain,
+                                     const AttributeDomain new_domain)
+{
+  return component.attribute_try_adapt_domain(
+      std::make_unique<OwnedArrayReadAttribute<T>>(old_domain, Array<T>(old_values)), new_domain);
+}
+
+static const std::array<std::pair<AttributeDomain, AttributeDomain>, 6> mesh_domain_pairs = {{
+    {ATTR_DOMAIN_POINT, ATTR_DOMAIN_CORNER},
+    {ATTR_DOMAIN_POINT, ATTR_DOMAIN_POLYGON},
+    {ATTR_DOMAIN_CORNER, ATTR_DOMAIN_POINT},
+    {ATTR_DOMAIN_CORNER, ATTR_DOMAIN_POLYGON},
+    {ATTR_DOMAIN_POLYGON, ATTR_DOMAIN_POINT},
+    {ATTR_DOMAIN_POLYGON, ATTR_DOMAIN_CORNER},
+}};
+
+TEST(attribute_access, AdaptDomainMatchesMixer)
+{
+  MeshComponent component;
+  component.replace(test_grid_mesh_create(8, true));
+  const Mesh &mesh = *component.get_for_read();
+  RandomNumberGenerator rng(0);
+
+  for (const std::pair<AttributeDomain, AttributeDomain> &domains : mesh_domain_pairs) {
+    const int old_size = component.attribute_domain_size(domains.first);
+    const int new_size = component.attribute_domain_size(domains.second);
+
+    Array<float3> float3_values(old_size);
+    Array<int> int_values(old_size);
+    Array<bool> bool_values(old_size);
+    for (const int i : IndexRange(old_size)) {
+      float3_values[i] = float3(rng.get_float(), rng.get_float(), rng.get_float());
+      int_values[i] = rng.get_int32(1000);
+      bool_values[i] = rng.get_float() > 0.5f;
+    }
+
+    ReadAttributePtr float3_attribute = adapt_domain<float3>(
+        component, float3_values, domains.first, domains.second);
+    ASSERT_TRUE(float3_attribute);
+    EXPECT_EQ(float3_attribute->domain(), domains.second);
+    const Array<float3> float3_expected = adapt_domain_with_mixer<float3>(
+        mesh, float3_values, domains.first, domains.second);
+    EXPECT_EQ_ARRAY(
+        float3_expected.data(), float3_attribute->get_span<float3>().data(), new_size);
+
+    ReadAttributePtr int_attribute = adapt_domain<int>(
+        component, int_values, domains.first, domains.second);
+    ASSERT_TRUE(int_attribute);
+    const Array<int> int_expected = adapt_domain_with_mixer<int>(
+        mesh, int_values, domains.first, domains.second);
+    EXPECT_EQ_ARRAY(int_expected.data(), int_attribute->get_span<int>().data(), new_size);
+
+    ReadAttributePtr bool_attribute = adapt_domain<bool>(
+        component, bool_values, domains.first, domains.second);
+    ASSERT_TRUE(bool_attribute);
+    const Array<bool> bool_expected = adapt_domain_with_mixer<bool>(
+        mesh, bool_values, domains.first, domains.second);
+    EXPECT_EQ_ARRAY(bool_expected.data(), bool_attribute->get_span<bool>().data(), new_size);
+  }
+}
+
+static const char *domain_name(const AttributeDomain domain)
+{
+  switch (domain) {
+    case ATTR_DOMAIN_POINT:
+      return "point";
+    case ATTR_DOMAIN_CORNER:
+      return "corner";
+    case ATTR_DOMAIN_POLYGON:
+      return "polygon";
+    default:
+      return "unknown";
+  }
+}
+
+static void test_attribute_domain_adapt_performance(const char *id, const int size)
+{
+  printf("\n========== STARTING %s ==========\n", id);
+
+  MeshComponent component;
+  component.replace(test_grid_mesh_create(size, true));
+  const Mesh &mesh = *component.get_for_read();
+
+  for (const std::pair<AttributeDomain, AttributeDomain> &domains : mesh_domain_pairs) {
+    Array<float3> values(component.attribute_domain_size(domains.first));
+    for (const int i : values.index_range()) {
+      values[i] = float3((float)i);
+    }
+
+    {
+      const double start_time = PIL_check_seconds_timer();
+      const Array<float3> new_values = adapt_domain_with_mixer<float3>(
+          mesh, values, domains.first, domains.second);
+      printf("\tAdapt float3 from %s to %s with a mixer: %fs\n",
+             domain_name(domains.first),
+             domain_name(domains.second),
+             PIL_check_seconds_timer() - start_time);
+    }
+
+    {
+      /* Copying the values into the source attribute is not measured. */
+      ReadAttributePtr attribute = std::make_unique<OwnedArrayReadAttribute<float3>>(
+          domains.first, Array<float3>(values.as_span()));
+      const double start_time = PIL_check_seconds_timer();
+      ReadAttributePtr new_attribute = component.attribute_try_adapt_domain(std::move(attribute),
+                                                                            domains.second);
+      printf("\tAdapt float3 from %s to %s: %fs\n",
+             domain_name(domains.first),
+             domain_name(domains.second),
+             PIL_check_seconds_timer() - start_time);
+    }
+  }
+
+  printf("========== ENDED %s ==========\n\n", id);
+}
+
+static void test_attribute_domain_read_performance(const char *id, const int size)
+{
+  printf("\n========== STARTING %s ==========\n", id);
+
+  MeshComponent component;
+  component.replace(test_grid_mesh_create(size, true));
+
+  {
+    const double start_time = PIL_check_seconds_timer();
+    ReadAttributePtr attribute = component.attribute_try_get_for_read("position",
+                                                                      ATTR_DOMAIN_CORNER);
+    printf("\tAdapt position from point to corner: %fs\n",
+           PIL_check_seconds_timer() - start_time);
+  }
+
+  ReadAttributePtr attribute = component.attribute_try_get_for_read(
+      "position", ATTR_DOMAIN_POINT, CD_PROP_FLOAT);
+  const int64_t values_num = attribute->size();
+
+  {
+    const double start_time = PIL_check_seconds_timer();
+    float sum = 0.0f;
+    for (const int64_t i : IndexRange(values_num)) {
+      float value;
+      attribute->get(i, &value);
+      sum += value;
+    }
+    printf("\tConverted read with a virtual call per element: %fs (sum %f)\n",
+           PIL_check_seconds_timer() - start_time,
+           sum);
+  }
+
+  {
+    const double start_time = PIL_check_seconds_timer();
+    Array<float> values(values_num);
+    attribute->materialize_to_uninitialized(IndexRange(values_num), values.data());
+    float sum = 0.0f;
+    for (const float value : values) {
+      sum += value;
+    }
+    printf("\tConverted read with one materialize call: %fs (sum %f)\n",
+           PIL_check_seconds_timer() - start_time,
+           sum);
+  }
+
+  ReadAttributePtr position_attribute = component.attribute_try_get_for_read("position");
+
+  {
+    const double start_time = PIL_check_seconds_timer();
+    float3 sum{0.0f};
+    for (const int64_t i : IndexRange(values_num)) {
+      float3 value;
+      position_attribute->get(i, &value);
+      sum += value;
+    }
+    printf("\tPosition read with a virtual call per element: %fs (sum %f)\n",
+           PIL_check_seconds_timer() - start_time,
+           sum.x);
+  }
+
+  {
+    const double start_time = PIL_check_seconds_timer();
+    float3 sum{0.0f};
+    attribute_devirtualize<float3>(*position_attribute, [&](const auto &values) {
+      for (const int64_t i : IndexRange(values.size())) {
+        sum += values[i];
+      }
+    });
+    printf("\tPosition read devirtualized: %fs (sum %f)\n",
+           PIL_check_seconds_timer() - start_time,
+           sum.x);
+  }
+
+  printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(attribute_access_performance, domain_read_100)
+{
+  test_attribute_domain_read_performance("100x100 grid", 100);
+}
+
+TEST(attribute_access_performance, domain_read_1000)
+{
+  test_attribute_domain_read_performance("1000x1000 grid", 1000);
+}
+
+TEST(attribute_access_performance, domain_adapt_100)
+{
+  test_attribute_domain_adapt_performance("100x100 grid", 100);
+}
+
+TEST(attribute_access_performance, domain_adapt_1000)
+{
+  test_attribute_domain_adapt_performance("1000x1000 grid", 1000);
+}
+
+}  // namespace blender::bke::tests
@@ -1127,7 +1127,8 @@ static BVHTree *bvhtree_from_editmesh_looptri_create_tree(float epsilon,
         }
       }
       BLI_assert(BLI_bvhtree_get_len(tree) == looptri_num_active);
-      BLI_bvhtree_balance(tree);
+      /* Triangle trees are mostly used for ray-casts, worth the slower build. */
+      BLI_bvhtree_balance_ex(tree, BVH_BALANCE_USE_SAH);
     }
   }
 
@@ -1173,7 +1174,8 @@ static BVHTree *bvhtree_from_mesh_looptri_create_tree(float epsilon,
         }
       }
       BLI_assert(BLI_bvhtree_get_len(tree) == looptri_num_active);
-      BLI_bvhtree_balance(tree);
+      /* Triangle trees are mostly used for ray-casts, worth the slower build. */
+      BLI_bvhtree_balance_ex(tree, BVH_BALANCE_USE_SAH);
     }
   }
 
@@ -130,13 +130,41 @@ static BVHTree *bvhtree_build_from_cloth(ClothModifierData *clmd, float epsilon)
   return bvhtree;
 }
 
+typedef struct ClothTriRefitData {
+  const ClothVertex *verts;
+  const MVertTri *tri;
+  bool moving;
+} ClothTriRefitData;
+
+static int bvhtree_refit_cloth_tri_cb(void *userdata, int index, float (*r_co)[3])
+{
+  const ClothTriRefitData *data = userdata;
+  const ClothVertex *verts = data->verts;
+  const MVertTri *vt = &data->tri[index];
+
+  if (!data->moving) {
+    copy_v3_v3(r_co[0], verts[vt->tri[0]].tx);
+    copy_v3_v3(r_co[1], verts[vt->tri[1]].tx);
+    copy_v3_v3(r_co[2], verts[vt->tri[2]].tx);
+    return 3;
+  }
+
+  /* Old and new locations, the bounds contain the whole motion. */
+  copy_v3_v3(r_co[0], verts[vt->tri[0]].txold);
+  copy_v3_v3(r_co[1], verts[vt->tri[1]].txold);
+  copy_v3_v3(r_co[2], verts[vt->tri[2]].txold);
+  copy_v3_v3(r_co[3], verts[vt->tri[0]].tx);
+  copy_v3_v3(r_co[4], verts[vt->tri[1]].tx);
+  copy_v3_v3(r_co[5], verts[vt->tri[2]].tx);
+  return 6;
+}
+
 void bvhtree_update_from_cloth(ClothModifierData *clmd, bool moving, bool self)
 {
   unsigned int i = 0;
   Cloth *cloth = clmd->clothObject;
   BVHTree *bvhtree;
   ClothVertex *verts = cloth->verts;
-  const MVertTri *vt;
 
   BLI_assert(!(clmd->hairdata != NULL && self));
 
@@ -151,43 +179,15 @@ void bvhtree_update_from_cloth(ClothModifierData *clmd, bool moving, bool self)
     return;
   }
 
-  vt = cloth->tri;
-
   /* update vertex position in bvh tree */
   if (clmd->hairdata == NULL) {
-    if (verts && vt) {
-      for (i = 0; i < cloth->primitive_num; i++, vt++) {
-        float co[3][3], co_moving[3][3];
-        bool ret;
-
-        /* copy new locations into array */
-        if (moving) {
-          copy_v3_v3(co[0], verts[vt->tri[0]].txold);
-          copy_v3_v3(co[1], verts[vt->tri[1]].txold);
-          copy_v3_v3(co[2], verts[vt->tri[2]].txold);
-
-          /* update moving positions */
-          copy_v3_v3(co_moving[0], verts[vt->tri[0]].tx);
-          copy_v3_v3(co_moving[1], verts[vt->tri[1]].tx);
-          copy_v3_v3(co_moving[2], verts[vt->tri[2]].tx);
-
-          ret = BLI_bvhtree_update_node(bvhtree, i, co[0], co_moving[0], 3);
-        }
-        else {
-          copy_v3_v3(co[0], verts[vt->tri[0]].tx);
-          copy_v3_v3(co[1], verts[vt->tri[1]].tx);
-          copy_v3_v3(co[2], verts[vt->tri[2]].tx);
-
-          ret = BLI_bvhtree_update_node(bvhtree, i, co[0], NULL, 3);
-        }
-
-        /* check if tree is already full */
-        if (ret == false) {
-          break;
-        }
-      }
-
-      BLI_bvhtree_update_tree(bvhtree);
+    if (verts && cloth->tri) {
+      ClothTriRefitData data = {
+          .verts = verts,
+          .tri = cloth->tri,
+          .moving = moving,
+      };
+      BLI_bvhtree_refit(bvhtree, bvhtree_refit_cloth_tri_cb, &data);
     }
   }
   else {
@@ -135,6 +135,32 @@ BVHTree *bvhtree_build_from_mvert(const MVert *mvert,
   return tree;
 }
 
+typedef struct MVertTriRefitData {
+  const MVert *mvert;
+  const MVert *mvert_moving;
+  const MVertTri *tri;
+} MVertTriRefitData;
+
+static int bvhtree_refit_mverttri_cb(void *userdata, int index, float (*r_co)[3])
+{
+  const MVertTriRefitData *data = userdata;
+  const MVertTri *vt = &data->tri[index];
+
+  copy_v3_v3(r_co[0], data->mvert[vt->tri[0]].co);
+  copy_v3_v3(r_co[1], data->mvert[vt->tri[1]].co);
+  copy_v3_v3(r_co[2], data->mvert[vt->tri[2]].co);
+
+  if (data->mvert_moving == NULL) {
+    return 3;
+  }
+
+  /* The moving positions expand the same bounds. */
+  copy_v3_v3(r_co[3], data->mvert_moving[vt->tri[0]].co);
+  copy_v3_v3(r_co[4], data->mvert_moving[vt->tri[1]].co);
+  copy_v3_v3(r_co[5], data->mvert_moving[vt->tri[2]].co);
+  return 6;
+}
+
 void bvhtree_update_from_mvert(BVHTree *bvhtree,
                                const MVert *mvert,
                                const MVert *mvert_moving,
@@ -147,41 +173,15 @@ void bvhtree_update_from_mvert(BVHTree *bvhtree,
     return;
   }
 
-  if (mvert_moving == NULL) {
-    moving = false;
-  }
-
-  const MVertTri *vt;
-  int i;
-  for (i = 0, vt = tri; i < tri_num; i++, vt++) {
-    float co[3][3];
-    bool ret;
-
-    copy_v3_v3(co[0], mvert[vt->tri[0]].co);
-    copy_v3_v3(co[1], mvert[vt->tri[1]].co);
-    copy_v3_v3(co[2], mvert[vt->tri[2]].co);
-
-    /* copy new locations into array */
-    if (moving) {
-      float co_moving[3][3];
-      /* update moving positions */
-      copy_v3_v3(co_moving[0], mvert_moving[vt->tri[0]].co);
-      copy_v3_v3(co_moving[1], mvert_moving[vt->tri[1]].co);
-      copy_v3_v3(co_moving[2], mvert_moving[vt->tri[2]].co);
-
-      ret = BLI_bvhtree_update_node(bvhtree, i, &co[0][0], &co_moving[0][0], 3);
-    }
-    else {
-      ret = BLI_bvhtree_update_node(bvhtree, i, &co[0][0], NULL, 3);
-    }
-
-    /* check if tree is already full */
-    if (ret == false) {
-      break;
-    }
-  }
+  BLI_assert(BLI_bvhtree_get_len(bvhtree) <= tri_num);
+  UNUSED_VARS_NDEBUG(tri_num);
 
-  BLI_bvhtree_update_tree(bvhtree);
+  MVertTriRefitData data = {
+      .mvert = mvert,
+      .mvert_moving = moving ? mvert_moving : NULL,
+      .tri = tri,
+  };
+  BLI_bvhtree_refit(bvhtree, bvhtree_refit_mverttri_cb, &data);
 }
 
 /* ***************************
@@ -15,6 +15,7 @@
  */
 
 #include "BLI_listbase.h"
+#include "BLI_task.hh"
 #include "BLI_threads.h"
 
 #include "DNA_mesh_types.h"
@@ -30,6 +31,8 @@
 
 #include "attribute_access_intern.hh"
 
+#include "atomic_ops.h"
+
 /* Can't include BKE_object_deform.h right now, due to an enum forward declaration.  */
 extern "C" MDeformVert *BKE_object_defgroup_data_create(ID *id);
 
@@ -158,6 +161,22 @@ bool MeshComponent::is_empty() const
   return mesh_ == nullptr;
 }
 
+bool MeshComponent::owns_direct_data() const
+{
+  return ownership_ == GeometryOwnershipType::Owned;
+}
+
+void MeshComponent::ensure_owns_direct_data()
+{
+  BLI_assert(this->is_mutable());
+  if (ownership_ != GeometryOwnershipType::Owned) {
+    if (mesh_ != nullptr) {
+      mesh_ = BKE_mesh_copy_for_eval(mesh_, false);
+    }
+    ownership_ = GeometryOwnershipType::Owned;
+  }
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -188,21 +207,83 @@ int MeshComponent::attribute_domain_size(const AttributeDomain domain) const
 
 namespace blender::bke {
 
-template<typename T>
+/**
+ * The corners that use every vertex, in the order of their indices. The corners of vertex `i` are
+ * `corners[offsets[i]]` up to `corners[offsets[i + 1] - 1]`.
+ */
+struct VertexCornerMap {
+  Array<int> offsets;
+  Array<int> corners;
+
+  Span<int> corners_of_vertex(const int vertex_index) const
+  {
+    const int start = offsets[vertex_index];
+    return corners.as_span().slice(start, offsets[vertex_index + 1] - start);
+  }
+};
+
+static VertexCornerMap build_vertex_corner_map(const Mesh &mesh)
+{
+  const Span<MLoop> loops{mesh.mloop, mesh.totloop};
+  VertexCornerMap map;
+
+  Array<int> counts(mesh.totvert, 0);
+  parallel_for(loops.index_range(), 4096, [&](IndexRange range) {
+    for (const int loop_index : range) {
+      atomic_add_and_fetch_int32(&counts[loops[loop_index].v], 1);
+    }
+  });
+
+  map.offsets.reinitialize(mesh.totvert + 1);
+  int offset = 0;
+  for (const int vertex_index : IndexRange(mesh.totvert)) {
+    map.offsets[vertex_index] = offset;
+    offset += counts[vertex_index];
+  }
+  map.offsets.last() = offset;
+
+  /* The counts are used again to find the next free position of every vertex. */
+  counts.fill(0);
+  map.corners.reinitialize(mesh.totloop);
+  parallel_for(loops.index_range(), 4096, [&](IndexRange range) {
+    for (const int loop_index : range) {
+      const int vertex_index = loops[loop_index].v;
+      const int position = map.offsets[vertex_index] +
+                           atomic_fetch_and_add_int32(&counts[vertex_index], 1);
+      map.corners[position] = loop_index;
+    }
+  });
+
+  /* Sort the corners of every vertex, so that the result does not depend on the order in which
+   * the threads inserted them. */
+  parallel_for(IndexRange(mesh.totvert), 4096, [&](IndexRange range) {
+    for (const int vertex_index : range) {
+      const int start = map.offsets[vertex_index];
+      std::sort(&map.corners[start], &map.corners[map.offsets[vertex_index + 1]]);
+    }
+  });
+
+  return map;
+}
+
+/* The old values are passed with a type that is given by #attribute_devirtualize. */
+template<typename T, typename OldValues>
 static void adapt_mesh_domain_corner_to_point_impl(const Mesh &mesh,
-                                                   const TypedReadAttribute<T> &attribute,
+                                                   const OldValues &old_values,
                                                    MutableSpan<T> r_values)
 {
   BLI_assert(r_values.size() == mesh.totvert);
-  attribute_math::DefaultMixer<T> mixer(r_values);
+  const VertexCornerMap map = build_vertex_corner_map(mesh);
 
-  for (const int loop_index : IndexRange(mesh.totloop)) {
-    const T value = attribute[loop_index];
-    const MLoop &loop = mesh.mloop[loop_index];
-    const int point_index = loop.v;
-    mixer.mix_in(point_index, value);
-  }
-  mixer.finalize();
+  parallel_for(IndexRange(mesh.totvert), 2048, [&](IndexRange range) {
+    for (const int point_index : range) {
+      attribute_math::DefaultAccumulator<T> accumulator;
+      for (const int loop_index : map.corners_of_vertex(point_index)) {
+        accumulator.mix_in(old_values[loop_index]);
+      }
+      r_values[point_index] = accumulator.finalize();
+    }
+  });
 }
 
 static ReadAttributePtr adapt_mesh_domain_corner_to_point(const Mesh &mesh,
@@ -212,11 +293,13 @@ static ReadAttributePtr adapt_mesh_domain_corner_to_point(const Mesh &mesh,
   const CustomDataType data_type = attribute->custom_data_type();
   attribute_math::convert_to_static_type(data_type, [&](auto dummy) {
     using T = decltype(dummy);
-    if constexpr (!std::is_void_v<attribute_math::DefaultMixer<T>>) {
+    if constexpr (!std::is_void_v<attribute_math::DefaultAccumulator<T>>) {
       /* We compute all interpolated values at once, because for this interpolation, one has to
        * iterate over all loops anyway. */
       Array<T> values(mesh.totvert);
-      adapt_mesh_domain_corner_to_point_impl<T>(mesh, *attribute, values);
+      attribute_devirtualize<T>(*attribute, [&](const auto &old_values) {
+        adapt_mesh_domain_corner_to_point_impl<T>(mesh, old_values, values);
+      });
       new_attribute = std::make_unique<OwnedArrayReadAttribute<T>>(ATTR_DOMAIN_POINT,
                                                                    std::move(values));
     }
@@ -224,17 +307,19 @@ static ReadAttributePtr adapt_mesh_domain_corner_to_point(const Mesh &mesh,
   return new_attribute;
 }
 
-template<typename T>
+template<typename T, typename OldValues>
 static void adapt_mesh_domain_point_to_corner_impl(const Mesh &mesh,
-                                                   const TypedReadAttribute<T> &attribute,
+                                                   const OldValues &old_values,
                                                    MutableSpan<T> r_values)
 {
   BLI_assert(r_values.size() == mesh.totloop);
 
-  for (const int loop_index : IndexRange(mesh.totloop)) {
-    const int vertex_index = mesh.mloop[loop_index].v;
-    r_values[loop_index] = attribute[vertex_index];
-  }
+  parallel_for(IndexRange(mesh.totloop), 4096, [&](IndexRange range) {
+    for (const int loop_index : range) {
+      const int vertex_index = mesh.mloop[loop_index].v;
+      r_values[loop_index] = old_values[vertex_index];
+    }
+  });
 }
 
 static ReadAttributePtr adapt_mesh_domain_point_to_corner(const Mesh &mesh,
@@ -249,7 +334,9 @@ static ReadAttributePtr adapt_mesh_domain_point_to_corner(const Mesh &mesh,
      * when an algorithm only accesses very few of the corner values. However, for the algorithms
      * we currently have, precomputing the array is fine. Also, it is easier to implement. */
     Array<T> values(mesh.totloop);
-    adapt_mesh_domain_point_to_corner_impl<T>(mesh, *attribute, values);
+    attribute_devirtualize<T>(*attribute, [&](const auto &old_values) {
+      adapt_mesh_domain_point_to_corner_impl<T>(mesh, old_values, values);
+    });
     new_attribute = std::make_unique<OwnedArrayReadAttribute<T>>(ATTR_DOMAIN_CORNER,
                                                                  std::move(values));
   });
@@ -261,23 +348,23 @@ static ReadAttributePtr adapt_mesh_domain_point_to_corner(const Mesh &mesh,
  * However, doing that makes the implementation simpler, and this can be optimized in the future if
  * only some values are required.
  */
-template<typename T>
+template<typename T, typename OldValues>
 static void adapt_mesh_domain_corner_to_polygon_impl(const Mesh &mesh,
-                                                     Span<T> old_values,
+                                                     const OldValues &old_values,
                                                      MutableSpan<T> r_values)
 {
   BLI_assert(r_values.size() == mesh.totpoly);
-  attribute_math::DefaultMixer<T> mixer(r_values);
 
-  for (const int poly_index : IndexRange(mesh.totpoly)) {
-    const MPoly &poly = mesh.mpoly[poly_index];
-    for (const int loop_index : IndexRange(poly.loopstart, poly.totloop)) {
-      const T value = old_values[loop_index];
-      mixer.mix_in(poly_index, value);
+  parallel_for(IndexRange(mesh.totpoly), 1024, [&](IndexRange range) {
+    for (const int poly_index : range) {
+      const MPoly &poly = mesh.mpoly[poly_index];
+      attribute_math::DefaultAccumulator<T> accumulator;
+      for (const int loop_index : IndexRange(poly.loopstart, poly.totloop)) {
+        accumulator.mix_in(old_values[loop_index]);
+      }
+      r_values[poly_index] = accumulator.finalize();
     }
-  }
-
-  mixer.finalize();
+  });
 }
 
 static ReadAttributePtr adapt_mesh_domain_corner_to_polygon(const Mesh &mesh,
@@ -287,35 +374,43 @@ static ReadAttributePtr adapt_mesh_domain_corner_to_polygon(const Mesh &mesh,
   const CustomDataType data_type = attribute->custom_data_type();
   attribute_math::convert_to_static_type(data_type, [&](auto dummy) {
     using T = decltype(dummy);
-    if constexpr (!std::is_void_v<attribute_math::DefaultMixer<T>>) {
+    if constexpr (!std::is_void_v<attribute_math::DefaultAccumulator<T>>) {
       Array<T> values(mesh.totpoly);
-      adapt_mesh_domain_corner_to_polygon_impl<T>(mesh, attribute->get_span<T>(), values);
-      new_attribute = std::make_unique<OwnedArrayReadAttribute<T>>(ATTR_DOMAIN_POINT,
+      attribute_devirtualize<T>(*attribute, [&](const auto &old_values) {
+        adapt_mesh_domain_corner_to_polygon_impl<T>(mesh, old_values, values);
+      });
+      new_attribute = std::make_unique<OwnedArrayReadAttribute<T>>(ATTR_DOMAIN_POLYGON,
                                                                    std::move(values));
     }
   });
   return new_attribute;
 }
 
-template<typename T>
+template<typename T, typename OldValues>
 void adapt_mesh_domain_polygon_to_point_impl(const Mesh &mesh,
-                                             Span<T> old_values,
+                                             const OldValues &old_values,
                                              MutableSpan<T> r_values)
 {
   BLI_assert(r_values.size() == mesh.totvert);
-  attribute_math::DefaultMixer<T> mixer(r_values);
+  const VertexCornerMap map = build_vertex_corner_map(mesh);
 
-  for (const int poly_index : IndexRange(mesh.totpoly)) {
-    const MPoly &poly = mesh.mpoly[poly_index];
-    const T value = old_values[poly_index];
-    for (const int loop_index : IndexRange(poly.loopstart, poly.totloop)) {
-      const MLoop &loop = mesh.mloop[loop_index];
-      const int point_index = loop.v;
-      mixer.mix_in(point_index, value);
+  Array<int> loop_to_poly_map(mesh.totloop);
+  parallel_for(IndexRange(mesh.totpoly), 4096, [&](IndexRange range) {
+    for (const int poly_index : range) {
+      const MPoly &poly = mesh.mpoly[poly_index];
+      loop_to_poly_map.as_mutable_span().slice(poly.loopstart, poly.totloop).fill(poly_index);
     }
-  }
+  });
 
-  mixer.finalize();
+  parallel_for(IndexRange(mesh.totvert), 2048, [&](IndexRange range) {
+    for (const int point_index : range) {
+      attribute_math::DefaultAccumulator<T> accumulator;
+      for (const int loop_index : map.corners_of_vertex(point_index)) {
+        accumulator.mix_in(old_values[loop_to_poly_map[loop_index]]);
+      }
+      r_values[point_index] = accumulator.finalize();
+    }
+  });
 }
 
 static ReadAttributePtr adapt_mesh_domain_polygon_to_point(const Mesh &mesh,
@@ -325,9 +420,11 @@ static ReadAttributePtr adapt_mesh_domain_polygon_to_point(const Mesh &mesh,
   const CustomDataType data_type = attribute->custom_data_type();
   attribute_math::convert_to_static_type(data_type, [&](auto dummy) {
     using T = decltype(dummy);
-    if constexpr (!std::is_void_v<attribute_math::DefaultMixer<T>>) {
+    if constexpr (!std::is_void_v<attribute_math::DefaultAccumulator<T>>) {
       Array<T> values(mesh.totvert);
-      adapt_mesh_domain_polygon_to_point_impl<T>(mesh, attribute->get_span<T>(), values);
+      attribute_devirtualize<T>(*attribute, [&](const auto &old_values) {
+        adapt_mesh_domain_polygon_to_point_impl<T>(mesh, old_values, values);
+      });
       new_attribute = std::make_unique<OwnedArrayReadAttribute<T>>(ATTR_DOMAIN_POINT,
                                                                    std::move(values));
     }
@@ -335,18 +432,20 @@ static ReadAttributePtr adapt_mesh_domain_polygon_to_point(const Mesh &mesh,
   return new_attribute;
 }
 
-template<typename T>
+template<typename T, typename OldValues>
 void adapt_mesh_domain_polygon_to_corner_impl(const Mesh &mesh,
-                                              const Span<T> old_values,
+                                              const OldValues &old_values,
                                               MutableSpan<T> r_values)
 {
   BLI_assert(r_values.size() == mesh.totloop);
 
-  for (const int poly_index : IndexRange(mesh.totpoly)) {
-    const MPoly &poly = mesh.mpoly[poly_index];
-    MutableSpan<T> poly_corner_values = r_values.slice(poly.loopstart, poly.totloop);
-    poly_corner_values.fill(old_values[poly_index]);
-  }
+  parallel_for(IndexRange(mesh.totpoly), 4096, [&](IndexRange range) {
+    for (const int poly_index : range) {
+      const MPoly &poly = mesh.mpoly[poly_index];
+      MutableSpan<T> poly_corner_values = r_values.slice(poly.loopstart, poly.totloop);
+      poly_corner_values.fill(old_values[poly_index]);
+    }
+  });
 }
 
 static ReadAttributePtr adapt_mesh_domain_polygon_to_corner(const Mesh &mesh,
@@ -356,10 +455,12 @@ static ReadAttributePtr adapt_mesh_domain_polygon_to_corner(const Mesh &mesh,
   const CustomDataType data_type = attribute->custom_data_type();
   attribute_math::convert_to_static_type(data_type, [&](auto dummy) {
     using T = decltype(dummy);
-    if constexpr (!std::is_void_v<attribute_math::DefaultMixer<T>>) {
+    if constexpr (!std::is_void_v<attribute_math::DefaultAccumulator<T>>) {
       Array<T> values(mesh.totloop);
-      adapt_mesh_domain_polygon_to_corner_impl<T>(mesh, attribute->get_span<T>(), values);
-      new_attribute = std::make_unique<OwnedArrayReadAttribute<T>>(ATTR_DOMAIN_POINT,
+      attribute_devirtualize<T>(*attribute, [&](const auto &old_values) {
+        adapt_mesh_domain_polygon_to_corner_impl<T>(mesh, old_values, values);
+      });
+      new_attribute = std::make_unique<OwnedArrayReadAttribute<T>>(ATTR_DOMAIN_CORNER,
                                                                    std::move(values));
     }
   });
@@ -371,23 +472,24 @@ static ReadAttributePtr adapt_mesh_domain_polygon_to_corner(const Mesh &mesh,
  * However, doing that makes the implementation simpler, and this can be optimized in the future if
  * only some values are required.
  */
-template<typename T>
+template<typename T, typename OldValues>
 static void adapt_mesh_domain_point_to_polygon_impl(const Mesh &mesh,
-                                                    const Span<T> old_values,
+                                                    const OldValues &old_values,
                                                     MutableSpan<T> r_values)
 {
   BLI_assert(r_values.size() == mesh.totpoly);
-  attribute_math::DefaultMixer<T> mixer(r_values);
 
-  for (const int poly_index : IndexRange(mesh.totpoly)) {
-    const MPoly &poly = mesh.mpoly[poly_index];
-    for (const int loop_index : IndexRange(poly.loopstart, poly.totloop)) {
-      MLoop &loop = mesh.mloop[loop_index];
-      const int point_index = loop.v;
-      mixer.mix_in(poly_index, old_values[point_index]);
+  parallel_for(IndexRange(mesh.totpoly), 1024, [&](IndexRange range) {
+    for (const int poly_index : range) {
+      const MPoly &poly = mesh.mpoly[poly_index];
+      attribute_math::DefaultAccumulator<T> accumulator;
+      for (const int loop_index : IndexRange(poly.loopstart, poly.totloop)) {
+        const MLoop &loop = mesh.mloop[loop_index];
+        accumulator.mix_in(old_values[loop.v]);
+      }
+      r_values[poly_index] = accumulator.finalize();
     }
-  }
-  mixer.finalize();
+  });
 }
 
 static ReadAttributePtr adapt_mesh_domain_point_to_polygon(const Mesh &mesh,
@@ -397,10 +499,12 @@ static ReadAttributePtr adapt_mesh_domain_point_to_polygon(const Mesh &mesh,
   const CustomDataType data_type = attribute->custom_data_type();
   attribute_math::convert_to_static_type(data_type, [&](auto dummy) {
     using T = decltype(dummy);
-    if constexpr (!std::is_void_v<attribute_math::DefaultMixer<T>>) {
+    if constexpr (!std::is_void_v<attribute_math::DefaultAccumulator<T>>) {
       Array<T> values(mesh.totpoly);
-      adapt_mesh_domain_point_to_polygon_impl<T>(mesh, attribute->get_span<T>(), values);
-      new_attribute = std::make_unique<OwnedArrayReadAttribute<T>>(ATTR_DOMAIN_POINT,
+      attribute_devirtualize<T>(*attribute, [&](const auto &old_values) {
+        adapt_mesh_domain_point_to_polygon_impl<T>(mesh, old_values, values);
+      });
+      new_attribute = std::make_unique<OwnedArrayReadAttribute<T>>(ATTR_DOMAIN_POLYGON,
                                                                    std::move(values));
     }
   });
@@ -493,8 +597,8 @@ static void set_vertex_position(MVert &vert, const float3 &position)
 static ReadAttributePtr make_vertex_position_read_attribute(const void *data,
                                                             const int domain_size)
 {
-  return std::make_unique<DerivedArrayReadAttribute<MVert, float3, get_vertex_position>>(
-      ATTR_DOMAIN_POINT, Span<MVert>((const MVert *)data, domain_size));
+  return std::make_unique<StridedArrayReadAttribute<MVert, float3>>(
+      ATTR_DOMAIN_POINT, Span<MVert>((const MVert *)data, domain_size), offsetof(MVert, co));
 }
 
 static WriteAttributePtr make_vertex_position_write_attribute(void *data, const int domain_size)
@@ -607,8 +711,8 @@ static void set_loop_uv(MLoopUV &uv, const float2 &co)
 
 static ReadAttributePtr make_uvs_read_attribute(const void *data, const int domain_size)
 {
-  return std::make_unique<DerivedArrayReadAttribute<MLoopUV, float2, get_loop_uv>>(
-      ATTR_DOMAIN_CORNER, Span((const MLoopUV *)data, domain_size));
+  return std::make_unique<StridedArrayReadAttribute<MLoopUV, float2>>(
+      ATTR_DOMAIN_CORNER, Span((const MLoopUV *)data, domain_size), offsetof(MLoopUV, uv));
 }
 
 static WriteAttributePtr make_uvs_write_attribute(void *data, const int domain_size)
@@ -97,4 +97,20 @@ Volume *VolumeComponent::get_for_write()
   return volume_;
 }
 
+bool VolumeComponent::owns_direct_data() const
+{
+  return ownership_ == GeometryOwnershipType::Owned;
+}
+
+void VolumeComponent::ensure_owns_direct_data()
+{
+  BLI_assert(this->is_mutable());
+  if (ownership_ != GeometryOwnershipType::Owned) {
+    if (volume_ != nullptr) {
+      volume_ = BKE_volume_copy_for_eval(volume_, false);
+    }
+    ownership_ = GeometryOwnershipType::Owned;
+  }
+}
+
 /** \} */
@@ -172,6 +172,22 @@ Vector<const GeometryComponent *> GeometrySet::get_components_for_read() const
   return components;
 }
 
+/**
+ * Make sure that the geometry set does not reference data that is owned by someone else, e.g. a
+ * mesh that is freed when the modifier evaluation is done. Afterwards the geometry set can be
+ * kept around for longer, for example in a cache.
+ */
+void GeometrySet::ensure_owns_direct_data()
+{
+  for (const GeometryComponentType type : components_.keys()) {
+    const GeometryComponent *component = this->get_component_for_read(type);
+    if (!component->owns_direct_data()) {
+      GeometryComponent &component_for_write = this->get_component_for_write(type);
+      component_for_write.ensure_owns_direct_data();
+    }
+  }
+}
+
 void GeometrySet::compute_boundbox_without_instances(float3 *r_min, float3 *r_max) const
 {
   const PointCloud *pointcloud = this->get_pointcloud_for_read();
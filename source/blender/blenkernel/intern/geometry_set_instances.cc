@@ -14,6 +14,8 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include "BLI_task.hh"
+
 #include "BKE_geometry_set_instances.hh"
 #include "BKE_mesh.h"
 #include "BKE_mesh_wrapper.h"
@@ -28,13 +30,35 @@
 
 namespace blender::bke {
 
-static void geometry_set_collect_recursive(const GeometrySet &geometry_set,
+/**
+ * An instance of the geometry of #GeometryInstanceGroup at the given index in the result vector.
+ * The transforms of the instances are only added to the groups in the end, so that the instances
+ * of an object or collection can be reused when it is instanced multiple times.
+ */
+struct GroupInstance {
+  int64_t group_index;
+  float4x4 transform;
+};
+
+struct InstancesGatherContext {
+  Vector<GeometryInstanceGroup> &r_sets;
+  /**
+   * The instances of every object and collection that has been gathered already, relative to
+   * the transform of the object or collection. This avoids creating a new group for every time an
+   * object is instanced.
+   */
+  Map<const ID *, Vector<GroupInstance>> instances_by_id;
+};
+
+static void geometry_set_collect_recursive(InstancesGatherContext &context,
+                                           const GeometrySet &geometry_set,
                                            const float4x4 &transform,
-                                           Vector<GeometryInstanceGroup> &r_sets);
+                                           Vector<GroupInstance> &r_instances);
 
-static void geometry_set_collect_recursive_collection(const Collection &collection,
+static void geometry_set_collect_recursive_collection(InstancesGatherContext &context,
+                                                      const Collection &collection,
                                                       const float4x4 &transform,
-                                                      Vector<GeometryInstanceGroup> &r_sets);
+                                                      Vector<GroupInstance> &r_instances);
 
 /**
  * \note This doesn't extract instances from the "dupli" system for non-geometry-nodes instances.
@@ -71,53 +95,101 @@ static GeometrySet object_get_geometry_set_for_read(const Object &object)
   return new_geometry_set;
 }
 
-static void geometry_set_collect_recursive_collection_instance(
-    const Collection &collection, const float4x4 &transform, Vector<GeometryInstanceGroup> &r_sets)
+/**
+ * Add the instances of an object or collection, gathering them only the first time the data is
+ * instanced.
+ */
+template<typename CollectF>
+static void geometry_set_collect_recursive_id(InstancesGatherContext &context,
+                                              const ID &id,
+                                              const float4x4 &transform,
+                                              Vector<GroupInstance> &r_instances,
+                                              const CollectF &collect)
+{
+  const Vector<GroupInstance> *id_instances = context.instances_by_id.lookup_ptr(&id);
+  if (id_instances == nullptr) {
+    float4x4 unit_transform;
+    unit_m4(unit_transform.values);
+    Vector<GroupInstance> new_id_instances;
+    collect(unit_transform, new_id_instances);
+    /* The map might have changed while gathering the instances recursively. */
+    id_instances = &context.instances_by_id.lookup_or_add(&id, std::move(new_id_instances));
+  }
+  for (const GroupInstance &instance : *id_instances) {
+    r_instances.append({instance.group_index, transform * instance.transform});
+  }
+}
+
+static void geometry_set_collect_recursive_collection_instance(InstancesGatherContext &context,
+                                                               const Collection &collection,
+                                                               const float4x4 &transform,
+                                                               Vector<GroupInstance> &r_instances)
 {
   float4x4 offset_matrix;
   unit_m4(offset_matrix.values);
   sub_v3_v3(offset_matrix.values[3], collection.instance_offset);
   const float4x4 instance_transform = transform * offset_matrix;
-  geometry_set_collect_recursive_collection(collection, instance_transform, r_sets);
+  geometry_set_collect_recursive_id(
+      context,
+      collection.id,
+      instance_transform,
+      r_instances,
+      [&](const float4x4 &unit_transform, Vector<GroupInstance> &r_collection_instances) {
+        geometry_set_collect_recursive_collection(
+            context, collection, unit_transform, r_collection_instances);
+      });
 }
 
-static void geometry_set_collect_recursive_object(const Object &object,
+static void geometry_set_collect_recursive_object(InstancesGatherContext &context,
+                                                  const Object &object,
                                                   const float4x4 &transform,
-                                                  Vector<GeometryInstanceGroup> &r_sets)
+                                                  Vector<GroupInstance> &r_instances)
 {
-  GeometrySet instance_geometry_set = object_get_geometry_set_for_read(object);
-  geometry_set_collect_recursive(instance_geometry_set, transform, r_sets);
-
-  if (object.type == OB_EMPTY) {
-    const Collection *collection_instance = object.instance_collection;
-    if (collection_instance != nullptr) {
-      geometry_set_collect_recursive_collection_instance(*collection_instance, transform, r_sets);
-    }
-  }
+  geometry_set_collect_recursive_id(
+      context,
+      object.id,
+      transform,
+      r_instances,
+      [&](const float4x4 &unit_transform, Vector<GroupInstance> &r_object_instances) {
+        GeometrySet instance_geometry_set = object_get_geometry_set_for_read(object);
+        geometry_set_collect_recursive(
+            context, instance_geometry_set, unit_transform, r_object_instances);
+
+        if (object.type == OB_EMPTY) {
+          const Collection *collection_instance = object.instance_collection;
+          if (collection_instance != nullptr) {
+            geometry_set_collect_recursive_collection_instance(
+                context, *collection_instance, unit_transform, r_object_instances);
+          }
+        }
+      });
 }
 
-static void geometry_set_collect_recursive_collection(const Collection &collection,
+static void geometry_set_collect_recursive_collection(InstancesGatherContext &context,
+                                                      const Collection &collection,
                                                       const float4x4 &transform,
-                                                      Vector<GeometryInstanceGroup> &r_sets)
+                                                      Vector<GroupInstance> &r_instances)
 {
   LISTBASE_FOREACH (const CollectionObject *, collection_object, &collection.gobject) {
     BLI_assert(collection_object->ob != nullptr);
     const Object &object = *collection_object->ob;
     const float4x4 object_transform = transform * object.obmat;
-    geometry_set_collect_recursive_object(object, object_transform, r_sets);
+    geometry_set_collect_recursive_object(context, object, object_transform, r_instances);
   }
   LISTBASE_FOREACH (const CollectionChild *, collection_child, &collection.children) {
     BLI_assert(collection_child->collection != nullptr);
     const Collection &collection = *collection_child->collection;
-    geometry_set_collect_recursive_collection(collection, transform, r_sets);
+    geometry_set_collect_recursive_collection(context, collection, transform, r_instances);
   }
 }
 
-static void geometry_set_collect_recursive(const GeometrySet &geometry_set,
+static void geometry_set_collect_recursive(InstancesGatherContext &context,
+                                           const GeometrySet &geometry_set,
                                            const float4x4 &transform,
-                                           Vector<GeometryInstanceGroup> &r_sets)
+                                           Vector<GroupInstance> &r_instances)
 {
-  r_sets.append({geometry_set, {transform}});
+  const int64_t group_index = context.r_sets.append_and_get_index({geometry_set, {}});
+  r_instances.append({group_index, transform});
 
   if (geometry_set.has_instances()) {
     const InstancesComponent &instances_component =
@@ -132,12 +204,13 @@ static void geometry_set_collect_recursive(const GeometrySet &geometry_set,
       if (data.type == INSTANCE_DATA_TYPE_OBJECT) {
         BLI_assert(data.data.object != nullptr);
         const Object &object = *data.data.object;
-        geometry_set_collect_recursive_object(object, instance_transform, r_sets);
+        geometry_set_collect_recursive_object(context, object, instance_transform, r_instances);
       }
       else if (data.type == INSTANCE_DATA_TYPE_COLLECTION) {
         BLI_assert(data.data.collection != nullptr);
         const Collection &collection = *data.data.collection;
-        geometry_set_collect_recursive_collection_instance(collection, instance_transform, r_sets);
+        geometry_set_collect_recursive_collection_instance(
+            context, collection, instance_transform, r_instances);
       }
     }
   }
@@ -148,6 +221,10 @@ static void geometry_set_collect_recursive(const GeometrySet &geometry_set,
  * instances and object instances will be expanded into the instances of their geometry components.
  * Even the instances in those geometry components' will be included.
  *
+ * Objects and collections that are instanced multiple times only have a single group, which
+ * contains the transforms of all their instances. That way the instances can be processed
+ * without copying their geometry for every instance.
+ *
  * \note For convenience (to avoid duplication in the caller), the returned vector also contains
  * the argument geometry set.
  *
@@ -156,12 +233,17 @@ static void geometry_set_collect_recursive(const GeometrySet &geometry_set,
 Vector<GeometryInstanceGroup> geometry_set_gather_instances(const GeometrySet &geometry_set)
 {
   Vector<GeometryInstanceGroup> result_vector;
+  InstancesGatherContext context{result_vector};
 
   float4x4 unit_transform;
   unit_m4(unit_transform.values);
 
-  geometry_set_collect_recursive(geometry_set, unit_transform, result_vector);
+  Vector<GroupInstance> instances;
+  geometry_set_collect_recursive(context, geometry_set, unit_transform, instances);
 
+  for (const GroupInstance &instance : instances) {
+    result_vector[instance.group_index].transforms.append(instance.transform);
+  }
   return result_vector;
 }
 
@@ -199,6 +281,82 @@ void gather_attribute_info(Map<std::string, AttributeKind> &attributes,
   }
 }
 
+/**
+ * The position of the elements of a single instance in the joined mesh. The offsets are computed
+ * before copying the data, so that the instances can be copied in parallel.
+ */
+struct MeshRealizeTask {
+  const Mesh *mesh;
+  const PointCloud *pointcloud;
+  const float4x4 *transform;
+  int vert_offset;
+  int edge_offset;
+  int loop_offset;
+  int poly_offset;
+};
+
+static void realize_mesh_instance(const MeshRealizeTask &task, Mesh &new_mesh)
+{
+  const Mesh &mesh = *task.mesh;
+  const float4x4 &transform = *task.transform;
+  const int vert_offset = task.vert_offset;
+  const int edge_offset = task.edge_offset;
+  const int loop_offset = task.loop_offset;
+
+  /* Large meshes are split up as well, in case there are only a few instances. */
+  parallel_for(IndexRange(mesh.totvert), 4096, [&](IndexRange range) {
+    for (const int i : range) {
+      const MVert &old_vert = mesh.mvert[i];
+      MVert &new_vert = new_mesh.mvert[vert_offset + i];
+
+      new_vert = old_vert;
+
+      const float3 new_position = transform * float3(old_vert.co);
+      copy_v3_v3(new_vert.co, new_position);
+    }
+  });
+  parallel_for(IndexRange(mesh.totedge), 4096, [&](IndexRange range) {
+    for (const int i : range) {
+      const MEdge &old_edge = mesh.medge[i];
+      MEdge &new_edge = new_mesh.medge[edge_offset + i];
+      new_edge = old_edge;
+      new_edge.v1 += vert_offset;
+      new_edge.v2 += vert_offset;
+    }
+  });
+  parallel_for(IndexRange(mesh.totloop), 4096, [&](IndexRange range) {
+    for (const int i : range) {
+      const MLoop &old_loop = mesh.mloop[i];
+      MLoop &new_loop = new_mesh.mloop[loop_offset + i];
+      new_loop = old_loop;
+      new_loop.v += vert_offset;
+      new_loop.e += edge_offset;
+    }
+  });
+  parallel_for(IndexRange(mesh.totpoly), 4096, [&](IndexRange range) {
+    for (const int i : range) {
+      const MPoly &old_poly = mesh.mpoly[i];
+      MPoly &new_poly = new_mesh.mpoly[task.poly_offset + i];
+      new_poly = old_poly;
+      new_poly.loopstart += loop_offset;
+    }
+  });
+}
+
+static void realize_pointcloud_instance(const MeshRealizeTask &task, Mesh &new_mesh)
+{
+  const PointCloud &pointcloud = *task.pointcloud;
+  const float4x4 &transform = *task.transform;
+  parallel_for(IndexRange(pointcloud.totpoint), 4096, [&](IndexRange range) {
+    for (const int i : range) {
+      MVert &new_vert = new_mesh.mvert[task.vert_offset + i];
+      const float3 old_position = pointcloud.co[i];
+      const float3 new_position = transform * old_position;
+      copy_v3_v3(new_vert.co, new_position);
+    }
+  });
+}
+
 static Mesh *join_mesh_topology_and_builtin_attributes(Span<GeometryInstanceGroup> set_groups,
                                                        const bool convert_points_to_vertices)
 {
@@ -210,15 +368,18 @@ static Mesh *join_mesh_topology_and_builtin_attributes(Span<GeometryInstanceGrou
   int64_t cd_dirty_poly = 0;
   int64_t cd_dirty_edge = 0;
   int64_t cd_dirty_loop = 0;
+  Vector<MeshRealizeTask> tasks;
   for (const GeometryInstanceGroup &set_group : set_groups) {
     const GeometrySet &set = set_group.geometry_set;
-    const int tot_transforms = set_group.transforms.size();
     if (set.has_mesh()) {
       const Mesh &mesh = *set.get_mesh_for_read();
-      totverts += mesh.totvert * tot_transforms;
-      totloops += mesh.totloop * tot_transforms;
-      totedges += mesh.totedge * tot_transforms;
-      totpolys += mesh.totpoly * tot_transforms;
+      for (const float4x4 &transform : set_group.transforms) {
+        tasks.append({&mesh, nullptr, &transform, totverts, totedges, totloops, totpolys});
+        totverts += mesh.totvert;
+        totloops += mesh.totloop;
+        totedges += mesh.totedge;
+        totpolys += mesh.totpoly;
+      }
       cd_dirty_vert |= mesh.runtime.cd_dirty_vert;
       cd_dirty_poly |= mesh.runtime.cd_dirty_poly;
       cd_dirty_edge |= mesh.runtime.cd_dirty_edge;
@@ -226,7 +387,10 @@ static Mesh *join_mesh_topology_and_builtin_attributes(Span<GeometryInstanceGrou
     }
     if (convert_points_to_vertices && set.has_pointcloud()) {
       const PointCloud &pointcloud = *set.get_pointcloud_for_read();
-      totverts += pointcloud.totpoint * tot_transforms;
+      for (const float4x4 &transform : set_group.transforms) {
+        tasks.append({nullptr, &pointcloud, &transform, totverts, 0, 0, 0});
+        totverts += pointcloud.totpoint;
+      }
     }
   }
 
@@ -245,68 +409,27 @@ static Mesh *join_mesh_topology_and_builtin_attributes(Span<GeometryInstanceGrou
   new_mesh->runtime.cd_dirty_edge = cd_dirty_edge;
   new_mesh->runtime.cd_dirty_loop = cd_dirty_loop;
 
-  int vert_offset = 0;
-  int loop_offset = 0;
-  int edge_offset = 0;
-  int poly_offset = 0;
-  for (const GeometryInstanceGroup &set_group : set_groups) {
-    const GeometrySet &set = set_group.geometry_set;
-    if (set.has_mesh()) {
-      const Mesh &mesh = *set.get_mesh_for_read();
-      for (const float4x4 &transform : set_group.transforms) {
-        for (const int i : IndexRange(mesh.totvert)) {
-          const MVert &old_vert = mesh.mvert[i];
-          MVert &new_vert = new_mesh->mvert[vert_offset + i];
-
-          new_vert = old_vert;
-
-          const float3 new_position = transform * float3(old_vert.co);
-          copy_v3_v3(new_vert.co, new_position);
-        }
-        for (const int i : IndexRange(mesh.totedge)) {
-          const MEdge &old_edge = mesh.medge[i];
-          MEdge &new_edge = new_mesh->medge[edge_offset + i];
-          new_edge = old_edge;
-          new_edge.v1 += vert_offset;
-          new_edge.v2 += vert_offset;
-        }
-        for (const int i : IndexRange(mesh.totloop)) {
-          const MLoop &old_loop = mesh.mloop[i];
-          MLoop &new_loop = new_mesh->mloop[loop_offset + i];
-          new_loop = old_loop;
-          new_loop.v += vert_offset;
-          new_loop.e += edge_offset;
-        }
-        for (const int i : IndexRange(mesh.totpoly)) {
-          const MPoly &old_poly = mesh.mpoly[i];
-          MPoly &new_poly = new_mesh->mpoly[poly_offset + i];
-          new_poly = old_poly;
-          new_poly.loopstart += loop_offset;
-        }
-
-        vert_offset += mesh.totvert;
-        loop_offset += mesh.totloop;
-        edge_offset += mesh.totedge;
-        poly_offset += mesh.totpoly;
+  parallel_for(tasks.index_range(), 1, [&](IndexRange range) {
+    for (const int i : range) {
+      const MeshRealizeTask &task = tasks[i];
+      if (task.mesh != nullptr) {
+        realize_mesh_instance(task, *new_mesh);
       }
-    }
-    if (convert_points_to_vertices && set.has_pointcloud()) {
-      const PointCloud &pointcloud = *set.get_pointcloud_for_read();
-      for (const float4x4 &transform : set_group.transforms) {
-        for (const int i : IndexRange(pointcloud.totpoint)) {
-          MVert &new_vert = new_mesh->mvert[vert_offset + i];
-          const float3 old_position = pointcloud.co[i];
-          const float3 new_position = transform * old_position;
-          copy_v3_v3(new_vert.co, new_position);
-        }
-        vert_offset += pointcloud.totpoint;
+      else {
+        realize_pointcloud_instance(task, *new_mesh);
       }
     }
-  }
+  });
 
   return new_mesh;
 }
 
+struct AttributeCopyTask {
+  const void *src_buffer;
+  int dst_offset;
+  int size;
+};
+
 static void join_attributes(Span<GeometryInstanceGroup> set_groups,
                             Span<GeometryComponentType> component_types,
                             const Map<std::string, AttributeKind> &attribute_info,
@@ -327,6 +450,10 @@ static void join_attributes(Span<GeometryInstanceGroup> set_groups,
     }
     fn::GMutableSpan dst_span = write_attribute->get_span_for_write_only();
 
+    /* Find the source data of every instance first, then copy it in parallel. The source
+     * attributes have to stay alive until the data is copied. */
+    Vector<ReadAttributePtr> source_attributes;
+    Vector<AttributeCopyTask> tasks;
     int offset = 0;
     for (const GeometryInstanceGroup &set_group : set_groups) {
       const GeometrySet &set = set_group.geometry_set;
@@ -343,9 +470,9 @@ static void join_attributes(Span<GeometryInstanceGroup> set_groups,
           if (source_attribute) {
             fn::GSpan src_span = source_attribute->get_span();
             const void *src_buffer = src_span.data();
+            source_attributes.append(std::move(source_attribute));
             for (const int UNUSED(i) : set_group.transforms.index_range()) {
-              void *dst_buffer = dst_span[offset];
-              cpp_type->copy_to_initialized_n(src_buffer, dst_buffer, domain_size);
+              tasks.append({src_buffer, offset, domain_size});
               offset += domain_size;
             }
           }
@@ -356,6 +483,18 @@ static void join_attributes(Span<GeometryInstanceGroup> set_groups,
       }
     }
 
+    parallel_for(tasks.index_range(), 1, [&](IndexRange range) {
+      for (const int i : range) {
+        const AttributeCopyTask &task = tasks[i];
+        parallel_for(IndexRange(task.size), 4096, [&](IndexRange copy_range) {
+          cpp_type->copy_to_initialized_n(
+              POINTER_OFFSET(task.src_buffer, cpp_type->size() * copy_range.start()),
+              dst_span[task.dst_offset + copy_range.start()],
+              copy_range.size());
+        });
+      }
+    });
+
     write_attribute->apply_span();
   }
 }
@@ -394,7 +533,8 @@ static void join_instance_groups_pointcloud(Span<GeometryInstanceGroup> set_grou
     const GeometrySet &set = set_group.geometry_set;
     if (set.has<PointCloudComponent>()) {
       const PointCloudComponent &component = *set.get_component_for_read<PointCloudComponent>();
-      totpoint += component.attribute_domain_size(ATTR_DOMAIN_POINT);
+      totpoint += component.attribute_domain_size(ATTR_DOMAIN_POINT) *
+                  set_group.transforms.size();
     }
   }
 
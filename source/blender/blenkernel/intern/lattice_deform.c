@@ -137,12 +137,12 @@ LatticeDeformData *BKE_lattice_deform_data_create(const Object *oblatt, const Ob
           fp[1] = bp->vec[1] - fv;
           fp[2] = bp->vec[2] - fw;
         }
-
-        mul_mat3_m4_v3(imat, fp);
       }
     }
   }
 
+  mul_mat3_m4_v3_array(imat, (float(*)[3])latticedata, num_points);
+
   lattice_deform_data = MEM_mallocN(sizeof(LatticeDeformData), "Lattice Deform Data");
   lattice_deform_data->latticedata = latticedata;
   lattice_deform_data->lattice_weights = lattice_weights;
@@ -1498,10 +1498,7 @@ void BKE_mesh_transform(Mesh *me, const float mat[4][4], bool do_keys)
   if (do_keys && me->key) {
     KeyBlock *kb;
     for (kb = me->key->block.first; kb; kb = kb->next) {
-      float *fp = kb->data;
-      for (i = kb->totelem; i--; fp += 3) {
-        mul_m4_v3(mat, fp);
-      }
+      mul_m4_v3_array(mat, kb->data, kb->totelem);
     }
   }
 
@@ -1513,9 +1510,7 @@ void BKE_mesh_transform(Mesh *me, const float mat[4][4], bool do_keys)
 
     copy_m3_m4(m3, mat);
     normalize_m3(m3);
-    for (i = 0; i < me->totloop; i++, lnors++) {
-      mul_m3_v3(m3, *lnors);
-    }
+    mul_m3_v3_array(m3, lnors, me->totloop);
   }
 }
 
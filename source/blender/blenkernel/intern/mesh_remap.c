@@ -115,6 +115,115 @@ static bool mesh_remap_bvhtree_query_raycast(BVHTreeFromMesh *treedata,
   return false;
 }
 
+/**
+ * Batch version of #mesh_remap_bvhtree_query_nearest for all \a cos at once,
+ * returns an array of results where the index is -1 for points without a hit.
+ */
+static BVHTreeNearest *mesh_remap_bvhtree_query_nearest_array(BVHTreeFromMesh *treedata,
+                                                              const float (*cos)[3],
+                                                              const int cos_num,
+                                                              const float max_dist_sq)
+{
+  BVHTreeNearest *nearest = MEM_mallocN(sizeof(*nearest) * (size_t)cos_num, __func__);
+  for (int i = 0; i < cos_num; i++) {
+    nearest[i].index = -1;
+    nearest[i].dist_sq = max_dist_sq;
+  }
+
+  BLI_bvhtree_find_nearest_array(
+      treedata->tree, cos, cos_num, nearest, treedata->nearest_callback, treedata, 0);
+
+  for (int i = 0; i < cos_num; i++) {
+    if (nearest[i].dist_sq > max_dist_sq) {
+      nearest[i].index = -1;
+    }
+  }
+  return nearest;
+}
+
+/**
+ * Batch version of #mesh_remap_bvhtree_query_raycast for all \a cos at once,
+ * returns an array of results where the index is -1 for points without a hit.
+ */
+static BVHTreeRayHit *mesh_remap_bvhtree_query_raycast_array(BVHTreeFromMesh *treedata,
+                                                             const float (*cos)[3],
+                                                             const float (*nos)[3],
+                                                             const int cos_num,
+                                                             const float radius,
+                                                             const float max_dist)
+{
+  BVHTreeRayHit *rayhits = MEM_mallocN(sizeof(*rayhits) * (size_t)cos_num, __func__);
+  BVHTreeRayHit *rayhits_inv = MEM_mallocN(sizeof(*rayhits_inv) * (size_t)cos_num, __func__);
+  float(*inv_nos)[3] = MEM_mallocN(sizeof(*inv_nos) * (size_t)cos_num, __func__);
+
+  for (int i = 0; i < cos_num; i++) {
+    rayhits[i].index = -1;
+    rayhits[i].dist = max_dist;
+  }
+  BLI_bvhtree_ray_cast_array(treedata->tree,
+                             cos,
+                             nos,
+                             cos_num,
+                             radius,
+                             rayhits,
+                             treedata->raycast_callback,
+                             treedata,
+                             BVH_RAYCAST_DEFAULT);
+
+  /* Also cast in the other direction! */
+  memcpy(rayhits_inv, rayhits, sizeof(*rayhits) * (size_t)cos_num);
+  for (int i = 0; i < cos_num; i++) {
+    negate_v3_v3(inv_nos[i], nos[i]);
+  }
+  BLI_bvhtree_ray_cast_array(treedata->tree,
+                             cos,
+                             (const float(*)[3])inv_nos,
+                             cos_num,
+                             radius,
+                             rayhits_inv,
+                             treedata->raycast_callback,
+                             treedata,
+                             BVH_RAYCAST_DEFAULT);
+
+  for (int i = 0; i < cos_num; i++) {
+    if (rayhits_inv[i].dist < rayhits[i].dist) {
+      rayhits[i] = rayhits_inv[i];
+    }
+    if (rayhits[i].dist > max_dist) {
+      rayhits[i].index = -1;
+    }
+  }
+
+  MEM_freeN(rayhits_inv);
+  MEM_freeN(inv_nos);
+  return rayhits;
+}
+
+/**
+ * Get the coordinates (and optionally normals) of \a verts in tree space.
+ */
+static void mesh_remap_verts_to_tree_space(const MVert *verts,
+                                           const int verts_num,
+                                           const SpaceTransform *space_transform,
+                                           float (*r_cos)[3],
+                                           float (*r_nos)[3])
+{
+  for (int i = 0; i < verts_num; i++) {
+    copy_v3_v3(r_cos[i], verts[i].co);
+    if (r_nos) {
+      normal_short_to_float_v3(r_nos[i], verts[i].no);
+    }
+
+    /* Convert the vertex to tree coordinates, if needed. */
+    if (space_transform) {
+      BLI_space_transform_apply(space_transform, r_cos[i]);
+      if (r_nos) {
+        BLI_space_transform_apply_normal(space_transform, r_nos[i]);
+      }
+    }
+  }
+}
+
 /** \} */
 
 /**
@@ -523,51 +632,43 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
   }
   else {
     BVHTreeFromMesh treedata = {NULL};
-    BVHTreeNearest nearest = {0};
-    BVHTreeRayHit rayhit = {0};
-    float hit_dist;
-    float tmp_co[3], tmp_no[3];
+    float(*cos_dst)[3] = MEM_mallocN(sizeof(*cos_dst) * (size_t)numverts_dst, __func__);
 
     if (mode == MREMAP_MODE_VERT_NEAREST) {
       BKE_bvhtree_from_mesh_get(&treedata, me_src, BVHTREE_FROM_VERTS, 2);
-      nearest.index = -1;
 
-      for (i = 0; i < numverts_dst; i++) {
-        copy_v3_v3(tmp_co, verts_dst[i].co);
+      mesh_remap_verts_to_tree_space(verts_dst, numverts_dst, space_transform, cos_dst, NULL);
+      BVHTreeNearest *nearest = mesh_remap_bvhtree_query_nearest_array(
+          &treedata, (const float(*)[3])cos_dst, numverts_dst, max_dist_sq);
 
-        /* Convert the vertex to tree coordinates, if needed. */
-        if (space_transform) {
-          BLI_space_transform_apply(space_transform, tmp_co);
-        }
-
-        if (mesh_remap_bvhtree_query_nearest(
-                &treedata, &nearest, tmp_co, max_dist_sq, &hit_dist)) {
-          mesh_remap_item_define(r_map, i, hit_dist, 0, 1, &nearest.index, &full_weight);
+      for (i = 0; i < numverts_dst; i++) {
+        if (nearest[i].index != -1) {
+          const float hit_dist = sqrtf(nearest[i].dist_sq);
+          mesh_remap_item_define(r_map, i, hit_dist, 0, 1, &nearest[i].index, &full_weight);
         }
         else {
           /* No source for this dest vertex! */
           BKE_mesh_remap_item_define_invalid(r_map, i);
         }
       }
+
+      MEM_freeN(nearest);
     }
     else if (ELEM(mode, MREMAP_MODE_VERT_EDGE_NEAREST, MREMAP_MODE_VERT_EDGEINTERP_NEAREST)) {
       MEdge *edges_src = me_src->medge;
       float(*vcos_src)[3] = BKE_mesh_vert_coords_alloc(me_src, NULL);
 
       BKE_bvhtree_from_mesh_get(&treedata, me_src, BVHTREE_FROM_EDGES, 2);
-      nearest.index = -1;
 
-      for (i = 0; i < numverts_dst; i++) {
-        copy_v3_v3(tmp_co, verts_dst[i].co);
+      mesh_remap_verts_to_tree_space(verts_dst, numverts_dst, space_transform, cos_dst, NULL);
+      BVHTreeNearest *nearest = mesh_remap_bvhtree_query_nearest_array(
+          &treedata, (const float(*)[3])cos_dst, numverts_dst, max_dist_sq);
 
-        /* Convert the vertex to tree coordinates, if needed. */
-        if (space_transform) {
-          BLI_space_transform_apply(space_transform, tmp_co);
-        }
-
-        if (mesh_remap_bvhtree_query_nearest(
-                &treedata, &nearest, tmp_co, max_dist_sq, &hit_dist)) {
-          MEdge *me = &edges_src[nearest.index];
+      for (i = 0; i < numverts_dst; i++) {
+        if (nearest[i].index != -1) {
+          const float *tmp_co = cos_dst[i];
+          const float hit_dist = sqrtf(nearest[i].dist_sq);
+          MEdge *me = &edges_src[nearest[i].index];
           const float *v1cos = vcos_src[me->v1];
           const float *v2cos = vcos_src[me->v2];
 
@@ -598,6 +699,7 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
         }
       }
 
+      MEM_freeN(nearest);
       MEM_freeN(vcos_src);
     }
     else if (ELEM(mode,
@@ -616,24 +718,25 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
       BKE_bvhtree_from_mesh_get(&treedata, me_src, BVHTREE_FROM_LOOPTRI, 2);
 
       if (mode == MREMAP_MODE_VERT_POLYINTERP_VNORPROJ) {
-        for (i = 0; i < numverts_dst; i++) {
-          copy_v3_v3(tmp_co, verts_dst[i].co);
-          normal_short_to_float_v3(tmp_no, verts_dst[i].no);
-
-          /* Convert the vertex to tree coordinates, if needed. */
-          if (space_transform) {
-            BLI_space_transform_apply(space_transform, tmp_co);
-            BLI_space_transform_apply_normal(space_transform, tmp_no);
-          }
+        float(*nos_dst)[3] = MEM_mallocN(sizeof(*nos_dst) * (size_t)numverts_dst, __func__);
+        mesh_remap_verts_to_tree_space(
+            verts_dst, numverts_dst, space_transform, cos_dst, nos_dst);
+        BVHTreeRayHit *rayhits = mesh_remap_bvhtree_query_raycast_array(
+            &treedata,
+            (const float(*)[3])cos_dst,
+            (const float(*)[3])nos_dst,
+            numverts_dst,
+            ray_radius,
+            max_dist);
 
-          if (mesh_remap_bvhtree_query_raycast(
-                  &treedata, &rayhit, tmp_co, tmp_no, ray_radius, max_dist, &hit_dist)) {
-            const MLoopTri *lt = &treedata.looptri[rayhit.index];
+        for (i = 0; i < numverts_dst; i++) {
+          if (rayhits[i].index != -1) {
+            const MLoopTri *lt = &treedata.looptri[rayhits[i].index];
             MPoly *mp_src = &polys_src[lt->poly];
             const int sources_num = mesh_remap_interp_poly_data_get(mp_src,
                                                                     loops_src,
                                                                     (const float(*)[3])vcos_src,
-                                                                    rayhit.co,
+                                                                    rayhits[i].co,
                                                                     &tmp_buff_size,
                                                                     &vcos,
                                                                     false,
@@ -642,28 +745,27 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
                                                                     true,
                                                                     NULL);
 
-            mesh_remap_item_define(r_map, i, hit_dist, 0, sources_num, indices, weights);
+            mesh_remap_item_define(
+                r_map, i, rayhits[i].dist, 0, sources_num, indices, weights);
           }
           else {
             /* No source for this dest vertex! */
             BKE_mesh_remap_item_define_invalid(r_map, i);
           }
         }
+
+        MEM_freeN(rayhits);
+        MEM_freeN(nos_dst);
       }
       else {
-        nearest.index = -1;
+        mesh_remap_verts_to_tree_space(verts_dst, numverts_dst, space_transform, cos_dst, NULL);
+        BVHTreeNearest *nearest = mesh_remap_bvhtree_query_nearest_array(
+            &treedata, (const float(*)[3])cos_dst, numverts_dst, max_dist_sq);
 
         for (i = 0; i < numverts_dst; i++) {
-          copy_v3_v3(tmp_co, verts_dst[i].co);
-
-          /* Convert the vertex to tree coordinates, if needed. */
-          if (space_transform) {
-            BLI_space_transform_apply(space_transform, tmp_co);
-          }
-
-          if (mesh_remap_bvhtree_query_nearest(
-                  &treedata, &nearest, tmp_co, max_dist_sq, &hit_dist)) {
-            const MLoopTri *lt = &treedata.looptri[nearest.index];
+          if (nearest[i].index != -1) {
+            const float hit_dist = sqrtf(nearest[i].dist_sq);
+            const MLoopTri *lt = &treedata.looptri[nearest[i].index];
             MPoly *mp = &polys_src[lt->poly];
 
             if (mode == MREMAP_MODE_VERT_POLY_NEAREST) {
@@ -671,7 +773,7 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
               mesh_remap_interp_poly_data_get(mp,
                                               loops_src,
                                               (const float(*)[3])vcos_src,
-                                              nearest.co,
+                                              nearest[i].co,
                                               &tmp_buff_size,
                                               &vcos,
                                               false,
@@ -686,7 +788,7 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
               const int sources_num = mesh_remap_interp_poly_data_get(mp,
                                                                       loops_src,
                                                                       (const float(*)[3])vcos_src,
-                                                                      nearest.co,
+                                                                      nearest[i].co,
                                                                       &tmp_buff_size,
                                                                       &vcos,
                                                                       false,
@@ -703,6 +805,8 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
             BKE_mesh_remap_item_define_invalid(r_map, i);
           }
         }
+
+        MEM_freeN(nearest);
       }
 
       MEM_freeN(vcos_src);
@@ -715,6 +819,7 @@ void BKE_mesh_remap_calc_verts_from_mesh(const int mode,
       memset(r_map->items, 0, sizeof(*r_map->items) * (size_t)numverts_dst);
     }
 
+    MEM_freeN(cos_dst);
     free_bvhtree_from_mesh(&treedata);
   }
 }
@@ -2252,64 +2357,78 @@ void BKE_mesh_remap_calc_polys_from_mesh(const int mode,
   }
   else {
     BVHTreeFromMesh treedata = {NULL};
-    BVHTreeNearest nearest = {0};
     BVHTreeRayHit rayhit = {0};
     float hit_dist;
 
     BKE_bvhtree_from_mesh_get(&treedata, me_src, BVHTREE_FROM_LOOPTRI, 2);
 
-    if (mode == MREMAP_MODE_POLY_NEAREST) {
-      nearest.index = -1;
+    if (ELEM(mode, MREMAP_MODE_POLY_NEAREST, MREMAP_MODE_POLY_NOR)) {
+      float(*cos_dst)[3] = MEM_mallocN(sizeof(*cos_dst) * (size_t)numpolys_dst, __func__);
+      float(*nos_dst)[3] = NULL;
 
       for (i = 0; i < numpolys_dst; i++) {
         MPoly *mp = &polys_dst[i];
-
-        BKE_mesh_calc_poly_center(mp, &loops_dst[mp->loopstart], verts_dst, tmp_co);
+        BKE_mesh_calc_poly_center(mp, &loops_dst[mp->loopstart], verts_dst, cos_dst[i]);
 
         /* Convert the vertex to tree coordinates, if needed. */
         if (space_transform) {
-          BLI_space_transform_apply(space_transform, tmp_co);
+          BLI_space_transform_apply(space_transform, cos_dst[i]);
         }
+      }
 
-        if (mesh_remap_bvhtree_query_nearest(
-                &treedata, &nearest, tmp_co, max_dist_sq, &hit_dist)) {
-          const MLoopTri *lt = &treedata.looptri[nearest.index];
-          const int poly_index = (int)lt->poly;
-          mesh_remap_item_define(r_map, i, hit_dist, 0, 1, &poly_index, &full_weight);
-        }
-        else {
-          /* No source for this dest poly! */
-          BKE_mesh_remap_item_define_invalid(r_map, i);
+      int *hit_indices = MEM_mallocN(sizeof(*hit_indices) * (size_t)numpolys_dst, __func__);
+      float *hit_dists = MEM_mallocN(sizeof(*hit_dists) * (size_t)numpolys_dst, __func__);
+
+      if (mode == MREMAP_MODE_POLY_NEAREST) {
+        BVHTreeNearest *nearest = mesh_remap_bvhtree_query_nearest_array(
+            &treedata, (const float(*)[3])cos_dst, numpolys_dst, max_dist_sq);
+        for (i = 0; i < numpolys_dst; i++) {
+          hit_indices[i] = nearest[i].index;
+          hit_dists[i] = sqrtf(nearest[i].dist_sq);
         }
+        MEM_freeN(nearest);
       }
-    }
-    else if (mode == MREMAP_MODE_POLY_NOR) {
-      BLI_assert(poly_nors_dst);
-
-      for (i = 0; i < numpolys_dst; i++) {
-        MPoly *mp = &polys_dst[i];
+      else {
+        BLI_assert(poly_nors_dst);
 
-        BKE_mesh_calc_poly_center(mp, &loops_dst[mp->loopstart], verts_dst, tmp_co);
-        copy_v3_v3(tmp_no, poly_nors_dst[i]);
+        nos_dst = MEM_mallocN(sizeof(*nos_dst) * (size_t)numpolys_dst, __func__);
+        for (i = 0; i < numpolys_dst; i++) {
+          copy_v3_v3(nos_dst[i], poly_nors_dst[i]);
+          if (space_transform) {
+            BLI_space_transform_apply_normal(space_transform, nos_dst[i]);
+          }
+        }
 
-        /* Convert the vertex to tree coordinates, if needed. */
-        if (space_transform) {
-          BLI_space_transform_apply(space_transform, tmp_co);
-          BLI_space_transform_apply_normal(space_transform, tmp_no);
+        BVHTreeRayHit *rayhits = mesh_remap_bvhtree_query_raycast_array(
+            &treedata,
+            (const float(*)[3])cos_dst,
+            (const float(*)[3])nos_dst,
+            numpolys_dst,
+            ray_radius,
+            max_dist);
+        for (i = 0; i < numpolys_dst; i++) {
+          hit_indices[i] = rayhits[i].index;
+          hit_dists[i] = rayhits[i].dist;
         }
+        MEM_freeN(rayhits);
+        MEM_freeN(nos_dst);
+      }
 
-        if (mesh_remap_bvhtree_query_raycast(
-                &treedata, &rayhit, tmp_co, tmp_no, ray_radius, max_dist, &hit_dist)) {
-          const MLoopTri *lt = &treedata.looptri[rayhit.index];
+      for (i = 0; i < numpolys_dst; i++) {
+        if (hit_indices[i] != -1) {
+          const MLoopTri *lt = &treedata.looptri[hit_indices[i]];
           const int poly_index = (int)lt->poly;
-
-          mesh_remap_item_define(r_map, i, hit_dist, 0, 1, &poly_index, &full_weight);
+          mesh_remap_item_define(r_map, i, hit_dists[i], 0, 1, &poly_index, &full_weight);
         }
         else {
           /* No source for this dest poly! */
           BKE_mesh_remap_item_define_invalid(r_map, i);
         }
       }
+
+      MEM_freeN(cos_dst);
+      MEM_freeN(hit_indices);
+      MEM_freeN(hit_dists);
     }
     else if (mode == MREMAP_MODE_POLY_POLYINTERP_PNORPROJ) {
       /* We cast our rays randomly, with a pseudo-even distribution
@@ -0,0 +1,288 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bke
+ */
+
+#include "BLI_array.hh"
+#include "BLI_hash.h"
+#include "BLI_math_base.h"
+#include "BLI_math_geom.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.hh"
+#include "BLI_task.hh"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "BKE_mesh_runtime.h"
+#include "BKE_mesh_sample.hh"
+
+namespace blender::bke::mesh_surface_sample {
+
+static Span<MLoopTri> get_mesh_looptris(const Mesh &mesh)
+{
+  /* This only updates a cache and can be considered to be logically const. */
+  const MLoopTri *looptris = BKE_mesh_runtime_looptri_ensure(const_cast<Mesh *>(&mesh));
+  const int looptris_len = BKE_mesh_runtime_looptri_len(&mesh);
+  return {looptris, looptris_len};
+}
+
+struct LooptriSample {
+  float3 v0_pos;
+  float3 v1_pos;
+  float3 v2_pos;
+  int points_amount;
+};
+
+/**
+ * Computes the number of points on the triangle. This uses the first random number of the
+ * generator, the following numbers are used for the positions of the points.
+ */
+static LooptriSample sample_looptri(const Mesh &mesh,
+                                    const MLoopTri &looptri,
+                                    const float4x4 &transform,
+                                    const float base_density,
+                                    const Span<float> density_factors,
+                                    RandomNumberGenerator &looptri_rng)
+{
+  const int v0_loop = looptri.tri[0];
+  const int v1_loop = looptri.tri[1];
+  const int v2_loop = looptri.tri[2];
+  LooptriSample sample;
+  sample.v0_pos = transform * float3(mesh.mvert[mesh.mloop[v0_loop].v].co);
+  sample.v1_pos = transform * float3(mesh.mvert[mesh.mloop[v1_loop].v].co);
+  sample.v2_pos = transform * float3(mesh.mvert[mesh.mloop[v2_loop].v].co);
+
+  float looptri_density_factor = 1.0f;
+  if (!density_factors.is_empty()) {
+    const float v0_density_factor = std::max(0.0f, density_factors[v0_loop]);
+    const float v1_density_factor = std::max(0.0f, density_factors[v1_loop]);
+    const float v2_density_factor = std::max(0.0f, density_factors[v2_loop]);
+    looptri_density_factor = (v0_density_factor + v1_density_factor + v2_density_factor) / 3.0f;
+  }
+  const float area = area_tri_v3(sample.v0_pos, sample.v1_pos, sample.v2_pos);
+
+  const float points_amount_fl = area * base_density * looptri_density_factor;
+  const float add_point_probability = fractf(points_amount_fl);
+  const bool add_point = add_point_probability > looptri_rng.get_float();
+  sample.points_amount = (int)points_amount_fl + (int)add_point;
+  return sample;
+}
+
+void sample_surface_random(const Mesh &mesh,
+                           const float4x4 &transform,
+                           const float base_density,
+                           const Span<float> density_factors,
+                           const int seed,
+                           Vector<float3> &r_positions,
+                           Vector<float3> &r_bary_coords,
+                           Vector<int> &r_looptri_indices)
+{
+  BLI_assert(density_factors.is_empty() || density_factors.size() == mesh.totloop);
+  Span<MLoopTri> looptris = get_mesh_looptris(mesh);
+
+  /* Count the points on every triangle first, so that they can be written to their final
+   * position in parallel afterwards. The random number generators are seeded again for that. */
+  Array<int> looptri_offsets(looptris.size() + 1);
+  parallel_for(looptris.index_range(), 1024, [&](IndexRange range) {
+    for (const int looptri_index : range) {
+      RandomNumberGenerator looptri_rng(BLI_hash_int(looptri_index + seed));
+      looptri_offsets[looptri_index] =
+          sample_looptri(
+              mesh, looptris[looptri_index], transform, base_density, density_factors, looptri_rng)
+              .points_amount;
+    }
+  });
+
+  int points_len = r_positions.size();
+  for (const int looptri_index : looptris.index_range()) {
+    const int points_amount = looptri_offsets[looptri_index];
+    looptri_offsets[looptri_index] = points_len;
+    points_len += points_amount;
+  }
+  looptri_offsets.last() = points_len;
+
+  r_positions.resize(points_len);
+  r_bary_coords.resize(points_len);
+  r_looptri_indices.resize(points_len);
+
+  parallel_for(looptris.index_range(), 1024, [&](IndexRange range) {
+    for (const int looptri_index : range) {
+      const int offset = looptri_offsets[looptri_index];
+      const int points_amount = looptri_offsets[looptri_index + 1] - offset;
+      if (points_amount == 0) {
+        continue;
+      }
+      RandomNumberGenerator looptri_rng(BLI_hash_int(looptri_index + seed));
+      const LooptriSample sample = sample_looptri(
+          mesh, looptris[looptri_index], transform, base_density, density_factors, looptri_rng);
+      BLI_assert(sample.points_amount == points_amount);
+
+      for (const int i : IndexRange(offset, points_amount)) {
+        const float3 bary_coord = looptri_rng.get_barycentric_coordinates();
+        interp_v3_v3v3v3(r_positions[i], sample.v0_pos, sample.v1_pos, sample.v2_pos, bary_coord);
+        r_bary_coords[i] = bary_coord;
+        r_looptri_indices[i] = looptri_index;
+      }
+    }
+  });
+}
+
+/**
+ * A uniform grid whose cells are as large as the minimum distance, so that all points that are
+ * close to a point are in the neighboring cells. The cells are stored in a hash table with a
+ * fixed number of buckets. Different cells can end up in the same bucket, which only means that
+ * more points have to be checked.
+ */
+class PointGrid {
+ private:
+  /** 64-bit cell coordinates, so that neighboring cells of clamped coordinates can't overflow. */
+  struct int3 {
+    int64_t x, y, z;
+  };
+
+  float cell_size_inv_;
+  uint32_t bucket_mask_;
+  /** The points of every bucket are stored in a contiguous range of #bucket_points_. */
+  Array<int> bucket_offsets_;
+  Array<int> bucket_points_;
+
+ public:
+  PointGrid(const Span<float3> positions, const Span<int> point_indices, const float cell_size)
+      : cell_size_inv_(1.0f / cell_size)
+  {
+    const int buckets_num = power_of_2_max_i(std::max<int>(point_indices.size(), 1));
+    bucket_mask_ = (uint32_t)(buckets_num - 1);
+
+    Array<int> point_buckets(point_indices.size());
+    parallel_for(point_indices.index_range(), 4096, [&](IndexRange range) {
+      for (const int i : range) {
+        const int3 cell = this->cell_for_position(positions[point_indices[i]]);
+        point_buckets[i] = (int)this->bucket_for_cell(cell);
+      }
+    });
+
+    /* Sort the points into the buckets with a counting sort. */
+    bucket_offsets_.reinitialize(buckets_num + 1);
+    bucket_offsets_.fill(0);
+    for (const int bucket : point_buckets) {
+      bucket_offsets_[bucket + 1]++;
+    }
+    for (const int bucket : IndexRange(buckets_num)) {
+      bucket_offsets_[bucket + 1] += bucket_offsets_[bucket];
+    }
+    Array<int> bucket_fill(buckets_num, 0);
+    bucket_points_.reinitialize(point_indices.size());
+    for (const int i : point_indices.index_range()) {
+      const int bucket = point_buckets[i];
+      bucket_points_[bucket_offsets_[bucket] + bucket_fill[bucket]] = point_indices[i];
+      bucket_fill[bucket]++;
+    }
+  }
+
+  /**
+   * Call the function for all points in the cells around the position. This includes points
+   * that are farther away than the cell size, and points can be passed to the function more than
+   * once.
+   */
+  template<typename Func> void foreach_point_near(const float3 &position, const Func &func) const
+  {
+    const int3 cell = this->cell_for_position(position);
+    for (int64_t z = cell.z - 1; z <= cell.z + 1; z++) {
+      for (int64_t y = cell.y - 1; y <= cell.y + 1; y++) {
+        for (int64_t x = cell.x - 1; x <= cell.x + 1; x++) {
+          const uint32_t bucket = this->bucket_for_cell({x, y, z});
+          const IndexRange bucket_range(bucket_offsets_[bucket],
+                                        bucket_offsets_[bucket + 1] - bucket_offsets_[bucket]);
+          for (const int point_index : bucket_points_.as_span().slice(bucket_range)) {
+            func(point_index);
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  /**
+   * Clamp before converting to an integer, a tiny cell size or large coordinates would overflow
+   * otherwise. Far away points sharing a clamped cell only means that more points are checked.
+   */
+  static int64_t cell_coordinate(const float value)
+  {
+    const float limit = (float)(INT64_C(1) << 62);
+    return (int64_t)floorf(std::min(limit, std::max(-limit, value)));
+  }
+
+  int3 cell_for_position(const float3 &position) const
+  {
+    return {cell_coordinate(position.x * cell_size_inv_),
+            cell_coordinate(position.y * cell_size_inv_),
+            cell_coordinate(position.z * cell_size_inv_)};
+  }
+
+  static uint32_t fold_coordinate(const int64_t value)
+  {
+    return (uint32_t)((uint64_t)value ^ ((uint64_t)value >> 32));
+  }
+
+  uint32_t bucket_for_cell(const int3 &cell) const
+  {
+    return BLI_hash_int_3d(
+               fold_coordinate(cell.x), fold_coordinate(cell.y), fold_coordinate(cell.z)) &
+           bucket_mask_;
+  }
+};
+
+void eliminate_close_points(const Span<float3> positions,
+                            const float minimum_distance,
+                            MutableSpan<bool> elimination_mask)
+{
+  BLI_assert(positions.size() == elimination_mask.size());
+  if (minimum_distance <= 0.0f) {
+    return;
+  }
+
+  Vector<int> remaining_points;
+  for (const int i : positions.index_range()) {
+    if (!elimination_mask[i]) {
+      remaining_points.append(i);
+    }
+  }
+  const PointGrid grid{positions, remaining_points, minimum_distance};
+  const float minimum_distance_sq = minimum_distance * minimum_distance;
+
+  /* Every point that is not eliminated yet is kept and eliminates the close points after it.
+   * Deciding on points in parallel is not worth it in index order: neighboring points usually
+   * have neighboring indices, which gives long chains of points that depend on each other. */
+  for (const int point_index : remaining_points) {
+    if (elimination_mask[point_index]) {
+      continue;
+    }
+    const float3 position = positions[point_index];
+    grid.foreach_point_near(position, [&](const int other_index) {
+      if (other_index <= point_index || elimination_mask[other_index]) {
+        return;
+      }
+      if (float3::distance_squared(position, positions[other_index]) <= minimum_distance_sq) {
+        elimination_mask[other_index] = true;
+      }
+    });
+  }
+}
+
+}  // namespace blender::bke::mesh_surface_sample
@@ -0,0 +1,285 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_kdtree.h"
+#include "BLI_math_matrix.h"
+#include "BLI_rand.hh"
+
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_mesh_sample.hh"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+#include "PIL_time.h"
+
+#include "mesh_test_utils.hh"
+
+namespace blender::bke::mesh_surface_sample::tests {
+
+using blender::bke::tests::test_grid_mesh_create;
+
+static float4x4 identity_transform()
+{
+  float4x4 transform;
+  unit_m4(transform.values);
+  return transform;
+}
+
+TEST(mesh_surface_sample, SampleSurfaceRandom)
+{
+  Mesh *mesh = test_grid_mesh_create(11);
+
+  Vector<float3> positions;
+  Vector<float3> bary_coords;
+  Vector<int> looptri_indices;
+  sample_surface_random(
+      *mesh, identity_transform(), 100.0f, {}, 0, positions, bary_coords, looptri_indices);
+  /* Every triangle has an area of 0.5, so it gets exactly 50 points. */
+  EXPECT_EQ(positions.size(), 100 * 100);
+  EXPECT_EQ(bary_coords.size(), positions.size());
+  EXPECT_EQ(looptri_indices.size(), positions.size());
+  for (const int i : positions.index_range()) {
+    EXPECT_EQ(looptri_indices[i], i / 50);
+    EXPECT_GE(positions[i].x, 0.0f);
+    EXPECT_LE(positions[i].x, 10.0f);
+    EXPECT_NEAR(bary_coords[i].x + bary_coords[i].y + bary_coords[i].z, 1.0f, 1e-5f);
+  }
+
+  /* Sampling again with the same seed gives the same points, they are appended to the vectors. */
+  sample_surface_random(
+      *mesh, identity_transform(), 100.0f, {}, 0, positions, bary_coords, looptri_indices);
+  EXPECT_EQ(positions.size(), 2 * 100 * 100);
+  for (const int i : IndexRange(100 * 100)) {
+    EXPECT_EQ(positions[i], positions[100 * 100 + i]);
+  }
+
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST(mesh_surface_sample, SampleSurfaceDensityFactors)
+{
+  Mesh *mesh = test_grid_mesh_create(11);
+
+  /* Only the corners of the first face have a density. */
+  Array<float> density_factors(mesh->totloop, 0.0f);
+  density_factors.as_mutable_span().take_front(4).fill(1.0f);
+
+  Vector<float3> positions;
+  Vector<float3> bary_coords;
+  Vector<int> looptri_indices;
+  sample_surface_random(*mesh,
+                        identity_transform(),
+                        100.0f,
+                        density_factors,
+                        0,
+                        positions,
+                        bary_coords,
+                        looptri_indices);
+  EXPECT_EQ(positions.size(), 100);
+  for (const int looptri_index : looptri_indices) {
+    EXPECT_LT(looptri_index, 2);
+  }
+
+  BKE_id_free(nullptr, mesh);
+}
+
+/* The elimination with a KD-tree that was used before, the result must not change. */
+static void eliminate_close_points_kdtree(const Span<float3> positions,
+                                          const float minimum_distance,
+                                          MutableSpan<bool> elimination_mask)
+{
+  KDTree_3d *kdtree = BLI_kdtree_3d_new(positions.size());
+  for (const int i : positions.index_range()) {
+    BLI_kdtree_3d_insert(kdtree, i, positions[i]);
+  }
+  BLI_kdtree_3d_balance(kdtree);
+
+  for (const int i : positions.index_range()) {
+    if (elimination_mask[i]) {
+      continue;
+    }
+    struct CallbackData {
+      int index;
+      MutableSpan<bool> elimination_mask;
+    } callback_data = {i, elimination_mask};
+
+    BLI_kdtree_3d_range_search_cb(
+        kdtree,
+        positions[i],
+        minimum_distance,
+        [](void *user_data, int index, const float *UNUSED(co), float UNUSED(dist_sq)) {
+          CallbackData &callback_data = *static_cast<CallbackData *>(user_data);
+          if (index != callback_data.index) {
+            callback_data.elimination_mask[index] = true;
+          }
+          return true;
+        },
+        &callback_data);
+  }
+  BLI_kdtree_3d_free(kdtree);
+}
+
+TEST(mesh_surface_sample, EliminateClosePointsSameAsKDTree)
+{
+  /* Points on the same triangle have neighboring indices, like in the Point Distribute node. */
+  Mesh *mesh = test_grid_mesh_create(21);
+  Vector<float3> positions;
+  Vector<float3> bary_coords;
+  Vector<int> looptri_indices;
+  sample_surface_random(
+      *mesh, identity_transform(), 50.0f, {}, 0, positions, bary_coords, looptri_indices);
+
+  for (const float minimum_distance : {0.01f, 0.2f, 3.0f}) {
+    Array<bool> elimination_mask(positions.size());
+    for (const int i : positions.index_range()) {
+      elimination_mask[i] = i % 7 == 0;
+    }
+    Array<bool> elimination_mask_kdtree = elimination_mask;
+
+    eliminate_close_points(positions, minimum_distance, elimination_mask);
+    eliminate_close_points_kdtree(positions, minimum_distance, elimination_mask_kdtree);
+    EXPECT_EQ_ARRAY(elimination_mask.data(), elimination_mask_kdtree.data(), positions.size());
+  }
+
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST(mesh_surface_sample, EliminateClosePoints)
+{
+  RandomNumberGenerator rng(0);
+  Array<float3> positions(5000);
+  for (float3 &position : positions) {
+    position = float3(rng.get_float(), rng.get_float(), rng.get_float()) * 10.0f;
+  }
+  Array<bool> elimination_mask(positions.size(), false);
+  /* Points that are eliminated already are not used. */
+  elimination_mask[0] = true;
+
+  const float minimum_distance = 0.5f;
+  eliminate_close_points(positions, minimum_distance, elimination_mask);
+  EXPECT_TRUE(elimination_mask[0]);
+
+  Vector<float3> remaining_positions;
+  for (const int i : positions.index_range()) {
+    if (!elimination_mask[i]) {
+      remaining_positions.append(positions[i]);
+    }
+  }
+  EXPECT_GT(remaining_positions.size(), 0);
+  EXPECT_LT(remaining_positions.size(), positions.size());
+
+  for (const int i : positions.index_range()) {
+    float closest_distance = FLT_MAX;
+    for (const float3 &remaining_position : remaining_positions) {
+      if (positions[i] != remaining_position) {
+        closest_distance = std::min(closest_distance,
+                                    float3::distance(positions[i], remaining_position));
+      }
+    }
+    if (elimination_mask[i]) {
+      /* Points are only eliminated when there is a remaining point close to them. */
+      if (i != 0) {
+        EXPECT_LE(closest_distance, minimum_distance);
+      }
+    }
+    else {
+      EXPECT_GT(closest_distance, minimum_distance);
+    }
+  }
+
+  /* The result is deterministic. */
+  Array<bool> elimination_mask_2(positions.size(), false);
+  elimination_mask_2[0] = true;
+  eliminate_close_points(positions, minimum_distance, elimination_mask_2);
+  EXPECT_EQ_ARRAY(elimination_mask.data(), elimination_mask_2.data(), positions.size());
+}
+
+TEST(mesh_surface_sample, EliminateClosePointsLargeCoordinates)
+{
+  /* Cell coordinates are far outside of the integer range here. */
+  const float minimum_distance = 1e-30f;
+  Vector<float3> positions = {
+      {1e30f, 0.0f, 0.0f}, {1e30f, 0.0f, 0.0f}, {-1e30f, 5.0f, 0.0f}, {0.0f, 0.0f, 1e-29f}};
+  Array<bool> elimination_mask(positions.size(), false);
+  eliminate_close_points(positions, minimum_distance, elimination_mask);
+
+  /* One of the two equal points is eliminated, the others are kept. */
+  EXPECT_NE(elimination_mask[0], elimination_mask[1]);
+  EXPECT_FALSE(elimination_mask[2]);
+  EXPECT_FALSE(elimination_mask[3]);
+}
+
+static void test_point_distribute_performance(const char *id, const float density)
+{
+  printf("\n========== STARTING %s ==========\n", id);
+
+  Mesh *mesh = test_grid_mesh_create(101);
+
+  Vector<float3> positions;
+  Vector<float3> bary_coords;
+  Vector<int> looptri_indices;
+  {
+    const double start_time = PIL_check_seconds_timer();
+    sample_surface_random(
+        *mesh, identity_transform(), density, {}, 0, positions, bary_coords, looptri_indices);
+    printf("\tSample %d points: %fs\n",
+           (int)positions.size(),
+           PIL_check_seconds_timer() - start_time);
+  }
+
+  /* Most of the points are removed. */
+  const float minimum_distance = 2.0f / sqrtf(density);
+
+  {
+    Array<bool> elimination_mask(positions.size(), false);
+    const double start_time = PIL_check_seconds_timer();
+    eliminate_close_points_kdtree(positions, minimum_distance, elimination_mask);
+    printf("\tEliminate close points with KD-tree: %fs\n",
+           PIL_check_seconds_timer() - start_time);
+  }
+
+  {
+    Array<bool> elimination_mask(positions.size(), false);
+    const double start_time = PIL_check_seconds_timer();
+    eliminate_close_points(positions, minimum_distance, elimination_mask);
+    printf("\tEliminate close points with grid: %fs\n", PIL_check_seconds_timer() - start_time);
+  }
+
+  BKE_id_free(nullptr, mesh);
+
+  printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(mesh_surface_sample_performance, density_10)
+{
+  test_point_distribute_performance("density 10", 10.0f);
+}
+
+TEST(mesh_surface_sample_performance, density_100)
+{
+  test_point_distribute_performance("density 100", 100.0f);
+}
+
+TEST(mesh_surface_sample_performance, density_1000)
+{
+  test_point_distribute_performance("density 1000", 1000.0f);
+}
+
+}  // namespace blender::bke::mesh_surface_sample::tests
@@ -0,0 +1,62 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include "BLI_index_range.hh"
+
+#include "BKE_mesh.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+namespace blender::bke::tests {
+
+/**
+ * Create a grid of quads with `size * size` vertices. The grid is flat and every quad has an
+ * area of one, unless \a use_height is set, then vertices are moved up to `z = x * y`.
+ */
+inline Mesh *test_grid_mesh_create(const int size, const bool use_height = false)
+{
+  const int quads_size = size - 1;
+  Mesh *mesh = BKE_mesh_new_nomain(
+      size * size, 0, 0, quads_size * quads_size * 4, quads_size * quads_size);
+  for (const int y : IndexRange(size)) {
+    for (const int x : IndexRange(size)) {
+      MVert &vert = mesh->mvert[y * size + x];
+      vert.co[0] = (float)x;
+      vert.co[1] = (float)y;
+      vert.co[2] = use_height ? (float)(x * y) : 0.0f;
+    }
+  }
+  for (const int y : IndexRange(quads_size)) {
+    for (const int x : IndexRange(quads_size)) {
+      const int poly_index = y * quads_size + x;
+      MPoly &poly = mesh->mpoly[poly_index];
+      poly.loopstart = poly_index * 4;
+      poly.totloop = 4;
+      MLoop *loops = &mesh->mloop[poly.loopstart];
+      loops[0].v = y * size + x;
+      loops[1].v = y * size + x + 1;
+      loops[2].v = (y + 1) * size + x + 1;
+      loops[3].v = (y + 1) * size + x;
+    }
+  }
+  BKE_mesh_calc_edges(mesh, false, false);
+  return mesh;
+}
+
+}  // namespace blender::bke::tests
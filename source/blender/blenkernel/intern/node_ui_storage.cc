@@ -126,14 +126,14 @@ static void node_error_message_log(bNodeTree &ntree,
   }
 }
 
-static NodeUIStorage &node_ui_storage_ensure(bNodeTree &ntree,
+/**
+ * The caller has to hold the lock of the tree's UI storage, because nodes are evaluated on
+ * multiple threads and the returned reference is invalidated when the maps grow.
+ */
+static NodeUIStorage &node_ui_storage_ensure(NodeTreeUIStorage &ui_storage,
                                              const NodeTreeEvaluationContext &context,
                                              const bNode &node)
 {
-  ui_storage_ensure(ntree);
-  NodeTreeUIStorage &ui_storage = *ntree.ui_storage;
-
-  std::lock_guard<std::mutex> lock(ui_storage.context_map_mutex);
   Map<std::string, NodeUIStorage> &node_tree_ui_storage =
       ui_storage.context_map.lookup_or_add_default(context);
 
@@ -151,7 +151,9 @@ void BKE_nodetree_error_message_add(bNodeTree &ntree,
 {
   node_error_message_log(ntree, node, message, type);
 
-  NodeUIStorage &node_ui_storage = node_ui_storage_ensure(ntree, context, node);
+  ui_storage_ensure(ntree);
+  std::lock_guard<std::mutex> lock(ntree.ui_storage->context_map_mutex);
+  NodeUIStorage &node_ui_storage = node_ui_storage_ensure(*ntree.ui_storage, context, node);
   node_ui_storage.warnings.append({type, std::move(message)});
 }
 
@@ -160,6 +162,8 @@ void BKE_nodetree_attribute_hint_add(bNodeTree &ntree,
                                      const bNode &node,
                                      const StringRef attribute_name)
 {
-  NodeUIStorage &node_ui_storage = node_ui_storage_ensure(ntree, context, node);
+  ui_storage_ensure(ntree);
+  std::lock_guard<std::mutex> lock(ntree.ui_storage->context_map_mutex);
+  NodeUIStorage &node_ui_storage = node_ui_storage_ensure(*ntree.ui_storage, context, node);
   node_ui_storage.attribute_name_hints.add_as(attribute_name);
 }
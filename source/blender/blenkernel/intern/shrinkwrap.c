@@ -91,6 +91,15 @@ typedef struct ShrinkwrapCalcData {
   float keepDist; /* Distance to keep above target surface (units are in local space) */
 } ShrinkwrapCalcData;
 
+/* Vertices with a non-zero weight in target space, for batched nearest queries. */
+typedef struct ShrinkwrapNearestBatch {
+  int len;
+  int *vert_index;
+  float *weight;
+  float (*co)[3];
+  BVHTreeNearest *nearest;
+} ShrinkwrapNearestBatch;
+
 typedef struct ShrinkwrapCalcCBData {
   ShrinkwrapCalcData *calc;
 
@@ -99,6 +108,8 @@ typedef struct ShrinkwrapCalcCBData {
 
   float *proj_axis;
   SpaceTransform *local2aux;
+
+  ShrinkwrapNearestBatch *batch;
 } ShrinkwrapCalcCBData;
 
 /* Checks if the modifier needs target normals with these settings. */
@@ -346,58 +357,77 @@ void BKE_shrinkwrap_compute_boundary_data(struct Mesh *mesh)
 }
 
 /**
- * Shrink-wrap to the nearest vertex
- *
- * it builds a #BVHTree of vertices we can attach to and then
- * for each vertex performs a nearest vertex search on the tree
+ * Gather the vertices with a weight in target space, to query all of them at once.
  */
-static void shrinkwrap_calc_nearest_vertex_cb_ex(void *__restrict userdata,
-                                                 const int i,
-                                                 const TaskParallelTLS *__restrict tls)
+static void shrinkwrap_nearest_batch_init(const ShrinkwrapCalcData *calc,
+                                          ShrinkwrapNearestBatch *batch)
 {
-  ShrinkwrapCalcCBData *data = userdata;
+  const size_t verts_num = (size_t)calc->numVerts;
+  batch->vert_index = MEM_mallocN(sizeof(*batch->vert_index) * verts_num, __func__);
+  batch->weight = MEM_mallocN(sizeof(*batch->weight) * verts_num, __func__);
+  batch->co = MEM_mallocN(sizeof(*batch->co) * verts_num, __func__);
+  batch->nearest = MEM_mallocN(sizeof(*batch->nearest) * verts_num, __func__);
+  batch->len = 0;
+
+  for (int i = 0; i < calc->numVerts; i++) {
+    float weight = BKE_defvert_array_find_weight_safe(calc->dvert, i, calc->vgroup);
+
+    if (calc->invert_vgroup) {
+      weight = 1.0f - weight;
+    }
 
-  ShrinkwrapCalcData *calc = data->calc;
-  BVHTreeFromMesh *treeData = &data->tree->treeData;
-  BVHTreeNearest *nearest = tls->userdata_chunk;
+    if (weight == 0.0f) {
+      continue;
+    }
 
-  float *co = calc->vertexCos[i];
-  float tmp_co[3];
-  float weight = BKE_defvert_array_find_weight_safe(calc->dvert, i, calc->vgroup);
+    const int j = batch->len++;
+    batch->vert_index[j] = i;
+    batch->weight[j] = weight;
 
-  if (calc->invert_vgroup) {
-    weight = 1.0f - weight;
-  }
+    /* Convert the vertex to tree coordinates */
+    if (calc->vert) {
+      copy_v3_v3(batch->co[j], calc->vert[i].co);
+    }
+    else {
+      copy_v3_v3(batch->co[j], calc->vertexCos[i]);
+    }
+    BLI_space_transform_apply(&calc->local2target, batch->co[j]);
 
-  if (weight == 0.0f) {
-    return;
+    batch->nearest[j].index = -1;
+    batch->nearest[j].dist_sq = FLT_MAX;
   }
+}
 
-  /* Convert the vertex to tree coordinates */
-  if (calc->vert) {
-    copy_v3_v3(tmp_co, calc->vert[i].co);
-  }
-  else {
-    copy_v3_v3(tmp_co, co);
-  }
-  BLI_space_transform_apply(&calc->local2target, tmp_co);
+static void shrinkwrap_nearest_batch_free(ShrinkwrapNearestBatch *batch)
+{
+  MEM_freeN(batch->vert_index);
+  MEM_freeN(batch->weight);
+  MEM_freeN(batch->co);
+  MEM_freeN(batch->nearest);
+}
 
-  /* Use local proximity heuristics (to reduce the nearest search)
-   *
-   * If we already had an hit before.. we assume this vertex is going to have a close hit to that
-   * other vertex so we can initiate the "nearest.dist" with the expected value to that last hit.
-   * This will lead in pruning of the search tree. */
-  if (nearest->index != -1) {
-    nearest->dist_sq = len_squared_v3v3(tmp_co, nearest->co);
-  }
-  else {
-    nearest->dist_sq = FLT_MAX;
-  }
+/**
+ * Shrink-wrap to the nearest vertex
+ *
+ * it builds a #BVHTree of vertices we can attach to and then
+ * for each vertex performs a nearest vertex search on the tree
+ */
+static void shrinkwrap_calc_nearest_vertex_cb_ex(void *__restrict userdata,
+                                                 const int j,
+                                                 const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ShrinkwrapCalcCBData *data = userdata;
 
-  BLI_bvhtree_find_nearest(treeData->tree, tmp_co, nearest, treeData->nearest_callback, treeData);
+  ShrinkwrapCalcData *calc = data->calc;
+  const ShrinkwrapNearestBatch *batch = data->batch;
+  const BVHTreeNearest *nearest = &batch->nearest[j];
 
   /* Found the nearest vertex */
   if (nearest->index != -1) {
+    float *co = calc->vertexCos[batch->vert_index[j]];
+    float weight = batch->weight[j];
+    float tmp_co[3];
+
     /* Adjusting the vertex weight,
      * so that after interpolating it keeps a certain distance from the nearest position */
     if (nearest->dist_sq > FLT_EPSILON) {
@@ -415,23 +445,30 @@ static void shrinkwrap_calc_nearest_vertex_cb_ex(void *__restrict userdata,
 
 static void shrinkwrap_calc_nearest_vertex(ShrinkwrapCalcData *calc)
 {
-  BVHTreeNearest nearest = NULL_BVHTreeNearest;
-
-  /* Setup nearest */
-  nearest.index = -1;
-  nearest.dist_sq = FLT_MAX;
+  BVHTreeFromMesh *treeData = &calc->tree->treeData;
+  ShrinkwrapNearestBatch batch;
+
+  /* Find the nearest vertex of all vertices at once. */
+  shrinkwrap_nearest_batch_init(calc, &batch);
+  BLI_bvhtree_find_nearest_array(treeData->tree,
+                                 (const float(*)[3])batch.co,
+                                 batch.len,
+                                 batch.nearest,
+                                 treeData->nearest_callback,
+                                 treeData,
+                                 0);
 
   ShrinkwrapCalcCBData data = {
       .calc = calc,
       .tree = calc->tree,
+      .batch = &batch,
   };
   TaskParallelSettings settings;
   BLI_parallel_range_settings_defaults(&settings);
-  settings.use_threading = (calc->numVerts > BKE_MESH_OMP_LIMIT);
-  settings.userdata_chunk = &nearest;
-  settings.userdata_chunk_size = sizeof(nearest);
-  BLI_task_parallel_range(
-      0, calc->numVerts, &data, shrinkwrap_calc_nearest_vertex_cb_ex, &settings);
+  settings.use_threading = (batch.len > BKE_MESH_OMP_LIMIT);
+  BLI_task_parallel_range(0, batch.len, &data, shrinkwrap_calc_nearest_vertex_cb_ex, &settings);
+
+  shrinkwrap_nearest_batch_free(&batch);
 }
 
 /*
@@ -1125,7 +1162,8 @@ void BKE_shrinkwrap_find_nearest_surface(struct ShrinkwrapTreeData *tree,
  * Shrinkwrap moving vertexs to the nearest surface point on the target
  *
  * it builds a BVHTree from the target mesh and then performs a
- * NN matches for each vertex
+ * NN matches for each vertex, this is used for #MOD_SHRINKWRAP_TARGET_PROJECT,
+ * other modes query all vertices at once.
  */
 static void shrinkwrap_calc_nearest_surface_point_cb_ex(void *__restrict userdata,
                                                         const int i,
@@ -1157,24 +1195,10 @@ static void shrinkwrap_calc_nearest_surface_point_cb_ex(void *__restrict userdat
   }
   BLI_space_transform_apply(&calc->local2target, tmp_co);
 
-  /* Use local proximity heuristics (to reduce the nearest search)
-   *
-   * If we already had an hit before.. we assume this vertex is going to have a close hit to that
-   * other vertex so we can initiate the "nearest.dist" with the expected value to that last hit.
-   * This will lead in pruning of the search tree. */
-  if (nearest->index != -1) {
-    if (calc->smd->shrinkType == MOD_SHRINKWRAP_TARGET_PROJECT) {
-      /* Heuristic doesn't work because of additional restrictions. */
-      nearest->index = -1;
-      nearest->dist_sq = FLT_MAX;
-    }
-    else {
-      nearest->dist_sq = len_squared_v3v3(tmp_co, nearest->co);
-    }
-  }
-  else {
-    nearest->dist_sq = FLT_MAX;
-  }
+  /* The local proximity heuristic used by #BLI_bvhtree_find_nearest_array
+   * doesn't work because of additional restrictions. */
+  nearest->index = -1;
+  nearest->dist_sq = FLT_MAX;
 
   BKE_shrinkwrap_find_nearest_surface(data->tree, nearest, tmp_co, calc->smd->shrinkType);
 
@@ -1382,8 +1406,69 @@ void BKE_shrinkwrap_snap_point_to_surface(const struct ShrinkwrapTreeData *tree,
   }
 }
 
+/* Apply the results of the batched nearest surface query. */
+static void shrinkwrap_calc_nearest_surface_point_apply_cb_ex(
+    void *__restrict userdata, const int j, const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ShrinkwrapCalcCBData *data = userdata;
+
+  ShrinkwrapCalcData *calc = data->calc;
+  const ShrinkwrapNearestBatch *batch = data->batch;
+  const BVHTreeNearest *nearest = &batch->nearest[j];
+
+  /* Found the nearest vertex */
+  if (nearest->index != -1) {
+    float *co = calc->vertexCos[batch->vert_index[j]];
+    float tmp_co[3];
+
+    BKE_shrinkwrap_snap_point_to_surface(data->tree,
+                                         NULL,
+                                         calc->smd->shrinkMode,
+                                         nearest->index,
+                                         nearest->co,
+                                         nearest->no,
+                                         calc->keepDist,
+                                         batch->co[j],
+                                         tmp_co);
+
+    /* Convert the coordinates back to mesh coordinates */
+    BLI_space_transform_invert(&calc->local2target, tmp_co);
+    interp_v3_v3v3(co, co, tmp_co, batch->weight[j]); /* linear interpolation */
+  }
+}
+
 static void shrinkwrap_calc_nearest_surface_point(ShrinkwrapCalcData *calc)
 {
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+
+  if (calc->smd->shrinkType != MOD_SHRINKWRAP_TARGET_PROJECT) {
+    BVHTreeFromMesh *treeData = &calc->tree->treeData;
+    ShrinkwrapNearestBatch batch;
+
+    /* Find the nearest surface point of all vertices at once. */
+    shrinkwrap_nearest_batch_init(calc, &batch);
+    BLI_bvhtree_find_nearest_array(calc->tree->bvh,
+                                   (const float(*)[3])batch.co,
+                                   batch.len,
+                                   batch.nearest,
+                                   treeData->nearest_callback,
+                                   treeData,
+                                   0);
+
+    ShrinkwrapCalcCBData data = {
+        .calc = calc,
+        .tree = calc->tree,
+        .batch = &batch,
+    };
+    settings.use_threading = (batch.len > BKE_MESH_OMP_LIMIT);
+    BLI_task_parallel_range(
+        0, batch.len, &data, shrinkwrap_calc_nearest_surface_point_apply_cb_ex, &settings);
+
+    shrinkwrap_nearest_batch_free(&batch);
+    return;
+  }
+
   BVHTreeNearest nearest = NULL_BVHTreeNearest;
 
   /* Setup nearest */
@@ -1395,8 +1480,6 @@ static void shrinkwrap_calc_nearest_surface_point(ShrinkwrapCalcData *calc)
       .calc = calc,
       .tree = calc->tree,
   };
-  TaskParallelSettings settings;
-  BLI_parallel_range_settings_defaults(&settings);
   settings.use_threading = (calc->numVerts > BKE_MESH_OMP_LIMIT);
   settings.userdata_chunk = &nearest;
   settings.userdata_chunk_size = sizeof(nearest);
@@ -0,0 +1,270 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A `blender::ConcurrentMap<Key, Value>` is an unordered associative container that can be used
+ * from multiple threads at the same time. It is the #blender::Map counterpart of
+ * #blender::ConcurrentSet, see BLI_concurrent_set.hh for how it works.
+ *
+ * Some noteworthy information:
+ * - All methods that modify or query single items are thread-safe. Methods that change the map as
+ *   a whole (#reserve, #clear, iteration) are not.
+ * - Values are returned by value, references would be invalidated when another thread grows the
+ *   stripe. To update a value in place use #add_or_modify, its callbacks are called while the
+ *   stripe is locked.
+ */
+
+#include <optional>
+
+#include "BLI_concurrent_set.hh"
+#include "BLI_map.hh"
+
+namespace blender {
+
+template<
+    /** Type of the keys stored in the map. It has to be copyable. */
+    typename Key,
+    /** Type of the values stored in the map. It has to be copyable. */
+    typename Value,
+    /**
+     * The strategy used to deal with collisions within a stripe. They are defined in
+     * BLI_probing_strategies.hh.
+     */
+    typename ProbingStrategy = DefaultProbingStrategy,
+    /** The hash function used to hash the keys. See BLI_hash.hh. */
+    typename Hash = DefaultHash<Key>,
+    /** The equality operator used to compare keys. */
+    typename IsEqual = DefaultEquality>
+class ConcurrentMap : NonCopyable, NonMovable {
+ public:
+  using StripeMap = Map<Key, Value, 0, ProbingStrategy, Hash, IsEqual>;
+
+ private:
+  /** Aligned to a cache line, so that locking one stripe doesn't slow down its neighbors. */
+  struct alignas(64) Stripe {
+    std::mutex mutex;
+    StripeMap map;
+  };
+
+  /** Mutable, because the locks are also used by const methods. */
+  mutable Array<Stripe, 0> stripes_;
+  /** The number of stripes minus one, the number of stripes is a power of two. */
+  uint64_t stripe_mask_;
+  Hash hash_;
+
+ public:
+  static constexpr int default_stripes_num = ConcurrentSet<Key>::default_stripes_num;
+
+  /**
+   * \param stripes_num: The number of independently locked maps, it is rounded up to a power of
+   * two.
+   */
+  ConcurrentMap(const int stripes_num = default_stripes_num)
+      : stripes_(power_of_2_max_i(std::max(stripes_num, 1))),
+        stripe_mask_(static_cast<uint64_t>(stripes_.size() - 1))
+  {
+  }
+
+  /**
+   * Add a key-value-pair to the map. If the key exists already, nothing is done. Returns true
+   * when the item has been added.
+   */
+  bool add(const Key &key, const Value &value)
+  {
+    Stripe &stripe = this->stripe_for_key(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.map.add(key, value);
+  }
+
+  /**
+   * Add a key-value-pair to the map. This invokes undefined behavior when the key is in the map
+   * already.
+   */
+  void add_new(const Key &key, const Value &value)
+  {
+    Stripe &stripe = this->stripe_for_key(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    stripe.map.add_new(key, value);
+  }
+
+  /**
+   * Returns true if there is a key in the map that compares equal to the given key.
+   */
+  bool contains(const Key &key) const
+  {
+    Stripe &stripe = this->stripe_for_key(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.map.contains(key);
+  }
+
+  /**
+   * Returns the value that corresponds to the given key. If the key is not in the map, the
+   * default value is returned.
+   */
+  Value lookup_default(const Key &key, const Value &default_value) const
+  {
+    Stripe &stripe = this->stripe_for_key(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    const Value *ptr = stripe.map.lookup_ptr(key);
+    return (ptr == nullptr) ? default_value : *ptr;
+  }
+
+  /**
+   * Returns the value that corresponds to the given key. If the key is not in the map, the value
+   * returned by `create_value()` is added first. The callback is called while the stripe is
+   * locked, so it is only called once per key, even when many threads add the same key.
+   */
+  template<typename CreateValueF>
+  Value lookup_or_add_cb(const Key &key, const CreateValueF &create_value)
+  {
+    Stripe &stripe = this->stripe_for_key(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.map.lookup_or_add_cb(key, create_value);
+  }
+
+  /**
+   * Calls `create_value(Value *ptr)` when the key is not in the map yet and
+   * `modify_value(Value *ptr)` otherwise, while the stripe is locked. Like in
+   * #Map::add_or_modify, create_value has to construct the value in uninitialized memory.
+   * Returns the value after the change.
+   *
+   * This can be used to reduce the values of all threads, e.g. to find the smallest index
+   * that has been added for a key.
+   */
+  template<typename CreateValueF, typename ModifyValueF>
+  Value add_or_modify(const Key &key,
+                      const CreateValueF &create_value,
+                      const ModifyValueF &modify_value)
+  {
+    Stripe &stripe = this->stripe_for_key(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    const Value *value_ptr = nullptr;
+    stripe.map.add_or_modify(
+        key,
+        [&](Value *ptr) {
+          create_value(ptr);
+          value_ptr = ptr;
+        },
+        [&](Value *ptr) {
+          modify_value(ptr);
+          value_ptr = ptr;
+        });
+    return *value_ptr;
+  }
+
+  /**
+   * Get the value that corresponds to the given key and remove it from the map. If the key is
+   * not in the map, nothing is returned.
+   */
+  std::optional<Value> pop_try(const Key &key)
+  {
+    Stripe &stripe = this->stripe_for_key(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.map.pop_try(key);
+  }
+
+  /**
+   * Remove the item with the given key. Returns true when the key existed.
+   */
+  bool remove(const Key &key)
+  {
+    Stripe &stripe = this->stripe_for_key(key);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.map.remove(key);
+  }
+
+  /**
+   * Make sure that the map can hold at least n items without growing, assuming the keys are
+   * distributed evenly over the stripes. This is not thread-safe.
+   */
+  void reserve(const int64_t n)
+  {
+    for (Stripe &stripe : stripes_) {
+      stripe.map.reserve(n / stripes_.size() + 1);
+    }
+  }
+
+  /**
+   * Remove all items from the map. This is not thread-safe.
+   */
+  void clear()
+  {
+    for (Stripe &stripe : stripes_) {
+      stripe.map.clear();
+    }
+  }
+
+  /**
+   * Returns the number of items in the map. This is not thread-safe.
+   */
+  int64_t size() const
+  {
+    int64_t size = 0;
+    for (const Stripe &stripe : stripes_) {
+      size += stripe.map.size();
+    }
+    return size;
+  }
+
+  bool is_empty() const
+  {
+    return this->size() == 0;
+  }
+
+  /**
+   * Call the function with every key and value in the map, in no particular order. This is not
+   * thread-safe.
+   */
+  template<typename FuncT> void foreach_item(const FuncT &func) const
+  {
+    for (const Stripe &stripe : stripes_) {
+      for (const auto item : stripe.map.items()) {
+        func(item.key, item.value);
+      }
+    }
+  }
+
+  /**
+   * The maps of the individual stripes. This can be used to process the items in parallel, once
+   * the map isn't modified anymore.
+   */
+  int64_t stripes_num() const
+  {
+    return stripes_.size();
+  }
+  StripeMap &stripe_map(const int64_t index)
+  {
+    return stripes_[index].map;
+  }
+  const StripeMap &stripe_map(const int64_t index) const
+  {
+    return stripes_[index].map;
+  }
+
+ private:
+  Stripe &stripe_for_key(const Key &key) const
+  {
+    /* Fibonacci hashing, so that the stripe depends on all the low bits of the hash. */
+    const uint64_t mixed_hash = hash_(key) * 0x9E3779B97F4A7C15ull;
+    return stripes_[static_cast<int64_t>((mixed_hash >> 32) & stripe_mask_)];
+  }
+};
+
+}  // namespace blender
@@ -0,0 +1,238 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A `blender::ConcurrentSet<Key>` is a set that can be used from multiple threads at the same
+ * time. It is meant for algorithms that deduplicate elements in parallel, where a #blender::Set
+ * would otherwise have to be filled on a single thread.
+ *
+ * The set is striped: the keys are distributed over a fixed number of #blender::Set instances
+ * based on their hash, and every one of them is protected by its own mutex. Threads only
+ * contend when they access the same stripe at the same time, which is unlikely when there are
+ * many more stripes than threads. Within a stripe the usual open addressing with the given
+ * probing strategy is used, so the hash and probing conventions are the same as for
+ * #blender::Set (see BLI_probing_strategies.hh).
+ *
+ * Some noteworthy information:
+ * - All methods that modify or query single keys are thread-safe. Methods that change the set as a
+ *   whole (#reserve, #clear, iteration) are not, they are expected to be called between parallel
+ *   sections.
+ * - Since other threads may grow a stripe at any time, keys are returned by value and not by
+ *   reference. The set is mostly useful for small keys like indices and pointers.
+ * - The stripe is selected with the high bits of a remixed hash, while the set within the stripe
+ *   uses the low bits of the original hash. That way trivial hash functions (e.g. for integers)
+ *   still distribute the keys well.
+ */
+
+#include <mutex>
+
+#include "BLI_hash.hh"
+#include "BLI_probing_strategies.hh"
+#include "BLI_set.hh"
+#include "BLI_utility_mixins.hh"
+
+namespace blender {
+
+template<
+    /** Type of the elements that are stored in this set. It has to be copyable. */
+    typename Key,
+    /**
+     * The strategy used to deal with collisions within a stripe. They are defined in
+     * BLI_probing_strategies.hh.
+     */
+    typename ProbingStrategy = DefaultProbingStrategy,
+    /** The hash function used to hash the keys. See BLI_hash.hh. */
+    typename Hash = DefaultHash<Key>,
+    /** The equality operator used to compare keys. */
+    typename IsEqual = DefaultEquality>
+class ConcurrentSet : NonCopyable, NonMovable {
+ public:
+  using StripeSet = Set<Key, 0, ProbingStrategy, Hash, IsEqual>;
+
+ private:
+  /** Aligned to a cache line, so that locking one stripe doesn't slow down its neighbors. */
+  struct alignas(64) Stripe {
+    std::mutex mutex;
+    StripeSet set;
+  };
+
+  /** Mutable, because the locks are also used by const methods. */
+  mutable Array<Stripe, 0> stripes_;
+  /** The number of stripes minus one, the number of stripes is a power of two. */
+  uint64_t stripe_mask_;
+  Hash hash_;
+
+ public:
+  /**
+   * \param stripes_num: The number of independently locked sets, it is rounded up to a power of
+   * two.
+   */
+  ConcurrentSet(const int stripes_num = default_stripes_num)
+      : stripes_(power_of_2_max_i(std::max(stripes_num, 1))),
+        stripe_mask_(static_cast<uint64_t>(stripes_.size() - 1))
+  {
+  }
+
+  /**
+   * Add a new key to the set. Returns true when the key did not exist before.
+   */
+  bool add(const Key &key)
+  {
+    const uint64_t hash = hash_(key);
+    Stripe &stripe = this->stripe_for_hash(hash);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.set.add(key);
+  }
+
+  /**
+   * Returns true if the key is in the set.
+   */
+  bool contains(const Key &key) const
+  {
+    const uint64_t hash = hash_(key);
+    Stripe &stripe = this->stripe_for_hash(hash);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.set.contains(key);
+  }
+
+  /**
+   * Returns the key that is stored in the set that compares equal to the given key. If there is
+   * none, the default key is returned.
+   */
+  Key lookup_key_default(const Key &key, const Key &default_key) const
+  {
+    const uint64_t hash = hash_(key);
+    Stripe &stripe = this->stripe_for_hash(hash);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    const Key *ptr = stripe.set.lookup_key_ptr(key);
+    return (ptr == nullptr) ? default_key : *ptr;
+  }
+
+  /**
+   * Returns the key that is stored in the set that compares equal to the given key. If there is
+   * none, the key returned by `create_key()` is added and returned. It has to compare equal to the
+   * given key.
+   *
+   * This is useful when the stored key owns data that should only be created once. The callback
+   * is called while the stripe is locked, so it should be cheap.
+   */
+  template<typename CreateKeyF>
+  Key lookup_key_or_add_cb(const Key &key, const CreateKeyF &create_key)
+  {
+    const uint64_t hash = hash_(key);
+    Stripe &stripe = this->stripe_for_hash(hash);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    const Key *ptr = stripe.set.lookup_key_ptr(key);
+    if (ptr != nullptr) {
+      return *ptr;
+    }
+    Key new_key = create_key();
+    BLI_assert(IsEqual{}(new_key, key));
+    stripe.set.add_new(new_key);
+    return new_key;
+  }
+
+  /**
+   * Remove the key from the set. Returns true when the key existed.
+   */
+  bool remove(const Key &key)
+  {
+    const uint64_t hash = hash_(key);
+    Stripe &stripe = this->stripe_for_hash(hash);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.set.remove(key);
+  }
+
+  /**
+   * Make sure that the set can hold at least n keys without growing, assuming the keys are
+   * distributed evenly over the stripes. This is not thread-safe.
+   */
+  void reserve(const int64_t n)
+  {
+    for (Stripe &stripe : stripes_) {
+      stripe.set.reserve(n / stripes_.size() + 1);
+    }
+  }
+
+  /**
+   * Remove all keys from the set. This is not thread-safe.
+   */
+  void clear()
+  {
+    for (Stripe &stripe : stripes_) {
+      stripe.set.clear();
+    }
+  }
+
+  /**
+   * Returns the number of keys in the set. This is not thread-safe.
+   */
+  int64_t size() const
+  {
+    int64_t size = 0;
+    for (const Stripe &stripe : stripes_) {
+      size += stripe.set.size();
+    }
+    return size;
+  }
+
+  bool is_empty() const
+  {
+    return this->size() == 0;
+  }
+
+  /**
+   * Call the function for every key in the set, in no particular order. This is not thread-safe.
+   */
+  template<typename FuncT> void foreach_key(const FuncT &func) const
+  {
+    for (const Stripe &stripe : stripes_) {
+      for (const Key &key : stripe.set) {
+        func(key);
+      }
+    }
+  }
+
+  /**
+   * The sets of the individual stripes. This can be used to process the keys in parallel, once the
+   * set isn't modified anymore.
+   */
+  int64_t stripes_num() const
+  {
+    return stripes_.size();
+  }
+  const StripeSet &stripe_set(const int64_t index) const
+  {
+    return stripes_[index].set;
+  }
+
+  /** Many more stripes than threads, to make contention unlikely. */
+  static constexpr int default_stripes_num = 256;
+
+ private:
+  Stripe &stripe_for_hash(const uint64_t hash) const
+  {
+    /* Fibonacci hashing, so that the stripe depends on all the low bits of the hash. */
+    const uint64_t mixed_hash = hash * 0x9E3779B97F4A7C15ull;
+    return stripes_[static_cast<int64_t>((mixed_hash >> 32) & stripe_mask_)];
+  }
+};
+
+}  // namespace blender
@@ -0,0 +1,104 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * A `blender::EnumerableThreadSpecific<T>` gives every thread that uses it its own instance of
+ * `T`. The instances are created lazily when a thread calls #local for the first time, and they
+ * can be iterated over once the parallel work is done, e.g. to combine the results of all
+ * threads.
+ *
+ * This is mainly a wrapper for `tbb::enumerable_thread_specific`, so that code using it also
+ * compiles without TBB. In that case the instances are stored in a map, that is protected by a
+ * mutex.
+ */
+
+#ifdef WITH_TBB
+#  include <tbb/enumerable_thread_specific.h>
+#endif
+
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "BLI_map.hh"
+#include "BLI_utility_mixins.hh"
+
+namespace blender {
+
+template<typename T> class EnumerableThreadSpecific : NonCopyable, NonMovable {
+#ifdef WITH_TBB
+
+ private:
+  tbb::enumerable_thread_specific<T> values_;
+
+ public:
+  /**
+   * Get the instance that belongs to the calling thread. It is constructed the first time it is
+   * accessed.
+   */
+  T &local()
+  {
+    return values_.local();
+  }
+
+  /**
+   * Call the function for the instance of every thread that called #local. This is not
+   * thread-safe.
+   */
+  template<typename FuncT> void foreach(const FuncT &func)
+  {
+    for (T &value : values_) {
+      func(value);
+    }
+  }
+
+#else /* WITH_TBB */
+
+ private:
+  struct ThreadIdHash {
+    uint64_t operator()(const std::thread::id &id) const
+    {
+      return std::hash<std::thread::id>{}(id);
+    }
+  };
+
+  std::mutex mutex_;
+  /* The values are not embedded in the map, so that their addresses don't change when it grows. */
+  Map<std::thread::id, std::unique_ptr<T>, 4, DefaultProbingStrategy, ThreadIdHash> values_;
+
+ public:
+  T &local()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return *values_.lookup_or_add_cb(std::this_thread::get_id(),
+                                     []() { return std::make_unique<T>(); });
+  }
+
+  template<typename FuncT> void foreach(const FuncT &func)
+  {
+    for (std::unique_ptr<T> &value : values_.values()) {
+      func(*value);
+    }
+  }
+
+#endif /* WITH_TBB */
+};
+
+}  // namespace blender
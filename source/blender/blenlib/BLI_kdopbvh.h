@@ -104,6 +104,13 @@ enum {
 #define BVH_RAYCAST_DEFAULT (BVH_RAYCAST_WATERTIGHT)
 #define BVH_RAYCAST_DIST_MAX (FLT_MAX / 2.0f)
 
+/* flag for BLI_bvhtree_balance_ex */
+enum {
+  /* Choose splits with the surface area heuristic instead of the median of the largest axis,
+   * gives faster queries, especially ray-casts over elements of uneven size and density. */
+  BVH_BALANCE_USE_SAH = (1 << 0),
+};
+
 /* callback must update nearest in case it finds a nearest result */
 typedef void (*BVHTree_NearestPointCallback)(void *userdata,
                                              int index,
@@ -130,6 +137,11 @@ typedef void (*BVHTree_NearestProjectedCallback)(void *userdata,
                                                  const int clip_plane_len,
                                                  BVHTreeNearest *nearest);
 
+/* callback to recalculate the points of a leaf in BLI_bvhtree_refit,
+ * writes at most BVH_REFIT_POINTS_MAX points to r_co and returns their number. */
+#define BVH_REFIT_POINTS_MAX 8
+typedef int (*BVHTree_RefitCallback)(void *userdata, int index, float (*r_co)[3]);
+
 /* callbacks to BLI_bvhtree_walk_dfs */
 /* return true to traverse into this nodes children, else skip. */
 typedef bool (*BVHTree_WalkParentCallback)(const BVHTreeAxisRange *bounds, void *userdata);
@@ -148,11 +160,13 @@ void BLI_bvhtree_free(BVHTree *tree);
 /* construct: first insert points, then call balance */
 void BLI_bvhtree_insert(BVHTree *tree, int index, const float co[3], int numpoints);
 void BLI_bvhtree_balance(BVHTree *tree);
+void BLI_bvhtree_balance_ex(BVHTree *tree, const int flag);
 
 /* update: first update points/nodes, then call update_tree to refit the bounding volumes */
 bool BLI_bvhtree_update_node(
     BVHTree *tree, int index, const float co[3], const float co_moving[3], int numpoints);
 void BLI_bvhtree_update_tree(BVHTree *tree);
+void BLI_bvhtree_refit(BVHTree *tree, BVHTree_RefitCallback callback, void *userdata);
 
 int BLI_bvhtree_overlap_thread_num(const BVHTree *tree);
 
@@ -195,6 +209,14 @@ int BLI_bvhtree_find_nearest(BVHTree *tree,
                              BVHTree_NearestPointCallback callback,
                              void *userdata);
 
+void BLI_bvhtree_find_nearest_array(BVHTree *tree,
+                                    const float (*co)[3],
+                                    const int co_len,
+                                    BVHTreeNearest *nearest,
+                                    BVHTree_NearestPointCallback callback,
+                                    void *userdata,
+                                    int flag);
+
 int BLI_bvhtree_find_nearest_first(BVHTree *tree,
                                    const float co[3],
                                    const float dist_sq,
@@ -233,6 +255,16 @@ void BLI_bvhtree_ray_cast_all(BVHTree *tree,
                               BVHTree_RayCastCallback callback,
                               void *userdata);
 
+void BLI_bvhtree_ray_cast_array(BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int rays_len,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag);
+
 float BLI_bvhtree_bb_raycast(const float bv[6],
                              const float light_start[3],
                              const float light_end[3],
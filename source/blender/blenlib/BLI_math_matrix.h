@@ -197,6 +197,13 @@ void mul_v3_mat3_m4v3_db(double r[3], const double M[4][4], const double v[3]);
 void mul_m4_v4(const float M[4][4], float r[4]);
 void mul_v4_m4v4(float r[4], const float M[4][4], const float v[4]);
 void mul_v4_m4v3(float r[4], const float M[4][4], const float v[3]); /* v has implicit w = 1.0f */
+void mul_m4_v3_array(const float M[4][4], float (*r)[3], const int r_len);
+void mul_v3_m4v3_array(float (*r)[3], const float M[4][4], const float (*v)[3], const int v_len);
+void mul_mat3_m4_v3_array(const float M[4][4], float (*r)[3], const int r_len);
+void mul_v3_mat3_m4v3_array(float (*r)[3],
+                            const float M[4][4],
+                            const float (*v)[3],
+                            const int v_len);
 void mul_project_m4_v3(const float M[4][4], float vec[3]);
 void mul_v3_project_m4_v3(float r[3], const float mat[4][4], const float vec[3]);
 void mul_v2_project_m4_v3(float r[2], const float M[4][4], const float vec[3]);
@@ -204,6 +211,7 @@ void mul_v2_project_m4_v3(float r[2], const float M[4][4], const float vec[3]);
 void mul_m3_v2(const float m[3][3], float r[2]);
 void mul_v2_m3v2(float r[2], const float m[3][3], const float v[2]);
 void mul_m3_v3(const float M[3][3], float r[3]);
+void mul_m3_v3_array(const float M[3][3], float (*r)[3], const int r_len);
 void mul_v3_m3v3(float r[3], const float M[3][3], const float a[3]);
 void mul_v2_m3v3(float r[2], const float M[3][3], const float a[3]);
 void mul_transposed_m3_v3(const float M[3][3], float r[3]);
@@ -34,3 +34,50 @@
 #  include <emmintrin.h>
 #  define BLI_HAVE_SSE2
 #endif
+
+#ifdef BLI_HAVE_SSE2
+
+#  include "BLI_compiler_compat.h"
+
+/**
+ * Load four consecutive `float[3]` vectors and transpose them so that each register holds one
+ * axis of all four vectors. Exactly 12 floats are read, so this is safe to use at the end of an
+ * array.
+ */
+BLI_INLINE void BLI_simd_load_v3_x4(const float (*v)[3], __m128 *r_x, __m128 *r_y, __m128 *r_z)
+{
+  /* a = (x0 y0 z0 x1), b = (y1 z1 x2 y2), c = (z2 x3 y3 z3). */
+  const __m128 a = _mm_loadu_ps(v[0]);
+  const __m128 b = _mm_loadu_ps(v[1] + 1);
+  const __m128 c = _mm_loadu_ps(v[2] + 2);
+
+  const __m128 x_b2c1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+  *r_x = _mm_shuffle_ps(a, x_b2c1, _MM_SHUFFLE(2, 0, 3, 0));
+
+  const __m128 y_a1b0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+  const __m128 y_b3c2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+  *r_y = _mm_shuffle_ps(y_a1b0, y_b3c2, _MM_SHUFFLE(2, 0, 2, 0));
+
+  const __m128 z_a2b1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+  const __m128 z_c0c3 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+  *r_z = _mm_shuffle_ps(z_a2b1, z_c0c3, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+ * Inverse of #BLI_simd_load_v3_x4, writes exactly 12 floats.
+ */
+BLI_INLINE void BLI_simd_store_v3_x4(float (*r)[3], const __m128 x, const __m128 y, const __m128 z)
+{
+  const __m128 a_lo = _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0));
+  const __m128 a_hi = _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0));
+  const __m128 b_lo = _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1));
+  const __m128 b_hi = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2));
+  const __m128 c_lo = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2));
+  const __m128 c_hi = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3));
+
+  _mm_storeu_ps(r[0], _mm_shuffle_ps(a_lo, a_hi, _MM_SHUFFLE(2, 0, 2, 0)));
+  _mm_storeu_ps(r[1] + 1, _mm_shuffle_ps(b_lo, b_hi, _MM_SHUFFLE(2, 0, 2, 0)));
+  _mm_storeu_ps(r[2] + 2, _mm_shuffle_ps(c_lo, c_hi, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+#endif /* BLI_HAVE_SSE2 */
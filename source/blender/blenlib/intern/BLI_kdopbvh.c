@@ -44,10 +44,13 @@
 #include "BLI_heap_simple.h"
 #include "BLI_kdopbvh.h"
 #include "BLI_math.h"
+#include "BLI_simd.h"
 #include "BLI_stack.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_strict_flags.h"
 
 /* used for iterative_raycast */
@@ -384,6 +387,16 @@ static void create_kdop_hull(
   }
 }
 
+static void bvhtree_node_inflate(const BVHTree *tree, BVHNode *node, const float dist)
+{
+  axis_t axis_iter;
+  for (axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
+    float dist_corrected = dist * bvhtree_kdop_axes_length[axis_iter];
+    node->bv[(2 * axis_iter)] -= dist_corrected;     /* minimum */
+    node->bv[(2 * axis_iter) + 1] += dist_corrected; /* maximum */
+  }
+}
+
 /**
  * \note depends on the fact that the BVH's for each face is already built
  */
@@ -863,6 +876,532 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Surface Area Heuristic Tree Building
+ *
+ * Alternative to #non_recursive_bvh_div_nodes that chooses splits with a binned
+ * surface area heuristic (SAH) over the leaf centroids, instead of the median of the largest axis.
+ * Each branch is split into up to `tree_type` children by repeatedly splitting the child with the
+ * largest surface area.
+ *
+ * Branches are first built into temporary arrays from multiple threads,
+ * then linked into the tree in depth-first order,
+ * so the resulting layout doesn't depend on thread scheduling.
+ *
+ * Only the X, Y and Z axes are used for the heuristic,
+ * so this is not supported for 18-DOP trees which don't store them.
+ * \{ */
+
+#define BVH_SAH_BINS 16
+/** Beyond this depth the median split is used, bounding the depth for degenerate input. */
+#define BVH_SAH_MEDIAN_DEPTH 48
+
+/** Child of a temporary branch that references the leaf at \a i in the leafs array. */
+#define SAH_CHILD_LEAF(i) (-((i) + 1))
+#define SAH_CHILD_IS_LEAF(c) ((c) < 0)
+#define SAH_CHILD_LEAF_INDEX(c) (-(c)-1)
+
+typedef struct BVHSAHBuildData {
+  const BVHTree *tree;
+  BVHNode **leafs_array;
+
+  /** Temporary branches, `tree_type` children for each (see #SAH_CHILD_LEAF). */
+  int *branch_children;
+  char *branch_totnode;
+  char *branch_main_axis;
+  int branch_len;
+} BVHSAHBuildData;
+
+typedef struct BVHSAHRange {
+  int begin, end;
+  /** Axis aligned bounds in k-DOP layout (min/max pairs for X, Y and Z). */
+  float bv[6];
+} BVHSAHRange;
+
+typedef struct BVHSAHBins {
+  int count[BVH_SAH_BINS];
+  float bv[BVH_SAH_BINS][6];
+} BVHSAHBins;
+
+typedef struct BVHSAHBinData {
+  BVHNode **leafs_array;
+  int begin;
+  int axis;
+  float centroid_min;
+  float scale;
+} BVHSAHBinData;
+
+static void bvh_sah_bv_init(float bv[6])
+{
+  bv[0] = bv[2] = bv[4] = FLT_MAX;
+  bv[1] = bv[3] = bv[5] = -FLT_MAX;
+}
+
+static void bvh_sah_bv_expand(float bv[6], const float other[6])
+{
+  for (int i = 0; i < 6; i += 2) {
+    bv[i] = min_ff(bv[i], other[i]);
+    bv[i + 1] = max_ff(bv[i + 1], other[i + 1]);
+  }
+}
+
+static float bvh_sah_half_area(const float bv[6])
+{
+  const float dx = bv[1] - bv[0];
+  const float dy = bv[3] - bv[2];
+  const float dz = bv[5] - bv[4];
+  if (dx < 0.0f) {
+    return 0.0f;
+  }
+  return dx * dy + dy * dz + dz * dx;
+}
+
+BLI_INLINE float bvh_sah_centroid(const BVHNode *node, const int axis)
+{
+  return (node->bv[2 * axis] + node->bv[(2 * axis) + 1]) * 0.5f;
+}
+
+BLI_INLINE int bvh_sah_bin_index(const BVHSAHBinData *data, const BVHNode *node)
+{
+  const int bin = (int)((bvh_sah_centroid(node, data->axis) - data->centroid_min) * data->scale);
+  return CLAMPIS(bin, 0, BVH_SAH_BINS - 1);
+}
+
+static void bvh_sah_range_calc_bv(const BVHSAHBuildData *data, BVHSAHRange *range)
+{
+  bvh_sah_bv_init(range->bv);
+  for (int i = range->begin; i < range->end; i++) {
+    bvh_sah_bv_expand(range->bv, data->leafs_array[i]->bv);
+  }
+}
+
+static void bvh_sah_bins_init(BVHSAHBins *bins)
+{
+  for (int i = 0; i < BVH_SAH_BINS; i++) {
+    bins->count[i] = 0;
+    bvh_sah_bv_init(bins->bv[i]);
+  }
+}
+
+static void bvh_sah_bins_fill_cb(void *__restrict userdata,
+                                 const int i,
+                                 const TaskParallelTLS *__restrict tls)
+{
+  const BVHSAHBinData *data = userdata;
+  BVHSAHBins *bins = tls->userdata_chunk;
+  const BVHNode *node = data->leafs_array[data->begin + i];
+  const int bin = bvh_sah_bin_index(data, node);
+
+  bins->count[bin]++;
+  bvh_sah_bv_expand(bins->bv[bin], node->bv);
+}
+
+static void bvh_sah_bins_reduce(const void *__restrict UNUSED(userdata),
+                                void *__restrict chunk_join,
+                                void *__restrict chunk)
+{
+  BVHSAHBins *bins_join = chunk_join;
+  const BVHSAHBins *bins = chunk;
+
+  for (int i = 0; i < BVH_SAH_BINS; i++) {
+    bins_join->count[i] += bins->count[i];
+    bvh_sah_bv_expand(bins_join->bv[i], bins->bv[i]);
+  }
+}
+
+/**
+ * Partition the leafs of \a range in two, returning the index of the first leaf on the right.
+ */
+static int bvh_sah_split(const BVHSAHBuildData *data,
+                         const BVHSAHRange *range,
+                         const bool use_median,
+                         char *r_axis)
+{
+  BVHNode **leafs_array = data->leafs_array;
+  const int len = range->end - range->begin;
+
+  float centroid_bv[6];
+  bvh_sah_bv_init(centroid_bv);
+  for (int i = range->begin; i < range->end; i++) {
+    for (int axis = 0; axis < 3; axis++) {
+      const float centroid = bvh_sah_centroid(leafs_array[i], axis);
+      centroid_bv[2 * axis] = min_ff(centroid_bv[2 * axis], centroid);
+      centroid_bv[(2 * axis) + 1] = max_ff(centroid_bv[(2 * axis) + 1], centroid);
+    }
+  }
+
+  /* #get_largest_axis returns the index of the maximum value. */
+  const int axis = get_largest_axis(centroid_bv) / 2;
+  const float extent = centroid_bv[(2 * axis) + 1] - centroid_bv[2 * axis];
+  *r_axis = (char)axis;
+
+  if (!use_median && extent > 0.0f) {
+    BVHSAHBinData bin_data = {
+        .leafs_array = leafs_array,
+        .begin = range->begin,
+        .axis = axis,
+        .centroid_min = centroid_bv[2 * axis],
+        .scale = (float)BVH_SAH_BINS / extent,
+    };
+
+    BVHSAHBins bins;
+    bvh_sah_bins_init(&bins);
+
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.use_threading = (len > KDOPBVH_THREAD_LEAF_THRESHOLD);
+    settings.userdata_chunk = &bins;
+    settings.userdata_chunk_size = sizeof(bins);
+    settings.func_reduce = bvh_sah_bins_reduce;
+    BLI_task_parallel_range(0, len, &bin_data, bvh_sah_bins_fill_cb, &settings);
+
+    /* Sweep from the right, then from the left to find the cheapest split. */
+    float right_area[BVH_SAH_BINS];
+    int right_count[BVH_SAH_BINS];
+    float bv[6];
+    int count = 0;
+    bvh_sah_bv_init(bv);
+    for (int i = BVH_SAH_BINS - 1; i > 0; i--) {
+      bvh_sah_bv_expand(bv, bins.bv[i]);
+      count += bins.count[i];
+      right_area[i] = bvh_sah_half_area(bv);
+      right_count[i] = count;
+    }
+
+    float best_cost = FLT_MAX;
+    int best_bin = -1;
+    count = 0;
+    bvh_sah_bv_init(bv);
+    for (int i = 1; i < BVH_SAH_BINS; i++) {
+      bvh_sah_bv_expand(bv, bins.bv[i - 1]);
+      count += bins.count[i - 1];
+      if (count == 0 || right_count[i] == 0) {
+        continue;
+      }
+      const float cost = bvh_sah_half_area(bv) * (float)count +
+                         right_area[i] * (float)right_count[i];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_bin = i;
+      }
+    }
+
+    if (best_bin != -1) {
+      int left = range->begin;
+      int right = range->end - 1;
+      while (left <= right) {
+        if (bvh_sah_bin_index(&bin_data, leafs_array[left]) < best_bin) {
+          left++;
+        }
+        else {
+          SWAP(BVHNode *, leafs_array[left], leafs_array[right]);
+          right--;
+        }
+      }
+      BLI_assert(left > range->begin && left < range->end);
+      return left;
+    }
+  }
+
+  /* Fall back to the median, used when all centroids are in the same bin too. */
+  const int mid = range->begin + len / 2;
+  partition_nth_element(leafs_array, range->begin, range->end, mid, (2 * axis) + 1);
+  return mid;
+}
+
+typedef struct BVHSAHChildrenData {
+  BVHSAHBuildData *build_data;
+  const BVHSAHRange *ranges;
+  const int *children;
+  int depth;
+} BVHSAHChildrenData;
+
+static void bvh_sah_build_branch(BVHSAHBuildData *data,
+                                 const BVHSAHRange *range,
+                                 const int branch,
+                                 const int depth);
+
+static void bvh_sah_build_children_cb(void *__restrict userdata,
+                                      const int i,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHSAHChildrenData *children_data = userdata;
+  const int child = children_data->children[i];
+  if (!SAH_CHILD_IS_LEAF(child)) {
+    bvh_sah_build_branch(
+        children_data->build_data, &children_data->ranges[i], child, children_data->depth + 1);
+  }
+}
+
+static void bvh_sah_build_branch(BVHSAHBuildData *data,
+                                 const BVHSAHRange *range,
+                                 const int branch,
+                                 const int depth)
+{
+  const int tree_type = data->tree->tree_type;
+  const bool use_median = (depth >= BVH_SAH_MEDIAN_DEPTH);
+
+  BVHSAHRange ranges[MAX_TREETYPE];
+  int ranges_len = 1;
+  ranges[0] = *range;
+
+  /* Split the child with the largest surface area until there are enough children.
+   * Ranges stay sorted along their split axis, which ray-casting relies on for early exits. */
+  while (ranges_len < tree_type) {
+    int split = -1;
+    float split_area = -1.0f;
+    for (int i = 0; i < ranges_len; i++) {
+      if (ranges[i].end - ranges[i].begin > 1) {
+        const float area = bvh_sah_half_area(ranges[i].bv);
+        if (area > split_area) {
+          split_area = area;
+          split = i;
+        }
+      }
+    }
+    if (split == -1) {
+      break;
+    }
+
+    char axis;
+    const int mid = bvh_sah_split(data, &ranges[split], use_median, &axis);
+    if (ranges_len == 1) {
+      data->branch_main_axis[branch] = axis;
+    }
+
+    memmove(&ranges[split + 2],
+            &ranges[split + 1],
+            sizeof(*ranges) * (size_t)(ranges_len - split - 1));
+    ranges[split + 1].begin = mid;
+    ranges[split + 1].end = ranges[split].end;
+    ranges[split].end = mid;
+    bvh_sah_range_calc_bv(data, &ranges[split]);
+    bvh_sah_range_calc_bv(data, &ranges[split + 1]);
+    ranges_len++;
+  }
+
+  int *children = &data->branch_children[branch * tree_type];
+  for (int i = 0; i < ranges_len; i++) {
+    if (ranges[i].end - ranges[i].begin == 1) {
+      children[i] = SAH_CHILD_LEAF(ranges[i].begin);
+    }
+    else {
+      children[i] = atomic_fetch_and_add_int32(&data->branch_len, 1);
+    }
+  }
+  data->branch_totnode[branch] = (char)ranges_len;
+
+  BVHSAHChildrenData children_data = {
+      .build_data = data,
+      .ranges = ranges,
+      .children = children,
+      .depth = depth,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (range->end - range->begin > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  BLI_task_parallel_range(0, ranges_len, &children_data, bvh_sah_build_children_cb, &settings);
+}
+
+/**
+ * Make sure the tree has room for \a nodes_len nodes,
+ * the SAH build can use more branches than the implicit tree #BLI_bvhtree_new allocates for.
+ *
+ * \note Only valid before the tree is balanced, when all nodes are leafs in insertion order.
+ */
+static void bvhtree_ensure_nodes_len(BVHTree *tree, const int nodes_len)
+{
+  if ((size_t)nodes_len <= MEM_allocN_len(tree->nodes) / sizeof(*tree->nodes)) {
+    return;
+  }
+
+  const int axis = tree->axis;
+  const int tree_type = tree->tree_type;
+
+  tree->nodes = MEM_recallocN(tree->nodes, sizeof(BVHNode *) * (size_t)nodes_len);
+  tree->nodebv = MEM_recallocN(tree->nodebv, sizeof(float) * (size_t)(axis * nodes_len));
+  tree->nodechild = MEM_recallocN(tree->nodechild,
+                                  sizeof(BVHNode *) * (size_t)(tree_type * nodes_len));
+  tree->nodearray = MEM_recallocN(tree->nodearray, sizeof(BVHNode) * (size_t)nodes_len);
+
+  for (int i = 0; i < nodes_len; i++) {
+    tree->nodearray[i].bv = &tree->nodebv[i * axis];
+    tree->nodearray[i].children = &tree->nodechild[i * tree_type];
+  }
+  for (int i = 0; i < tree->totleaf; i++) {
+    tree->nodes[i] = &tree->nodearray[i];
+  }
+}
+
+/**
+ * Build the tree branches, sets `tree->totbranch`.
+ * Bounds of the branches are not calculated.
+ */
+static void bvhtree_build_sah(BVHTree *tree)
+{
+  const int totleaf = tree->totleaf;
+  const int tree_type = tree->tree_type;
+  BLI_assert(totleaf > 1);
+
+  /* There are never more branches than in a binary tree. */
+  const int branches_max = totleaf - 1;
+
+  BVHSAHBuildData data = {
+      .tree = tree,
+      .leafs_array = MEM_mallocN(sizeof(BVHNode *) * (size_t)totleaf, __func__),
+      .branch_children = MEM_mallocN(sizeof(int) * (size_t)(branches_max * tree_type), __func__),
+      .branch_totnode = MEM_mallocN(sizeof(char) * (size_t)branches_max, __func__),
+      .branch_main_axis = MEM_mallocN(sizeof(char) * (size_t)branches_max, __func__),
+      .branch_len = 1,
+  };
+  memcpy(data.leafs_array, tree->nodes, sizeof(BVHNode *) * (size_t)totleaf);
+
+  BVHSAHRange root_range = {.begin = 0, .end = totleaf};
+  bvh_sah_range_calc_bv(&data, &root_range);
+  bvh_sah_build_branch(&data, &root_range, 0, 0);
+
+  /* Leafs are referenced by their position in the node array which may be reallocated. */
+  int *leaf_order = MEM_mallocN(sizeof(int) * (size_t)totleaf, __func__);
+  for (int i = 0; i < totleaf; i++) {
+    leaf_order[i] = (int)(data.leafs_array[i] - tree->nodearray);
+  }
+  MEM_freeN(data.leafs_array);
+
+  bvhtree_ensure_nodes_len(tree, totleaf + data.branch_len);
+
+  for (int i = 0; i < totleaf; i++) {
+    tree->nodes[i] = &tree->nodearray[leaf_order[i]];
+  }
+  MEM_freeN(leaf_order);
+
+  /* Link the temporary branches in depth first order. */
+  struct {
+    int branch;
+    int child_index;
+    BVHNode *parent;
+  } *stack = MEM_mallocN(sizeof(*stack) * (size_t)data.branch_len, __func__);
+  int stack_len = 0;
+  int totbranch = 0;
+
+  stack[stack_len].branch = 0;
+  stack[stack_len].child_index = 0;
+  stack[stack_len].parent = NULL;
+  stack_len++;
+
+  while (stack_len) {
+    stack_len--;
+    const int branch = stack[stack_len].branch;
+    BVHNode *node = &tree->nodearray[totleaf + totbranch];
+    tree->nodes[totleaf + totbranch] = node;
+    totbranch++;
+
+    node->parent = stack[stack_len].parent;
+    if (node->parent) {
+      node->parent->children[stack[stack_len].child_index] = node;
+    }
+    node->totnode = data.branch_totnode[branch];
+    node->main_axis = data.branch_main_axis[branch];
+
+    const int *children = &data.branch_children[branch * tree_type];
+    /* Push in reverse so the first child gets the next index. */
+    for (int i = node->totnode - 1; i >= 0; i--) {
+      if (SAH_CHILD_IS_LEAF(children[i])) {
+        BVHNode *leaf = tree->nodes[SAH_CHILD_LEAF_INDEX(children[i])];
+        node->children[i] = leaf;
+        leaf->parent = node;
+      }
+      else {
+        stack[stack_len].branch = children[i];
+        stack[stack_len].child_index = i;
+        stack[stack_len].parent = node;
+        stack_len++;
+      }
+    }
+  }
+  BLI_assert(totbranch == data.branch_len);
+
+  tree->totbranch = totbranch;
+
+  MEM_freeN(stack);
+  MEM_freeN(data.branch_children);
+  MEM_freeN(data.branch_totnode);
+  MEM_freeN(data.branch_main_axis);
+}
+
+#undef SAH_CHILD_LEAF
+#undef SAH_CHILD_IS_LEAF
+#undef SAH_CHILD_LEAF_INDEX
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Parallel Refit
+ *
+ * Bottom-up update of the branch bounds, the last child of a branch to be updated
+ * joins the branch and continues with its parent.
+ * This doesn't depend on the layout of the branches, so works for both builders.
+ * \{ */
+
+typedef struct BVHRefitData {
+  BVHTree *tree;
+  /** Number of updated children per branch. */
+  int *branch_updated;
+
+  /* Optional, recalculate the leaf bounds first. */
+  BVHTree_RefitCallback callback;
+  void *userdata;
+} BVHRefitData;
+
+static void bvhtree_refit_leaf_cb(void *__restrict userdata,
+                                  const int i,
+                                  const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHRefitData *data = userdata;
+  BVHTree *tree = data->tree;
+  BVHNode *node = tree->nodes[i];
+
+  if (data->callback) {
+    float co[BVH_REFIT_POINTS_MAX][3];
+    const int numpoints = data->callback(data->userdata, node->index, co);
+    BLI_assert(numpoints > 0 && numpoints <= BVH_REFIT_POINTS_MAX);
+    create_kdop_hull(tree, node, co[0], numpoints, 0);
+    bvhtree_node_inflate(tree, node, tree->epsilon);
+  }
+
+  BVHNode *root = tree->nodes[tree->totleaf];
+  while (node != root) {
+    BVHNode *parent = node->parent;
+    const int branch = (int)(parent - tree->nodes[tree->totleaf]);
+    /* The atomic makes the bounds written by the other children visible to this thread. */
+    if (atomic_add_and_fetch_int32(&data->branch_updated[branch], 1) != parent->totnode) {
+      break;
+    }
+    node_join(tree, parent);
+    node = parent;
+  }
+}
+
+static void bvhtree_refit_parallel(BVHTree *tree, BVHTree_RefitCallback callback, void *userdata)
+{
+  BVHRefitData data = {
+      .tree = tree,
+      .branch_updated = MEM_callocN(sizeof(int) * (size_t)tree->totbranch, __func__),
+      .callback = callback,
+      .userdata = userdata,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (tree->totleaf > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 1024;
+  BLI_task_parallel_range(0, tree->totleaf, &data, bvhtree_refit_leaf_cb, &settings);
+
+  MEM_freeN(data.branch_updated);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree API
  * \{ */
@@ -954,6 +1493,14 @@ void BLI_bvhtree_free(BVHTree *tree)
 }
 
 void BLI_bvhtree_balance(BVHTree *tree)
+{
+  BLI_bvhtree_balance_ex(tree, 0);
+}
+
+/**
+ * \param flag: See #BVH_BALANCE_USE_SAH.
+ */
+void BLI_bvhtree_balance_ex(BVHTree *tree, const int flag)
 {
   BVHNode **leafs_array = tree->nodes;
 
@@ -961,15 +1508,21 @@ void BLI_bvhtree_balance(BVHTree *tree)
    * (some big bug goes here if its being called more than once per tree) */
   BLI_assert(tree->totbranch == 0);
 
-  /* Build the implicit tree */
-  non_recursive_bvh_div_nodes(
-      tree, tree->nodearray + (tree->totleaf - 1), leafs_array, tree->totleaf);
+  if ((flag & BVH_BALANCE_USE_SAH) && (tree->totleaf > 1) && (tree->start_axis == 0)) {
+    bvhtree_build_sah(tree);
+    BLI_bvhtree_update_tree(tree);
+  }
+  else {
+    /* Build the implicit tree */
+    non_recursive_bvh_div_nodes(
+        tree, tree->nodearray + (tree->totleaf - 1), leafs_array, tree->totleaf);
 
-  /* current code expects the branches to be linked to the nodes array
-   * we perform that linkage here */
-  tree->totbranch = implicit_needed_branches(tree->tree_type, tree->totleaf);
-  for (int i = 0; i < tree->totbranch; i++) {
-    tree->nodes[tree->totleaf + i] = &tree->nodearray[tree->totleaf + i];
+    /* current code expects the branches to be linked to the nodes array
+     * we perform that linkage here */
+    tree->totbranch = implicit_needed_branches(tree->tree_type, tree->totleaf);
+    for (int i = 0; i < tree->totbranch; i++) {
+      tree->nodes[tree->totleaf + i] = &tree->nodearray[tree->totleaf + i];
+    }
   }
 
 #ifdef USE_SKIP_LINKS
@@ -985,16 +1538,6 @@ void BLI_bvhtree_balance(BVHTree *tree)
 #endif
 }
 
-static void bvhtree_node_inflate(const BVHTree *tree, BVHNode *node, const float dist)
-{
-  axis_t axis_iter;
-  for (axis_iter = tree->start_axis; axis_iter < tree->stop_axis; axis_iter++) {
-    float dist_corrected = dist * bvhtree_kdop_axes_length[axis_iter];
-    node->bv[(2 * axis_iter)] -= dist_corrected;     /* minimum */
-    node->bv[(2 * axis_iter) + 1] += dist_corrected; /* maximum */
-  }
-}
-
 void BLI_bvhtree_insert(BVHTree *tree, int index, const float co[3], int numpoints)
 {
   BVHNode *node = NULL;
@@ -1043,6 +1586,11 @@ bool BLI_bvhtree_update_node(
  */
 void BLI_bvhtree_update_tree(BVHTree *tree)
 {
+  if (tree->totleaf > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+    bvhtree_refit_parallel(tree, NULL, NULL);
+    return;
+  }
+
   /* Update bottom=>top
    * TRICKY: the way we build the tree all the children have an index greater than the parent
    * This allows us todo a bottom up update by starting on the bigger numbered branch. */
@@ -1054,6 +1602,32 @@ void BLI_bvhtree_update_tree(BVHTree *tree)
     node_join(tree, *index);
   }
 }
+
+/**
+ * Recalculate the bounds of all leafs and branches without changing the tree structure.
+ * Alternative to #BLI_bvhtree_update_node() followed by #BLI_bvhtree_update_tree(),
+ * the leaf points are requested from \a callback so large trees can be refit in parallel.
+ *
+ * \param callback: Gives the points of an element, must be thread-safe.
+ */
+void BLI_bvhtree_refit(BVHTree *tree, BVHTree_RefitCallback callback, void *userdata)
+{
+  if (tree->totleaf > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+    bvhtree_refit_parallel(tree, callback, userdata);
+    return;
+  }
+
+  for (int i = 0; i < tree->totleaf; i++) {
+    BVHNode *node = tree->nodes[i];
+    float co[BVH_REFIT_POINTS_MAX][3];
+    const int numpoints = callback(userdata, node->index, co);
+    BLI_assert(numpoints > 0 && numpoints <= BVH_REFIT_POINTS_MAX);
+    create_kdop_hull(tree, node, co[0], numpoints, 0);
+    bvhtree_node_inflate(tree, node, tree->epsilon);
+  }
+  BLI_bvhtree_update_tree(tree);
+}
+
 /**
  * Number of times #BLI_bvhtree_insert has been called.
  * mainly useful for asserts functions to check we added the correct number.
@@ -1109,6 +1683,24 @@ static bool tree_overlap_test(const BVHNode *node1,
                               axis_t start_axis,
                               axis_t stop_axis)
 {
+#ifdef BLI_HAVE_SSE2
+  if (start_axis == 0 && stop_axis == 3) {
+    /* Bounding boxes, test axes (0, 1) and (1, 2) with two overlapping loads. The comparisons
+     * match the scalar version so NaN bounds overlap in both. */
+    const __m128 a01 = _mm_loadu_ps(node1->bv), a12 = _mm_loadu_ps(node1->bv + 2);
+    const __m128 b01 = _mm_loadu_ps(node2->bv), b12 = _mm_loadu_ps(node2->bv + 2);
+    /* Swap the (min, max) pairs of the second box. */
+    const __m128 b01_swap = _mm_shuffle_ps(b01, b01, _MM_SHUFFLE(2, 3, 0, 1));
+    const __m128 b12_swap = _mm_shuffle_ps(b12, b12, _MM_SHUFFLE(2, 3, 0, 1));
+    /* Lanes (0, 2): `min1 > max2`, lanes (1, 3): `max1 < min2`. */
+    const int gt = _mm_movemask_ps(
+        _mm_or_ps(_mm_cmpgt_ps(a01, b01_swap), _mm_cmpgt_ps(a12, b12_swap)));
+    const int lt = _mm_movemask_ps(
+        _mm_or_ps(_mm_cmplt_ps(a01, b01_swap), _mm_cmplt_ps(a12, b12_swap)));
+    return ((gt & 0x5) | (lt & 0xa)) == 0;
+  }
+#endif
+
   const float *bv1 = node1->bv + (start_axis << 1);
   const float *bv2 = node2->bv + (start_axis << 1);
   const float *bv1_end = node1->bv + (stop_axis << 1);
@@ -2077,6 +2669,305 @@ void BLI_bvhtree_ray_cast_all(BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree_ray_cast_array / BLI_bvhtree_find_nearest_array
+ *
+ * Batches of independent queries, threaded over the batch.
+ *
+ * Rays are traversed in packets of four consecutive rays sharing one traversal, the bounding
+ * volumes are tested against all rays of the packet at once. Neighboring rays in the batch
+ * should be coherent (e.g. cast from neighboring vertices) for this to pay off.
+ *
+ * \{ */
+
+#define BVH_RAY_PACKET_SIZE 4
+/* Rays or points per task, also the size of the nearest query blocks. */
+#define BVH_QUERY_BATCH_CHUNK 256
+
+typedef struct BVHRayCastArrayData {
+  const BVHTree *tree;
+  const float (*co)[3];
+  const float (*dir)[3];
+  int rays_len;
+  float radius;
+  BVHTreeRayHit *hits;
+  BVHTree_RayCastCallback callback;
+  void *userdata;
+  int flag;
+} BVHRayCastArrayData;
+
+#ifdef BLI_HAVE_SSE2
+typedef struct BVHRayPacketData {
+  BVHRayCastData lane[BVH_RAY_PACKET_SIZE];
+  __m128 origin[3];
+  __m128 idot_axis[3];
+  /* Used to pick the order of children, from the first ray of the packet. */
+  const float *ray_dot_axis;
+} BVHRayPacketData;
+
+/**
+ * SIMD version of #fast_ray_nearest_hit, returns the mask of the rays that hit the node
+ * closer than their current hit.
+ */
+static int ray_packet_nearest_hit(const BVHRayPacketData *data,
+                                  const BVHNode *node,
+                                  float r_dist[BVH_RAY_PACKET_SIZE])
+{
+  const float *bv = node->bv;
+  __m128 t_near = _mm_set1_ps(-FLT_MAX);
+  __m128 t_far = _mm_set1_ps(FLT_MAX);
+
+  for (int i = 0; i < 3; i++, bv += 2) {
+    const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bv[0]), data->origin[i]),
+                                 data->idot_axis[i]);
+    const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bv[1]), data->origin[i]),
+                                 data->idot_axis[i]);
+    t_near = _mm_max_ps(t_near, _mm_min_ps(t1, t2));
+    t_far = _mm_min_ps(t_far, _mm_max_ps(t1, t2));
+  }
+
+  const __m128 hit_dist = _mm_setr_ps(data->lane[0].hit.dist,
+                                      data->lane[1].hit.dist,
+                                      data->lane[2].hit.dist,
+                                      data->lane[3].hit.dist);
+  _mm_storeu_ps(r_dist, t_near);
+  return _mm_movemask_ps(_mm_and_ps(
+      _mm_and_ps(_mm_cmple_ps(t_near, t_far), _mm_cmpge_ps(t_far, _mm_setzero_ps())),
+      _mm_cmplt_ps(t_near, hit_dist)));
+}
+
+static void dfs_raycast_packet(BVHRayPacketData *data, const BVHNode *node, int mask)
+{
+  float dist[BVH_RAY_PACKET_SIZE];
+  mask &= ray_packet_nearest_hit(data, node, dist);
+  if (mask == 0) {
+    return;
+  }
+
+  if (node->totnode == 0) {
+    for (int i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+      if ((mask & (1 << i)) == 0) {
+        continue;
+      }
+      BVHRayCastData *lane = &data->lane[i];
+      if (lane->callback) {
+        lane->callback(lane->userdata, node->index, &lane->ray, &lane->hit);
+      }
+      else {
+        lane->hit.index = node->index;
+        lane->hit.dist = dist[i];
+        madd_v3_v3v3fl(lane->hit.co, lane->ray.origin, lane->ray.direction, dist[i]);
+      }
+    }
+  }
+  else {
+    if (data->ray_dot_axis[node->main_axis] > 0.0f) {
+      for (int i = 0; i != node->totnode; i++) {
+        dfs_raycast_packet(data, node->children[i], mask);
+      }
+    }
+    else {
+      for (int i = node->totnode - 1; i >= 0; i--) {
+        dfs_raycast_packet(data, node->children[i], mask);
+      }
+    }
+  }
+}
+#endif /* BLI_HAVE_SSE2 */
+
+static void bvhtree_ray_cast_lane_init(const BVHRayCastArrayData *data,
+                                       const int index,
+                                       BVHRayCastData *lane)
+{
+  BLI_ASSERT_UNIT_V3(data->dir[index]);
+
+  lane->tree = data->tree;
+  lane->callback = data->callback;
+  lane->userdata = data->userdata;
+  copy_v3_v3(lane->ray.origin, data->co[index]);
+  copy_v3_v3(lane->ray.direction, data->dir[index]);
+  lane->ray.radius = data->radius;
+  bvhtree_ray_cast_data_precalc(lane, data->flag);
+  lane->hit = data->hits[index];
+}
+
+static void bvhtree_ray_cast_array_cb(void *__restrict userdata,
+                                      const int packet,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHRayCastArrayData *data = userdata;
+  BVHNode *root = data->tree->nodes[data->tree->totleaf];
+  const int begin = packet * BVH_RAY_PACKET_SIZE;
+  const int end = min_ii(begin + BVH_RAY_PACKET_SIZE, data->rays_len);
+
+#ifdef BLI_HAVE_SSE2
+  /* The packet test doesn't support a radius, see #fast_ray_nearest_hit. */
+  if (data->radius == 0.0f) {
+    BVHRayPacketData packet_data;
+    float origin[3][BVH_RAY_PACKET_SIZE], idot_axis[3][BVH_RAY_PACKET_SIZE];
+    int mask = 0;
+
+    for (int i = 0; i < BVH_RAY_PACKET_SIZE; i++) {
+      BVHRayCastData *lane = &packet_data.lane[i];
+      /* Unused lanes repeat the last ray, they are masked out of the traversal. */
+      bvhtree_ray_cast_lane_init(data, min_ii(begin + i, end - 1), lane);
+      if (begin + i < end) {
+        mask |= 1 << i;
+      }
+      for (int axis = 0; axis < 3; axis++) {
+        origin[axis][i] = lane->ray.origin[axis];
+        idot_axis[axis][i] = lane->idot_axis[axis];
+      }
+    }
+    for (int axis = 0; axis < 3; axis++) {
+      packet_data.origin[axis] = _mm_loadu_ps(origin[axis]);
+      packet_data.idot_axis[axis] = _mm_loadu_ps(idot_axis[axis]);
+    }
+    packet_data.ray_dot_axis = packet_data.lane[0].ray_dot_axis;
+
+    dfs_raycast_packet(&packet_data, root, mask);
+
+    for (int i = begin; i < end; i++) {
+      data->hits[i] = packet_data.lane[i - begin].hit;
+    }
+    return;
+  }
+#endif
+
+  for (int i = begin; i < end; i++) {
+    BVHRayCastData lane;
+    bvhtree_ray_cast_lane_init(data, i, &lane);
+    dfs_raycast(&lane, root);
+    data->hits[i] = lane.hit;
+  }
+}
+
+/**
+ * Cast many rays at once, this is the same as calling #BLI_bvhtree_ray_cast_ex for every ray,
+ * but faster for large batches of rays.
+ *
+ * \param hits: Input and output, like the \a hit argument of #BLI_bvhtree_ray_cast_ex,
+ * the index and distance must be initialized for every ray.
+ * \note The \a callback is called from multiple threads.
+ */
+void BLI_bvhtree_ray_cast_array(BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int rays_len,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag)
+{
+  if (tree->nodes[tree->totleaf] == NULL || rays_len == 0) {
+    return;
+  }
+
+  BVHRayCastArrayData data = {
+      .tree = tree,
+      .co = co,
+      .dir = dir,
+      .rays_len = rays_len,
+      .radius = radius,
+      .hits = hits,
+      .callback = callback,
+      .userdata = userdata,
+      .flag = flag,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (rays_len > BVH_QUERY_BATCH_CHUNK);
+  settings.min_iter_per_thread = BVH_QUERY_BATCH_CHUNK / BVH_RAY_PACKET_SIZE;
+
+  const int packets_len = (rays_len + BVH_RAY_PACKET_SIZE - 1) / BVH_RAY_PACKET_SIZE;
+  BLI_task_parallel_range(0, packets_len, &data, bvhtree_ray_cast_array_cb, &settings);
+}
+
+typedef struct BVHNearestArrayData {
+  BVHTree *tree;
+  const float (*co)[3];
+  int co_len;
+  BVHTreeNearest *nearest;
+  BVHTree_NearestPointCallback callback;
+  void *userdata;
+  int flag;
+} BVHNearestArrayData;
+
+static void bvhtree_find_nearest_array_cb(void *__restrict userdata,
+                                          const int chunk,
+                                          const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHNearestArrayData *data = userdata;
+  const int begin = chunk * BVH_QUERY_BATCH_CHUNK;
+  const int end = min_ii(begin + BVH_QUERY_BATCH_CHUNK, data->co_len);
+  const BVHTreeNearest *prev = NULL;
+
+  for (int i = begin; i < end; i++) {
+    BVHTreeNearest *nearest = &data->nearest[i];
+
+    /* Use local proximity heuristics (to reduce the nearest search), the result of the
+     * previous point is a valid upper bound for this one. The chunks are fixed so the
+     * results don't depend on the number of threads. */
+    if (prev && prev->index != -1) {
+      const float dist_sq = len_squared_v3v3(data->co[i], prev->co);
+      if (dist_sq < nearest->dist_sq) {
+        *nearest = *prev;
+        nearest->dist_sq = dist_sq;
+      }
+    }
+
+    BLI_bvhtree_find_nearest_ex(
+        data->tree, data->co[i], nearest, data->callback, data->userdata, data->flag);
+    prev = nearest;
+  }
+}
+
+/**
+ * Find the nearest element for many points at once, this is the same as calling
+ * #BLI_bvhtree_find_nearest_ex for every point, but faster for large batches of points.
+ *
+ * \param nearest: Input and output, like the \a nearest argument of
+ * #BLI_bvhtree_find_nearest_ex, the index and distance must be initialized for every point.
+ * \note The \a callback is called from multiple threads. The result of a point is used to limit
+ * the search for the next one, so the callback must set the actual nearest location.
+ */
+void BLI_bvhtree_find_nearest_array(BVHTree *tree,
+                                    const float (*co)[3],
+                                    const int co_len,
+                                    BVHTreeNearest *nearest,
+                                    BVHTree_NearestPointCallback callback,
+                                    void *userdata,
+                                    int flag)
+{
+  if (tree->nodes[tree->totleaf] == NULL || co_len == 0) {
+    return;
+  }
+
+  BVHNearestArrayData data = {
+      .tree = tree,
+      .co = co,
+      .co_len = co_len,
+      .nearest = nearest,
+      .callback = callback,
+      .userdata = userdata,
+      .flag = flag,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (co_len > BVH_QUERY_BATCH_CHUNK);
+
+  const int chunks_len = (co_len + BVH_QUERY_BATCH_CHUNK - 1) / BVH_QUERY_BATCH_CHUNK;
+  BLI_task_parallel_range(0, chunks_len, &data, bvhtree_find_nearest_array_cb, &settings);
+}
+
+#undef BVH_RAY_PACKET_SIZE
+#undef BVH_QUERY_BATCH_CHUNK
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
@@ -22,6 +22,7 @@
 
 #include "BLI_kdtree_impl.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 #include "BLI_strict_flags.h"
 #include "BLI_utildefines.h"
 
@@ -56,6 +57,11 @@ struct KDTree {
 #define KD_NEAR_ALLOC_INC 100 /* alloc increment for collecting nearest */
 #define KD_FOUND_ALLOC_INC 50 /* alloc increment for collecting nearest */
 
+/* Balance both halves of larger (sub) trees in parallel. */
+#define KD_BALANCE_THREAD_THRESHOLD 8192
+/* Query points per task for the batched queries. */
+#define KD_BATCH_CHUNK 256
+
 #define KD_NODE_UNSET ((uint)-1)
 
 /**
@@ -145,6 +151,24 @@ void BLI_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS])
 #endif
 }
 
+static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs);
+
+typedef struct KDTreeBalanceData {
+  KDTreeNode *nodes[2];
+  uint nodes_len[2];
+  uint ofs[2];
+  uint axis;
+  uint r_root[2];
+} KDTreeBalanceData;
+
+static void kdtree_balance_cb(void *__restrict userdata,
+                              const int i,
+                              const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  KDTreeBalanceData *data = userdata;
+  data->r_root[i] = kdtree_balance(data->nodes[i], data->nodes_len[i], data->axis, data->ofs[i]);
+}
+
 static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
 {
   KDTreeNode *node;
@@ -194,13 +218,76 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
   node = &nodes[median];
   node->d = axis;
   axis = (axis + 1) % KD_DIMS;
-  node->left = kdtree_balance(nodes, median, axis, ofs);
-  node->right = kdtree_balance(
-      nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
+
+  if (nodes_len > KD_BALANCE_THREAD_THRESHOLD) {
+    /* The halves don't overlap, balance them in parallel. */
+    KDTreeBalanceData data = {
+        .nodes = {nodes, nodes + median + 1},
+        .nodes_len = {median, nodes_len - (median + 1)},
+        .ofs = {ofs, (median + 1) + ofs},
+        .axis = axis,
+    };
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    BLI_task_parallel_range(0, 2, &data, kdtree_balance_cb, &settings);
+    node->left = data.r_root[0];
+    node->right = data.r_root[1];
+  }
+  else {
+    node->left = kdtree_balance(nodes, median, axis, ofs);
+    node->right = kdtree_balance(
+        nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
+  }
 
   return median + ofs;
 }
 
+/**
+ * Balancing stores each sub-tree around its median.
+ * Re-order the nodes depth first instead, so the left child directly follows its parent,
+ * this way a search touches fewer cache lines.
+ */
+static void kdtree_order_depth_first(KDTree *tree)
+{
+  const uint nodes_len = tree->nodes_len;
+  KDTreeNode *nodes = tree->nodes;
+  KDTreeNode *nodes_new = MEM_mallocN(sizeof(KDTreeNode) * nodes_len, __func__);
+  uint *node_map = MEM_mallocN(sizeof(uint) * nodes_len, __func__);
+  uint *stack = MEM_mallocN(sizeof(uint) * nodes_len, __func__);
+  uint stack_len = 0, pos = 0;
+
+  stack[stack_len++] = tree->root;
+  while (stack_len) {
+    const uint i = stack[--stack_len];
+    node_map[i] = pos;
+    nodes_new[pos++] = nodes[i];
+    if (nodes[i].right != KD_NODE_UNSET) {
+      stack[stack_len++] = nodes[i].right;
+    }
+    if (nodes[i].left != KD_NODE_UNSET) {
+      stack[stack_len++] = nodes[i].left;
+    }
+  }
+  BLI_assert(pos == nodes_len);
+
+  for (uint i = 0; i < nodes_len; i++) {
+    KDTreeNode *node = &nodes_new[i];
+    if (node->left != KD_NODE_UNSET) {
+      node->left = node_map[node->left];
+    }
+    if (node->right != KD_NODE_UNSET) {
+      node->right = node_map[node->right];
+    }
+  }
+
+  memcpy(nodes, nodes_new, sizeof(KDTreeNode) * nodes_len);
+  tree->root = 0;
+
+  MEM_freeN(nodes_new);
+  MEM_freeN(node_map);
+  MEM_freeN(stack);
+}
+
 void BLI_kdtree_nd_(balance)(KDTree *tree)
 {
   if (tree->root != KD_NODE_ROOT_IS_INIT) {
@@ -212,6 +299,10 @@ void BLI_kdtree_nd_(balance)(KDTree *tree)
 
   tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
 
+  if (tree->nodes_len > 1) {
+    kdtree_order_depth_first(tree);
+  }
+
 #ifdef DEBUG
   tree->is_balanced = true;
 #endif
@@ -625,8 +716,10 @@ static void nearest_add_in_range(KDTreeNearest **r_nearest,
   KDTreeNearest *to;
 
   if (UNLIKELY(nearest_index >= *nearest_len_capacity)) {
+    /* Grow geometrically, batched searches append the results of many points. */
+    *nearest_len_capacity += MAX2(*nearest_len_capacity, KD_FOUND_ALLOC_INC);
     *r_nearest = MEM_reallocN_id(
-        *r_nearest, (*nearest_len_capacity += KD_FOUND_ALLOC_INC) * sizeof(KDTreeNode), __func__);
+        *r_nearest, *nearest_len_capacity * sizeof(KDTreeNearest), __func__);
   }
 
   to = (*r_nearest) + nearest_index;
@@ -637,40 +730,25 @@ static void nearest_add_in_range(KDTreeNearest **r_nearest,
 }
 
 /**
- * Range search returns number of points nearest_len, with results in nearest
- *
- * \param r_nearest: Allocated array of nearest nearest_len (caller is responsible for freeing).
+ * Append the nodes in \a range to \a r_nearest (which is reallocated as needed),
+ * from \a nearest_len onward. Returns the new length.
  */
-int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
-    const KDTree *tree,
-    const float co[KD_DIMS],
-    KDTreeNearest **r_nearest,
-    const float range,
-    float (*len_sq_fn)(const float co_search[KD_DIMS],
-                       const float co_test[KD_DIMS],
-                       const void *user_data),
-    const void *user_data)
+static uint kdtree_range_search_append(const KDTree *tree,
+                                       const float co[KD_DIMS],
+                                       const float range,
+                                       float (*len_sq_fn)(const float co_search[KD_DIMS],
+                                                          const float co_test[KD_DIMS],
+                                                          const void *user_data),
+                                       const void *user_data,
+                                       KDTreeNearest **r_nearest,
+                                       uint nearest_len,
+                                       uint *nearest_len_capacity)
 {
   const KDTreeNode *nodes = tree->nodes;
   uint *stack, stack_default[KD_STACK_INIT];
-  KDTreeNearest *nearest = NULL;
   const float range_sq = range * range;
   float dist_sq;
   uint stack_len_capacity, cur = 0;
-  uint nearest_len = 0, nearest_len_capacity = 0;
-
-#ifdef DEBUG
-  BLI_assert(tree->is_balanced == true);
-#endif
-
-  if (UNLIKELY(tree->root == KD_NODE_UNSET)) {
-    return 0;
-  }
-
-  if (len_sq_fn == NULL) {
-    len_sq_fn = len_squared_vnvn_cb;
-    BLI_assert(user_data == NULL);
-  }
 
   stack = stack_default;
   stack_len_capacity = ARRAY_SIZE(stack_default);
@@ -694,7 +772,7 @@ int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
       dist_sq = len_sq_fn(co, node->co, user_data);
       if (dist_sq <= range_sq) {
         nearest_add_in_range(
-            &nearest, nearest_len++, &nearest_len_capacity, node->index, dist_sq, node->co);
+            r_nearest, nearest_len++, nearest_len_capacity, node->index, dist_sq, node->co);
       }
 
       if (node->left != KD_NODE_UNSET) {
@@ -714,6 +792,43 @@ int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
     MEM_freeN(stack);
   }
 
+  return nearest_len;
+}
+
+/**
+ * Range search returns number of points nearest_len, with results in nearest
+ *
+ * \param r_nearest: Allocated array of nearest nearest_len (caller is responsible for freeing).
+ */
+int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
+    const KDTree *tree,
+    const float co[KD_DIMS],
+    KDTreeNearest **r_nearest,
+    const float range,
+    float (*len_sq_fn)(const float co_search[KD_DIMS],
+                       const float co_test[KD_DIMS],
+                       const void *user_data),
+    const void *user_data)
+{
+  KDTreeNearest *nearest = NULL;
+  uint nearest_len = 0, nearest_len_capacity = 0;
+
+#ifdef DEBUG
+  BLI_assert(tree->is_balanced == true);
+#endif
+
+  if (UNLIKELY(tree->root == KD_NODE_UNSET)) {
+    return 0;
+  }
+
+  if (len_sq_fn == NULL) {
+    len_sq_fn = len_squared_vnvn_cb;
+    BLI_assert(user_data == NULL);
+  }
+
+  nearest_len = kdtree_range_search_append(
+      tree, co, range, len_sq_fn, user_data, &nearest, nearest_len, &nearest_len_capacity);
+
   if (nearest_len) {
     qsort(nearest, nearest_len, sizeof(KDTreeNearest), nearest_cmp_dist);
   }
@@ -806,6 +921,186 @@ finally:
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Batched Queries
+ *
+ * Run the same query for many points, threaded over the points.
+ * \{ */
+
+typedef struct KDTreeBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  uint co_len;
+
+  /* find_nearest_n */
+  KDTreeNearest *nearest;
+  uint nearest_len_capacity;
+  int *nearest_len;
+
+  /* range_search, results of every chunk, the number of results per point is stored
+   * in the offsets until they are accumulated. */
+  float range;
+  KDTreeNearest **chunk_nearest;
+  int *offsets;
+} KDTreeBatchData;
+
+static void kdtree_find_nearest_n_array_cb(void *__restrict userdata,
+                                           const int chunk,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  const uint begin = (uint)chunk * KD_BATCH_CHUNK;
+  const uint end = MIN2(begin + KD_BATCH_CHUNK, data->co_len);
+
+  for (uint i = begin; i < end; i++) {
+    data->nearest_len[i] = BLI_kdtree_nd_(find_nearest_n)(
+        data->tree,
+        data->co[i],
+        &data->nearest[(size_t)i * data->nearest_len_capacity],
+        data->nearest_len_capacity);
+  }
+}
+
+/**
+ * Batch version of #BLI_kdtree_3d_find_nearest_n.
+ *
+ * \param r_nearest: An array of \a co_len * \a nearest_len_capacity nearest,
+ * the results of the point at index `i` start at `i * nearest_len_capacity`.
+ * \param r_nearest_len: The number of points found for every point.
+ */
+void BLI_kdtree_nd_(find_nearest_n_array)(const KDTree *tree,
+                                          const float (*co)[KD_DIMS],
+                                          const uint co_len,
+                                          KDTreeNearest *r_nearest,
+                                          const uint nearest_len_capacity,
+                                          int *r_nearest_len)
+{
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .co_len = co_len,
+      .nearest = r_nearest,
+      .nearest_len_capacity = nearest_len_capacity,
+      .nearest_len = r_nearest_len,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (co_len > KD_BATCH_CHUNK);
+
+  const int chunks_len = (int)((co_len + KD_BATCH_CHUNK - 1) / KD_BATCH_CHUNK);
+  BLI_task_parallel_range(0, chunks_len, &data, kdtree_find_nearest_n_array_cb, &settings);
+}
+
+static void kdtree_range_search_array_cb(void *__restrict userdata,
+                                         const int chunk,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  const uint begin = (uint)chunk * KD_BATCH_CHUNK;
+  const uint end = MIN2(begin + KD_BATCH_CHUNK, data->co_len);
+
+  KDTreeNearest *nearest = NULL;
+  uint nearest_len = 0, nearest_len_capacity = 0;
+
+  for (uint i = begin; i < end; i++) {
+    const uint nearest_len_prev = nearest_len;
+    nearest_len = kdtree_range_search_append(data->tree,
+                                             data->co[i],
+                                             data->range,
+                                             len_squared_vnvn_cb,
+                                             NULL,
+                                             &nearest,
+                                             nearest_len,
+                                             &nearest_len_capacity);
+    const uint found = nearest_len - nearest_len_prev;
+    if (found > 1) {
+      qsort(nearest + nearest_len_prev, found, sizeof(KDTreeNearest), nearest_cmp_dist);
+    }
+    data->offsets[i + 1] = (int)found;
+  }
+
+  data->chunk_nearest[chunk] = nearest;
+}
+
+/**
+ * Batch version of #BLI_kdtree_3d_range_search.
+ *
+ * \param r_nearest: Allocated array of the results of all points (caller is responsible for
+ * freeing), the results of every point are sorted by distance.
+ * \param r_offsets: An array of \a co_len + 1 offsets, the results of the point at index `i`
+ * are `r_nearest[r_offsets[i]]` up to `r_nearest[r_offsets[i + 1]]`.
+ * \returns The total number of results.
+ */
+int BLI_kdtree_nd_(range_search_array)(const KDTree *tree,
+                                       const float (*co)[KD_DIMS],
+                                       const uint co_len,
+                                       const float range,
+                                       KDTreeNearest **r_nearest,
+                                       int *r_offsets)
+{
+  r_offsets[0] = 0;
+  *r_nearest = NULL;
+
+#ifdef DEBUG
+  BLI_assert(tree->is_balanced == true);
+#endif
+
+  if (UNLIKELY(tree->root == KD_NODE_UNSET)) {
+    for (uint i = 0; i < co_len; i++) {
+      r_offsets[i + 1] = 0;
+    }
+    return 0;
+  }
+
+  const int chunks_len = (int)((co_len + KD_BATCH_CHUNK - 1) / KD_BATCH_CHUNK);
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .co_len = co_len,
+      .range = range,
+      .chunk_nearest = MEM_mallocN(sizeof(KDTreeNearest *) * (size_t)chunks_len, __func__),
+      .offsets = r_offsets,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (co_len > KD_BATCH_CHUNK);
+  BLI_task_parallel_range(0, chunks_len, &data, kdtree_range_search_array_cb, &settings);
+
+  for (uint i = 0; i < co_len; i++) {
+    r_offsets[i + 1] += r_offsets[i];
+  }
+  const int nearest_len = r_offsets[co_len];
+
+  if (nearest_len) {
+    KDTreeNearest *nearest = MEM_mallocN(sizeof(KDTreeNearest) * (size_t)nearest_len, __func__);
+    for (int chunk = 0; chunk < chunks_len; chunk++) {
+      if (data.chunk_nearest[chunk] == NULL) {
+        continue;
+      }
+      const uint begin = (uint)chunk * KD_BATCH_CHUNK;
+      const uint end = MIN2(begin + KD_BATCH_CHUNK, co_len);
+      memcpy(&nearest[r_offsets[begin]],
+             data.chunk_nearest[chunk],
+             sizeof(KDTreeNearest) * (size_t)(r_offsets[end] - r_offsets[begin]));
+      MEM_freeN(data.chunk_nearest[chunk]);
+    }
+    *r_nearest = nearest;
+  }
+  else {
+    for (int chunk = 0; chunk < chunks_len; chunk++) {
+      MEM_SAFE_FREE(data.chunk_nearest[chunk]);
+    }
+  }
+
+  MEM_freeN(data.chunk_nearest);
+
+  return nearest_len;
+}
+
+/** \} */
+
 /**
  * Use when we want to loop over nodes ordered by index.
  * Requires indices to be aligned with nodes.
@@ -820,6 +1115,35 @@ static uint *kdtree_order(const KDTree *tree)
   return order;
 }
 
+/**
+ * The nodes sorted by their position along the tree (an in-order traversal),
+ * this is the order balancing leaves the nodes in, before #kdtree_order_depth_first.
+ */
+static uint *kdtree_order_in_order(const KDTree *tree)
+{
+  const KDTreeNode *nodes = tree->nodes;
+  uint *order = MEM_mallocN(sizeof(uint) * tree->nodes_len, __func__);
+  uint *stack = MEM_mallocN(sizeof(uint) * tree->nodes_len, __func__);
+  uint stack_len = 0, order_len = 0;
+  uint i = tree->root;
+
+  while (stack_len || i != KD_NODE_UNSET) {
+    if (i != KD_NODE_UNSET) {
+      stack[stack_len++] = i;
+      i = nodes[i].left;
+    }
+    else {
+      i = stack[--stack_len];
+      order[order_len++] = i;
+      i = nodes[i].right;
+    }
+  }
+  BLI_assert(order_len == tree->nodes_len);
+
+  MEM_freeN(stack);
+  return order;
+}
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_kdtree_3d_calc_duplicates_fast
  * \{ */
@@ -917,8 +1241,10 @@ int BLI_kdtree_nd_(calc_duplicates_fast)(const KDTree *tree,
     MEM_freeN(order);
   }
   else {
+    /* Loop over the nodes in the same order regardless of the layout of the node array. */
+    uint *order = kdtree_order_in_order(tree);
     for (uint i = 0; i < tree->nodes_len; i++) {
-      const uint node_index = i;
+      const uint node_index = order[i];
       const int index = p.nodes[node_index].index;
       if (ELEM(duplicates[index], -1, index)) {
         p.search = index;
@@ -931,6 +1257,7 @@ int BLI_kdtree_nd_(calc_duplicates_fast)(const KDTree *tree,
         }
       }
     }
+    MEM_freeN(order);
   }
   return found;
 }
@@ -821,6 +821,83 @@ void mul_v3_mat3_m4v3_db(double r[3], const double mat[4][4], const double vec[3
   r[2] = x * mat[0][2] + y * mat[1][2] + mat[2][2] * vec[2];
 }
 
+/**
+ * Shared implementation of the `*_array` variants below, \a r and \a v may be the same array.
+ * The arithmetic matches the single vector functions exactly,
+ * so results don't depend on which code path handled an element.
+ */
+static void mul_v3_m4v3_array_impl(float (*r)[3],
+                                   const float M[4][4],
+                                   const float (*v)[3],
+                                   const int v_len,
+                                   const bool use_translation)
+{
+  int i = 0;
+
+#ifdef BLI_HAVE_SSE2
+  const __m128 m00 = _mm_set1_ps(M[0][0]), m01 = _mm_set1_ps(M[0][1]), m02 = _mm_set1_ps(M[0][2]);
+  const __m128 m10 = _mm_set1_ps(M[1][0]), m11 = _mm_set1_ps(M[1][1]), m12 = _mm_set1_ps(M[1][2]);
+  const __m128 m20 = _mm_set1_ps(M[2][0]), m21 = _mm_set1_ps(M[2][1]), m22 = _mm_set1_ps(M[2][2]);
+  const __m128 m30 = _mm_set1_ps(M[3][0]), m31 = _mm_set1_ps(M[3][1]), m32 = _mm_set1_ps(M[3][2]);
+
+  for (; i + 4 <= v_len; i += 4) {
+    __m128 x, y, z;
+    BLI_simd_load_v3_x4(v + i, &x, &y, &z);
+
+    __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_mul_ps(m20, z));
+    __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_mul_ps(m21, z));
+    __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_mul_ps(m22, z));
+    if (use_translation) {
+      rx = _mm_add_ps(rx, m30);
+      ry = _mm_add_ps(ry, m31);
+      rz = _mm_add_ps(rz, m32);
+    }
+
+    BLI_simd_store_v3_x4(r + i, rx, ry, rz);
+  }
+#endif
+
+  for (; i < v_len; i++) {
+    const float x = v[i][0];
+    const float y = v[i][1];
+    const float z = v[i][2];
+
+    r[i][0] = x * M[0][0] + y * M[1][0] + M[2][0] * z;
+    r[i][1] = x * M[0][1] + y * M[1][1] + M[2][1] * z;
+    r[i][2] = x * M[0][2] + y * M[1][2] + M[2][2] * z;
+    if (use_translation) {
+      add_v3_v3(r[i], M[3]);
+    }
+  }
+}
+
+/** Array version of #mul_m4_v3(). */
+void mul_m4_v3_array(const float M[4][4], float (*r)[3], const int r_len)
+{
+  mul_v3_m4v3_array_impl(r, M, (const float(*)[3])r, r_len, true);
+}
+
+/** Array version of #mul_v3_m4v3(). */
+void mul_v3_m4v3_array(float (*r)[3], const float M[4][4], const float (*v)[3], const int v_len)
+{
+  mul_v3_m4v3_array_impl(r, M, v, v_len, true);
+}
+
+/** Array version of #mul_mat3_m4_v3(). */
+void mul_mat3_m4_v3_array(const float M[4][4], float (*r)[3], const int r_len)
+{
+  mul_v3_m4v3_array_impl(r, M, (const float(*)[3])r, r_len, false);
+}
+
+/** Array version of #mul_v3_mat3_m4v3(). */
+void mul_v3_mat3_m4v3_array(float (*r)[3],
+                            const float M[4][4],
+                            const float (*v)[3],
+                            const int v_len)
+{
+  mul_v3_m4v3_array_impl(r, M, v, v_len, false);
+}
+
 void mul_project_m4_v3(const float mat[4][4], float vec[3])
 {
   /* absolute value to not flip the frustum upside down behind the camera */
@@ -932,6 +1009,14 @@ void mul_m3_v3(const float M[3][3], float r[3])
   mul_v3_m3v3(r, M, (const float[3]){UNPACK3(r)});
 }
 
+/** Array version of #mul_m3_v3(). */
+void mul_m3_v3_array(const float M[3][3], float (*r)[3], const int r_len)
+{
+  float M4[4][4];
+  copy_m4_m3(M4, M);
+  mul_v3_m4v3_array_impl(r, M4, (const float(*)[3])r, r_len, false);
+}
+
 void mul_m3_v3_db(const double M[3][3], double r[3])
 {
   mul_v3_m3v3_db(r, M, (const double[3]){UNPACK3(r)});
@@ -1044,11 +1044,77 @@ void minmax_v2v2_v2(float min[2], float max[2], const float vec[2])
 
 void minmax_v3v3_v3_array(float r_min[3], float r_max[3], const float (*vec_arr)[3], int nbr)
 {
+#ifdef BLI_HAVE_SSE2
+  if (nbr >= 4) {
+    __m128 min_x = _mm_set1_ps(r_min[0]), min_y = _mm_set1_ps(r_min[1]);
+    __m128 min_z = _mm_set1_ps(r_min[2]);
+    __m128 max_x = _mm_set1_ps(r_max[0]), max_y = _mm_set1_ps(r_max[1]);
+    __m128 max_z = _mm_set1_ps(r_max[2]);
+
+    for (; nbr >= 4; nbr -= 4, vec_arr += 4) {
+      __m128 x, y, z;
+      BLI_simd_load_v3_x4(vec_arr, &x, &y, &z);
+      /* Argument order matters, NAN coordinates are skipped as they are by #minmax_v3v3_v3. */
+      min_x = _mm_min_ps(x, min_x);
+      min_y = _mm_min_ps(y, min_y);
+      min_z = _mm_min_ps(z, min_z);
+      max_x = _mm_max_ps(x, max_x);
+      max_y = _mm_max_ps(y, max_y);
+      max_z = _mm_max_ps(z, max_z);
+    }
+
+    float lanes_min[3][4], lanes_max[3][4];
+    _mm_storeu_ps(lanes_min[0], min_x);
+    _mm_storeu_ps(lanes_min[1], min_y);
+    _mm_storeu_ps(lanes_min[2], min_z);
+    _mm_storeu_ps(lanes_max[0], max_x);
+    _mm_storeu_ps(lanes_max[1], max_y);
+    _mm_storeu_ps(lanes_max[2], max_z);
+    for (int lane = 0; lane < 4; lane++) {
+      const float lane_min[3] = {lanes_min[0][lane], lanes_min[1][lane], lanes_min[2][lane]};
+      const float lane_max[3] = {lanes_max[0][lane], lanes_max[1][lane], lanes_max[2][lane]};
+      minmax_v3v3_v3(r_min, r_max, lane_min);
+      minmax_v3v3_v3(r_min, r_max, lane_max);
+    }
+  }
+#endif
+
   while (nbr--) {
     minmax_v3v3_v3(r_min, r_max, *vec_arr++);
   }
 }
 
+/**
+ * Array version of #normalize_v3(), vectors that are too short to normalize are zeroed.
+ */
+void normalize_v3_array(float (*vec_arr)[3], const int vec_len)
+{
+  int i = 0;
+
+#ifdef BLI_HAVE_SSE2
+  const __m128 eps = _mm_set1_ps(1.0e-35f);
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  for (; i + 4 <= vec_len; i += 4) {
+    __m128 x, y, z;
+    BLI_simd_load_v3_x4((const float(*)[3])(vec_arr + i), &x, &y, &z);
+
+    const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    const __m128 use = _mm_cmpgt_ps(d, eps);
+    const __m128 mul = _mm_div_ps(one, _mm_sqrt_ps(d));
+
+    BLI_simd_store_v3_x4(vec_arr + i,
+                         _mm_and_ps(use, _mm_mul_ps(x, mul)),
+                         _mm_and_ps(use, _mm_mul_ps(y, mul)),
+                         _mm_and_ps(use, _mm_mul_ps(z, mul)));
+  }
+#endif
+
+  for (; i < vec_len; i++) {
+    normalize_v3(vec_arr[i]);
+  }
+}
+
 /** ensure \a v1 is \a dist from \a v2 */
 void dist_ensure_v3_v3fl(float v1[3], const float v2[3], const float dist)
 {
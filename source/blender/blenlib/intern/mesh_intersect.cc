@@ -22,6 +22,7 @@
 #ifdef WITH_GMP
 
 #  include <algorithm>
+#  include <atomic>
 #  include <fstream>
 #  include <iostream>
 #  include <memory>
@@ -29,6 +30,7 @@
 #  include "BLI_allocator.hh"
 #  include "BLI_array.hh"
 #  include "BLI_assert.h"
+#  include "BLI_concurrent_set.hh"
 #  include "BLI_delaunay_2d.h"
 #  include "BLI_double3.hh"
 #  include "BLI_float3.hh"
@@ -307,6 +309,8 @@ std::ostream &operator<<(std::ostream &os, const Face *f)
  * It also keeps has a hash table of all Verts created so that it can
  * ensure that only one instance of a Vert with a given co_exact will
  * exist. I.e., it de-duplicates the vertices.
+ * The hash table is a #ConcurrentSet, so threads only wait on each other
+ * when they look up vertices that hash to the same stripe.
  */
 class IMeshArena::IMeshArenaImpl : NonCopyable, NonMovable {
 
@@ -333,21 +337,23 @@ class IMeshArena::IMeshArenaImpl : NonCopyable, NonMovable {
     }
   };
 
-  Set<VSetKey> vset_;
+  /**
+   * Ownership of the Vert memory is here, every key in the set owns its Vert.
+   */
+  ConcurrentSet<VSetKey> vset_;
 
   /**
-   * Ownership of the Vert memory is here, so destroying this reclaims that memory.
+   * Ownership of the Face memory is here, so destroying this reclaims that memory.
    *
    * TODO: replace these with pooled allocation, and just destroy the pools at the end.
    */
-  Vector<std::unique_ptr<Vert>> allocated_verts_;
   Vector<std::unique_ptr<Face>> allocated_faces_;
 
   /* Use these to allocate ids when Verts and Faces are allocated. */
-  int next_vert_id_ = 0;
+  std::atomic<int> next_vert_id_ = 0;
   int next_face_id_ = 0;
 
-  /* Need a lock when multi-threading to protect allocation of new elements. */
+  /* Need a lock when multi-threading to protect allocation of new faces. */
 #  ifdef USE_SPINLOCK
   SpinLock lock_;
 #  else
@@ -367,6 +373,7 @@ class IMeshArena::IMeshArenaImpl : NonCopyable, NonMovable {
   }
   ~IMeshArenaImpl()
   {
+    vset_.foreach_key([](const VSetKey &vskey) { delete vskey.vert; });
     if (intersect_use_threading) {
 #  ifdef USE_SPINLOCK
       BLI_spin_end(&lock_);
@@ -379,13 +386,12 @@ class IMeshArena::IMeshArenaImpl : NonCopyable, NonMovable {
   void reserve(int vert_num_hint, int face_num_hint)
   {
     vset_.reserve(vert_num_hint);
-    allocated_verts_.reserve(vert_num_hint);
     allocated_faces_.reserve(face_num_hint);
   }
 
   int tot_allocated_verts() const
   {
-    return allocated_verts_.size();
+    return static_cast<int>(vset_.size());
   }
 
   int tot_allocated_faces() const
@@ -443,25 +449,7 @@ class IMeshArena::IMeshArenaImpl : NonCopyable, NonMovable {
   {
     Vert vtry(co, double3(co[0].get_d(), co[1].get_d(), co[2].get_d()), NO_INDEX, NO_INDEX);
     VSetKey vskey(&vtry);
-    if (intersect_use_threading) {
-#  ifdef USE_SPINLOCK
-      BLI_spin_lock(&lock_);
-#  else
-      BLI_mutex_lock(mutex_);
-#  endif
-    }
-    const VSetKey *lookup = vset_.lookup_key_ptr(vskey);
-    if (intersect_use_threading) {
-#  ifdef USE_SPINLOCK
-      BLI_spin_unlock(&lock_);
-#  else
-      BLI_mutex_unlock(mutex_);
-#  endif
-    }
-    if (!lookup) {
-      return nullptr;
-    }
-    return lookup->vert;
+    return vset_.lookup_key_default(vskey, VSetKey(nullptr)).vert;
   }
 
   /**
@@ -487,38 +475,16 @@ class IMeshArena::IMeshArenaImpl : NonCopyable, NonMovable {
   {
     /* Don't allocate Vert yet, in case it is already there. */
     Vert vtry(mco, dco, NO_INDEX, NO_INDEX);
-    const Vert *ans;
     VSetKey vskey(&vtry);
-    if (intersect_use_threading) {
-#  ifdef USE_SPINLOCK
-      BLI_spin_lock(&lock_);
-#  else
-      BLI_mutex_lock(mutex_);
-#  endif
-    }
-    const VSetKey *lookup = vset_.lookup_key_ptr(vskey);
-    if (!lookup) {
-      vskey.vert = new Vert(mco, dco, next_vert_id_++, orig);
-      vset_.add_new(vskey);
-      allocated_verts_.append(std::unique_ptr<Vert>(vskey.vert));
-      ans = vskey.vert;
-    }
-    else {
-      /* It was a duplicate, so return the existing one.
-       * Note that the returned Vert may have a different orig.
-       * This is the intended semantics: if the Vert already
-       * exists then we are merging verts and using the first-seen
-       * one as the canonical one. */
-      ans = lookup->vert;
-    }
-    if (intersect_use_threading) {
-#  ifdef USE_SPINLOCK
-      BLI_spin_unlock(&lock_);
-#  else
-      BLI_mutex_unlock(mutex_);
-#  endif
-    }
-    return ans;
+    /* If it was a duplicate, the existing one is returned.
+     * Note that the returned Vert may have a different orig.
+     * This is the intended semantics: if the Vert already
+     * exists then we are merging verts and using the first-seen
+     * one as the canonical one. */
+    return vset_
+        .lookup_key_or_add_cb(vskey,
+                              [&]() { return VSetKey(new Vert(mco, dco, next_vert_id_++, orig)); })
+        .vert;
   };
 };
 
@@ -0,0 +1,139 @@
+/* Apache License, Version 2.0 */
+
+#include "BLI_concurrent_map.hh"
+#include "BLI_concurrent_set.hh"
+#include "BLI_task.hh"
+#include "BLI_vector.hh"
+#include "testing/testing.h"
+
+namespace blender::tests {
+
+TEST(concurrent_set, AddContains)
+{
+  ConcurrentSet<int> set;
+  EXPECT_TRUE(set.is_empty());
+  EXPECT_TRUE(set.add(5));
+  EXPECT_FALSE(set.add(5));
+  EXPECT_TRUE(set.add(6));
+  EXPECT_TRUE(set.contains(5));
+  EXPECT_TRUE(set.contains(6));
+  EXPECT_FALSE(set.contains(7));
+  EXPECT_EQ(set.size(), 2);
+  EXPECT_TRUE(set.remove(5));
+  EXPECT_FALSE(set.remove(5));
+  EXPECT_EQ(set.size(), 1);
+  set.clear();
+  EXPECT_TRUE(set.is_empty());
+}
+
+TEST(concurrent_set, SingleStripe)
+{
+  ConcurrentSet<int> set(1);
+  EXPECT_EQ(set.stripes_num(), 1);
+  for (int i = 0; i < 1000; i++) {
+    set.add(i);
+  }
+  EXPECT_EQ(set.size(), 1000);
+  EXPECT_EQ(set.stripe_set(0).size(), 1000);
+}
+
+TEST(concurrent_set, ParallelAdd)
+{
+  ConcurrentSet<int> set(64);
+  EXPECT_EQ(set.stripes_num(), 64);
+  /* Every key is added four times. */
+  parallel_for(IndexRange(40000), 256, [&](IndexRange range) {
+    for (const int i : range) {
+      set.add(i / 4);
+    }
+  });
+  EXPECT_EQ(set.size(), 10000);
+  int64_t sum = 0;
+  set.foreach_key([&](const int key) { sum += key; });
+  EXPECT_EQ(sum, int64_t(9999) * 10000 / 2);
+
+  /* All stripes are used, even though the integer hash is trivial. */
+  for (const int64_t i : IndexRange(set.stripes_num())) {
+    EXPECT_GT(set.stripe_set(i).size(), 0);
+  }
+}
+
+TEST(concurrent_set, LookupKeyOrAddCB)
+{
+  struct Key {
+    int value;
+    int id;
+
+    uint64_t hash() const
+    {
+      return static_cast<uint64_t>(value);
+    }
+
+    bool operator==(const Key &other) const
+    {
+      return value == other.value;
+    }
+  };
+
+  ConcurrentSet<Key> set;
+  int created = 0;
+  Key key = set.lookup_key_or_add_cb({3, -1}, [&]() { return Key{3, created++}; });
+  EXPECT_EQ(key.id, 0);
+  key = set.lookup_key_or_add_cb({3, -1}, [&]() { return Key{3, created++}; });
+  EXPECT_EQ(key.id, 0);
+  key = set.lookup_key_or_add_cb({4, -1}, [&]() { return Key{4, created++}; });
+  EXPECT_EQ(key.id, 1);
+  EXPECT_EQ(created, 2);
+  EXPECT_EQ(set.lookup_key_default({4, -1}, {0, -1}).id, 1);
+  EXPECT_EQ(set.lookup_key_default({5, -1}, {0, -1}).id, -1);
+}
+
+TEST(concurrent_map, AddLookup)
+{
+  ConcurrentMap<int, float> map;
+  EXPECT_TRUE(map.add(1, 2.0f));
+  EXPECT_FALSE(map.add(1, 3.0f));
+  EXPECT_TRUE(map.contains(1));
+  EXPECT_FALSE(map.contains(2));
+  EXPECT_EQ(map.lookup_default(1, 0.0f), 2.0f);
+  EXPECT_EQ(map.lookup_default(2, 0.0f), 0.0f);
+  EXPECT_EQ(map.lookup_or_add_cb(2, []() { return 4.0f; }), 4.0f);
+  EXPECT_EQ(map.lookup_or_add_cb(2, []() { return 5.0f; }), 4.0f);
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_TRUE(map.remove(1));
+  EXPECT_EQ(map.size(), 1);
+}
+
+TEST(concurrent_map, AddNewPopTry)
+{
+  ConcurrentMap<int, int> map;
+  parallel_for(IndexRange(1000), 64, [&](IndexRange range) {
+    for (const int i : range) {
+      map.add_new(i, i * 2);
+    }
+  });
+  EXPECT_EQ(map.size(), 1000);
+  EXPECT_EQ(map.pop_try(10), std::optional<int>(20));
+  EXPECT_FALSE(map.pop_try(10).has_value());
+  EXPECT_FALSE(map.pop_try(1000).has_value());
+  EXPECT_EQ(map.size(), 999);
+}
+
+TEST(concurrent_map, ParallelAddOrModifyMin)
+{
+  ConcurrentMap<int, int> map;
+  /* Find the smallest index for every key, independent of the order the threads run in. */
+  parallel_for(IndexRange(30000), 128, [&](IndexRange range) {
+    for (const int i : range) {
+      const int index = 29999 - i;
+      map.add_or_modify(
+          index % 1000,
+          [&](int *value) { *value = index; },
+          [&](int *value) { *value = std::min(*value, index); });
+    }
+  });
+  EXPECT_EQ(map.size(), 1000);
+  map.foreach_item([&](const int key, const int value) { EXPECT_EQ(key, value); });
+}
+
+}  // namespace blender::tests
@@ -0,0 +1,40 @@
+/* Apache License, Version 2.0 */
+
+#include "BLI_enumerable_thread_specific.hh"
+#include "BLI_task.hh"
+#include "BLI_vector.hh"
+#include "testing/testing.h"
+
+namespace blender::tests {
+
+TEST(enumerable_thread_specific, Local)
+{
+  EnumerableThreadSpecific<int> counter;
+  EXPECT_EQ(counter.local(), 0);
+  counter.local()++;
+  counter.local()++;
+  EXPECT_EQ(counter.local(), 2);
+}
+
+TEST(enumerable_thread_specific, ParallelSum)
+{
+  EnumerableThreadSpecific<Vector<int>> values;
+  parallel_for(IndexRange(10000), 32, [&](IndexRange range) {
+    Vector<int> &local_values = values.local();
+    for (const int i : range) {
+      local_values.append(i);
+    }
+  });
+  int64_t size = 0;
+  int64_t sum = 0;
+  values.foreach([&](Vector<int> &local_values) {
+    size += local_values.size();
+    for (const int i : local_values) {
+      sum += i;
+    }
+  });
+  EXPECT_EQ(size, 10000);
+  EXPECT_EQ(sum, int64_t(9999) * 10000 / 2);
+}
+
+}  // namespace blender::tests
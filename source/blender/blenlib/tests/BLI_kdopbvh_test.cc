@@ -8,6 +8,7 @@
 
 #include "BLI_compiler_attrs.h"
 #include "BLI_kdopbvh.h"
+#include "BLI_math_geom.h"
 #include "BLI_math_vector.h"
 #include "BLI_rand.h"
 
@@ -66,11 +67,16 @@ static void optimal_check_callback(void *userdata,
  * Note that a small epsilon is added to the BVH nodes bounds, even if we pass in zero.
  * Use rounding to ensure very close nodes don't cause the wrong node to be found as nearest.
  */
-static void find_nearest_points_test(
-    int points_len, float scale, int round, int random_seed, bool optimal = false)
+static void find_nearest_points_test(int points_len,
+                                     float scale,
+                                     int round,
+                                     int random_seed,
+                                     bool optimal = false,
+                                     int tree_type = 8,
+                                     int balance_flag = 0)
 {
   struct RNG *rng = BLI_rng_new(random_seed);
-  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, tree_type, 8);
 
   void *mem = MEM_mallocN(sizeof(float[3]) * points_len, __func__);
   float(*points)[3] = (float(*)[3])mem;
@@ -79,7 +85,7 @@ static void find_nearest_points_test(
     rng_v3_round(points[i], 3, rng, round, scale);
     BLI_bvhtree_insert(tree, i, points[i], 1);
   }
-  BLI_bvhtree_balance(tree);
+  BLI_bvhtree_balance_ex(tree, balance_flag);
 
   /* first find each point */
   BVHTree_NearestPointCallback callback = optimal ? optimal_check_callback : nullptr;
@@ -132,3 +138,295 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+TEST(kdopbvh, SAHFindNearest_2)
+{
+  find_nearest_points_test(2, 1.0, 1000, 123, false, 2, BVH_BALANCE_USE_SAH);
+}
+TEST(kdopbvh, SAHFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, 2, BVH_BALANCE_USE_SAH);
+  find_nearest_points_test(500, 1.0, 1000, 12, false, 4, BVH_BALANCE_USE_SAH);
+  find_nearest_points_test(500, 1.0, 1000, 12, false, 8, BVH_BALANCE_USE_SAH);
+}
+TEST(kdopbvh, SAHOptimalFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, true, 4, BVH_BALANCE_USE_SAH);
+}
+TEST(kdopbvh, SAHFindNearest_Duplicates)
+{
+  /* Coarse rounding gives many coincident points, which can't be split by the heuristic. */
+  find_nearest_points_test(500, 1.0, 4, 12, false, 4, BVH_BALANCE_USE_SAH);
+}
+
+static void raycast_triangles_callback(void *userdata,
+                                       int index,
+                                       const BVHTreeRay *ray,
+                                       BVHTreeRayHit *hit)
+{
+  const float(*tris)[3][3] = (const float(*)[3][3])userdata;
+  float dist;
+  if (isect_ray_tri_v3(ray->origin,
+                       ray->direction,
+                       tris[index][0],
+                       tris[index][1],
+                       tris[index][2],
+                       &dist,
+                       nullptr) &&
+      dist < hit->dist) {
+    hit->index = index;
+    hit->dist = dist;
+  }
+}
+
+/**
+ * Cast the same rays against triangles in trees built with \a balance_flag,
+ * hits must match casting against all triangles.
+ */
+static void raycast_triangles_test(int tris_len, int tree_type, int balance_flag, int random_seed)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  float(*tris)[3][3] = (float(*)[3][3])MEM_mallocN(sizeof(*tris) * tris_len, __func__);
+  BVHTree *tree = BLI_bvhtree_new(tris_len, 0.0f, tree_type, 6);
+
+  for (int i = 0; i < tris_len; i++) {
+    float center[3];
+    rng_v3_round(center, 3, rng, 1000, 1.0f);
+    /* Mix of small and large triangles, where the split heuristic matters. */
+    const float size = (i % 16 == 0) ? 0.5f : 0.01f;
+    for (int j = 0; j < 3; j++) {
+      rng_v3_round(tris[i][j], 3, rng, 1000, size);
+      add_v3_v3(tris[i][j], center);
+    }
+    BLI_bvhtree_insert(tree, i, tris[i][0], 3);
+  }
+  BLI_bvhtree_balance_ex(tree, balance_flag);
+
+  float rays_co[200][3], rays_dir[200][3];
+  BVHTreeRayHit hits[200], hits_expect[200];
+  int rays_len = 0;
+
+  for (int i = 0; i < 200; i++) {
+    float co[3], dir[3];
+    rng_v3_round(co, 3, rng, 1000, 2.0f);
+    rng_v3_round(dir, 3, rng, 1000, 1.0f);
+    if (normalize_v3(dir) == 0.0f) {
+      continue;
+    }
+
+    BVHTreeRayHit hit = {-1};
+    hit.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree, co, dir, 0.0f, &hit, raycast_triangles_callback, tris);
+
+    BVHTreeRayHit hit_expect = {-1};
+    hit_expect.dist = BVH_RAYCAST_DIST_MAX;
+    BVHTreeRay ray = {{0}};
+    copy_v3_v3(ray.origin, co);
+    copy_v3_v3(ray.direction, dir);
+    for (int j = 0; j < tris_len; j++) {
+      raycast_triangles_callback(tris, j, &ray, &hit_expect);
+    }
+
+    EXPECT_EQ(hit.index == -1, hit_expect.index == -1);
+    if (hit_expect.index != -1) {
+      EXPECT_FLOAT_EQ(hit.dist, hit_expect.dist);
+    }
+
+    copy_v3_v3(rays_co[rays_len], co);
+    copy_v3_v3(rays_dir[rays_len], dir);
+    hits_expect[rays_len] = hit_expect;
+    rays_len++;
+  }
+
+  /* The same rays as a batch, an odd number of rays tests the last incomplete packet. */
+  rays_len -= (rays_len % 2) ? 0 : 1;
+  for (int i = 0; i < rays_len; i++) {
+    hits[i].index = -1;
+    hits[i].dist = BVH_RAYCAST_DIST_MAX;
+  }
+  BLI_bvhtree_ray_cast_array(
+      tree, rays_co, rays_dir, rays_len, 0.0f, hits, raycast_triangles_callback, tris, 0);
+  for (int i = 0; i < rays_len; i++) {
+    EXPECT_EQ(hits[i].index == -1, hits_expect[i].index == -1);
+    if (hits_expect[i].index != -1) {
+      EXPECT_FLOAT_EQ(hits[i].dist, hits_expect[i].dist);
+    }
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(tris);
+}
+
+TEST(kdopbvh, RayCast)
+{
+  raycast_triangles_test(1000, 4, 0, 1);
+}
+TEST(kdopbvh, SAHRayCast)
+{
+  raycast_triangles_test(1000, 2, BVH_BALANCE_USE_SAH, 1);
+  raycast_triangles_test(1000, 4, BVH_BALANCE_USE_SAH, 2);
+  raycast_triangles_test(3, 8, BVH_BALANCE_USE_SAH, 3);
+}
+
+static void nearest_points_callback(void *userdata,
+                                    int index,
+                                    const float co[3],
+                                    BVHTreeNearest *nearest)
+{
+  const float(*points)[3] = (const float(*)[3])userdata;
+  const float dist_sq = len_squared_v3v3(co, points[index]);
+  if (dist_sq < nearest->dist_sq) {
+    nearest->index = index;
+    nearest->dist_sq = dist_sq;
+    copy_v3_v3(nearest->co, points[index]);
+  }
+}
+
+TEST(kdopbvh, FindNearestArray)
+{
+  const int points_len = 2000;
+  const int queries_len = 1001;
+  struct RNG *rng = BLI_rng_new(7);
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(*points) * points_len, __func__);
+  float(*queries)[3] = (float(*)[3])MEM_mallocN(sizeof(*queries) * queries_len, __func__);
+  BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest) * queries_len,
+                                                          __func__);
+
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0f, 4, 6);
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  for (int i = 0; i < queries_len; i++) {
+    rng_v3_round(queries[i], 3, rng, 1000, 1.5f);
+    nearest[i].index = -1;
+    /* Limit some of the queries, to check the limit is respected. */
+    nearest[i].dist_sq = (i % 3 == 0) ? 0.0001f : FLT_MAX;
+  }
+  BLI_bvhtree_find_nearest_array(
+      tree, queries, queries_len, nearest, nearest_points_callback, points, 0);
+
+  for (int i = 0; i < queries_len; i++) {
+    BVHTreeNearest nearest_expect;
+    nearest_expect.index = -1;
+    nearest_expect.dist_sq = (i % 3 == 0) ? 0.0001f : FLT_MAX;
+    BLI_bvhtree_find_nearest(tree, queries[i], &nearest_expect, nearest_points_callback, points);
+
+    EXPECT_EQ(nearest[i].index == -1, nearest_expect.index == -1);
+    if (nearest_expect.index != -1) {
+      EXPECT_FLOAT_EQ(nearest[i].dist_sq, nearest_expect.dist_sq);
+      EXPECT_EQ_ARRAY(nearest[i].co, nearest_expect.co, 3);
+    }
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+  MEM_freeN(queries);
+  MEM_freeN(nearest);
+}
+
+static bool overlap_count_callback(void *UNUSED(userdata),
+                                   int UNUSED(index_a),
+                                   int UNUSED(index_b),
+                                   int UNUSED(thread))
+{
+  return true;
+}
+
+TEST(kdopbvh, OverlapBoxes)
+{
+  const int boxes_len = 1000;
+  struct RNG *rng = BLI_rng_new(3);
+  float(*boxes)[2][3] = (float(*)[2][3])MEM_mallocN(sizeof(*boxes) * boxes_len, __func__);
+
+  /* The 6-DOP tree uses the SIMD bounding box overlap test. */
+  BVHTree *tree = BLI_bvhtree_new(boxes_len, 0.0f, 4, 6);
+  for (int i = 0; i < boxes_len; i++) {
+    rng_v3_round(boxes[i][0], 3, rng, 1000, 1.0f);
+    rng_v3_round(boxes[i][1], 3, rng, 1000, 0.1f);
+    add_v3_v3(boxes[i][1], boxes[i][0]);
+    BLI_bvhtree_insert(tree, i, boxes[i][0], 2);
+  }
+  BLI_bvhtree_balance(tree);
+
+  uint overlap_len = 0;
+  BVHTreeOverlap *overlap = BLI_bvhtree_overlap(
+      tree, tree, &overlap_len, overlap_count_callback, nullptr);
+
+  /* Leaf bounds are inflated by the tree epsilon. */
+  float(*bounds)[2][3] = (float(*)[2][3])MEM_mallocN(sizeof(*bounds) * boxes_len, __func__);
+  for (int i = 0; i < boxes_len; i++) {
+    INIT_MINMAX(bounds[i][0], bounds[i][1]);
+    minmax_v3v3_v3_array(bounds[i][0], bounds[i][1], boxes[i], 2);
+    add_v3_fl(bounds[i][0], -FLT_EPSILON);
+    add_v3_fl(bounds[i][1], FLT_EPSILON);
+  }
+  uint overlap_expect_len = 0;
+  for (int i = 0; i < boxes_len; i++) {
+    /* Leafs don't overlap themselves. */
+    for (int j = 0; j < boxes_len; j++) {
+      if (j != i && isect_aabb_aabb_v3(bounds[i][0], bounds[i][1], bounds[j][0], bounds[j][1])) {
+        overlap_expect_len++;
+      }
+    }
+  }
+  EXPECT_EQ(overlap_len, overlap_expect_len);
+  MEM_freeN(bounds);
+
+  MEM_SAFE_FREE(overlap);
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(boxes);
+}
+
+static int refit_points_callback(void *userdata, int index, float (*r_co)[3])
+{
+  const float(*points)[3] = (const float(*)[3])userdata;
+  copy_v3_v3(r_co[0], points[index]);
+  return 1;
+}
+
+TEST(kdopbvh, Refit)
+{
+  /* Large enough to use the threaded refit. */
+  const int points_len = 5000;
+  struct RNG *rng = BLI_rng_new(42);
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(*points) * points_len, __func__);
+
+  for (const int balance_flag : {0, int(BVH_BALANCE_USE_SAH)}) {
+    BVHTree *tree = BLI_bvhtree_new(points_len, 0.0f, 4, 8);
+    for (int i = 0; i < points_len; i++) {
+      rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+      BLI_bvhtree_insert(tree, i, points[i], 1);
+    }
+    BLI_bvhtree_balance_ex(tree, balance_flag);
+
+    /* Deform the points, the tree must find them at their new positions. */
+    for (int i = 0; i < points_len; i++) {
+      points[i][0] = points[i][0] * 2.0f + 1.0f;
+      points[i][2] = -points[i][2];
+    }
+    BLI_bvhtree_refit(tree, refit_points_callback, points);
+
+    for (int i = 0; i < points_len; i++) {
+      const int j = BLI_bvhtree_find_nearest(tree, points[i], nullptr, nullptr, nullptr);
+      EXPECT_EQ_ARRAY(points[i], points[j], 3);
+    }
+
+    float bb_min[3], bb_max[3], expect_min[3], expect_max[3];
+    INIT_MINMAX(expect_min, expect_max);
+    minmax_v3v3_v3_array(expect_min, expect_max, points, points_len);
+    BLI_bvhtree_get_bounding_box(tree, bb_min, bb_max);
+    EXPECT_V3_NEAR(bb_min, expect_min, 1e-5f);
+    EXPECT_V3_NEAR(bb_max, expect_max, 1e-5f);
+
+    BLI_bvhtree_free(tree);
+  }
+
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+}
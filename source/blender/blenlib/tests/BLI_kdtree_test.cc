@@ -0,0 +1,197 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdtree.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static float (*kdtree_test_points_create(const int points_len, const int seed))[3]
+{
+  RNG *rng = BLI_rng_new(seed);
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(*points) * points_len, __func__);
+  for (int i = 0; i < points_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, points[i]);
+    mul_v3_fl(points[i], BLI_rng_get_float(rng));
+  }
+  BLI_rng_free(rng);
+  return points;
+}
+
+static KDTree_3d *kdtree_test_tree_create(const float (*points)[3], const int points_len)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(points_len);
+  for (int i = 0; i < points_len; i++) {
+    BLI_kdtree_3d_insert(tree, i, points[i]);
+  }
+  BLI_kdtree_3d_balance(tree);
+  return tree;
+}
+
+/* -------------------------------------------------------------------- */
+/* Tests */
+
+TEST(kdtree, Empty)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(0);
+  BLI_kdtree_3d_balance(tree);
+
+  const float co[3] = {0.0f, 0.0f, 0.0f};
+  KDTreeNearest_3d nearest;
+  EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, co, &nearest), -1);
+
+  int nearest_len = -1;
+  BLI_kdtree_3d_find_nearest_n_array(tree, &co, 1, &nearest, 1, &nearest_len);
+  EXPECT_EQ(nearest_len, 0);
+
+  KDTreeNearest_3d *range_nearest;
+  int offsets[2];
+  EXPECT_EQ(BLI_kdtree_3d_range_search_array(tree, &co, 1, 1.0f, &range_nearest, offsets), 0);
+  EXPECT_EQ(range_nearest, nullptr);
+  EXPECT_EQ(offsets[0], 0);
+  EXPECT_EQ(offsets[1], 0);
+
+  BLI_kdtree_3d_free(tree);
+}
+
+/* Compare against a brute force search, large enough to balance on multiple threads. */
+TEST(kdtree, FindNearest)
+{
+  const int points_len = 20000;
+  float(*points)[3] = kdtree_test_points_create(points_len, 0);
+  float(*queries)[3] = kdtree_test_points_create(100, 1);
+  KDTree_3d *tree = kdtree_test_tree_create(points, points_len);
+
+  for (int i = 0; i < 100; i++) {
+    int index_expect = -1;
+    float dist_sq_expect = FLT_MAX;
+    for (int j = 0; j < points_len; j++) {
+      const float dist_sq = len_squared_v3v3(queries[i], points[j]);
+      if (dist_sq < dist_sq_expect) {
+        dist_sq_expect = dist_sq;
+        index_expect = j;
+      }
+    }
+
+    KDTreeNearest_3d nearest;
+    EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, queries[i], &nearest), index_expect);
+    EXPECT_EQ(nearest.index, index_expect);
+    EXPECT_FLOAT_EQ(nearest.dist, sqrtf(dist_sq_expect));
+    EXPECT_V3_NEAR(nearest.co, points[index_expect], 0.0f);
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  MEM_freeN(queries);
+}
+
+TEST(kdtree, FindNearestNArray)
+{
+  const int points_len = 5000, queries_len = 1000, nearest_len_capacity = 8;
+  float(*points)[3] = kdtree_test_points_create(points_len, 0);
+  float(*queries)[3] = kdtree_test_points_create(queries_len, 1);
+  KDTree_3d *tree = kdtree_test_tree_create(points, points_len);
+
+  KDTreeNearest_3d *nearest = (KDTreeNearest_3d *)MEM_mallocN(
+      sizeof(*nearest) * queries_len * nearest_len_capacity, __func__);
+  int *nearest_len = (int *)MEM_mallocN(sizeof(*nearest_len) * queries_len, __func__);
+  BLI_kdtree_3d_find_nearest_n_array(
+      tree, queries, queries_len, nearest, nearest_len_capacity, nearest_len);
+
+  for (int i = 0; i < queries_len; i++) {
+    KDTreeNearest_3d nearest_expect[nearest_len_capacity];
+    const int nearest_len_expect = BLI_kdtree_3d_find_nearest_n(
+        tree, queries[i], nearest_expect, nearest_len_capacity);
+    ASSERT_EQ(nearest_len[i], nearest_len_expect);
+    for (int j = 0; j < nearest_len_expect; j++) {
+      const KDTreeNearest_3d *n = &nearest[i * nearest_len_capacity + j];
+      EXPECT_EQ(n->index, nearest_expect[j].index);
+      EXPECT_EQ(n->dist, nearest_expect[j].dist);
+    }
+  }
+
+  MEM_freeN(nearest);
+  MEM_freeN(nearest_len);
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  MEM_freeN(queries);
+}
+
+TEST(kdtree, RangeSearchArray)
+{
+  const int points_len = 5000, queries_len = 1000;
+  const float range = 0.1f;
+  float(*points)[3] = kdtree_test_points_create(points_len, 0);
+  float(*queries)[3] = kdtree_test_points_create(queries_len, 1);
+  KDTree_3d *tree = kdtree_test_tree_create(points, points_len);
+
+  KDTreeNearest_3d *nearest;
+  int *offsets = (int *)MEM_mallocN(sizeof(*offsets) * (queries_len + 1), __func__);
+  const int nearest_len = BLI_kdtree_3d_range_search_array(
+      tree, queries, queries_len, range, &nearest, offsets);
+  EXPECT_EQ(offsets[0], 0);
+  EXPECT_EQ(offsets[queries_len], nearest_len);
+
+  for (int i = 0; i < queries_len; i++) {
+    KDTreeNearest_3d *nearest_expect;
+    const int nearest_len_expect = BLI_kdtree_3d_range_search(
+        tree, queries[i], &nearest_expect, range);
+    ASSERT_EQ(offsets[i + 1] - offsets[i], nearest_len_expect);
+    for (int j = 0; j < nearest_len_expect; j++) {
+      const KDTreeNearest_3d *n = &nearest[offsets[i] + j];
+      EXPECT_EQ(n->dist, nearest_expect[j].dist);
+      EXPECT_LE(n->dist, range);
+    }
+    if (nearest_expect) {
+      MEM_freeN(nearest_expect);
+    }
+  }
+
+  MEM_SAFE_FREE(nearest);
+  MEM_freeN(offsets);
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  MEM_freeN(queries);
+}
+
+TEST(kdtree, CalcDuplicatesFast)
+{
+  const int points_len = 2000;
+  float(*points)[3] = kdtree_test_points_create(points_len, 0);
+  for (int i = 0; i < points_len; i += 4) {
+    copy_v3_v3(points[i + 1], points[i]);
+    points[i + 3][0] = points[i + 2][0] + 1e-5f;
+    points[i + 3][1] = points[i + 2][1];
+    points[i + 3][2] = points[i + 2][2];
+  }
+  KDTree_3d *tree = kdtree_test_tree_create(points, points_len);
+
+  int *duplicates = (int *)MEM_mallocN(sizeof(*duplicates) * points_len, __func__);
+  for (int use_index_order = 0; use_index_order < 2; use_index_order++) {
+    for (int i = 0; i < points_len; i++) {
+      duplicates[i] = -1;
+    }
+    const int found = BLI_kdtree_3d_calc_duplicates_fast(
+        tree, 1e-4f, use_index_order, duplicates);
+    EXPECT_EQ(found, points_len / 2);
+    for (int i = 0; i < points_len; i += 2) {
+      /* One of each pair is the target, the other is merged into it. */
+      const int target = (duplicates[i] == i) ? i : i + 1;
+      const int other = (target == i) ? i + 1 : i;
+      EXPECT_EQ(duplicates[target], target);
+      EXPECT_EQ(duplicates[other], target);
+      if (use_index_order) {
+        EXPECT_EQ(target, i);
+      }
+    }
+  }
+
+  MEM_freeN(duplicates);
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+}
@@ -2,6 +2,8 @@
 
 #include "testing/testing.h"
 
+#include "BLI_array.hh"
+#include "BLI_float3.hh"
 #include "BLI_math_matrix.h"
 
 TEST(math_matrix, interp_m4_m4m4_regular)
@@ -97,3 +99,47 @@ TEST(math_matrix, interp_m3_m3m3_singularity)
   EXPECT_NEAR(0.0f, determinant_m3_array(result), 1e-5);
   EXPECT_M3_NEAR(result, expect, 1e-5);
 }
+
+TEST(math_matrix, mul_m4_v3_array)
+{
+  float matrix[4][4] = {
+      {0.224976f, -0.333770f, 0.765074f, 0.100000f},
+      {0.389669f, 0.647565f, 0.168130f, 0.200000f},
+      {-0.536231f, 0.330541f, 0.443163f, 0.300000f},
+      {0.000000f, 0.000000f, 0.000000f, 1.000000f},
+  };
+  transpose_m4(matrix);
+  float matrix3[3][3];
+  copy_m3_m4(matrix3, matrix);
+
+  /* Sizes that are not a multiple of the SIMD width test the remainder handling. */
+  for (const int len : {0, 1, 3, 4, 5, 8, 11}) {
+    blender::Array<blender::float3> src(len);
+    for (const int i : src.index_range()) {
+      src[i] = {i * 0.5f - 2.0f, 1.0f - i * 0.25f, i * i * 0.125f};
+    }
+
+    blender::Array<blender::float3> result = src;
+    mul_m4_v3_array(matrix, (float(*)[3])result.data(), len);
+    for (const int i : src.index_range()) {
+      float expect[3];
+      mul_v3_m4v3(expect, matrix, src[i]);
+      EXPECT_V3_NEAR(result[i], expect, 0.0f);
+    }
+
+    mul_v3_mat3_m4v3_array((float(*)[3])result.data(), matrix, (const float(*)[3])src.data(), len);
+    for (const int i : src.index_range()) {
+      float expect[3];
+      mul_v3_mat3_m4v3(expect, matrix, src[i]);
+      EXPECT_V3_NEAR(result[i], expect, 0.0f);
+    }
+
+    result = src;
+    mul_m3_v3_array(matrix3, (float(*)[3])result.data(), len);
+    for (const int i : src.index_range()) {
+      float expect[3];
+      mul_v3_m3v3(expect, matrix3, src[i]);
+      EXPECT_V3_NEAR(result[i], expect, 0.0f);
+    }
+  }
+}
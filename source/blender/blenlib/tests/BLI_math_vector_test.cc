@@ -45,3 +45,46 @@ TEST(math_vector, ClampVecWithVecs)
   EXPECT_FLOAT_EQ(1.0f, c[0]);
   EXPECT_FLOAT_EQ(3.0f, c[1]);
 }
+
+TEST(math_vector, normalize_v3_array)
+{
+  float vecs[7][3] = {
+      {1.0f, 2.0f, 3.0f},
+      {0.0f, 0.0f, 0.0f},
+      {-4.0f, 0.5f, 0.0f},
+      {1e-20f, 0.0f, 0.0f},
+      {0.0f, -7.0f, 0.0f},
+      {3.0f, 3.0f, -3.0f},
+      {0.1f, 0.2f, 0.3f},
+  };
+  float expect[7][3];
+  memcpy(expect, vecs, sizeof(vecs));
+  for (int i = 0; i < 7; i++) {
+    normalize_v3(expect[i]);
+  }
+
+  normalize_v3_array(vecs, 7);
+  for (int i = 0; i < 7; i++) {
+    EXPECT_V3_NEAR(vecs[i], expect[i], 0.0f);
+  }
+}
+
+TEST(math_vector, minmax_v3v3_v3_array)
+{
+  const float vecs[6][3] = {
+      {1.0f, 2.0f, 3.0f},
+      {-1.0f, 0.0f, 8.0f},
+      {5.0f, -2.0f, 0.0f},
+      {0.0f, 0.0f, 0.0f},
+      {2.0f, 9.0f, -1.0f},
+      {-3.0f, 1.0f, 2.0f},
+  };
+  float min[3], max[3];
+  INIT_MINMAX(min, max);
+  minmax_v3v3_v3_array(min, max, vecs, 6);
+
+  const float expect_min[3] = {-3.0f, -2.0f, -1.0f};
+  const float expect_max[3] = {5.0f, 9.0f, 8.0f};
+  EXPECT_V3_NEAR(min, expect_min, 0.0f);
+  EXPECT_V3_NEAR(max, expect_max, 0.0f);
+}
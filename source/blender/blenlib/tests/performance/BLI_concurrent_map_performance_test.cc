@@ -0,0 +1,124 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "BLI_concurrent_map.hh"
+#include "BLI_concurrent_set.hh"
+#include "BLI_map.hh"
+#include "BLI_set.hh"
+#include "BLI_task.hh"
+#include "BLI_threads.h"
+#include "BLI_vector.hh"
+
+#include "PIL_time.h"
+
+#ifdef WITH_TBB
+#  include <tbb/task_arena.h>
+#endif
+
+namespace blender::tests {
+
+/* Every key is added this many times, like vertices that are shared by several faces. */
+#define DUPLICATES_NUM 4
+
+static Vector<int> concurrent_perf_keys(const int keys_num)
+{
+  Vector<int> keys(keys_num * DUPLICATES_NUM);
+  for (const int i : keys.index_range()) {
+    /* Spread the duplicates, so that they are usually added by different threads. */
+    keys[i] = static_cast<int>((static_cast<uint64_t>(i) * 2654435761u) % keys_num);
+  }
+  return keys;
+}
+
+template<typename FuncT> static void concurrent_perf_run_threads(const int threads_num, FuncT func)
+{
+#ifdef WITH_TBB
+  tbb::task_arena arena(threads_num);
+  arena.execute(func);
+#else
+  UNUSED_VARS(threads_num);
+  func();
+#endif
+}
+
+static void concurrent_perf_test_do(const char *id, const int keys_num)
+{
+  printf("\n========== STARTING %s ==========\n", id);
+
+  const Vector<int> keys = concurrent_perf_keys(keys_num);
+
+  {
+    Set<int> set;
+    const double init_time = PIL_check_seconds_timer();
+    for (const int key : keys) {
+      set.add(key);
+    }
+    printf(
+        "\tSet: %d keys added in %fs\n", int(set.size()), PIL_check_seconds_timer() - init_time);
+  }
+
+  {
+    Map<int, int> map;
+    const double init_time = PIL_check_seconds_timer();
+    for (const int i : keys.index_range()) {
+      map.add_or_modify(
+          keys[i],
+          [&](int *value) { *value = int(i); },
+          [&](int *value) { *value = std::min(*value, int(i)); });
+    }
+    printf("\tMap add_or_modify: %d keys added in %fs\n",
+           int(map.size()),
+           PIL_check_seconds_timer() - init_time);
+  }
+
+  const int max_threads_num = BLI_system_thread_count();
+  for (int threads_num = 1; threads_num <= max_threads_num; threads_num *= 2) {
+    ConcurrentSet<int> set;
+    const double init_time = PIL_check_seconds_timer();
+    concurrent_perf_run_threads(threads_num, [&]() {
+      parallel_for(keys.index_range(), 4096, [&](const IndexRange range) {
+        for (const int i : range) {
+          set.add(keys[i]);
+        }
+      });
+    });
+    printf("\tConcurrentSet, %d threads: %d keys added in %fs\n",
+           threads_num,
+           int(set.size()),
+           PIL_check_seconds_timer() - init_time);
+  }
+
+  for (int threads_num = 1; threads_num <= max_threads_num; threads_num *= 2) {
+    ConcurrentMap<int, int> map;
+    const double init_time = PIL_check_seconds_timer();
+    concurrent_perf_run_threads(threads_num, [&]() {
+      parallel_for(keys.index_range(), 4096, [&](const IndexRange range) {
+        for (const int i : range) {
+          map.add_or_modify(
+              keys[i],
+              [&](int *value) { *value = int(i); },
+              [&](int *value) { *value = std::min(*value, int(i)); });
+        }
+      });
+    });
+    printf("\tConcurrentMap add_or_modify, %d threads: %d keys added in %fs\n",
+           threads_num,
+           int(map.size()),
+           PIL_check_seconds_timer() - init_time);
+  }
+
+  printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(concurrent_map, Keys_100000)
+{
+  concurrent_perf_test_do("100000 keys", 100000);
+}
+
+TEST(concurrent_map, Keys_1000000)
+{
+  concurrent_perf_test_do("1000000 keys", 1000000);
+}
+
+}  // namespace blender::tests
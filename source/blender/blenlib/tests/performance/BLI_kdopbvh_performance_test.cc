@@ -0,0 +1,209 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+
+#include "BLI_kdopbvh.h"
+#include "BLI_math_geom.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+
+#include "PIL_time.h"
+
+#define NUM_RUN_AVERAGED 10
+#define NUM_QUERIES 100000
+
+/* Triangles scattered in clusters of very different density,
+ * the kind of input where the split heuristic matters. */
+static float (*kdopbvh_perf_tris_create(const int tris_len, RNG *rng))[3][3]
+{
+  float(*tris)[3][3] = (float(*)[3][3])MEM_mallocN(sizeof(*tris) * tris_len, __func__);
+  for (int i = 0; i < tris_len; i++) {
+    float center[3];
+    BLI_rng_get_float_unit_v3(rng, center);
+    mul_v3_fl(center, (i % 8 == 0) ? 10.0f : 1.0f);
+    const float size = (i % 32 == 0) ? 0.5f : 0.02f;
+    for (int j = 0; j < 3; j++) {
+      BLI_rng_get_float_unit_v3(rng, tris[i][j]);
+      mul_v3_fl(tris[i][j], size);
+      add_v3_v3(tris[i][j], center);
+    }
+  }
+  return tris;
+}
+
+static void kdopbvh_perf_raycast_cb(void *userdata,
+                                    int index,
+                                    const BVHTreeRay *ray,
+                                    BVHTreeRayHit *hit)
+{
+  const float(*tri)[3] = ((const float(*)[3][3])userdata)[index];
+  float dist;
+  if (isect_ray_tri_v3(ray->origin, ray->direction, tri[0], tri[1], tri[2], &dist, nullptr) &&
+      dist < hit->dist) {
+    hit->index = index;
+    hit->dist = dist;
+  }
+}
+
+static BVHTree *kdopbvh_perf_tree_create(const float (*tris)[3][3],
+                                         const int tris_len,
+                                         const int tree_type,
+                                         const int balance_flag)
+{
+  BVHTree *tree = BLI_bvhtree_new(tris_len, 0.0f, tree_type, 6);
+  for (int i = 0; i < tris_len; i++) {
+    BLI_bvhtree_insert(tree, i, tris[i][0], 3);
+  }
+  BLI_bvhtree_balance_ex(tree, balance_flag);
+  return tree;
+}
+
+static void kdopbvh_perf_test_do(const char *id,
+                                 const int tris_len,
+                                 const int tree_type,
+                                 const int balance_flag)
+{
+  printf("\n========== STARTING %s ==========\n", id);
+
+  RNG *rng = BLI_rng_new(0);
+  float(*tris)[3][3] = kdopbvh_perf_tris_create(tris_len, rng);
+
+  double build_time = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    const double init_time = PIL_check_seconds_timer();
+    BVHTree *tree = kdopbvh_perf_tree_create(tris, tris_len, tree_type, balance_flag);
+    build_time += PIL_check_seconds_timer() - init_time;
+    BLI_bvhtree_free(tree);
+  }
+  printf("\tbuild: done in %fs on average over %d runs\n",
+         build_time / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED);
+
+  BVHTree *tree = kdopbvh_perf_tree_create(tris, tris_len, tree_type, balance_flag);
+
+  {
+    double refit_time = 0.0;
+    for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+      const double init_time = PIL_check_seconds_timer();
+      for (int j = 0; j < tris_len; j++) {
+        BLI_bvhtree_update_node(tree, j, tris[j][0], nullptr, 3);
+      }
+      BLI_bvhtree_update_tree(tree);
+      refit_time += PIL_check_seconds_timer() - init_time;
+    }
+    printf("\trefit: done in %fs on average over %d runs\n",
+           refit_time / NUM_RUN_AVERAGED,
+           NUM_RUN_AVERAGED);
+  }
+
+  float(*rays_co)[3] = (float(*)[3])MEM_mallocN(sizeof(*rays_co) * NUM_QUERIES, __func__);
+  float(*rays_dir)[3] = (float(*)[3])MEM_mallocN(sizeof(*rays_dir) * NUM_QUERIES, __func__);
+  BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hits) * NUM_QUERIES, __func__);
+  for (int i = 0; i < NUM_QUERIES; i++) {
+    /* Rays from a grid on a sphere, so neighboring rays are coherent. */
+    const float u = (float)(i % 316) / 316.0f, v = (float)(i / 316) / 316.0f;
+    const float theta = u * (float)M_PI * 2.0f, phi = v * (float)M_PI;
+    rays_co[i][0] = cosf(theta) * sinf(phi) * 12.0f;
+    rays_co[i][1] = sinf(theta) * sinf(phi) * 12.0f;
+    rays_co[i][2] = cosf(phi) * 12.0f;
+    negate_v3_v3(rays_dir[i], rays_co[i]);
+    normalize_v3(rays_dir[i]);
+  }
+
+  {
+    int hits_len = 0;
+    const double init_time = PIL_check_seconds_timer();
+    for (int i = 0; i < NUM_QUERIES; i++) {
+      BVHTreeRayHit hit;
+      hit.index = -1;
+      hit.dist = BVH_RAYCAST_DIST_MAX;
+      if (BLI_bvhtree_ray_cast(
+              tree, rays_co[i], rays_dir[i], 0.0f, &hit, kdopbvh_perf_raycast_cb, tris) != -1) {
+        hits_len++;
+      }
+    }
+    printf("\traycast: %d queries (%d hits) done in %fs\n",
+           NUM_QUERIES,
+           hits_len,
+           PIL_check_seconds_timer() - init_time);
+  }
+
+  {
+    int hits_len = 0;
+    const double init_time = PIL_check_seconds_timer();
+    for (int i = 0; i < NUM_QUERIES; i++) {
+      hits[i].index = -1;
+      hits[i].dist = BVH_RAYCAST_DIST_MAX;
+    }
+    BLI_bvhtree_ray_cast_array(
+        tree, rays_co, rays_dir, NUM_QUERIES, 0.0f, hits, kdopbvh_perf_raycast_cb, tris, 0);
+    const double time = PIL_check_seconds_timer() - init_time;
+    for (int i = 0; i < NUM_QUERIES; i++) {
+      hits_len += (hits[i].index != -1);
+    }
+    printf("\traycast array: %d queries (%d hits) done in %fs\n", NUM_QUERIES, hits_len, time);
+  }
+
+  /* Nearest queries from the same points. */
+  BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest) * NUM_QUERIES,
+                                                          __func__);
+  for (int i = 0; i < NUM_QUERIES; i++) {
+    mul_v3_fl(rays_co[i], 0.5f);
+  }
+
+  {
+    const double init_time = PIL_check_seconds_timer();
+    for (int i = 0; i < NUM_QUERIES; i++) {
+      BLI_bvhtree_find_nearest(tree, rays_co[i], nullptr, nullptr, nullptr);
+    }
+    printf("\tnearest: %d queries done in %fs\n",
+           NUM_QUERIES,
+           PIL_check_seconds_timer() - init_time);
+  }
+
+  {
+    const double init_time = PIL_check_seconds_timer();
+    for (int i = 0; i < NUM_QUERIES; i++) {
+      nearest[i].index = -1;
+      nearest[i].dist_sq = FLT_MAX;
+    }
+    BLI_bvhtree_find_nearest_array(tree, rays_co, NUM_QUERIES, nearest, nullptr, nullptr, 0);
+    printf("\tnearest array: %d queries done in %fs\n",
+           NUM_QUERIES,
+           PIL_check_seconds_timer() - init_time);
+  }
+
+  MEM_freeN(rays_co);
+  MEM_freeN(rays_dir);
+  MEM_freeN(hits);
+  MEM_freeN(nearest);
+  BLI_bvhtree_free(tree);
+  MEM_freeN(tris);
+  BLI_rng_free(rng);
+
+  printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(kdopbvh, MedianBuild4_100000)
+{
+  kdopbvh_perf_test_do("Median split, 4-ary, 100000 triangles", 100000, 4, 0);
+}
+
+TEST(kdopbvh, SAHBuild4_100000)
+{
+  kdopbvh_perf_test_do("SAH split, 4-ary, 100000 triangles", 100000, 4, BVH_BALANCE_USE_SAH);
+}
+
+TEST(kdopbvh, MedianBuild2_1000000)
+{
+  kdopbvh_perf_test_do("Median split, 2-ary, 1000000 triangles", 1000000, 2, 0);
+}
+
+TEST(kdopbvh, SAHBuild2_1000000)
+{
+  kdopbvh_perf_test_do("SAH split, 2-ary, 1000000 triangles", 1000000, 2, BVH_BALANCE_USE_SAH);
+}
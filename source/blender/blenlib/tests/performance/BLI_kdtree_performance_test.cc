@@ -0,0 +1,125 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+
+#include "BLI_kdtree.h"
+#include "BLI_rand.h"
+
+#include "PIL_time.h"
+
+#define NUM_RUN_AVERAGED 10
+#define NUM_QUERIES 100000
+#define NUM_NEAREST 8
+
+static void kdtree_perf_points_fill(float (*points)[3], const int points_len, RNG *rng)
+{
+  for (int i = 0; i < points_len; i++) {
+    for (int j = 0; j < 3; j++) {
+      points[i][j] = BLI_rng_get_float(rng) * 2.0f - 1.0f;
+    }
+  }
+}
+
+static void kdtree_perf_test_do(const char *id, const int points_len, const float range)
+{
+  printf("\n========== STARTING %s ==========\n", id);
+
+  RNG *rng = BLI_rng_new(0);
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(*points) * points_len, __func__);
+  kdtree_perf_points_fill(points, points_len, rng);
+  float(*queries)[3] = (float(*)[3])MEM_mallocN(sizeof(*queries) * NUM_QUERIES, __func__);
+  kdtree_perf_points_fill(queries, NUM_QUERIES, rng);
+
+  KDTree_3d *tree = nullptr;
+  double balance_time = 0.0;
+  for (int i = 0; i < NUM_RUN_AVERAGED; i++) {
+    if (tree) {
+      BLI_kdtree_3d_free(tree);
+    }
+    tree = BLI_kdtree_3d_new(points_len);
+    for (int j = 0; j < points_len; j++) {
+      BLI_kdtree_3d_insert(tree, j, points[j]);
+    }
+    const double init_time = PIL_check_seconds_timer();
+    BLI_kdtree_3d_balance(tree);
+    balance_time += PIL_check_seconds_timer() - init_time;
+  }
+  printf("\tbalance: done in %fs on average over %d runs\n",
+         balance_time / NUM_RUN_AVERAGED,
+         NUM_RUN_AVERAGED);
+
+  KDTreeNearest_3d *nearest = (KDTreeNearest_3d *)MEM_mallocN(
+      sizeof(*nearest) * NUM_QUERIES * NUM_NEAREST, __func__);
+  int *nearest_len = (int *)MEM_mallocN(sizeof(*nearest_len) * NUM_QUERIES, __func__);
+
+  {
+    const double init_time = PIL_check_seconds_timer();
+    for (int i = 0; i < NUM_QUERIES; i++) {
+      nearest_len[i] = BLI_kdtree_3d_find_nearest_n(
+          tree, queries[i], &nearest[i * NUM_NEAREST], NUM_NEAREST);
+    }
+    printf("\tfind_nearest_n: %d queries done in %fs\n",
+           NUM_QUERIES,
+           PIL_check_seconds_timer() - init_time);
+  }
+
+  {
+    const double init_time = PIL_check_seconds_timer();
+    BLI_kdtree_3d_find_nearest_n_array(
+        tree, queries, NUM_QUERIES, nearest, NUM_NEAREST, nearest_len);
+    printf("\tfind_nearest_n array: %d queries done in %fs\n",
+           NUM_QUERIES,
+           PIL_check_seconds_timer() - init_time);
+  }
+
+  {
+    int found = 0;
+    const double init_time = PIL_check_seconds_timer();
+    for (int i = 0; i < NUM_QUERIES; i++) {
+      KDTreeNearest_3d *range_nearest;
+      found += BLI_kdtree_3d_range_search(tree, queries[i], &range_nearest, range);
+      MEM_SAFE_FREE(range_nearest);
+    }
+    printf("\trange_search: %d queries (%d found) done in %fs\n",
+           NUM_QUERIES,
+           found,
+           PIL_check_seconds_timer() - init_time);
+  }
+
+  {
+    int *offsets = (int *)MEM_mallocN(sizeof(*offsets) * (NUM_QUERIES + 1), __func__);
+    KDTreeNearest_3d *range_nearest;
+    const double init_time = PIL_check_seconds_timer();
+    const int found = BLI_kdtree_3d_range_search_array(
+        tree, queries, NUM_QUERIES, range, &range_nearest, offsets);
+    printf("\trange_search array: %d queries (%d found) done in %fs\n",
+           NUM_QUERIES,
+           found,
+           PIL_check_seconds_timer() - init_time);
+    MEM_SAFE_FREE(range_nearest);
+    MEM_freeN(offsets);
+  }
+
+  MEM_freeN(nearest);
+  MEM_freeN(nearest_len);
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(queries);
+  MEM_freeN(points);
+  BLI_rng_free(rng);
+
+  printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(kdtree, Points_100000)
+{
+  kdtree_perf_test_do("100000 points", 100000, 0.05f);
+}
+
+TEST(kdtree, Points_1000000)
+{
+  kdtree_perf_test_do("1000000 points", 1000000, 0.02f);
+}
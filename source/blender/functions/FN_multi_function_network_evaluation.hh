@@ -25,6 +25,7 @@
 namespace blender::fn {
 
 class MFNetworkEvaluationStorage;
+class MFNetworkEvaluationBufferCache;
 
 class MFNetworkEvaluator : public MultiFunction {
  private:
@@ -39,6 +40,12 @@ class MFNetworkEvaluator : public MultiFunction {
  private:
   using Storage = MFNetworkEvaluationStorage;
 
+  bool can_evaluate_in_chunks() const;
+  void call_chunk(IndexMask mask,
+                  MFParams params,
+                  MFContext context,
+                  MFNetworkEvaluationBufferCache *buffer_cache) const;
+
   void copy_inputs_to_storage(MFParams params, Storage &storage) const;
   void copy_outputs_to_storage(
       MFParams params,
@@ -178,6 +178,14 @@ class GMutableSpan {
     BLI_assert(type_->is<T>());
     return MutableSpan<T>(static_cast<T *>(data_), size_);
   }
+
+  GMutableSpan slice(const int64_t start, const int64_t size) const
+  {
+    BLI_assert(start >= 0);
+    BLI_assert(size >= 0);
+    BLI_assert(start + size <= size_);
+    return GMutableSpan(*type_, POINTER_OFFSET(data_, type_->size() * start), size);
+  }
 };
 
 enum class VSpanCategory {
@@ -443,6 +451,31 @@ class GVSpan : public VSpanBase<void> {
     return GSpan(*this->type_, data, this->virtual_size_);
   }
 
+  /**
+   * Returns a virtual span that references the elements in the given range. A single value stays
+   * a single value, so that functions can still detect that it is the same for all elements.
+   */
+  GVSpan slice(const int64_t start, const int64_t size) const
+  {
+    BLI_assert(start >= 0);
+    BLI_assert(size >= 0);
+    BLI_assert(start + size <= this->virtual_size_);
+    GVSpan ref = *this;
+    ref.virtual_size_ = size;
+    switch (this->category_) {
+      case VSpanCategory::Single:
+        break;
+      case VSpanCategory::FullArray:
+        ref.data_.full_array.data = POINTER_OFFSET(this->data_.full_array.data,
+                                                   start * type_->size());
+        break;
+      case VSpanCategory::FullPointerArray:
+        ref.data_.full_pointer_array.data = this->data_.full_pointer_array.data + start;
+        break;
+    }
+    return ref;
+  }
+
   void materialize_to_uninitialized(void *dst) const
   {
     this->materialize_to_uninitialized(IndexRange(virtual_size_), dst);
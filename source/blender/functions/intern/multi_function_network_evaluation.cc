@@ -28,21 +28,76 @@
  * - Avoids data copies in many cases.
  * - Every node is executed at most once.
  * - Can compute sub-functions on a single element, when the result is the same for all elements.
+ * - Large masks are split into chunks that are evaluated in parallel. The chunks are small enough
+ *   that the temporary buffers of a chain of functions stay in the CPU cache, and the buffers are
+ *   reused by the following chunks on the same thread.
  *
  * Possible improvements:
- * - Cache and reuse buffers.
  * - Use "deepest depth first" heuristic to decide which order the inputs of a node should be
  *   computed. This reduces the number of required temporary buffers when they are reused.
  */
 
 #include "FN_multi_function_network_evaluation.hh"
 
+#include "BLI_enumerable_thread_specific.hh"
+#include "BLI_hash_tables.hh"
 #include "BLI_stack.hh"
+#include "BLI_task.hh"
 
 namespace blender::fn {
 
 struct Value;
 
+/**
+ * Masks with more indices are split into chunks of this size, which are evaluated independently.
+ * With the usual attribute types, the temporary buffers of a chunk fit into the L2 cache.
+ */
+static constexpr int64_t evaluation_chunk_size = 2048;
+
+/**
+ * Temporary buffers that are freed by the evaluation of one chunk are kept here, so that the
+ * evaluation of the next chunk on the same thread does not have to allocate them again.
+ */
+class MFNetworkEvaluationBufferCache : NonCopyable, NonMovable {
+ private:
+  struct Buffer {
+    void *data;
+    int64_t size;
+    int64_t alignment;
+  };
+  Vector<Buffer> free_buffers_;
+
+ public:
+  MFNetworkEvaluationBufferCache() = default;
+
+  ~MFNetworkEvaluationBufferCache()
+  {
+    for (const Buffer &buffer : free_buffers_) {
+      MEM_freeN(buffer.data);
+    }
+  }
+
+  void *allocate(const int64_t size, const int64_t alignment)
+  {
+    for (const int64_t i : free_buffers_.index_range()) {
+      const Buffer &buffer = free_buffers_[i];
+      if (buffer.size >= size && buffer.alignment == alignment) {
+        void *data = buffer.data;
+        free_buffers_.remove_and_reorder(i);
+        return data;
+      }
+    }
+    return MEM_mallocN_aligned(size, alignment, __func__);
+  }
+
+  void deallocate(void *data, const int64_t alignment)
+  {
+    /* The buffer might be larger than requested, when it has been reused. */
+    const int64_t size = static_cast<int64_t>(MEM_allocN_len(data));
+    free_buffers_.append({data, size, alignment});
+  }
+};
+
 /**
  * This keeps track of all the values that flow through the multi-function network. Therefore it
  * maintains a mapping between output sockets and their corresponding values. Every `value`
@@ -56,9 +111,13 @@ class MFNetworkEvaluationStorage {
   IndexMask mask_;
   Array<Value *> value_per_output_id_;
   int64_t min_array_size_;
+  /** Optional, when it is null, the buffers are freed directly. */
+  MFNetworkEvaluationBufferCache *buffer_cache_;
 
  public:
-  MFNetworkEvaluationStorage(IndexMask mask, int socket_id_amount);
+  MFNetworkEvaluationStorage(IndexMask mask,
+                             int socket_id_amount,
+                             MFNetworkEvaluationBufferCache *buffer_cache = nullptr);
   ~MFNetworkEvaluationStorage();
 
   /* Add the values that have been provided by the caller of the multi-function network. */
@@ -97,6 +156,10 @@ class MFNetworkEvaluationStorage {
   bool socket_is_computed(const MFOutputSocket &socket);
   bool is_same_value_for_every_index(const MFOutputSocket &socket);
   bool socket_has_buffer_for_output(const MFOutputSocket &socket);
+
+ private:
+  void *allocate_single_buffer(const CPPType &type);
+  void free_single_buffer(GMutableSpan span);
 };
 
 MFNetworkEvaluator::MFNetworkEvaluator(Vector<const MFOutputSocket *> inputs,
@@ -141,8 +204,83 @@ void MFNetworkEvaluator::call(IndexMask mask, MFParams params, MFContext context
     return;
   }
 
+  if (mask.size() <= evaluation_chunk_size || !this->can_evaluate_in_chunks()) {
+    this->call_chunk(mask, params, context, nullptr);
+    return;
+  }
+
+  EnumerableThreadSpecific<MFNetworkEvaluationBufferCache> buffer_caches;
+
+  const int64_t chunks_num = ceil_division(mask.size(), evaluation_chunk_size);
+  parallel_for(IndexRange(chunks_num), 1, [&](const IndexRange chunk_range) {
+    MFNetworkEvaluationBufferCache &buffer_cache = buffer_caches.local();
+    for (const int64_t chunk_index : chunk_range) {
+      const int64_t chunk_start = chunk_index * evaluation_chunk_size;
+      const Span<int64_t> indices = mask.indices().slice(
+          chunk_start, std::min(evaluation_chunk_size, mask.size() - chunk_start));
+
+      /* The functions are called with spans that start at the first index of the chunk, so the
+       * indices have to be shifted accordingly. */
+      const int64_t offset = indices.first();
+      const int64_t chunk_array_size = indices.last() - offset + 1;
+      Vector<int64_t> shifted_indices;
+      if (chunk_array_size != indices.size()) {
+        shifted_indices.reserve(indices.size());
+        for (const int64_t i : indices) {
+          shifted_indices.append(i - offset);
+        }
+      }
+      const IndexMask chunk_mask = shifted_indices.is_empty() ?
+                                       IndexMask(IndexRange(chunk_array_size)) :
+                                       IndexMask(shifted_indices);
+
+      MFParamsBuilder chunk_params{*this, chunk_array_size};
+      for (const int param_index : this->param_indices()) {
+        const MFParamType param_type = this->param_type(param_index);
+        switch (param_type.category()) {
+          case MFParamType::SingleInput: {
+            const GVSpan values = params.readonly_single_input(param_index);
+            chunk_params.add_readonly_single_input(values.slice(offset, chunk_array_size));
+            break;
+          }
+          case MFParamType::SingleOutput: {
+            const GMutableSpan values = params.uninitialized_single_output(param_index);
+            chunk_params.add_uninitialized_single_output(values.slice(offset, chunk_array_size));
+            break;
+          }
+          default: {
+            BLI_assert(false);
+            break;
+          }
+        }
+      }
+
+      this->call_chunk(chunk_mask, chunk_params, context, &buffer_cache);
+    }
+  });
+}
+
+/**
+ * Vector parameters cannot be sliced, because the vector arrays are shared by all elements.
+ */
+bool MFNetworkEvaluator::can_evaluate_in_chunks() const
+{
+  for (const int param_index : this->param_indices()) {
+    if (this->param_type(param_index).data_type().category() != MFDataType::Single) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BLI_NOINLINE void MFNetworkEvaluator::call_chunk(
+    IndexMask mask,
+    MFParams params,
+    MFContext context,
+    MFNetworkEvaluationBufferCache *buffer_cache) const
+{
   const MFNetwork &network = outputs_[0]->node().network();
-  Storage storage(mask, network.socket_id_amount());
+  Storage storage(mask, network.socket_id_amount(), buffer_cache);
 
   Vector<const MFInputSocket *> outputs_to_initialize_in_the_end;
 
@@ -506,10 +644,12 @@ struct OwnVectorValue : public Value {
 /** \name Storage methods
  * \{ */
 
-MFNetworkEvaluationStorage::MFNetworkEvaluationStorage(IndexMask mask, int socket_id_amount)
+MFNetworkEvaluationStorage::MFNetworkEvaluationStorage(
+    IndexMask mask, int socket_id_amount, MFNetworkEvaluationBufferCache *buffer_cache)
     : mask_(mask),
       value_per_output_id_(socket_id_amount, nullptr),
-      min_array_size_(mask.min_array_size())
+      min_array_size_(mask.min_array_size()),
+      buffer_cache_(buffer_cache)
 {
 }
 
@@ -528,7 +668,7 @@ MFNetworkEvaluationStorage::~MFNetworkEvaluationStorage()
       }
       else {
         type.destruct_indices(span.data(), mask_);
-        MEM_freeN(span.data());
+        this->free_single_buffer(span);
       }
     }
     else if (any_value->type == ValueType::OwnVector) {
@@ -538,6 +678,25 @@ MFNetworkEvaluationStorage::~MFNetworkEvaluationStorage()
   }
 }
 
+void *MFNetworkEvaluationStorage::allocate_single_buffer(const CPPType &type)
+{
+  const int64_t size = min_array_size_ * type.size();
+  if (buffer_cache_ != nullptr) {
+    return buffer_cache_->allocate(size, type.alignment());
+  }
+  return MEM_mallocN_aligned(size, type.alignment(), AT);
+}
+
+void MFNetworkEvaluationStorage::free_single_buffer(GMutableSpan span)
+{
+  if (buffer_cache_ != nullptr) {
+    buffer_cache_->deallocate(span.data(), span.type().alignment());
+  }
+  else {
+    MEM_freeN(span.data());
+  }
+}
+
 IndexMask MFNetworkEvaluationStorage::mask() const
 {
   return mask_;
@@ -638,7 +797,7 @@ void MFNetworkEvaluationStorage::finish_input_socket(const MFInputSocket &socket
         }
         else {
           type.destruct_indices(span.data(), mask_);
-          MEM_freeN(span.data());
+          this->free_single_buffer(span);
         }
         value_per_output_id_[origin.id()] = nullptr;
       }
@@ -702,7 +861,7 @@ GMutableSpan MFNetworkEvaluationStorage::get_single_output__full(const MFOutputS
   Value *any_value = value_per_output_id_[socket.id()];
   if (any_value == nullptr) {
     const CPPType &type = socket.data_type().single_type();
-    void *buffer = MEM_mallocN_aligned(min_array_size_ * type.size(), type.alignment(), AT);
+    void *buffer = this->allocate_single_buffer(type);
     GMutableSpan span(type, buffer, min_array_size_);
 
     auto *value =
@@ -806,7 +965,7 @@ GMutableSpan MFNetworkEvaluationStorage::get_mutable_single__full(const MFInputS
   }
 
   GVSpan virtual_span = this->get_single_input__full(input);
-  void *new_buffer = MEM_mallocN_aligned(min_array_size_ * type.size(), type.alignment(), AT);
+  void *new_buffer = this->allocate_single_buffer(type);
   GMutableSpan new_array_ref(type, new_buffer, min_array_size_);
   virtual_span.materialize_to_uninitialized(mask_, new_array_ref.data());
 
@@ -65,6 +65,59 @@ TEST(multi_function_network, Test1)
   }
 }
 
+TEST(multi_function_network, LargeMask)
+{
+  CustomMF_SI_SO<int, int> add_10_fn("add 10", [](int value) { return value + 10; });
+  CustomMF_SI_SI_SO<int, int, int> multiply_fn("multiply", [](int a, int b) { return a * b; });
+
+  MFNetwork network;
+
+  MFNode &node1 = network.add_function(add_10_fn);
+  MFNode &node2 = network.add_function(multiply_fn);
+  MFNode &node3 = network.add_function(add_10_fn);
+  MFOutputSocket &input_socket1 = network.add_input("Input 1", MFDataType::ForSingle<int>());
+  MFOutputSocket &input_socket2 = network.add_input("Input 2", MFDataType::ForSingle<int>());
+  MFInputSocket &output_socket = network.add_output("Output", MFDataType::ForSingle<int>());
+  network.add_link(input_socket1, node1.input(0));
+  network.add_link(node1.output(0), node2.input(0));
+  network.add_link(input_socket2, node3.input(0));
+  network.add_link(node3.output(0), node2.input(1));
+  network.add_link(node2.output(0), output_socket);
+
+  MFNetworkEvaluator network_fn{{&input_socket1, &input_socket2}, {&output_socket}};
+
+  /* The mask is larger than a chunk, and the chunks have holes in them. */
+  const int size = 100000;
+  Array<int> values(size);
+  Vector<int64_t> indices;
+  for (const int i : values.index_range()) {
+    values[i] = i % 100;
+    if (i % 3 != 0 || i > size / 2) {
+      indices.append(i);
+    }
+  }
+  int single_value = 2;
+  Array<int> results(size, -1);
+
+  MFParamsBuilder params(network_fn, size);
+  params.add_readonly_single_input(values.as_span());
+  params.add_readonly_single_input(&single_value);
+  params.add_uninitialized_single_output(results.as_mutable_span());
+
+  MFContextBuilder context;
+
+  network_fn.call(indices.as_span(), params, context);
+
+  for (const int i : values.index_range()) {
+    if (i % 3 != 0 || i > size / 2) {
+      EXPECT_EQ(results[i], (i % 100 + 10) * 12);
+    }
+    else {
+      EXPECT_EQ(results[i], -1);
+    }
+  }
+}
+
 class ConcatVectorsFunction : public MultiFunction {
  public:
   ConcatVectorsFunction()
@@ -122,6 +122,23 @@ void ABCHairWriter::do_write(HierarchyContext &context)
   abc_curves_schema_.set(sample);
 }
 
+/**
+ * Inverse of the object matrix with the Z-up to Y-up conversion folded in, so hair keys are
+ * brought into the local Y-up space with a single multiplication.
+ */
+static void hair_yup_inverse_matrix(float r_mat[4][4], const float obmat[4][4])
+{
+  float inv_mat[4][4];
+  invert_m4_m4_safe(inv_mat, obmat);
+
+  for (int i = 0; i < 4; i++) {
+    r_mat[i][0] = inv_mat[i][0];
+    r_mat[i][1] = inv_mat[i][2];
+    r_mat[i][2] = -inv_mat[i][1];
+    r_mat[i][3] = inv_mat[i][3];
+  }
+}
+
 void ABCHairWriter::write_hair_sample(const HierarchyContext &context,
                                       Mesh *mesh,
                                       std::vector<Imath::V3f> &verts,
@@ -130,8 +147,8 @@ void ABCHairWriter::write_hair_sample(const HierarchyContext &context,
                                       std::vector<int32_t> &hvertices)
 {
   /* Get untransformed vertices, there's a xform under the hair. */
-  float inv_mat[4][4];
-  invert_m4_m4_safe(inv_mat, context.object->obmat);
+  float yup_inv_mat[4][4];
+  hair_yup_inverse_matrix(yup_inv_mat, context.object->obmat);
 
   MTFace *mtface = mesh->mtface;
   MFace *mface = mesh->mface;
@@ -226,14 +243,11 @@ void ABCHairWriter::write_hair_sample(const HierarchyContext &context,
     int steps = path->segments + 1;
     hvertices.push_back(steps);
 
+    const size_t first_vert = verts.size();
     for (k = 0; k < steps; k++, path++) {
-      float vert[3];
-      copy_v3_v3(vert, path->co);
-      mul_m4_v3(inv_mat, vert);
-
-      /* Convert Z-up to Y-up. */
-      verts.emplace_back(vert[0], vert[2], -vert[1]);
+      verts.emplace_back(path->co[0], path->co[1], path->co[2]);
     }
+    mul_m4_v3_array(yup_inv_mat, reinterpret_cast<float(*)[3]>(verts.data() + first_vert), steps);
   }
 }
 
@@ -245,8 +259,8 @@ void ABCHairWriter::write_hair_child_sample(const HierarchyContext &context,
                                             std::vector<int32_t> &hvertices)
 {
   /* Get untransformed vertices, there's a xform under the hair. */
-  float inv_mat[4][4];
-  invert_m4_m4_safe(inv_mat, context.object->obmat);
+  float yup_inv_mat[4][4];
+  hair_yup_inverse_matrix(yup_inv_mat, context.object->obmat);
 
   MTFace *mtface = mesh->mtface;
   MVert *mverts = mesh->mvert;
@@ -299,16 +313,11 @@ void ABCHairWriter::write_hair_child_sample(const HierarchyContext &context,
     int steps = path->segments + 1;
     hvertices.push_back(steps);
 
-    for (int k = 0; k < steps; k++) {
-      float vert[3];
-      copy_v3_v3(vert, path->co);
-      mul_m4_v3(inv_mat, vert);
-
-      /* Convert Z-up to Y-up. */
-      verts.emplace_back(vert[0], vert[2], -vert[1]);
-
-      path++;
+    const size_t first_vert = verts.size();
+    for (int k = 0; k < steps; k++, path++) {
+      verts.emplace_back(path->co[0], path->co[1], path->co[2]);
     }
+    mul_m4_v3_array(yup_inv_mat, reinterpret_cast<float(*)[3]>(verts.data() + first_vert), steps);
   }
 }
 
@@ -21,16 +21,21 @@
  * \ingroup modifiers
  */
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
+#include <mutex>
 #include <string>
 
 #include "MEM_guardedalloc.h"
 
+#include "BLI_concurrent_map.hh"
+#include "BLI_enumerable_thread_specific.hh"
 #include "BLI_float3.hh"
 #include "BLI_listbase.h"
 #include "BLI_set.hh"
 #include "BLI_string.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "DNA_collection_types.h"
@@ -66,12 +71,15 @@
 #include "DEG_depsgraph_build.h"
 #include "DEG_depsgraph_query.h"
 
+#include "PIL_time.h"
+
 #include "MOD_modifiertypes.h"
 #include "MOD_nodes.h"
 #include "MOD_ui_common.h"
 
 #include "NOD_derived_node_tree.hh"
 #include "NOD_geometry.h"
+#include "NOD_geometry_cache.hh"
 #include "NOD_geometry_exec.hh"
 #include "NOD_node_tree_multi_function.hh"
 #include "NOD_type_callbacks.hh"
@@ -90,7 +98,10 @@ using blender::bke::PersistentDataHandleMap;
 using blender::bke::PersistentObjectHandle;
 using blender::fn::GMutablePointer;
 using blender::fn::GValueMap;
+using blender::nodes::CacheKey;
+using blender::nodes::CacheKeyBuilder;
 using blender::nodes::GeoNodeExecParams;
+using blender::nodes::GeometryNodesCache;
 using namespace blender::fn::multi_function_types;
 using namespace blender::nodes::derived_node_tree_types;
 
@@ -252,10 +263,60 @@ static bool isDisabled(const struct Scene *UNUSED(scene),
   return false;
 }
 
+/**
+ * Evaluates the node tree to compute the group outputs. First all nodes that are needed for the
+ * outputs are found, then every node is executed in a separate task as soon as the nodes it
+ * depends on are done. That way independent branches of the tree are computed in parallel.
+ *
+ * Nodes that support laziness only get the inputs they request. The nodes computing those inputs
+ * are added while the tree is evaluated, so branches that are not requested are never computed.
+ *
+ * When a cache is passed in, the outputs of slow nodes are stored in it. Nodes whose outputs are
+ * found in the cache are not executed, and neither are the nodes they depend on, unless their
+ * outputs are used elsewhere.
+ */
 class GeometryNodesEvaluator {
  private:
-  blender::LinearAllocator<> allocator_;
-  Map<std::pair<DInputSocket, DOutputSocket>, GMutablePointer> value_by_input_;
+  struct NodeState {
+    DNode node;
+    /** Number of links from nodes that have not been executed yet. */
+    std::atomic<int> missing_inputs_num = 0;
+    /** Nodes that depend on this node, once for every link. Protected by #schedule_mutex_. */
+    Vector<NodeState *> dependents;
+    /** True when the outputs of the node have been forwarded. Protected by #schedule_mutex_. */
+    bool is_finished = false;
+    /** Inputs of a lazy node, they are kept when the node is executed again. */
+    std::unique_ptr<GValueMap<StringRef>> lazy_inputs;
+    /** Inputs that a lazy node requested during its last execution. */
+    Vector<DInputSocket> requested_inputs;
+    /** Identifies the outputs of the node in the cache, empty when they can't be cached. */
+    std::optional<CacheKey> cache_key;
+    /** Cached outputs that are used instead of executing the node. */
+    std::shared_ptr<const GeometryNodesCache::Entry> cached_entry;
+    /** Data for the cache entry that is gathered during the execution. */
+    double execution_time = 0.0;
+    Vector<NodeWarning> warnings;
+    Vector<std::string> attribute_hints;
+  };
+
+  /** Every thread has its own allocator, because nodes are executed in parallel. */
+  blender::EnumerableThreadSpecific<blender::LinearAllocator<>> allocators_;
+  blender::ConcurrentMap<std::pair<DInputSocket, DOutputSocket>, GMutablePointer> value_by_input_;
+  /** Outputs that are linked to inputs that might be used, the others are not computed. */
+  Set<DOutputSocket> required_outputs_;
+  /** Protects the scheduling data below and in #NodeState, since lazy nodes add dependencies. */
+  std::mutex schedule_mutex_;
+  Map<DNode, std::unique_ptr<NodeState>> node_states_;
+  Set<DOutputSocket> unavailable_outputs_;
+  /**
+   * Cache keys of the nodes that were slow in earlier evaluations and of the nodes they depend on.
+   * The keys are computed in the constructor and not modified afterwards.
+   */
+  Map<DNode, std::optional<CacheKey>> node_cache_keys_;
+  Map<DOutputSocket, std::optional<uint64_t>> group_input_cache_keys_;
+  /** Only set while the cache keys are computed, the values are forwarded afterwards. */
+  const Map<DOutputSocket, GMutablePointer> *group_input_data_ = nullptr;
+  GeometryNodesCache *cache_;
   Vector<DInputSocket> group_outputs_;
   blender::nodes::MultiFunctionByNode &mf_by_node_;
   const blender::nodes::DataTypeConversions &conversions_;
@@ -271,8 +332,10 @@ class GeometryNodesEvaluator {
                          const PersistentDataHandleMap &handle_map,
                          const Object *self_object,
                          const ModifierData *modifier,
-                         Depsgraph *depsgraph)
-      : group_outputs_(std::move(group_outputs)),
+                         Depsgraph *depsgraph,
+                         GeometryNodesCache *cache)
+      : cache_(cache),
+        group_outputs_(std::move(group_outputs)),
         mf_by_node_(mf_by_node),
         conversions_(blender::nodes::get_implicit_type_conversions()),
         handle_map_(handle_map),
@@ -280,6 +343,11 @@ class GeometryNodesEvaluator {
         modifier_(modifier),
         depsgraph_(depsgraph)
   {
+    if (cache_ != nullptr) {
+      group_input_data_ = &group_input_data;
+      this->compute_slow_node_cache_keys();
+      group_input_data_ = nullptr;
+    }
     for (auto item : group_input_data.items()) {
       this->forward_to_inputs(item.key, item.value);
     }
@@ -287,18 +355,416 @@ class GeometryNodesEvaluator {
 
   Vector<GMutablePointer> execute()
   {
+    Vector<NodeState *> ready_nodes = this->prepare_node_states();
+
+    TaskPool *task_pool = BLI_task_pool_create(this, TASK_PRIORITY_HIGH);
+    for (NodeState *node_state : ready_nodes) {
+      BLI_task_pool_push(task_pool, execute_node_task, node_state, false, nullptr);
+    }
+    BLI_task_pool_work_and_wait(task_pool);
+    BLI_task_pool_free(task_pool);
+
     Vector<GMutablePointer> results;
     for (const DInputSocket &group_output : group_outputs_) {
       Vector<GMutablePointer> result = this->get_input_values(group_output);
       results.append(result[0]);
     }
-    for (GMutablePointer value : value_by_input_.values()) {
-      value.destruct();
-    }
+    value_by_input_.foreach_item(
+        [](const std::pair<DInputSocket, DOutputSocket> &UNUSED(key), GMutablePointer value) {
+          value.destruct();
+        });
     return results;
   }
 
  private:
+  blender::LinearAllocator<> &local_allocator()
+  {
+    return allocators_.local();
+  }
+
+  static bool node_supports_laziness(const DNode node)
+  {
+    return node->bnode()->typeinfo->geometry_node_execute_supports_laziness;
+  }
+
+  /**
+   * The sockets that the value of the input comes from. Only the first link of inputs that are
+   * not multi-input sockets is used, see #get_input_values.
+   */
+  static Vector<DSocket> origin_sockets(const DInputSocket socket)
+  {
+    Vector<DSocket> from_sockets;
+    socket.foreach_origin_socket([&](DSocket from_socket) { from_sockets.append(from_socket); });
+    if (!socket->is_multi_input_socket() && from_sockets.size() > 1) {
+      from_sockets.resize(1);
+    }
+    return from_sockets;
+  }
+
+  /**
+   * Find the outputs that might be used to compute the group outputs. This includes the outputs
+   * linked to lazy nodes, even though they might never be requested. Otherwise the node computing
+   * them could be executed before a lazy node requests one of them.
+   */
+  void find_required_outputs()
+  {
+    Set<DNode> visited_nodes;
+    Vector<DNode> nodes_to_check;
+    auto add_socket = [&](const DInputSocket socket) {
+      for (const DSocket from_socket : origin_sockets(socket)) {
+        if (!from_socket->is_output()) {
+          continue;
+        }
+        const DOutputSocket from_output_socket{from_socket};
+        if (!from_output_socket->is_available()) {
+          continue;
+        }
+        required_outputs_.add(from_output_socket);
+        const DNode from_node{from_output_socket.context(), &from_output_socket->node()};
+        if (visited_nodes.add(from_node)) {
+          nodes_to_check.append(from_node);
+        }
+      }
+    };
+
+    for (const DInputSocket &group_output : group_outputs_) {
+      add_socket(group_output);
+    }
+    while (!nodes_to_check.is_empty()) {
+      const DNode node = nodes_to_check.pop_last();
+      for (const InputSocketRef *input_socket : node->inputs()) {
+        if (input_socket->is_available()) {
+          add_socket({node.context(), input_socket});
+        }
+      }
+    }
+  }
+
+  /**
+   * Find all nodes that have to be executed to compute the group outputs, and the links between
+   * them. Returns the nodes that don't depend on other nodes and can be executed right away.
+   */
+  Vector<NodeState *> prepare_node_states()
+  {
+    this->find_required_outputs();
+
+    Vector<NodeState *> ready_nodes;
+    std::lock_guard<std::mutex> lock(schedule_mutex_);
+    this->add_dependencies(group_outputs_, nullptr, ready_nodes);
+    return ready_nodes;
+  }
+
+  /**
+   * Make sure that the nodes computing the given inputs are executed before the dependent node.
+   * Nodes that have not been added before are added with their own dependencies, the ones that
+   * can be executed right away are appended to `r_ready_nodes`. The caller has to lock
+   * #schedule_mutex_.
+   */
+  void add_dependencies(const Span<DInputSocket> sockets,
+                        NodeState *dependent,
+                        Vector<NodeState *> &r_ready_nodes)
+  {
+    Vector<NodeState *> new_nodes;
+
+    auto add_socket_dependencies = [&](const DInputSocket socket, NodeState *dependent) {
+      for (const DSocket from_socket : origin_sockets(socket)) {
+        if (!from_socket->is_output()) {
+          /* The value of an unlinked input is used. */
+          continue;
+        }
+        const DOutputSocket from_output_socket{from_socket};
+        if (!from_output_socket->is_available()) {
+          /* Unavailable outputs have a default value, the node does not have to be executed. */
+          if (unavailable_outputs_.add(from_output_socket)) {
+            this->forward_default_value(from_output_socket);
+          }
+          continue;
+        }
+        if (value_by_input_.contains(std::make_pair(socket, from_output_socket))) {
+          /* The value is a group input or it has been computed already. */
+          continue;
+        }
+        const DNode from_node{from_output_socket.context(), &from_output_socket->node()};
+        NodeState &from_state = *node_states_.lookup_or_add_cb(from_node, [&]() {
+          std::unique_ptr<NodeState> state = std::make_unique<NodeState>();
+          state->node = from_node;
+          this->lookup_cached_outputs(*state);
+          new_nodes.append(state.get());
+          return state;
+        });
+        if (from_state.is_finished) {
+          /* The node has forwarded its outputs after the check above. */
+          continue;
+        }
+        if (dependent != nullptr) {
+          from_state.dependents.append(dependent);
+          dependent->missing_inputs_num++;
+        }
+      }
+    };
+
+    for (const DInputSocket &socket : sockets) {
+      add_socket_dependencies(socket, dependent);
+    }
+    /* The vector grows while the new nodes are checked. */
+    for (int64_t i = 0; i < new_nodes.size(); i++) {
+      NodeState *node_state = new_nodes[i];
+      const DNode node = node_state->node;
+      if (node_state->cached_entry) {
+        /* The inputs are not needed when the outputs are cached. */
+        continue;
+      }
+      if (node_supports_laziness(node)) {
+        /* Dependencies are added when the node requests its inputs. */
+        continue;
+      }
+      for (const InputSocketRef *input_socket : node->inputs()) {
+        if (input_socket->is_available()) {
+          add_socket_dependencies({node.context(), input_socket}, node_state);
+        }
+      }
+    }
+
+    for (NodeState *node_state : new_nodes) {
+      if (node_state->missing_inputs_num == 0) {
+        r_ready_nodes.append(node_state);
+      }
+    }
+  }
+
+  /**
+   * Find the cached outputs of the node, when all outputs that are used are in the cache. The
+   * caller has to lock #schedule_mutex_.
+   */
+  void lookup_cached_outputs(NodeState &node_state)
+  {
+    const DNode node = node_state.node;
+    const std::optional<CacheKey> *cache_key = node_cache_keys_.lookup_ptr(node);
+    if (cache_key == nullptr || !*cache_key) {
+      return;
+    }
+    node_state.cache_key = *cache_key;
+    std::shared_ptr<const GeometryNodesCache::Entry> entry = cache_->lookup(
+        *node_state.cache_key);
+    if (!entry) {
+      return;
+    }
+    for (const OutputSocketRef *output_socket : node->outputs()) {
+      if (output_socket->is_available() &&
+          required_outputs_.contains({node.context(), output_socket})) {
+        if (entry->lookup_output(output_socket->identifier()) == nullptr) {
+          return;
+        }
+      }
+    }
+    node_state.cached_entry = std::move(entry);
+  }
+
+  /**
+   * Compute the keys of the nodes that were slow in earlier evaluations, before the group input
+   * values are forwarded. The other nodes don't get a key, so the group inputs are only hashed
+   * when a node that depends on them might be cached.
+   */
+  void compute_slow_node_cache_keys()
+  {
+    if (!cache_->has_slow_nodes()) {
+      return;
+    }
+    Set<DNode> visited_nodes;
+    Vector<DNode> nodes_to_check;
+    auto add_origin_nodes = [&](const DInputSocket socket) {
+      for (const DSocket from_socket : origin_sockets(socket)) {
+        if (from_socket->is_output()) {
+          const DNode from_node{from_socket.context(), &from_socket->node()};
+          if (visited_nodes.add(from_node)) {
+            nodes_to_check.append(from_node);
+          }
+        }
+      }
+    };
+    for (const DInputSocket &socket : group_outputs_) {
+      add_origin_nodes(socket);
+    }
+    while (!nodes_to_check.is_empty()) {
+      const DNode node = nodes_to_check.pop_last();
+      if (cache_->is_slow_node(node_identity(node))) {
+        this->node_cache_key(node);
+      }
+      for (const InputSocketRef *input_socket : node->inputs()) {
+        if (input_socket->is_available()) {
+          add_origin_nodes({node.context(), input_socket});
+        }
+      }
+    }
+  }
+
+  /**
+   * Name of the node that stays the same across evaluations: the names of the group nodes it is
+   * nested in and its own name.
+   */
+  static std::string node_identity(const DNode node)
+  {
+    std::string identity = node->name();
+    for (const DTreeContext *context = node.context(); context->parent_node() != nullptr;
+         context = context->parent_context()) {
+      identity = std::string(context->parent_node()->name()) + "/" + identity;
+    }
+    return identity;
+  }
+
+  /**
+   * The key of a node depends on its type and settings and on the keys of all values that are
+   * passed to its inputs. Nothing is returned when the outputs of the node can't be cached.
+   */
+  std::optional<CacheKey> node_cache_key(const DNode node)
+  {
+    const std::optional<CacheKey> *stored_key = node_cache_keys_.lookup_ptr(node);
+    if (stored_key != nullptr) {
+      return *stored_key;
+    }
+    /* Computing the key adds the keys of the linked nodes to the map, which can reallocate it, so
+     * the pointer above must not be used after this. */
+    std::optional<CacheKey> key = this->compute_node_cache_key(node);
+    node_cache_keys_.add(node, key);
+    return key;
+  }
+
+  std::optional<CacheKey> compute_node_cache_key(const DNode node)
+  {
+    const bNode &bnode = *node->bnode();
+    if (!blender::nodes::node_supports_caching(bnode)) {
+      return std::nullopt;
+    }
+    CacheKey key;
+    key.add(node_identity(node));
+    key.add(node->idname());
+    key.add(static_cast<uint64_t>(static_cast<uint16_t>(bnode.custom1)) |
+            (static_cast<uint64_t>(static_cast<uint16_t>(bnode.custom2)) << 16));
+    key.add_bytes(&bnode.custom3, sizeof(float));
+    key.add_bytes(&bnode.custom4, sizeof(float));
+    if (bnode.storage != nullptr) {
+      /* Storage that contains pointers results in more cache misses, but that's fine. */
+      key.add_bytes(bnode.storage, MEM_allocN_len(bnode.storage));
+    }
+    /* Some nodes output different values for viewport and render evaluation. */
+    key.add(static_cast<uint64_t>(DEG_get_mode(depsgraph_)));
+
+    for (const InputSocketRef *input_socket : node->inputs()) {
+      if (!input_socket->is_available()) {
+        continue;
+      }
+      const DInputSocket socket{node.context(), input_socket};
+      const CPPType &type = *blender::nodes::socket_cpp_type_get(*input_socket->typeinfo());
+      key.add(input_socket->identifier());
+      key.add(type.name());
+      const Vector<DSocket> from_sockets = origin_sockets(socket);
+      key.add(static_cast<uint64_t>(from_sockets.size()));
+      if (from_sockets.is_empty()) {
+        const std::optional<uint64_t> value_key = this->unlinked_input_cache_key(socket);
+        if (!value_key) {
+          return std::nullopt;
+        }
+        key.add(*value_key);
+        continue;
+      }
+      for (const DSocket from_socket : from_sockets) {
+        const std::optional<uint64_t> value_key = this->origin_socket_cache_key(from_socket);
+        if (!value_key) {
+          return std::nullopt;
+        }
+        key.add(node_identity({from_socket.context(), &from_socket->node()}));
+        key.add(from_socket->identifier());
+        key.add(*value_key);
+      }
+    }
+    return key;
+  }
+
+  std::optional<uint64_t> origin_socket_cache_key(const DSocket from_socket)
+  {
+    if (!from_socket->is_output()) {
+      return this->unlinked_input_cache_key(DInputSocket(from_socket));
+    }
+    const DOutputSocket from_output_socket{from_socket};
+    const GMutablePointer *group_input = group_input_data_->lookup_ptr(from_output_socket);
+    if (group_input != nullptr) {
+      return group_input_cache_keys_.lookup_or_add_cb(from_output_socket, [&]() {
+        return blender::nodes::hash_socket_value(*group_input->type(), group_input->get());
+      });
+    }
+    CacheKeyBuilder key;
+    key.add(from_output_socket->identifier());
+    if (!from_output_socket->is_available()) {
+      /* The default value of the socket type is used. */
+      key.add(from_output_socket->idname());
+      return key.get();
+    }
+    const DNode from_node{from_output_socket.context(), &from_output_socket->node()};
+    const std::optional<CacheKey> from_node_key = this->node_cache_key(from_node);
+    if (!from_node_key) {
+      return std::nullopt;
+    }
+    key.add(from_node_key->hash());
+    return key.get();
+  }
+
+  std::optional<uint64_t> unlinked_input_cache_key(const DInputSocket socket)
+  {
+    const bNodeSocket &bsocket = *socket->bsocket();
+    if (ELEM(bsocket.type, SOCK_OBJECT, SOCK_COLLECTION)) {
+      /* The referenced data can change without the socket value changing. */
+      return std::nullopt;
+    }
+    const CPPType &type = *blender::nodes::socket_cpp_type_get(*socket->typeinfo());
+    BUFFER_FOR_CPP_TYPE_VALUE(type, buffer);
+    blender::nodes::socket_cpp_value_get(bsocket, buffer);
+    const std::optional<uint64_t> key = blender::nodes::hash_socket_value(type, buffer);
+    type.destruct(buffer);
+    return key;
+  }
+
+  static void execute_node_task(TaskPool *__restrict pool, void *taskdata)
+  {
+    GeometryNodesEvaluator &evaluator = *static_cast<GeometryNodesEvaluator *>(
+        BLI_task_pool_user_data(pool));
+    NodeState &node_state = *static_cast<NodeState *>(taskdata);
+    evaluator.execute_node_and_schedule(pool, node_state);
+  }
+
+  void execute_node_and_schedule(TaskPool *pool, NodeState &node_state)
+  {
+    while (!this->compute_node_and_forward(node_state)) {
+      /* The node requested inputs that are not available yet. The counter is incremented while
+       * the dependencies are added, so that the node is not scheduled by a dependency that
+       * finishes in the meantime. */
+      Vector<NodeState *> ready_nodes;
+      node_state.missing_inputs_num = 1;
+      {
+        std::lock_guard<std::mutex> lock(schedule_mutex_);
+        this->add_dependencies(node_state.requested_inputs, &node_state, ready_nodes);
+      }
+      for (NodeState *ready_node : ready_nodes) {
+        BLI_task_pool_push(pool, execute_node_task, ready_node, false, nullptr);
+      }
+      if (node_state.missing_inputs_num.fetch_sub(1) != 1) {
+        /* The node is executed again by the last dependency that finishes. */
+        return;
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(schedule_mutex_);
+      node_state.is_finished = true;
+    }
+
+    /* Schedule the nodes that have all their inputs now. */
+    for (NodeState *dependent : node_state.dependents) {
+      if (dependent->missing_inputs_num.fetch_sub(1) == 1) {
+        BLI_task_pool_push(pool, execute_node_task, dependent, false, nullptr);
+      }
+    }
+  }
+
   Vector<GMutablePointer> get_input_values(const DInputSocket socket_to_compute)
   {
     Vector<DSocket> from_sockets;
@@ -335,7 +801,7 @@ class GeometryNodesEvaluator {
          * can happen when a node linked to a multi-input-socket is muted. */
         GMutablePointer value = values[first_occurence];
         const CPPType *type = value.type();
-        void *copy_buffer = allocator_.allocate(type->size(), type->alignment());
+        void *copy_buffer = this->local_allocator().allocate(type->size(), type->alignment());
         type->copy_to_uninitialized(value.get(), copy_buffer);
         values.append({type, copy_buffer});
       }
@@ -350,15 +816,10 @@ class GeometryNodesEvaluator {
       const DOutputSocket from_output_socket{from_socket};
       const std::pair<DInputSocket, DOutputSocket> key = std::make_pair(socket_to_compute,
                                                                         from_output_socket);
+      /* The node that computes the value has been executed before this one. */
       std::optional<GMutablePointer> value = value_by_input_.pop_try(key);
-      if (value.has_value()) {
-        /* This input has been computed before, return it directly. */
-        return {*value};
-      }
-
-      /* Compute the socket now. */
-      this->compute_output_and_forward(from_output_socket);
-      return {value_by_input_.pop(key)};
+      BLI_assert(value.has_value());
+      return {*value};
     }
 
     /* Get value from an unlinked input socket. */
@@ -367,55 +828,179 @@ class GeometryNodesEvaluator {
     return {get_unlinked_input_value(from_input_socket, type)};
   }
 
-  void compute_output_and_forward(const DOutputSocket socket_to_compute)
+  void forward_default_value(const DOutputSocket socket)
   {
-    const DNode node{socket_to_compute.context(), &socket_to_compute->node()};
+    const CPPType &type = *blender::nodes::socket_cpp_type_get(*socket->typeinfo());
+    void *buffer = this->local_allocator().allocate(type.size(), type.alignment());
+    type.copy_to_uninitialized(type.default_value(), buffer);
+    this->forward_to_inputs(socket, {type, buffer});
+  }
 
-    if (!socket_to_compute->is_available()) {
-      /* If the output is not available, use a default value. */
-      const CPPType &type = *blender::nodes::socket_cpp_type_get(*socket_to_compute->typeinfo());
-      void *buffer = allocator_.allocate(type.size(), type.alignment());
-      type.copy_to_uninitialized(type.default_value(), buffer);
-      this->forward_to_inputs(socket_to_compute, {type, buffer});
-      return;
+  void load_input_values(const DInputSocket socket,
+                         GValueMap<StringRef> &node_inputs_map,
+                         blender::LinearAllocator<> &allocator)
+  {
+    Vector<GMutablePointer> values = this->get_input_values(socket);
+    for (int i = 0; i < values.size(); ++i) {
+      /* Values from Multi Input Sockets are stored in input map with the format
+       * <identifier>[<index>]. */
+      blender::StringRefNull key = allocator.copy_string(
+          socket->identifier() + (i > 0 ? ("[" + std::to_string(i)) + "]" : ""));
+      node_inputs_map.add_new_direct(key, std::move(values[i]));
+    }
+  }
+
+  /**
+   * Execute the node and forward its outputs. Returns false when the node requested inputs that
+   * are not available yet, see #GeoNodeExecParams::lazy_require_input.
+   */
+  bool compute_node_and_forward(NodeState &node_state)
+  {
+    const DNode node = node_state.node;
+    if (node_state.cached_entry) {
+      this->forward_cached_outputs(node_state);
+      return true;
     }
+    blender::LinearAllocator<> &allocator = this->local_allocator();
 
     /* Prepare inputs required to execute the node. */
-    GValueMap<StringRef> node_inputs_map{allocator_};
-    for (const InputSocketRef *input_socket : node->inputs()) {
-      if (input_socket->is_available()) {
-        Vector<GMutablePointer> values = this->get_input_values({node.context(), input_socket});
-        for (int i = 0; i < values.size(); ++i) {
-          /* Values from Multi Input Sockets are stored in input map with the format
-           * <identifier>[<index>]. */
-          blender::StringRefNull key = allocator_.copy_string(
-              input_socket->identifier() + (i > 0 ? ("[" + std::to_string(i)) + "]" : ""));
-          node_inputs_map.add_new_direct(key, std::move(values[i]));
+    GValueMap<StringRef> eager_inputs_map{allocator};
+    GValueMap<StringRef> *node_inputs_map = &eager_inputs_map;
+    if (node_supports_laziness(node)) {
+      if (!node_state.lazy_inputs) {
+        node_state.lazy_inputs = std::make_unique<GValueMap<StringRef>>(allocator);
+      }
+      node_inputs_map = node_state.lazy_inputs.get();
+      for (const DInputSocket &socket : node_state.requested_inputs) {
+        this->load_input_values(socket, *node_inputs_map, allocator);
+      }
+      node_state.requested_inputs.clear();
+    }
+    else {
+      for (const InputSocketRef *input_socket : node->inputs()) {
+        if (input_socket->is_available()) {
+          this->load_input_values({node.context(), input_socket}, *node_inputs_map, allocator);
         }
       }
     }
 
-    /* Execute the node. */
-    GValueMap<StringRef> node_outputs_map{allocator_};
-    GeoNodeExecParams params{
-        node, node_inputs_map, node_outputs_map, handle_map_, self_object_, modifier_, depsgraph_};
+    Vector<StringRef> required_outputs;
+    for (const OutputSocketRef *output_socket : node->outputs()) {
+      if (required_outputs_.contains({node.context(), output_socket})) {
+        required_outputs.append(output_socket->identifier());
+      }
+    }
+
+    /* Execute the node. The data that is lost when the node is not executed again is gathered for
+     * the cache. */
+    const bool may_be_cached = node_state.cache_key.has_value();
+    this->store_ui_hints(
+        node, *node_inputs_map, may_be_cached ? &node_state.attribute_hints : nullptr);
+    GValueMap<StringRef> node_outputs_map{allocator};
+    Vector<StringRef> requested_inputs;
+    GeoNodeExecParams params{node,
+                             *node_inputs_map,
+                             node_outputs_map,
+                             handle_map_,
+                             self_object_,
+                             modifier_,
+                             depsgraph_,
+                             required_outputs,
+                             &requested_inputs,
+                             may_be_cached ? &node_state.warnings : nullptr};
+    const double start_time = PIL_check_seconds_timer();
     this->execute_node(node, params);
+    node_state.execution_time += PIL_check_seconds_timer() - start_time;
+
+    if (!requested_inputs.is_empty()) {
+      for (const StringRef identifier : requested_inputs) {
+        for (const InputSocketRef *input_socket : node->inputs()) {
+          if (input_socket->identifier() == identifier) {
+            node_state.requested_inputs.append_non_duplicates({node.context(), input_socket});
+          }
+        }
+      }
+      return false;
+    }
+    node_state.lazy_inputs.reset();
 
-    /* Forward computed outputs to linked input sockets. */
+    /* Forward computed outputs to linked input sockets. Outputs that are not required are
+     * destructed with the map. */
+    Vector<std::pair<DOutputSocket, GMutablePointer>> output_values;
     for (const OutputSocketRef *output_socket : node->outputs()) {
-      if (output_socket->is_available()) {
+      const DOutputSocket socket{node.context(), output_socket};
+      if (output_socket->is_available() && required_outputs_.contains(socket)) {
         GMutablePointer value = node_outputs_map.extract(output_socket->identifier());
-        this->forward_to_inputs({node.context(), output_socket}, value);
+        output_values.append({socket, value});
+      }
+    }
+    if (cache_ != nullptr && node_state.execution_time >= GeometryNodesCache::min_execution_time) {
+      if (may_be_cached) {
+        this->add_to_cache(node_state, output_values);
+      }
+      else {
+        /* The node gets a key in the next evaluation. */
+        cache_->tag_slow_node(node_identity(node));
+      }
+    }
+    for (const std::pair<DOutputSocket, GMutablePointer> &item : output_values) {
+      this->forward_to_inputs(item.first, item.second);
+    }
+    return true;
+  }
+
+  void add_to_cache(const NodeState &node_state,
+                    Span<std::pair<DOutputSocket, GMutablePointer>> output_values)
+  {
+    std::unique_ptr<GeometryNodesCache::Entry> entry =
+        std::make_unique<GeometryNodesCache::Entry>();
+    for (const std::pair<DOutputSocket, GMutablePointer> &item : output_values) {
+      const GMutablePointer value = item.second;
+      if (!entry->add_output(item.first->identifier(), *value.type(), value.get())) {
+        return;
       }
     }
+    entry->warnings = node_state.warnings;
+    entry->attribute_hints = node_state.attribute_hints;
+    cache_->add(*node_state.cache_key, std::move(entry));
+  }
+
+  /**
+   * Forward copies of the cached outputs. The warnings and attribute names that the node would
+   * have added to the UI are added again, because they are cleared before every evaluation.
+   */
+  void forward_cached_outputs(NodeState &node_state)
+  {
+    const DNode node = node_state.node;
+    const GeometryNodesCache::Entry &entry = *node_state.cached_entry;
+    for (const OutputSocketRef *output_socket : node->outputs()) {
+      const DOutputSocket socket{node.context(), output_socket};
+      if (output_socket->is_available() && required_outputs_.contains(socket)) {
+        const GMutablePointer *cached_value = entry.lookup_output(output_socket->identifier());
+        BLI_assert(cached_value != nullptr);
+        const CPPType &type = *cached_value->type();
+        void *buffer = this->local_allocator().allocate(type.size(), type.alignment());
+        type.copy_to_uninitialized(cached_value->get(), buffer);
+        this->forward_to_inputs(socket, {type, buffer});
+      }
+    }
+
+    bNodeTree *btree_original = (bNodeTree *)DEG_get_original_id((ID *)node->btree());
+    const NodeTreeEvaluationContext context(*self_object_, *modifier_);
+    for (const NodeWarning &warning : entry.warnings) {
+      BKE_nodetree_error_message_add(
+          *btree_original, context, *node->bnode(), warning.type, warning.message);
+    }
+    for (const std::string &attribute_name : entry.attribute_hints) {
+      BKE_nodetree_attribute_hint_add(*btree_original, context, *node->bnode(), attribute_name);
+    }
+    node_state.cached_entry.reset();
   }
 
   void execute_node(const DNode node, GeoNodeExecParams params)
   {
     const bNode &bnode = params.node();
 
-    this->store_ui_hints(node, params);
-
     /* Use the geometry-node-execute callback if it exists. */
     if (bnode.typeinfo->geometry_node_execute != nullptr) {
       bnode.typeinfo->geometry_node_execute(params);
@@ -433,7 +1018,9 @@ class GeometryNodesEvaluator {
     this->execute_unknown_node(node, params);
   }
 
-  void store_ui_hints(const DNode node, GeoNodeExecParams params) const
+  void store_ui_hints(const DNode node,
+                      const GValueMap<StringRef> &node_inputs_map,
+                      Vector<std::string> *r_attribute_names) const
   {
     for (const InputSocketRef *socket_ref : node->inputs()) {
       if (!socket_ref->is_available()) {
@@ -451,7 +1038,13 @@ class GeometryNodesEvaluator {
       bNodeTree *btree_original = (bNodeTree *)DEG_get_original_id((ID *)btree_cow);
       const NodeTreeEvaluationContext context(*self_object_, *modifier_);
 
-      const GeometrySet &geometry_set = params.get_input<GeometrySet>(socket_ref->identifier());
+      if (!node_inputs_map.contains(socket_ref->identifier())) {
+        /* The input has not been requested by a lazy node. */
+        continue;
+      }
+
+      const GeometrySet &geometry_set = node_inputs_map.lookup<GeometrySet>(
+          socket_ref->identifier());
       const Vector<const GeometryComponent *> components = geometry_set.get_components_for_read();
 
       for (const GeometryComponent *component : components) {
@@ -459,6 +1052,9 @@ class GeometryNodesEvaluator {
             [&](StringRefNull attribute_name, const AttributeMetaData &UNUSED(meta_data)) {
               BKE_nodetree_attribute_hint_add(
                   *btree_original, context, *node->bnode(), attribute_name);
+              if (r_attribute_names != nullptr) {
+                r_attribute_names->append(attribute_name);
+              }
               return true;
             });
       }
@@ -483,7 +1079,7 @@ class GeometryNodesEvaluator {
     for (const OutputSocketRef *socket_ref : node->outputs()) {
       if (socket_ref->is_available()) {
         const CPPType &type = *blender::nodes::socket_cpp_type_get(*socket_ref->typeinfo());
-        void *buffer = allocator_.allocate(type.size(), type.alignment());
+        void *buffer = this->local_allocator().allocate(type.size(), type.alignment());
         fn_params.add_uninitialized_single_output(GMutableSpan(type, buffer, 1));
         output_data.append(GMutablePointer(type, buffer));
       }
@@ -529,7 +1125,7 @@ class GeometryNodesEvaluator {
         to_sockets_same_type.append(to_socket);
       }
       else {
-        void *buffer = allocator_.allocate(to_type.size(), to_type.alignment());
+        void *buffer = this->local_allocator().allocate(to_type.size(), to_type.alignment());
         if (conversions_.is_convertible(from_type, to_type)) {
           conversions_.convert(from_type, to_type, value_to_forward.get(), buffer);
         }
@@ -561,7 +1157,7 @@ class GeometryNodesEvaluator {
       add_value_to_input_socket(first_key, value_to_forward);
       for (const DInputSocket &to_socket : other_to_sockets) {
         const std::pair<DInputSocket, DOutputSocket> key = std::make_pair(to_socket, from_socket);
-        void *buffer = allocator_.allocate(type.size(), type.alignment());
+        void *buffer = this->local_allocator().allocate(type.size(), type.alignment());
         type.copy_to_uninitialized(value_to_forward.get(), buffer);
         add_value_to_input_socket(key, GMutablePointer{type, buffer});
       }
@@ -577,9 +1173,10 @@ class GeometryNodesEvaluator {
   GMutablePointer get_unlinked_input_value(const DInputSocket &socket,
                                            const CPPType &required_type)
   {
+    blender::LinearAllocator<> &allocator = this->local_allocator();
     bNodeSocket *bsocket = socket->bsocket();
     const CPPType &type = *blender::nodes::socket_cpp_type_get(*socket->typeinfo());
-    void *buffer = allocator_.allocate(type.size(), type.alignment());
+    void *buffer = allocator.allocate(type.size(), type.alignment());
 
     if (bsocket->type == SOCK_OBJECT) {
       Object *object = ((bNodeSocketValueObject *)bsocket->default_value)->value;
@@ -599,13 +1196,13 @@ class GeometryNodesEvaluator {
       return {type, buffer};
     }
     if (conversions_.is_convertible(type, required_type)) {
-      void *converted_buffer = allocator_.allocate(required_type.size(),
-                                                   required_type.alignment());
+      void *converted_buffer = allocator.allocate(required_type.size(),
+                                                  required_type.alignment());
       conversions_.convert(type, required_type, buffer, converted_buffer);
       type.destruct(buffer);
       return {required_type, converted_buffer};
     }
-    void *default_buffer = allocator_.allocate(required_type.size(), required_type.alignment());
+    void *default_buffer = allocator.allocate(required_type.size(), required_type.alignment());
     type.copy_to_uninitialized(type.default_value(), default_buffer);
     return {required_type, default_buffer};
   }
@@ -1085,13 +1682,21 @@ static GeometrySet compute_geometry(const DerivedNodeTree &tree,
   Vector<DInputSocket> group_outputs;
   group_outputs.append({root_context, &socket_to_compute});
 
+  /* The cache is stored in the runtime data of the evaluated modifier, which is kept when the
+   * evaluated object is updated. */
+  if (nmd->modifier.runtime == nullptr) {
+    nmd->modifier.runtime = new GeometryNodesCache();
+  }
+  GeometryNodesCache *cache = static_cast<GeometryNodesCache *>(nmd->modifier.runtime);
+
   GeometryNodesEvaluator evaluator{group_inputs,
                                    group_outputs,
                                    mf_by_node,
                                    handle_map,
                                    ctx->object,
                                    (ModifierData *)nmd,
-                                   ctx->depsgraph};
+                                   ctx->depsgraph,
+                                   cache};
 
   Vector<GMutablePointer> results = evaluator.execute();
   BLI_assert(results.size() == 1);
@@ -1348,6 +1953,12 @@ static void freeData(ModifierData *md)
   }
 }
 
+static void freeRuntimeData(void *runtime_data_v)
+{
+  GeometryNodesCache *cache = static_cast<GeometryNodesCache *>(runtime_data_v);
+  delete cache;
+}
+
 static void requiredDataMask(Object *UNUSED(ob),
                              ModifierData *UNUSED(md),
                              CustomData_MeshMasks *r_cddata_masks)
@@ -1389,7 +2000,7 @@ ModifierTypeInfo modifierType_Nodes = {
     /* dependsOnNormals */ nullptr,
     /* foreachIDLink */ foreachIDLink,
     /* foreachTexLink */ foreachTexLink,
-    /* freeRuntimeData */ nullptr,
+    /* freeRuntimeData */ freeRuntimeData,
     /* panelRegister */ panelRegister,
     /* blendWrite */ blendWrite,
     /* blendRead */ blendRead,
@@ -39,6 +39,7 @@
 #include "BLI_bitmap.h"
 #include "BLI_kdtree.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 
 #include "BLT_translation.h"
 
@@ -464,6 +465,75 @@ static void weld_vert_groups_setup(const uint mvert_len,
 /** \name Weld Edge API
  * \{ */
 
+struct WeldEdgeOverlapData {
+  const struct WeldGroup *v_links;
+  const uint *link_edge_buffer;
+  uint *edge_dest_map;
+  WeldEdge *wedge;
+};
+
+/**
+ * Edges that connect the same vertices are merged into the one with the lowest index.
+ * Each edge only searches for that edge and only writes to itself, so edges can be tested in
+ * parallel.
+ */
+static void weld_edge_overlap_cb(void *__restrict userdata,
+                                 const int iter,
+                                 const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const struct WeldEdgeOverlapData *data = userdata;
+  const uint i = (uint)iter;
+  WeldEdge *we = &data->wedge[i];
+  if (we->flag == ELEM_COLLAPSED) {
+    return;
+  }
+
+  uint dst_vert_a = we->vert_a;
+  uint dst_vert_b = we->vert_b;
+
+  const struct WeldGroup *link_a = &data->v_links[dst_vert_a];
+  const struct WeldGroup *link_b = &data->v_links[dst_vert_b];
+
+  uint edges_len_a = link_a->len;
+  uint edges_len_b = link_b->len;
+
+  if (edges_len_a <= 1 || edges_len_b <= 1) {
+    return;
+  }
+
+  /* Both lists are sorted, the first edge they have in common (other than this one) is the one
+   * with the lowest index. */
+  const uint *edges_ctx_a = &data->link_edge_buffer[link_a->ofs];
+  const uint *edges_ctx_b = &data->link_edge_buffer[link_b->ofs];
+
+  for (; edges_len_a--; edges_ctx_a++) {
+    uint e_ctx_a = *edges_ctx_a;
+    if (e_ctx_a == i) {
+      continue;
+    }
+    if (e_ctx_a > i) {
+      /* This edge has the lowest index, the other edges are merged into it. */
+      return;
+    }
+    while (edges_len_b && *edges_ctx_b < e_ctx_a) {
+      edges_ctx_b++;
+      edges_len_b--;
+    }
+    if (edges_len_b == 0) {
+      return;
+    }
+    if (e_ctx_a == *edges_ctx_b) {
+      const WeldEdge *we_a = &data->wedge[e_ctx_a];
+      BLI_assert(ELEM(we_a->vert_a, dst_vert_a, dst_vert_b));
+      BLI_assert(ELEM(we_a->vert_b, dst_vert_a, dst_vert_b));
+      BLI_assert(we_a->edge_orig != we->edge_orig);
+      data->edge_dest_map[we->edge_orig] = we_a->edge_orig;
+      we->edge_dest = we_a->edge_orig;
+      return;
+    }
+  }
+}
+
 static void weld_edge_ctx_setup(const uint mvert_len,
                                 const uint wedge_len,
                                 struct WeldGroup *r_vlinks,
@@ -526,54 +596,22 @@ static void weld_edge_ctx_setup(const uint mvert_len,
       vl_iter->ofs -= vl_iter->len;
     }
 
-    we = &r_wedge[0];
-    for (uint i = 0; i < wedge_len; i++, we++) {
-      if (we->edge_dest != OUT_OF_CONTEXT) {
-        /* No need to retest edges.
-         * (Already includes collapsed edges). */
-        continue;
-      }
-
-      uint dst_vert_a = we->vert_a;
-      uint dst_vert_b = we->vert_b;
-
-      struct WeldGroup *link_a = &v_links[dst_vert_a];
-      struct WeldGroup *link_b = &v_links[dst_vert_b];
-
-      uint edges_len_a = link_a->len;
-      uint edges_len_b = link_b->len;
-
-      if (edges_len_a <= 1 || edges_len_b <= 1) {
-        continue;
-      }
-
-      uint *edges_ctx_a = &link_edge_buffer[link_a->ofs];
-      uint *edges_ctx_b = &link_edge_buffer[link_b->ofs];
-      uint edge_orig = we->edge_orig;
+    struct WeldEdgeOverlapData data = {
+        .v_links = v_links,
+        .link_edge_buffer = link_edge_buffer,
+        .edge_dest_map = r_edge_dest_map,
+        .wedge = r_wedge,
+    };
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.use_threading = (wedge_len > 10000);
+    settings.min_iter_per_thread = 1024;
+    BLI_task_parallel_range(0, (int)wedge_len, &data, weld_edge_overlap_cb, &settings);
 
-      for (; edges_len_a--; edges_ctx_a++) {
-        uint e_ctx_a = *edges_ctx_a;
-        if (e_ctx_a == i) {
-          continue;
-        }
-        while (edges_len_b && *edges_ctx_b < e_ctx_a) {
-          edges_ctx_b++;
-          edges_len_b--;
-        }
-        if (edges_len_b == 0) {
-          break;
-        }
-        uint e_ctx_b = *edges_ctx_b;
-        if (e_ctx_a == e_ctx_b) {
-          WeldEdge *we_b = &r_wedge[e_ctx_b];
-          BLI_assert(ELEM(we_b->vert_a, dst_vert_a, dst_vert_b));
-          BLI_assert(ELEM(we_b->vert_b, dst_vert_a, dst_vert_b));
-          BLI_assert(we_b->edge_dest == OUT_OF_CONTEXT);
-          BLI_assert(we_b->edge_orig != edge_orig);
-          r_edge_dest_map[we_b->edge_orig] = edge_orig;
-          we_b->edge_dest = edge_orig;
-          edge_kill_len++;
-        }
+    we = &r_wedge[0];
+    for (uint i = wedge_len; i--; we++) {
+      if (!ELEM(we->edge_dest, OUT_OF_CONTEXT, ELEM_COLLAPSED)) {
+        edge_kill_len++;
       }
     }
 
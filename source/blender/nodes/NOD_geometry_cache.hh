@@ -0,0 +1,246 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup nodes
+ *
+ * The geometry nodes cache keeps the outputs of executed nodes across evaluations of a node tree.
+ * When a node is about to be executed again with the same inputs and settings, the cached outputs
+ * are used instead, and the nodes that only compute its inputs don't have to be executed either.
+ *
+ * Cache entries are identified by a key that is computed from everything the outputs of a node
+ * depend on: the node type, its settings, and the keys of the nodes linked to its inputs. The
+ * values that enter the node tree from outside (the modifier geometry and the group inputs) are
+ * hashed by content. That way entries stay valid when unrelated data changes, and results computed
+ * for an earlier frame are found again when its inputs are the same. Besides the hash, a key
+ * stores the identities of the node and its inputs and the node settings, which are compared on
+ * lookup. Values linked to the inputs are only represented by their 64 bit hashes.
+ *
+ * Only nodes that were slow in an earlier evaluation get a key, so that the input geometry is not
+ * hashed when there is nothing worth caching.
+ *
+ * Values whose content cannot be hashed (e.g. objects, whose evaluated state is not part of the
+ * value) make the nodes that use them uncacheable, see #hash_socket_value. The same is true for
+ * nodes that reference an ID directly, see #node_supports_caching.
+ */
+
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "BLI_map.hh"
+#include "BLI_set.hh"
+#include "BLI_string_ref.hh"
+#include "BLI_utility_mixins.hh"
+#include "BLI_vector.hh"
+
+#include "BKE_node_ui_storage.hh"
+
+#include "FN_cpp_type.hh"
+#include "FN_generic_pointer.hh"
+
+struct GeometrySet;
+struct bNode;
+
+namespace blender::nodes {
+
+using fn::CPPType;
+using fn::GMutablePointer;
+
+/**
+ * Builds a hash from a sequence of values. The order of the values matters.
+ */
+class CacheKeyBuilder {
+ private:
+  uint64_t hash_ = 0x2545f4914f6cdd1dull;
+
+ public:
+  void add(const uint64_t value)
+  {
+    hash_ = mix(hash_ ^ mix(value + 0x9e3779b97f4a7c15ull));
+  }
+
+  void add(const StringRef str)
+  {
+    this->add(static_cast<uint64_t>(str.size()));
+    this->add_bytes(str.data(), str.size());
+  }
+
+  void add_bytes(const void *data, int64_t size);
+
+  uint64_t get() const
+  {
+    return hash_;
+  }
+
+ private:
+  /* The finalizer of SplitMix64. */
+  static uint64_t mix(uint64_t value)
+  {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+  }
+};
+
+/**
+ * Identifies the cache entry of a node. Keys are compared by their full data, the hash is only
+ * used to find candidates.
+ */
+class CacheKey {
+ private:
+  CacheKeyBuilder hash_builder_;
+  std::string data_;
+
+ public:
+  void add(const uint64_t value)
+  {
+    hash_builder_.add(value);
+    data_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  void add(const StringRef str)
+  {
+    this->add(static_cast<uint64_t>(str.size()));
+    data_.append(str.data(), static_cast<size_t>(str.size()));
+  }
+
+  /** The bytes are stored in the key, so this should only be used for small data. */
+  void add_bytes(const void *data, const int64_t size)
+  {
+    hash_builder_.add_bytes(data, size);
+    data_.append(static_cast<const char *>(data), static_cast<size_t>(size));
+  }
+
+  uint64_t hash() const
+  {
+    return hash_builder_.get();
+  }
+
+  int64_t memory_size() const
+  {
+    return static_cast<int64_t>(sizeof(CacheKey) + data_.size());
+  }
+
+  friend bool operator==(const CacheKey &a, const CacheKey &b)
+  {
+    return a.hash() == b.hash() && a.data_ == b.data_;
+  }
+};
+
+/**
+ * Hash of a value that is passed between nodes, based on its content. Nothing is returned when
+ * the value depends on data that is not part of the value itself, like the evaluated state of an
+ * object, or when hashing the content is not supported.
+ */
+std::optional<uint64_t> hash_socket_value(const CPPType &type, const void *value);
+
+/**
+ * Returns false when the outputs of the node depend on data that is not part of its key. This is
+ * the case for nodes that reference an ID (e.g. the texture of the Attribute Sample Texture node),
+ * because the ID and the data it uses can change without the node changing.
+ */
+bool node_supports_caching(const bNode &node);
+
+class GeometryNodesCache : NonCopyable, NonMovable {
+ public:
+  /**
+   * The outputs of a node execution, together with the information that would be lost if the node
+   * is not executed again.
+   */
+  class Entry : NonCopyable, NonMovable {
+   private:
+    /** The values are owned by the entry, they are never modified. */
+    Vector<std::pair<std::string, GMutablePointer>> outputs_;
+    int64_t memory_size_ = 0;
+
+   public:
+    Vector<NodeWarning> warnings;
+    Vector<std::string> attribute_hints;
+
+    ~Entry();
+
+    /**
+     * Add a copy of the output value. Returns false when the value cannot be cached, e.g. because
+     * it references objects that might change independently.
+     */
+    bool add_output(StringRef identifier, const CPPType &type, const void *value);
+
+    /** Returns null when the output has not been cached. */
+    const GMutablePointer *lookup_output(StringRef identifier) const;
+
+    int64_t memory_size() const
+    {
+      return memory_size_;
+    }
+  };
+
+  /** Budget of a single cache, the least recently used entries are removed to stay below it. */
+  static constexpr int64_t default_memory_budget = 512ll * 1024ll * 1024ll;
+  /**
+   * Nodes that are faster than this (in seconds) are not cached. Storing their outputs would not
+   * save time, and shared geometry in the cache has to be copied before it can be modified.
+   */
+  static constexpr double min_execution_time = 0.001;
+
+ private:
+  struct StoredEntry {
+    std::shared_ptr<const Entry> entry;
+    uint64_t last_use;
+    /** Size of the entry and the key. */
+    int64_t memory_size;
+  };
+
+  std::mutex mutex_;
+  Map<CacheKey, StoredEntry> entries_;
+  /** Identities of the nodes that took at least #min_execution_time in an earlier evaluation. */
+  Set<std::string> slow_nodes_;
+  int64_t memory_budget_;
+  int64_t memory_used_ = 0;
+  uint64_t use_counter_ = 0;
+
+ public:
+  GeometryNodesCache(int64_t memory_budget = default_memory_budget);
+
+  /**
+   * Returns null when there is no entry for the key. The returned entry stays valid even if it is
+   * removed from the cache in the mean time.
+   */
+  std::shared_ptr<const Entry> lookup(const CacheKey &key);
+
+  /** Add an entry, unless another entry has been added for the same key already. */
+  void add(CacheKey key, std::unique_ptr<Entry> entry);
+
+  /**
+   * Remember that a node without a key was slow, so that it gets a key in the next evaluation.
+   * The identity has to be stable across evaluations, e.g. the path of node names.
+   */
+  void tag_slow_node(StringRef node_identity);
+  bool is_slow_node(StringRef node_identity);
+  bool has_slow_nodes();
+
+  void clear();
+
+  int64_t size();
+  int64_t memory_used();
+
+ private:
+  void remove_least_recently_used();
+};
+
+}  // namespace blender::nodes
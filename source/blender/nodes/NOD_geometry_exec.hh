@@ -33,6 +33,7 @@ struct ModifierData;
 
 namespace blender::nodes {
 
+using bke::attribute_devirtualize;
 using bke::BooleanReadAttribute;
 using bke::BooleanWriteAttribute;
 using bke::Color4fReadAttribute;
@@ -66,6 +67,10 @@ class GeoNodeExecParams {
   const Object *self_object_;
   const ModifierData *modifier_;
   Depsgraph *depsgraph_;
+  Span<StringRef> required_outputs_;
+  Vector<StringRef> *r_requested_inputs_;
+  /* Warnings are also added here when it is not null, so that they can be cached. */
+  Vector<NodeWarning> *r_warnings_;
 
  public:
   GeoNodeExecParams(const DNode node,
@@ -74,17 +79,51 @@ class GeoNodeExecParams {
                     const PersistentDataHandleMap &handle_map,
                     const Object *self_object,
                     const ModifierData *modifier,
-                    Depsgraph *depsgraph)
+                    Depsgraph *depsgraph,
+                    Span<StringRef> required_outputs,
+                    Vector<StringRef> *r_requested_inputs,
+                    Vector<NodeWarning> *r_warnings = nullptr)
       : node_(node),
         input_values_(input_values),
         output_values_(output_values),
         handle_map_(handle_map),
         self_object_(self_object),
         modifier_(modifier),
-        depsgraph_(depsgraph)
+        depsgraph_(depsgraph),
+        required_outputs_(required_outputs),
+        r_requested_inputs_(r_requested_inputs),
+        r_warnings_(r_warnings)
   {
   }
 
+  /**
+   * Request the value of an input in a node that sets
+   * #bNodeType::geometry_node_execute_supports_laziness. Returns true when the value is not
+   * available yet. In that case the node has to return without setting any outputs, it is executed
+   * again once the requested inputs have been computed.
+   *
+   * Since the node can be executed more than once, inputs must not be extracted before all the
+   * inputs that are needed are available.
+   */
+  bool lazy_require_input(StringRef identifier)
+  {
+    BLI_assert(node_->bnode()->typeinfo->geometry_node_execute_supports_laziness);
+    if (input_values_.contains(identifier)) {
+      return false;
+    }
+    r_requested_inputs_->append(identifier);
+    return true;
+  }
+
+  /**
+   * Returns false when the output is not used by any other node. The node does not have to
+   * compute it then.
+   */
+  bool output_is_required(StringRef identifier) const
+  {
+    return required_outputs_.contains(identifier);
+  }
+
   /**
    * Get the input value for the input socket with the given identifier.
    *
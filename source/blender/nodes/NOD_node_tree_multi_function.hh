@@ -413,6 +413,11 @@ class DataTypeConversions {
                const CPPType &to_type,
                const void *from_value,
                void *to_value) const;
+  void convert_n(const CPPType &from_type,
+                 const CPPType &to_type,
+                 const void *from_values,
+                 void *to_values,
+                 int64_t amount) const;
 };
 
 const DataTypeConversions &get_implicit_type_conversions();
@@ -0,0 +1,389 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_hash_mm2a.h"
+
+#include "DNA_customdata_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_node_types.h"
+#include "DNA_pointcloud_types.h"
+
+#include "BKE_customdata.h"
+#include "BKE_geometry_set.hh"
+#include "BKE_persistent_data_handle.hh"
+
+#include "NOD_geometry_cache.hh"
+
+namespace blender::nodes {
+
+void CacheKeyBuilder::add_bytes(const void *data, const int64_t size)
+{
+  /* Two 32 bit hashes with different seeds, to make collisions less likely. */
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  const uint32_t low = BLI_hash_mm2(bytes, static_cast<size_t>(size), (uint32_t)hash_);
+  const uint32_t high = BLI_hash_mm2(bytes, static_cast<size_t>(size), (uint32_t)(hash_ >> 32));
+  this->add((static_cast<uint64_t>(high) << 32) | low);
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Geometry Hashing
+ * \{ */
+
+/* Returns false when a layer contains data that can't be hashed. */
+static bool hash_custom_data(const CustomData &data, const int size, CacheKeyBuilder &key)
+{
+  key.add(static_cast<uint64_t>(size));
+  key.add(static_cast<uint64_t>(data.totlayer));
+  for (const int i : IndexRange(data.totlayer)) {
+    const CustomDataLayer &layer = data.layers[i];
+    key.add(static_cast<uint64_t>(layer.type));
+    key.add(layer.name);
+    key.add(static_cast<uint64_t>(layer.active) | (static_cast<uint64_t>(layer.active_rnd) << 32));
+    if (layer.data == nullptr) {
+      continue;
+    }
+    if (layer.type == CD_MDEFORMVERT) {
+      const MDeformVert *dverts = static_cast<const MDeformVert *>(layer.data);
+      for (const int j : IndexRange(size)) {
+        key.add(static_cast<uint64_t>(dverts[j].totweight));
+        if (dverts[j].dw != nullptr) {
+          key.add_bytes(dverts[j].dw, sizeof(MDeformWeight) * dverts[j].totweight);
+        }
+      }
+    }
+    else if (CustomData_layertype_is_dynamic(layer.type)) {
+      /* Other layers with pointers are not supported. */
+      return false;
+    }
+    else {
+      key.add_bytes(layer.data, static_cast<int64_t>(CustomData_sizeof(layer.type)) * size);
+    }
+  }
+  return true;
+}
+
+static int64_t custom_data_memory_size(const CustomData &data, const int size)
+{
+  int64_t memory_size = 0;
+  for (const int i : IndexRange(data.totlayer)) {
+    const CustomDataLayer &layer = data.layers[i];
+    memory_size += static_cast<int64_t>(CustomData_sizeof(layer.type)) * size;
+    if (layer.type == CD_MDEFORMVERT && layer.data != nullptr) {
+      const MDeformVert *dverts = static_cast<const MDeformVert *>(layer.data);
+      for (const int j : IndexRange(size)) {
+        memory_size += sizeof(MDeformWeight) * dverts[j].totweight;
+      }
+    }
+  }
+  return memory_size;
+}
+
+static bool hash_mesh_component(const MeshComponent &component, CacheKeyBuilder &key)
+{
+  const Mesh *mesh = component.get_for_read();
+  if (mesh == nullptr) {
+    key.add(static_cast<uint64_t>(0));
+    return true;
+  }
+  if (mesh->runtime.wrapper_type != ME_WRAPPER_TYPE_MDATA) {
+    return false;
+  }
+  if (!hash_custom_data(mesh->vdata, mesh->totvert, key) ||
+      !hash_custom_data(mesh->edata, mesh->totedge, key) ||
+      !hash_custom_data(mesh->fdata, mesh->totface, key) ||
+      !hash_custom_data(mesh->ldata, mesh->totloop, key) ||
+      !hash_custom_data(mesh->pdata, mesh->totpoly, key)) {
+    return false;
+  }
+  key.add(static_cast<uint64_t>(mesh->flag));
+  key.add_bytes(&mesh->smoothresh, sizeof(float));
+  key.add(static_cast<uint64_t>(mesh->totcol));
+  if (mesh->mat != nullptr) {
+    key.add_bytes(mesh->mat, sizeof(*mesh->mat) * mesh->totcol);
+  }
+  /* The order of the names in the map is arbitrary, so their hashes are combined with a sum. */
+  uint64_t vertex_group_names_hash = 0;
+  for (const auto item : component.vertex_group_names().items()) {
+    CacheKeyBuilder name_key;
+    name_key.add(item.key);
+    name_key.add(static_cast<uint64_t>(item.value));
+    vertex_group_names_hash += name_key.get();
+  }
+  key.add(vertex_group_names_hash);
+  return true;
+}
+
+static bool hash_pointcloud_component(const PointCloudComponent &component,
+                                      CacheKeyBuilder &key)
+{
+  const PointCloud *pointcloud = component.get_for_read();
+  if (pointcloud == nullptr) {
+    key.add(static_cast<uint64_t>(0));
+    return true;
+  }
+  if (!hash_custom_data(pointcloud->pdata, pointcloud->totpoint, key)) {
+    return false;
+  }
+  key.add(static_cast<uint64_t>(pointcloud->totcol));
+  if (pointcloud->mat != nullptr) {
+    key.add_bytes(pointcloud->mat, sizeof(*pointcloud->mat) * pointcloud->totcol);
+  }
+  return true;
+}
+
+static std::optional<uint64_t> hash_geometry_set(const GeometrySet &geometry_set)
+{
+  CacheKeyBuilder key;
+  /* Instances reference objects that can change without the geometry changing, and volume grids
+   * are too large to be hashed. */
+  if (geometry_set.has<InstancesComponent>() || geometry_set.has<VolumeComponent>()) {
+    return std::nullopt;
+  }
+  const MeshComponent *mesh_component = geometry_set.get_component_for_read<MeshComponent>();
+  if (mesh_component != nullptr) {
+    key.add(GEO_COMPONENT_TYPE_MESH);
+    if (!hash_mesh_component(*mesh_component, key)) {
+      return std::nullopt;
+    }
+  }
+  const PointCloudComponent *pointcloud_component =
+      geometry_set.get_component_for_read<PointCloudComponent>();
+  if (pointcloud_component != nullptr) {
+    key.add(GEO_COMPONENT_TYPE_POINT_CLOUD);
+    if (!hash_pointcloud_component(*pointcloud_component, key)) {
+      return std::nullopt;
+    }
+  }
+  return key.get();
+}
+
+/* Returns nothing for geometry that is not cached. */
+static std::optional<int64_t> geometry_set_memory_size(const GeometrySet &geometry_set)
+{
+  if (geometry_set.has<InstancesComponent>() || geometry_set.has<VolumeComponent>()) {
+    return std::nullopt;
+  }
+  int64_t memory_size = sizeof(GeometrySet);
+  const Mesh *mesh = geometry_set.get_mesh_for_read();
+  if (mesh != nullptr) {
+    memory_size += sizeof(Mesh);
+    memory_size += custom_data_memory_size(mesh->vdata, mesh->totvert);
+    memory_size += custom_data_memory_size(mesh->edata, mesh->totedge);
+    memory_size += custom_data_memory_size(mesh->fdata, mesh->totface);
+    memory_size += custom_data_memory_size(mesh->ldata, mesh->totloop);
+    memory_size += custom_data_memory_size(mesh->pdata, mesh->totpoly);
+  }
+  const PointCloud *pointcloud = geometry_set.get_pointcloud_for_read();
+  if (pointcloud != nullptr) {
+    memory_size += sizeof(PointCloud);
+    memory_size += custom_data_memory_size(pointcloud->pdata, pointcloud->totpoint);
+  }
+  return memory_size;
+}
+
+/** \} */
+
+std::optional<uint64_t> hash_socket_value(const CPPType &type, const void *value)
+{
+  std::optional<uint64_t> value_hash;
+  if (type.is<GeometrySet>()) {
+    value_hash = hash_geometry_set(*static_cast<const GeometrySet *>(value));
+  }
+  else if (type.is<bke::PersistentObjectHandle>() ||
+           type.is<bke::PersistentCollectionHandle>()) {
+    /* The handles are only valid for one evaluation, and the referenced data can change. */
+    return std::nullopt;
+  }
+  else {
+    value_hash = type.hash(value);
+  }
+  if (!value_hash) {
+    return std::nullopt;
+  }
+  CacheKeyBuilder key;
+  key.add(type.name());
+  key.add(*value_hash);
+  return key.get();
+}
+
+bool node_supports_caching(const bNode &node)
+{
+  return node.id == nullptr;
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Cache Entry
+ * \{ */
+
+GeometryNodesCache::Entry::~Entry()
+{
+  for (std::pair<std::string, GMutablePointer> &item : outputs_) {
+    item.second.destruct();
+    MEM_freeN(item.second.get());
+  }
+}
+
+bool GeometryNodesCache::Entry::add_output(const StringRef identifier,
+                                           const CPPType &type,
+                                           const void *value)
+{
+  int64_t value_size = type.size();
+  if (type.is<GeometrySet>()) {
+    const std::optional<int64_t> geometry_size = geometry_set_memory_size(
+        *static_cast<const GeometrySet *>(value));
+    if (!geometry_size) {
+      return false;
+    }
+    value_size = *geometry_size;
+  }
+  else if (type.is<bke::PersistentObjectHandle>() ||
+           type.is<bke::PersistentCollectionHandle>()) {
+    return false;
+  }
+
+  void *buffer = MEM_mallocN_aligned(type.size(), type.alignment(), __func__);
+  type.copy_to_uninitialized(value, buffer);
+  if (type.is<GeometrySet>()) {
+    /* The geometry might reference data that is freed after the evaluation, e.g. the mesh passed
+     * to the modifier. Also, the geometry is shared with the evaluation, so it would be copied
+     * anyway when it is modified later on. */
+    static_cast<GeometrySet *>(buffer)->ensure_owns_direct_data();
+  }
+  outputs_.append({identifier, {type, buffer}});
+  memory_size_ += value_size;
+  return true;
+}
+
+const GMutablePointer *GeometryNodesCache::Entry::lookup_output(const StringRef identifier) const
+{
+  for (const std::pair<std::string, GMutablePointer> &item : outputs_) {
+    if (item.first == identifier) {
+      return &item.second;
+    }
+  }
+  return nullptr;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Cache
+ * \{ */
+
+GeometryNodesCache::GeometryNodesCache(const int64_t memory_budget)
+    : memory_budget_(memory_budget)
+{
+}
+
+std::shared_ptr<const GeometryNodesCache::Entry> GeometryNodesCache::lookup(const CacheKey &key)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  StoredEntry *stored_entry = entries_.lookup_ptr(key);
+  if (stored_entry == nullptr) {
+    return {};
+  }
+  stored_entry->last_use = ++use_counter_;
+  return stored_entry->entry;
+}
+
+void GeometryNodesCache::add(CacheKey key, std::unique_ptr<Entry> entry)
+{
+  const int64_t memory_size = entry->memory_size() + key.memory_size();
+  if (memory_size > memory_budget_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool added = entries_.add(std::move(key), {std::move(entry), ++use_counter_, memory_size});
+  if (!added) {
+    return;
+  }
+  memory_used_ += memory_size;
+  if (memory_used_ > memory_budget_) {
+    this->remove_least_recently_used();
+  }
+}
+
+/* The caller has to lock the mutex. */
+void GeometryNodesCache::remove_least_recently_used()
+{
+  Vector<std::pair<uint64_t, const CacheKey *>> last_use_and_key;
+  for (const auto item : entries_.items()) {
+    last_use_and_key.append({item.value.last_use, &item.key});
+  }
+  std::sort(last_use_and_key.begin(),
+            last_use_and_key.end(),
+            [](const std::pair<uint64_t, const CacheKey *> &a,
+               const std::pair<uint64_t, const CacheKey *> &b) { return a.first < b.first; });
+  /* The keys are removed after sorting, because removing them invalidates the pointers. */
+  Vector<CacheKey> keys_to_remove;
+  int64_t memory_used = memory_used_;
+  for (const std::pair<uint64_t, const CacheKey *> &item : last_use_and_key) {
+    if (memory_used <= memory_budget_) {
+      break;
+    }
+    memory_used -= entries_.lookup(*item.second).memory_size;
+    keys_to_remove.append(*item.second);
+  }
+  for (const CacheKey &key : keys_to_remove) {
+    entries_.remove_contained(key);
+  }
+  memory_used_ = memory_used;
+}
+
+void GeometryNodesCache::tag_slow_node(const StringRef node_identity)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  slow_nodes_.add_as(node_identity);
+}
+
+bool GeometryNodesCache::is_slow_node(const StringRef node_identity)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return slow_nodes_.contains_as(node_identity);
+}
+
+bool GeometryNodesCache::has_slow_nodes()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !slow_nodes_.is_empty();
+}
+
+void GeometryNodesCache::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  slow_nodes_.clear();
+  memory_used_ = 0;
+}
+
+int64_t GeometryNodesCache::size()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+int64_t GeometryNodesCache::memory_used()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return memory_used_;
+}
+
+/** \} */
+
+}  // namespace blender::nodes
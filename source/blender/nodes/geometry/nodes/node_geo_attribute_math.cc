@@ -175,8 +175,10 @@ static void do_math_operation(Span<float> span_a,
   UNUSED_VARS_NDEBUG(success);
 }
 
-static void do_math_operation(Span<float> span_a,
-                              Span<float> span_b,
+/* The inputs are passed with the types given by #attribute_devirtualize. */
+template<typename InputA, typename InputB>
+static void do_math_operation(const InputA &span_a,
+                              const InputB &span_b,
                               MutableSpan<float> span_result,
                               const NodeMathOperation operation)
 {
@@ -190,7 +192,8 @@ static void do_math_operation(Span<float> span_a,
   UNUSED_VARS_NDEBUG(success);
 }
 
-static void do_math_operation(Span<float> span_input,
+template<typename Input>
+static void do_math_operation(const Input &span_input,
                               MutableSpan<float> span_result,
                               const NodeMathOperation operation)
 {
@@ -250,7 +253,7 @@ static void attribute_math_calc(GeometryComponent &component, const GeoNodeExecP
     return;
   }
 
-  /* Note that passing the data with `get_span<float>()` works
+  /* Note that accessing the data as float works
    * because the attributes were accessed with #CD_PROP_FLOAT. */
   if (operation_use_input_b(operation)) {
     ReadAttributePtr attribute_b = params.get_input_attribute(
@@ -271,16 +274,19 @@ static void attribute_math_calc(GeometryComponent &component, const GeoNodeExecP
                         operation);
     }
     else {
-      do_math_operation(attribute_a->get_span<float>(),
-                        attribute_b->get_span<float>(),
-                        attribute_result->get_span_for_write_only<float>(),
-                        operation);
+      MutableSpan<float> result_span = attribute_result->get_span_for_write_only<float>();
+      attribute_devirtualize<float>(*attribute_a, [&](const auto &span_a) {
+        attribute_devirtualize<float>(*attribute_b, [&](const auto &span_b) {
+          do_math_operation(span_a, span_b, result_span, operation);
+        });
+      });
     }
   }
   else {
-    do_math_operation(attribute_a->get_span<float>(),
-                      attribute_result->get_span_for_write_only<float>(),
-                      operation);
+    MutableSpan<float> result_span = attribute_result->get_span_for_write_only<float>();
+    attribute_devirtualize<float>(*attribute_a, [&](const auto &span_input) {
+      do_math_operation(span_input, result_span, operation);
+    });
   }
 
   attribute_result.apply_span_and_save();
@@ -113,8 +113,6 @@ static Mesh *mesh_boolean_calc(const Mesh *mesh_a, const Mesh *mesh_b, int boole
 namespace blender::nodes {
 static void geo_node_boolean_exec(GeoNodeExecParams params)
 {
-  GeometrySet geometry_set_in_a = params.extract_input<GeometrySet>("Geometry 1");
-  GeometrySet geometry_set_in_b = params.extract_input<GeometrySet>("Geometry 2");
   GeometrySet geometry_set_out;
 
   GeometryNodeBooleanOperation operation = (GeometryNodeBooleanOperation)params.node().custom1;
@@ -124,6 +122,25 @@ static void geo_node_boolean_exec(GeoNodeExecParams params)
     return;
   }
 
+  if (params.lazy_require_input("Geometry 1")) {
+    return;
+  }
+  /* The result of a difference or intersection with an empty first geometry does not depend on
+   * the second geometry, so it does not have to be computed. */
+  if (operation != GEO_NODE_BOOLEAN_UNION) {
+    const GeometrySet &geometry_set_in_a = params.get_input<GeometrySet>("Geometry 1");
+    if (!geometry_set_in_a.has_mesh() && !geometry_set_in_a.has_instances()) {
+      params.set_output("Geometry", params.extract_input<GeometrySet>("Geometry 1"));
+      return;
+    }
+  }
+  if (params.lazy_require_input("Geometry 2")) {
+    return;
+  }
+
+  GeometrySet geometry_set_in_a = params.extract_input<GeometrySet>("Geometry 1");
+  GeometrySet geometry_set_in_b = params.extract_input<GeometrySet>("Geometry 2");
+
   /* TODO: Boolean does support an input of multiple meshes. Currently they must all be
    * converted to BMesh before running the operation though. D9957 will make it possible
    * to use the mesh structure directly. */
@@ -163,5 +180,6 @@ void register_node_type_geo_boolean()
   node_type_socket_templates(&ntype, geo_node_boolean_in, geo_node_boolean_out);
   ntype.draw_buttons = geo_node_boolean_layout;
   ntype.geometry_node_execute = blender::nodes::geo_node_boolean_exec;
+  ntype.geometry_node_execute_supports_laziness = true;
   nodeRegisterType(&ntype);
 }
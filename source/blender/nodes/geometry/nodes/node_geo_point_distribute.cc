@@ -16,10 +16,9 @@
 
 #include "BLI_float3.hh"
 #include "BLI_hash.h"
-#include "BLI_kdtree.h"
 #include "BLI_math_vector.h"
-#include "BLI_rand.hh"
 #include "BLI_span.hh"
+#include "BLI_task.hh"
 #include "BLI_timeit.hh"
 
 #include "DNA_mesh_types.h"
@@ -32,6 +31,7 @@
 #include "BKE_geometry_set_instances.hh"
 #include "BKE_mesh.h"
 #include "BKE_mesh_runtime.h"
+#include "BKE_mesh_sample.hh"
 #include "BKE_pointcloud.h"
 
 #include "UI_interface.h"
@@ -92,151 +92,41 @@ static Span<MLoopTri> get_mesh_looptris(const Mesh &mesh)
   return {looptris, looptris_len};
 }
 
-static void sample_mesh_surface(const Mesh &mesh,
-                                const float4x4 &transform,
-                                const float base_density,
-                                const FloatReadAttribute *density_factors,
-                                const int seed,
-                                Vector<float3> &r_positions,
-                                Vector<float3> &r_bary_coords,
-                                Vector<int> &r_looptri_indices)
-{
-  Span<MLoopTri> looptris = get_mesh_looptris(mesh);
-
-  for (const int looptri_index : looptris.index_range()) {
-    const MLoopTri &looptri = looptris[looptri_index];
-    const int v0_loop = looptri.tri[0];
-    const int v1_loop = looptri.tri[1];
-    const int v2_loop = looptri.tri[2];
-    const int v0_index = mesh.mloop[v0_loop].v;
-    const int v1_index = mesh.mloop[v1_loop].v;
-    const int v2_index = mesh.mloop[v2_loop].v;
-    const float3 v0_pos = transform * float3(mesh.mvert[v0_index].co);
-    const float3 v1_pos = transform * float3(mesh.mvert[v1_index].co);
-    const float3 v2_pos = transform * float3(mesh.mvert[v2_index].co);
-
-    float looptri_density_factor = 1.0f;
-    if (density_factors != nullptr) {
-      const float v0_density_factor = std::max(0.0f, (*density_factors)[v0_loop]);
-      const float v1_density_factor = std::max(0.0f, (*density_factors)[v1_loop]);
-      const float v2_density_factor = std::max(0.0f, (*density_factors)[v2_loop]);
-      looptri_density_factor = (v0_density_factor + v1_density_factor + v2_density_factor) / 3.0f;
-    }
-    const float area = area_tri_v3(v0_pos, v1_pos, v2_pos);
-
-    const int looptri_seed = BLI_hash_int(looptri_index + seed);
-    RandomNumberGenerator looptri_rng(looptri_seed);
-
-    const float points_amount_fl = area * base_density * looptri_density_factor;
-    const float add_point_probability = fractf(points_amount_fl);
-    const bool add_point = add_point_probability > looptri_rng.get_float();
-    const int point_amount = (int)points_amount_fl + (int)add_point;
-
-    for (int i = 0; i < point_amount; i++) {
-      const float3 bary_coord = looptri_rng.get_barycentric_coordinates();
-      float3 point_pos;
-      interp_v3_v3v3v3(point_pos, v0_pos, v1_pos, v2_pos, bary_coord);
-      r_positions.append(point_pos);
-      r_bary_coords.append(bary_coord);
-      r_looptri_indices.append(looptri_index);
-    }
-  }
-}
-
-BLI_NOINLINE static KDTree_3d *build_kdtree(Span<Vector<float3>> positions_all,
-                                            const int initial_points_len)
-{
-  KDTree_3d *kdtree = BLI_kdtree_3d_new(initial_points_len);
-
-  int i_point = 0;
-  for (const Vector<float3> &positions : positions_all) {
-    for (const float3 position : positions) {
-      BLI_kdtree_3d_insert(kdtree, i_point, position);
-      i_point++;
-    }
-  }
-  BLI_kdtree_3d_balance(kdtree);
-  return kdtree;
-}
-
-BLI_NOINLINE static void update_elimination_mask_for_close_points(
-    Span<Vector<float3>> positions_all,
-    Span<int> instance_start_offsets,
-    const float minimum_distance,
-    MutableSpan<bool> elimination_mask,
-    const int initial_points_len)
-{
-  if (minimum_distance <= 0.0f) {
-    return;
-  }
-
-  KDTree_3d *kdtree = build_kdtree(positions_all, initial_points_len);
-
-  /* The elimination mask is a flattened array for every point,
-   * so keep track of the index to it separately. */
-  for (const int i_instance : positions_all.index_range()) {
-    Span<float3> positions = positions_all[i_instance];
-    const int offset = instance_start_offsets[i_instance];
-
-    for (const int i : positions.index_range()) {
-      if (elimination_mask[offset + i]) {
-        continue;
-      }
-
-      struct CallbackData {
-        int index;
-        MutableSpan<bool> elimination_mask;
-      } callback_data = {offset + i, elimination_mask};
-
-      BLI_kdtree_3d_range_search_cb(
-          kdtree,
-          positions[i],
-          minimum_distance,
-          [](void *user_data, int index, const float *UNUSED(co), float UNUSED(dist_sq)) {
-            CallbackData &callback_data = *static_cast<CallbackData *>(user_data);
-            if (index != callback_data.index) {
-              callback_data.elimination_mask[index] = true;
-            }
-            return true;
-          },
-          &callback_data);
-    }
-  }
-  BLI_kdtree_3d_free(kdtree);
-}
-
 BLI_NOINLINE static void update_elimination_mask_based_on_density_factors(
     const Mesh &mesh,
-    const FloatReadAttribute &density_factors,
+    const Span<float> density_factors,
     Span<float3> bary_coords,
     Span<int> looptri_indices,
     MutableSpan<bool> elimination_mask)
 {
   Span<MLoopTri> looptris = get_mesh_looptris(mesh);
-  for (const int i : bary_coords.index_range()) {
-    if (elimination_mask[i]) {
-      continue;
-    }
+  parallel_for(bary_coords.index_range(), 2048, [&](IndexRange range) {
+    for (const int i : range) {
+      if (elimination_mask[i]) {
+        continue;
+      }
 
-    const MLoopTri &looptri = looptris[looptri_indices[i]];
-    const float3 bary_coord = bary_coords[i];
+      const MLoopTri &looptri = looptris[looptri_indices[i]];
+      const float3 bary_coord = bary_coords[i];
 
-    const int v0_loop = looptri.tri[0];
-    const int v1_loop = looptri.tri[1];
-    const int v2_loop = looptri.tri[2];
+      const int v0_loop = looptri.tri[0];
+      const int v1_loop = looptri.tri[1];
+      const int v2_loop = looptri.tri[2];
 
-    const float v0_density_factor = std::max(0.0f, density_factors[v0_loop]);
-    const float v1_density_factor = std::max(0.0f, density_factors[v1_loop]);
-    const float v2_density_factor = std::max(0.0f, density_factors[v2_loop]);
+      const float v0_density_factor = std::max(0.0f, density_factors[v0_loop]);
+      const float v1_density_factor = std::max(0.0f, density_factors[v1_loop]);
+      const float v2_density_factor = std::max(0.0f, density_factors[v2_loop]);
 
-    const float probablity = v0_density_factor * bary_coord.x + v1_density_factor * bary_coord.y +
-                             v2_density_factor * bary_coord.z;
+      const float probablity = v0_density_factor * bary_coord.x +
+                               v1_density_factor * bary_coord.y +
+                               v2_density_factor * bary_coord.z;
 
-    const float hash = BLI_hash_int_01(bary_coord.hash());
-    if (hash > probablity) {
-      elimination_mask[i] = true;
+      const float hash = BLI_hash_int_01(bary_coord.hash());
+      if (hash > probablity) {
+        elimination_mask[i] = true;
+      }
     }
-  }
+  });
 }
 
 BLI_NOINLINE static void eliminate_points_based_on_mask(Span<bool> elimination_mask,
@@ -263,22 +153,24 @@ BLI_NOINLINE static void interpolate_attribute_point(const Mesh &mesh,
   BLI_assert(data_in.size() == mesh.totvert);
   Span<MLoopTri> looptris = get_mesh_looptris(mesh);
 
-  for (const int i : bary_coords.index_range()) {
-    const int looptri_index = looptri_indices[i];
-    const MLoopTri &looptri = looptris[looptri_index];
-    const float3 &bary_coord = bary_coords[i];
+  parallel_for(bary_coords.index_range(), 2048, [&](IndexRange range) {
+    for (const int i : range) {
+      const int looptri_index = looptri_indices[i];
+      const MLoopTri &looptri = looptris[looptri_index];
+      const float3 &bary_coord = bary_coords[i];
 
-    const int v0_index = mesh.mloop[looptri.tri[0]].v;
-    const int v1_index = mesh.mloop[looptri.tri[1]].v;
-    const int v2_index = mesh.mloop[looptri.tri[2]].v;
+      const int v0_index = mesh.mloop[looptri.tri[0]].v;
+      const int v1_index = mesh.mloop[looptri.tri[1]].v;
+      const int v2_index = mesh.mloop[looptri.tri[2]].v;
 
-    const T &v0 = data_in[v0_index];
-    const T &v1 = data_in[v1_index];
-    const T &v2 = data_in[v2_index];
+      const T &v0 = data_in[v0_index];
+      const T &v1 = data_in[v1_index];
+      const T &v2 = data_in[v2_index];
 
-    const T interpolated_value = attribute_math::mix3(bary_coord, v0, v1, v2);
-    data_out[i] = interpolated_value;
-  }
+      const T interpolated_value = attribute_math::mix3(bary_coord, v0, v1, v2);
+      data_out[i] = interpolated_value;
+    }
+  });
 }
 
 template<typename T>
@@ -291,22 +183,24 @@ BLI_NOINLINE static void interpolate_attribute_corner(const Mesh &mesh,
   BLI_assert(data_in.size() == mesh.totloop);
   Span<MLoopTri> looptris = get_mesh_looptris(mesh);
 
-  for (const int i : bary_coords.index_range()) {
-    const int looptri_index = looptri_indices[i];
-    const MLoopTri &looptri = looptris[looptri_index];
-    const float3 &bary_coord = bary_coords[i];
+  parallel_for(bary_coords.index_range(), 2048, [&](IndexRange range) {
+    for (const int i : range) {
+      const int looptri_index = looptri_indices[i];
+      const MLoopTri &looptri = looptris[looptri_index];
+      const float3 &bary_coord = bary_coords[i];
 
-    const int loop_index_0 = looptri.tri[0];
-    const int loop_index_1 = looptri.tri[1];
-    const int loop_index_2 = looptri.tri[2];
+      const int loop_index_0 = looptri.tri[0];
+      const int loop_index_1 = looptri.tri[1];
+      const int loop_index_2 = looptri.tri[2];
 
-    const T &v0 = data_in[loop_index_0];
-    const T &v1 = data_in[loop_index_1];
-    const T &v2 = data_in[loop_index_2];
+      const T &v0 = data_in[loop_index_0];
+      const T &v1 = data_in[loop_index_1];
+      const T &v2 = data_in[loop_index_2];
 
-    const T interpolated_value = attribute_math::mix3(bary_coord, v0, v1, v2);
-    data_out[i] = interpolated_value;
-  }
+      const T interpolated_value = attribute_math::mix3(bary_coord, v0, v1, v2);
+      data_out[i] = interpolated_value;
+    }
+  });
 }
 
 template<typename T>
@@ -318,12 +212,14 @@ BLI_NOINLINE static void interpolate_attribute_polygon(const Mesh &mesh,
   BLI_assert(data_in.size() == mesh.totpoly);
   Span<MLoopTri> looptris = get_mesh_looptris(mesh);
 
-  for (const int i : data_out.index_range()) {
-    const int looptri_index = looptri_indices[i];
-    const MLoopTri &looptri = looptris[looptri_index];
-    const int poly_index = looptri.poly;
-    data_out[i] = data_in[poly_index];
-  }
+  parallel_for(data_out.index_range(), 2048, [&](IndexRange range) {
+    for (const int i : range) {
+      const int looptri_index = looptri_indices[i];
+      const MLoopTri &looptri = looptris[looptri_index];
+      const int poly_index = looptri.poly;
+      data_out[i] = data_in[poly_index];
+    }
+  });
 }
 
 template<typename T>
@@ -462,23 +358,25 @@ BLI_NOINLINE static void compute_special_attributes(Span<GeometryInstanceGroup>
       float rotation_matrix[3][3];
       mat4_to_rot(rotation_matrix, transform.values);
 
-      for (const int i : bary_coords.index_range()) {
-        const int looptri_index = looptri_indices[i];
-        const MLoopTri &looptri = looptris[looptri_index];
-        const float3 &bary_coord = bary_coords[i];
-
-        const int v0_index = mesh.mloop[looptri.tri[0]].v;
-        const int v1_index = mesh.mloop[looptri.tri[1]].v;
-        const int v2_index = mesh.mloop[looptri.tri[2]].v;
-        const float3 v0_pos = float3(mesh.mvert[v0_index].co);
-        const float3 v1_pos = float3(mesh.mvert[v1_index].co);
-        const float3 v2_pos = float3(mesh.mvert[v2_index].co);
-
-        ids[i] = (int)(bary_coord.hash() + (uint64_t)looptri_index);
-        normal_tri_v3(normals[i], v0_pos, v1_pos, v2_pos);
-        mul_m3_v3(rotation_matrix, normals[i]);
-        rotations[i] = normal_to_euler_rotation(normals[i]);
-      }
+      parallel_for(bary_coords.index_range(), 2048, [&](IndexRange range) {
+        for (const int i : range) {
+          const int looptri_index = looptri_indices[i];
+          const MLoopTri &looptri = looptris[looptri_index];
+          const float3 &bary_coord = bary_coords[i];
+
+          const int v0_index = mesh.mloop[looptri.tri[0]].v;
+          const int v1_index = mesh.mloop[looptri.tri[1]].v;
+          const int v2_index = mesh.mloop[looptri.tri[2]].v;
+          const float3 v0_pos = float3(mesh.mvert[v0_index].co);
+          const float3 v1_pos = float3(mesh.mvert[v1_index].co);
+          const float3 v2_pos = float3(mesh.mvert[v2_index].co);
+
+          ids[i] = (int)(bary_coord.hash() + (uint64_t)looptri_index);
+          normal_tri_v3(normals[i], v0_pos, v1_pos, v2_pos);
+          mul_m3_v3(rotation_matrix, normals[i]);
+          rotations[i] = normal_to_euler_rotation(normals[i]);
+        }
+      });
 
       i_instance++;
     }
@@ -526,19 +424,20 @@ static void distribute_points_random(Span<GeometryInstanceGroup> set_groups,
     const MeshComponent &component = *set.get_component_for_read<MeshComponent>();
     const FloatReadAttribute density_factors = component.attribute_get_for_read<float>(
         density_attribute_name, ATTR_DOMAIN_CORNER, use_one_default ? 1.0f : 0.0f);
+    const Span<float> density_factors_span = density_factors.get_span();
     const Mesh &mesh = *component.get_for_read();
     for (const float4x4 &transform : set_group.transforms) {
       Vector<float3> &positions = positions_all[i_instance];
       Vector<float3> &bary_coords = bary_coords_all[i_instance];
       Vector<int> &looptri_indices = looptri_indices_all[i_instance];
-      sample_mesh_surface(mesh,
-                          transform,
-                          density,
-                          &density_factors,
-                          seed,
-                          positions,
-                          bary_coords,
-                          looptri_indices);
+      bke::mesh_surface_sample::sample_surface_random(mesh,
+                                                      transform,
+                                                      density,
+                                                      density_factors_span,
+                                                      seed,
+                                                      positions,
+                                                      bary_coords,
+                                                      looptri_indices);
       i_instance++;
     }
   }
@@ -564,8 +463,8 @@ static void distribute_points_poisson_disk(Span<GeometryInstanceGroup> set_group
       Vector<float3> &positions = positions_all[i_instance];
       Vector<float3> &bary_coords = bary_coords_all[i_instance];
       Vector<int> &looptri_indices = looptri_indices_all[i_instance];
-      sample_mesh_surface(
-          mesh, transform, density, nullptr, seed, positions, bary_coords, looptri_indices);
+      bke::mesh_surface_sample::sample_surface_random(
+          mesh, transform, density, {}, seed, positions, bary_coords, looptri_indices);
 
       instance_start_offsets[i_instance] = initial_points_len;
       initial_points_len += positions.size();
@@ -579,14 +478,18 @@ static void distribute_points_poisson_disk(Span<GeometryInstanceGroup> set_group
   const bool use_one_default = density_attribute_name.is_empty();
 
   /* Unlike the other result arrays, the elimination mask in stored as a flat array for every
-   * point, in order to simplify culling points from the KDTree (which needs to know about all
-   * points at once). */
+   * point, because points of all instances have to be checked against each other. */
   Array<bool> elimination_mask(initial_points_len, false);
-  update_elimination_mask_for_close_points(positions_all,
-                                           instance_start_offsets,
-                                           minimum_distance,
-                                           elimination_mask,
-                                           initial_points_len);
+  if (minimum_distance > 0.0f) {
+    Array<float3> initial_positions(initial_points_len);
+    for (const int i : positions_all.index_range()) {
+      initial_positions.as_mutable_span()
+          .slice(instance_start_offsets[i], positions_all[i].size())
+          .copy_from(positions_all[i]);
+    }
+    bke::mesh_surface_sample::eliminate_close_points(
+        initial_positions, minimum_distance, elimination_mask);
+  }
 
   i_instance = 0;
   for (const GeometryInstanceGroup &set_group : set_groups) {
@@ -595,6 +498,7 @@ static void distribute_points_poisson_disk(Span<GeometryInstanceGroup> set_group
     const Mesh &mesh = *component.get_for_read();
     const FloatReadAttribute density_factors = component.attribute_get_for_read<float>(
         density_attribute_name, ATTR_DOMAIN_CORNER, use_one_default ? 1.0f : 0.0f);
+    const Span<float> density_factors_span = density_factors.get_span();
 
     for (const int UNUSED(i_set_instance) : set_group.transforms.index_range()) {
       Vector<float3> &positions = positions_all[i_instance];
@@ -604,7 +508,7 @@ static void distribute_points_poisson_disk(Span<GeometryInstanceGroup> set_group
       const int offset = instance_start_offsets[i_instance];
       update_elimination_mask_based_on_density_factors(
           mesh,
-          density_factors,
+          density_factors_span,
           bary_coords,
           looptri_indices,
           elimination_mask.as_mutable_span().slice(offset, positions.size()));
@@ -694,7 +598,7 @@ static void geo_node_point_distribute_exec(GeoNodeExecParams params)
   }
 
   int final_points_len = 0;
-  Array<int> instance_start_offsets(set_groups.size());
+  Array<int> instance_start_offsets(positions_all.size());
   for (const int i : positions_all.index_range()) {
     Vector<float3> &positions = positions_all[i];
     instance_start_offsets[i] = final_points_len;
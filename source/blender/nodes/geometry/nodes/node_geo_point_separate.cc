@@ -39,8 +39,8 @@ static bNodeSocketTemplate geo_node_point_instance_out[] = {
 namespace blender::nodes {
 
 static void fill_new_attribute_from_input(const ReadAttribute &input_attribute,
-                                          WriteAttribute &out_attribute_a,
-                                          WriteAttribute &out_attribute_b,
+                                          WriteAttribute *out_attribute_a,
+                                          WriteAttribute *out_attribute_b,
                                           Span<bool> a_or_b)
 {
   fn::GSpan in_span = input_attribute.get_span();
@@ -49,25 +49,51 @@ static void fill_new_attribute_from_input(const ReadAttribute &input_attribute,
   for (int i_in = 0; i_in < in_span.size(); i_in++) {
     const bool move_to_b = a_or_b[i_in];
     if (move_to_b) {
-      out_attribute_b.set(i_b, in_span[i_in]);
+      if (out_attribute_b != nullptr) {
+        out_attribute_b->set(i_b, in_span[i_in]);
+      }
       i_b++;
     }
     else {
-      out_attribute_a.set(i_a, in_span[i_in]);
+      if (out_attribute_a != nullptr) {
+        out_attribute_a->set(i_a, in_span[i_in]);
+      }
       i_a++;
     }
   }
 }
 
 /**
- * Move the original attribute values to the two output components.
+ * Get the attribute on an output component for writing, it is created when necessary. Returns
+ * null when the attribute can't be created.
+ */
+static WriteAttributePtr split_attribute_get_for_write(GeometryComponent &out_component,
+                                                       const StringRef name,
+                                                       const AttributeDomain domain,
+                                                       const CustomDataType data_type)
+{
+  /* Don't try to create the attribute on the new component if it already exists (i.e. has been
+   * initialized by someone else). */
+  if (!out_component.attribute_exists(name)) {
+    if (!out_component.attribute_try_create(name, domain, data_type)) {
+      return {};
+    }
+  }
+  WriteAttributePtr out_attribute = out_component.attribute_try_get_for_write(name);
+  BLI_assert(out_attribute);
+  return out_attribute;
+}
+
+/**
+ * Move the original attribute values to the two output components. An output component can be
+ * null when the corresponding output is not used.
  *
  * \note This assumes a consistent ordering of indices before and after the split,
  * which is true for points and a simple vertex array.
  */
 static void move_split_attributes(const GeometryComponent &in_component,
-                                  GeometryComponent &out_component_a,
-                                  GeometryComponent &out_component_b,
+                                  GeometryComponent *out_component_a,
+                                  GeometryComponent *out_component_b,
                                   Span<bool> a_or_b)
 {
   Set<std::string> attribute_names = in_component.attribute_names();
@@ -84,27 +110,23 @@ static void move_split_attributes(const GeometryComponent &in_component,
     const CustomDataType data_type = bke::cpp_type_to_custom_data_type(attribute->cpp_type());
     const AttributeDomain domain = attribute->domain();
 
-    /* Don't try to create the attribute on the new component if it already exists (i.e. has been
-     * initialized by someone else). */
-    if (!out_component_a.attribute_exists(name)) {
-      if (!out_component_a.attribute_try_create(name, domain, data_type)) {
+    WriteAttributePtr out_attribute_a;
+    WriteAttributePtr out_attribute_b;
+    if (out_component_a != nullptr) {
+      out_attribute_a = split_attribute_get_for_write(*out_component_a, name, domain, data_type);
+      if (!out_attribute_a) {
         continue;
       }
     }
-    if (!out_component_b.attribute_exists(name)) {
-      if (!out_component_b.attribute_try_create(name, domain, data_type)) {
+    if (out_component_b != nullptr) {
+      out_attribute_b = split_attribute_get_for_write(*out_component_b, name, domain, data_type);
+      if (!out_attribute_b) {
         continue;
       }
     }
 
-    WriteAttributePtr out_attribute_a = out_component_a.attribute_try_get_for_write(name);
-    WriteAttributePtr out_attribute_b = out_component_b.attribute_try_get_for_write(name);
-    if (!out_attribute_a || !out_attribute_b) {
-      BLI_assert(false);
-      continue;
-    }
-
-    fill_new_attribute_from_input(*attribute, *out_attribute_a, *out_attribute_b, a_or_b);
+    fill_new_attribute_from_input(
+        *attribute, out_attribute_a.get(), out_attribute_b.get(), a_or_b);
   }
 }
 
@@ -134,8 +156,8 @@ static Array<bool> count_point_splits(const GeometryComponent &component,
 
 static void separate_mesh(const MeshComponent &in_component,
                           const GeoNodeExecParams &params,
-                          MeshComponent &out_component_a,
-                          MeshComponent &out_component_b)
+                          MeshComponent *out_component_a,
+                          MeshComponent *out_component_b)
 {
   const int size = in_component.attribute_domain_size(ATTR_DOMAIN_POINT);
   if (size == 0) {
@@ -146,16 +168,20 @@ static void separate_mesh(const MeshComponent &in_component,
   int b_total;
   Array<bool> a_or_b = count_point_splits(in_component, params, &a_total, &b_total);
 
-  out_component_a.replace(BKE_mesh_new_nomain(a_total, 0, 0, 0, 0));
-  out_component_b.replace(BKE_mesh_new_nomain(b_total, 0, 0, 0, 0));
+  if (out_component_a != nullptr) {
+    out_component_a->replace(BKE_mesh_new_nomain(a_total, 0, 0, 0, 0));
+  }
+  if (out_component_b != nullptr) {
+    out_component_b->replace(BKE_mesh_new_nomain(b_total, 0, 0, 0, 0));
+  }
 
   move_split_attributes(in_component, out_component_a, out_component_b, a_or_b);
 }
 
 static void separate_point_cloud(const PointCloudComponent &in_component,
                                  const GeoNodeExecParams &params,
-                                 PointCloudComponent &out_component_a,
-                                 PointCloudComponent &out_component_b)
+                                 PointCloudComponent *out_component_a,
+                                 PointCloudComponent *out_component_b)
 {
   const int size = in_component.attribute_domain_size(ATTR_DOMAIN_POINT);
   if (size == 0) {
@@ -166,16 +192,24 @@ static void separate_point_cloud(const PointCloudComponent &in_component,
   int b_total;
   Array<bool> a_or_b = count_point_splits(in_component, params, &a_total, &b_total);
 
-  out_component_a.replace(BKE_pointcloud_new_nomain(a_total));
-  out_component_b.replace(BKE_pointcloud_new_nomain(b_total));
+  if (out_component_a != nullptr) {
+    out_component_a->replace(BKE_pointcloud_new_nomain(a_total));
+  }
+  if (out_component_b != nullptr) {
+    out_component_b->replace(BKE_pointcloud_new_nomain(b_total));
+  }
 
   move_split_attributes(in_component, out_component_a, out_component_b, a_or_b);
 }
 
 static void geo_node_point_separate_exec(GeoNodeExecParams params)
 {
+  /* Outputs that are not used by other nodes are left empty. */
+  const bool compute_a = params.output_is_required("Geometry 1");
+  const bool compute_b = params.output_is_required("Geometry 2");
+
   GeometrySet geometry_set = params.extract_input<GeometrySet>("Geometry");
-  GeometrySet out_set_a(geometry_set);
+  GeometrySet out_set_a = compute_a ? geometry_set : GeometrySet();
   GeometrySet out_set_b;
 
   /* TODO: This is not necessary-- the input geometry set can be read only,
@@ -183,16 +217,17 @@ static void geo_node_point_separate_exec(GeoNodeExecParams params)
   geometry_set = geometry_set_realize_instances(geometry_set);
 
   if (geometry_set.has<PointCloudComponent>()) {
-    separate_point_cloud(*geometry_set.get_component_for_read<PointCloudComponent>(),
-                         params,
-                         out_set_a.get_component_for_write<PointCloudComponent>(),
-                         out_set_b.get_component_for_write<PointCloudComponent>());
+    separate_point_cloud(
+        *geometry_set.get_component_for_read<PointCloudComponent>(),
+        params,
+        compute_a ? &out_set_a.get_component_for_write<PointCloudComponent>() : nullptr,
+        compute_b ? &out_set_b.get_component_for_write<PointCloudComponent>() : nullptr);
   }
   if (geometry_set.has<MeshComponent>()) {
     separate_mesh(*geometry_set.get_component_for_read<MeshComponent>(),
                   params,
-                  out_set_a.get_component_for_write<MeshComponent>(),
-                  out_set_b.get_component_for_write<MeshComponent>());
+                  compute_a ? &out_set_a.get_component_for_write<MeshComponent>() : nullptr,
+                  compute_b ? &out_set_b.get_component_for_write<MeshComponent>() : nullptr);
   }
 
   params.set_output("Geometry 1", std::move(out_set_a));
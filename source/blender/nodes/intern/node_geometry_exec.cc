@@ -29,6 +29,10 @@ namespace blender::nodes {
 
 void GeoNodeExecParams::error_message_add(const NodeWarningType type, std::string message) const
 {
+  if (r_warnings_ != nullptr) {
+    r_warnings_->append({type, message});
+  }
+
   bNodeTree *btree_cow = node_->btree();
   BLI_assert(btree_cow != nullptr);
   if (btree_cow == nullptr) {
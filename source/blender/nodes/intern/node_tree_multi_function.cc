@@ -241,6 +241,27 @@ void DataTypeConversions::convert(const CPPType &from_type,
   fn->call({0}, params, context);
 }
 
+/**
+ * Convert many values at once. The values in the destination buffer are expected to be
+ * uninitialized.
+ */
+void DataTypeConversions::convert_n(const CPPType &from_type,
+                                    const CPPType &to_type,
+                                    const void *from_values,
+                                    void *to_values,
+                                    const int64_t amount) const
+{
+  const fn::MultiFunction *fn = this->get_conversion(MFDataType::ForSingle(from_type),
+                                                     MFDataType::ForSingle(to_type));
+  BLI_assert(fn != nullptr);
+
+  fn::MFContextBuilder context;
+  fn::MFParamsBuilder params{*fn, amount};
+  params.add_readonly_single_input(fn::GSpan(from_type, from_values, amount));
+  params.add_uninitialized_single_output(fn::GMutableSpan(to_type, to_values, amount));
+  fn->call(IndexRange(amount), params, context);
+}
+
 static fn::MFOutputSocket &insert_default_value_for_type(CommonMFNetworkBuilderData &common,
                                                          fn::MFDataType type)
 {
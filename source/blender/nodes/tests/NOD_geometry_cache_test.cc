@@ -0,0 +1,147 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "DNA_ID.h"
+#include "DNA_node_types.h"
+
+#include "NOD_geometry_cache.hh"
+
+namespace blender::nodes::tests {
+
+static CacheKey make_key(const uint64_t value)
+{
+  CacheKey key;
+  key.add("Node");
+  key.add(value);
+  return key;
+}
+
+static std::unique_ptr<GeometryNodesCache::Entry> make_entry(const int32_t value)
+{
+  std::unique_ptr<GeometryNodesCache::Entry> entry = std::make_unique<GeometryNodesCache::Entry>();
+  EXPECT_TRUE(entry->add_output("Value", CPPType::get<int32_t>(), &value));
+  return entry;
+}
+
+static int32_t entry_value(const GeometryNodesCache::Entry &entry)
+{
+  const GMutablePointer *value = entry.lookup_output("Value");
+  EXPECT_NE(value, nullptr);
+  return *value->get<int32_t>();
+}
+
+TEST(geometry_nodes_cache, KeyEquality)
+{
+  const CacheKey a = make_key(5);
+  const CacheKey b = make_key(5);
+  const CacheKey c = make_key(6);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a.hash(), b.hash());
+  EXPECT_FALSE(a == c);
+  EXPECT_NE(a.hash(), c.hash());
+}
+
+TEST(geometry_nodes_cache, KeyOrderAndBoundaries)
+{
+  CacheKey a;
+  a.add(static_cast<uint64_t>(1));
+  a.add(static_cast<uint64_t>(2));
+  CacheKey b;
+  b.add(static_cast<uint64_t>(2));
+  b.add(static_cast<uint64_t>(1));
+  EXPECT_FALSE(a == b);
+  EXPECT_NE(a.hash(), b.hash());
+
+  /* Strings are prefixed with their length, so splitting them differently changes the key. */
+  CacheKey c;
+  c.add("ab");
+  c.add("c");
+  CacheKey d;
+  d.add("a");
+  d.add("bc");
+  EXPECT_FALSE(c == d);
+  EXPECT_NE(c.hash(), d.hash());
+}
+
+TEST(geometry_nodes_cache, LookupAndAdd)
+{
+  GeometryNodesCache cache;
+  EXPECT_EQ(cache.lookup(make_key(1)), nullptr);
+
+  cache.add(make_key(1), make_entry(10));
+  /* An entry that exists already is not replaced. */
+  cache.add(make_key(1), make_entry(20));
+  EXPECT_EQ(cache.size(), 1);
+
+  const std::shared_ptr<const GeometryNodesCache::Entry> entry = cache.lookup(make_key(1));
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry_value(*entry), 10);
+  EXPECT_EQ(cache.lookup(make_key(2)), nullptr);
+}
+
+TEST(geometry_nodes_cache, EvictLeastRecentlyUsed)
+{
+  const int64_t entry_size = make_entry(0)->memory_size() + make_key(0).memory_size();
+  GeometryNodesCache cache(2 * entry_size);
+
+  cache.add(make_key(1), make_entry(1));
+  cache.add(make_key(2), make_entry(2));
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.memory_used(), 2 * entry_size);
+
+  /* The first entry is used again, so the second one is the least recently used. */
+  EXPECT_NE(cache.lookup(make_key(1)), nullptr);
+  cache.add(make_key(3), make_entry(3));
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.memory_used(), 2 * entry_size);
+  EXPECT_NE(cache.lookup(make_key(1)), nullptr);
+  EXPECT_EQ(cache.lookup(make_key(2)), nullptr);
+  EXPECT_NE(cache.lookup(make_key(3)), nullptr);
+}
+
+TEST(geometry_nodes_cache, EntryLargerThanBudget)
+{
+  const int64_t entry_size = make_entry(0)->memory_size() + make_key(0).memory_size();
+  GeometryNodesCache cache(entry_size - 1);
+  cache.add(make_key(1), make_entry(1));
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(cache.memory_used(), 0);
+}
+
+TEST(geometry_nodes_cache, EvictedEntryStaysValid)
+{
+  const int64_t entry_size = make_entry(0)->memory_size() + make_key(0).memory_size();
+  GeometryNodesCache cache(entry_size);
+  cache.add(make_key(1), make_entry(1));
+  const std::shared_ptr<const GeometryNodesCache::Entry> entry = cache.lookup(make_key(1));
+  cache.add(make_key(2), make_entry(2));
+  EXPECT_EQ(cache.lookup(make_key(1)), nullptr);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry_value(*entry), 1);
+}
+
+TEST(geometry_nodes_cache, NodeWithIDNotCached)
+{
+  /* The data of an ID can change without the node changing, so a node that uses a changed ID
+   * must not find the outputs that were cached for the old ID data. */
+  bNode node = {};
+  EXPECT_TRUE(node_supports_caching(node));
+  ID id = {};
+  node.id = &id;
+  EXPECT_FALSE(node_supports_caching(node));
+}
+
+TEST(geometry_nodes_cache, SlowNodes)
+{
+  GeometryNodesCache cache;
+  EXPECT_FALSE(cache.has_slow_nodes());
+  cache.tag_slow_node("Group/Subdivide");
+  EXPECT_TRUE(cache.has_slow_nodes());
+  EXPECT_TRUE(cache.is_slow_node("Group/Subdivide"));
+  EXPECT_FALSE(cache.is_slow_node("Subdivide"));
+  cache.clear();
+  EXPECT_FALSE(cache.has_slow_nodes());
+}
+
+}  // namespace blender::nodes::tests